@@ -253,6 +253,19 @@ void MEM_enable_fail_on_memleak(void);
  */
 void MEM_use_lockfree_allocator(void);
 
+/**
+ * Switch allocator to fast mode (see #MEM_use_lockfree_allocator), and allocate small blocks from
+ * per-thread size-class arenas instead of the system allocator.
+ *
+ * This avoids contention in the system allocator when many threads allocate small blocks at the
+ * same time. Memory of freed small blocks is kept for reuse and not given back to the system.
+ * Larger blocks are still allocated with the system allocator. Memory usage tracking works the
+ * same as with #MEM_use_lockfree_allocator.
+ *
+ * \note The switch between allocator types can only happen before any allocation did happen.
+ */
+void MEM_use_lockfree_arena_allocator(void);
+
 /**
  * Switch allocator to slow fully guarded mode.
  *
@@ -264,6 +277,54 @@ void MEM_use_lockfree_allocator(void);
  */
 void MEM_use_guarded_allocator(void);
 
+/**
+ * Track the memory usage per block name (the `str` passed to e.g. #MEM_mallocN) and per thread.
+ *
+ * This is much cheaper than switching to the fully guarded allocator, so it can be used to find
+ * out which parts of the code use most memory in production builds. It's only supported by the
+ * lock-free allocator and adds one pointer to the size of every block.
+ *
+ * \note This can only change before any allocation did happen.
+ */
+void MEM_use_memory_tag_tracking(bool enabled);
+
+/** Memory usage of all blocks with the same name, see #MEM_foreach_tag_usage. */
+typedef struct MEM_TagUsage {
+  const char *name;
+  /**
+   * Index of the thread in order of creation when the usage is reported per thread, otherwise -1.
+   * Threads that have exited already are reported with -1 as well.
+   */
+  int thread_index;
+  /**
+   * Number of bytes allocated with this name. Per thread this is the number of bytes that the
+   * thread allocated minus the bytes it freed, which can be negative.
+   */
+  int64_t mem_in_use;
+  /** Number of blocks, can be negative per thread for the same reason as above. */
+  int64_t blocks_num;
+  /**
+   * Approximate peak of #mem_in_use since the last call to #MEM_reset_peak_memory. Zero when the
+   * usage is reported per thread.
+   */
+  int64_t peak;
+} MEM_TagUsage;
+
+/**
+ * Call \a func for the memory usage of every block name, or of every combination of name and
+ * thread when \a per_thread is true. Nothing is reported when tag tracking is disabled, see
+ * #MEM_use_memory_tag_tracking.
+ */
+void MEM_foreach_tag_usage(bool per_thread,
+                           void (*func)(const MEM_TagUsage *usage, void *user_data),
+                           void *user_data);
+
+/**
+ * Print the memory usage per block name and per thread. This is also part of
+ * #MEM_printmemlist_stats when tag tracking is enabled.
+ */
+void MEM_print_tag_usage(void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -165,6 +165,20 @@ void MEM_use_lockfree_allocator()
   MEM_name_ptr = MEM_lockfree_name_ptr;
   MEM_name_ptr_set = MEM_lockfree_name_ptr_set;
 #endif
+
+  mem_lockfree_use_arenas(false);
+}
+
+void MEM_use_lockfree_arena_allocator()
+{
+  MEM_use_lockfree_allocator();
+  mem_lockfree_use_arenas(true);
+}
+
+void MEM_use_memory_tag_tracking(const bool enabled)
+{
+  assert_for_allocator_change();
+  mem_lockfree_use_tags(enabled);
 }
 
 void MEM_use_guarded_allocator()
@@ -0,0 +1,299 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup intern_mem
+ *
+ * Small block allocator with per-thread caches, used by the lock-free allocator after
+ * #MEM_use_lockfree_arena_allocator has been called.
+ *
+ * Blocks are grouped into size classes. Every thread has a free list per size class, so that most
+ * allocations and frees don't need any synchronization. Free blocks are moved between the threads
+ * and a global pool in batches, which only requires locking a mutex of the size class once per
+ * batch. New blocks are allocated in slabs that contain one batch each.
+ *
+ * Memory of slabs is never returned to the system. It is reused for later allocations of the
+ * same size class instead. That's usually fine because the small blocks only make up a fraction
+ * of the total memory usage, and the same kinds of allocations happen again and again.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+#include "MEM_guardedalloc.h"
+#include "mallocn_intern.hh"
+
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+namespace {
+
+struct FreeBlock {
+  FreeBlock *next;
+  /** Only used by the first block of a batch in #SizeClass::batches. */
+  FreeBlock *next_batch;
+};
+
+/**
+ * Every slab starts with this header. It's only used to keep the slabs reachable, which avoids
+ * false positives in leak checkers.
+ */
+struct alignas(16) SlabHeader {
+  SlabHeader *next;
+};
+
+/** 16 byte steps up to 128 bytes, then 4 classes per power of two up to #MEM_ARENA_MAX_SIZE. */
+constexpr int size_classes_num = 8 + 3 * 4;
+/** Approximate size of a batch in bytes. */
+constexpr size_t batch_bytes = 16 * 1024;
+
+struct alignas(64) SizeClass {
+  std::mutex mutex;
+  size_t block_size = 0;
+  int batch_size = 0;
+  /** Stack of full batches, linked with #FreeBlock::next_batch. */
+  FreeBlock *batches = nullptr;
+  /** Blocks returned by exiting threads, these don't form a full batch. */
+  FreeBlock *loose = nullptr;
+  int loose_num = 0;
+};
+
+struct Global {
+  SizeClass size_classes[size_classes_num];
+  /** Size class index for every multiple of 16 bytes up to #MEM_ARENA_MAX_SIZE. */
+  uint8_t size_class_by_size[MEM_ARENA_MAX_SIZE / 16 + 1];
+
+  std::mutex slabs_mutex;
+  SlabHeader *slabs = nullptr;
+
+  Global()
+  {
+    for (int i = 0; i < size_classes_num; i++) {
+      size_t block_size;
+      if (i < 8) {
+        block_size = size_t(i + 1) * 16;
+      }
+      else {
+        block_size = size_t(5 + (i - 8) % 4) << (5 + (i - 8) / 4);
+      }
+      size_classes[i].block_size = block_size;
+      size_classes[i].batch_size = int(std::clamp<size_t>(batch_bytes / block_size, 8, 256));
+    }
+    assert(size_classes[size_classes_num - 1].block_size == MEM_ARENA_MAX_SIZE);
+
+    int size_class = 0;
+    for (size_t i = 0; i <= MEM_ARENA_MAX_SIZE / 16; i++) {
+      while (size_classes[size_class].block_size < i * 16) {
+        size_class++;
+      }
+      size_class_by_size[i] = uint8_t(size_class);
+    }
+  }
+};
+
+struct LocalSizeClass {
+  FreeBlock *free = nullptr;
+  int free_num = 0;
+};
+
+struct LocalCache {
+  LocalSizeClass size_classes[size_classes_num];
+
+  LocalCache();
+  ~LocalCache();
+};
+
+}  // namespace
+
+/**
+ * The global data is never destructed, because blocks may still be freed during destruction of
+ * static variables and thread-locals, in unspecified order.
+ */
+static Global &get_global()
+{
+  static Global *global = new Global();
+  return *global;
+}
+
+/**
+ * Trivially destructible, so it can still be accessed while the thread is exiting. Null before the
+ * cache of the current thread has been created and after it has been destructed.
+ */
+static thread_local LocalCache *local_cache = nullptr;
+static thread_local bool local_cache_destructed = false;
+
+static LocalCache *get_local_cache()
+{
+  if (LIKELY(local_cache)) {
+    return local_cache;
+  }
+  if (local_cache_destructed) {
+    return nullptr;
+  }
+  static thread_local LocalCache cache;
+  return &cache;
+}
+
+static FreeBlock *allocate_slab(SizeClass &size_class, int &r_num)
+{
+  const size_t block_size = size_class.block_size;
+  const int batch_size = size_class.batch_size;
+  char *data = static_cast<char *>(
+      malloc(sizeof(SlabHeader) + block_size * size_t(batch_size)));
+  if (UNLIKELY(data == nullptr)) {
+    return nullptr;
+  }
+
+  SlabHeader *header = reinterpret_cast<SlabHeader *>(data);
+  Global &global = get_global();
+  {
+    std::lock_guard lock{global.slabs_mutex};
+    header->next = global.slabs;
+    global.slabs = header;
+  }
+
+  char *blocks = data + sizeof(SlabHeader);
+  for (int i = 0; i < batch_size; i++) {
+    FreeBlock *block = reinterpret_cast<FreeBlock *>(blocks + size_t(i) * block_size);
+    block->next = (i + 1 < batch_size) ?
+                      reinterpret_cast<FreeBlock *>(blocks + size_t(i + 1) * block_size) :
+                      nullptr;
+  }
+  r_num = batch_size;
+  return reinterpret_cast<FreeBlock *>(blocks);
+}
+
+/** Take free blocks from the global pool, or allocate new ones. */
+static FreeBlock *take_blocks(SizeClass &size_class, int &r_num)
+{
+  {
+    std::lock_guard lock{size_class.mutex};
+    if (FreeBlock *batch = size_class.batches) {
+      size_class.batches = batch->next_batch;
+      r_num = size_class.batch_size;
+      return batch;
+    }
+    if (FreeBlock *loose = size_class.loose) {
+      r_num = size_class.loose_num;
+      size_class.loose = nullptr;
+      size_class.loose_num = 0;
+      return loose;
+    }
+  }
+  return allocate_slab(size_class, r_num);
+}
+
+/** Give a list of \a num blocks back to the global pool. */
+static void give_blocks(SizeClass &size_class, FreeBlock *head, const int num)
+{
+  if (num == size_class.batch_size) {
+    std::lock_guard lock{size_class.mutex};
+    head->next_batch = size_class.batches;
+    size_class.batches = head;
+    return;
+  }
+  FreeBlock *tail = head;
+  while (tail->next) {
+    tail = tail->next;
+  }
+  std::lock_guard lock{size_class.mutex};
+  tail->next = size_class.loose;
+  size_class.loose = head;
+  size_class.loose_num += num;
+}
+
+LocalCache::LocalCache()
+{
+  local_cache = this;
+}
+
+LocalCache::~LocalCache()
+{
+  Global &global = get_global();
+  for (int i = 0; i < size_classes_num; i++) {
+    LocalSizeClass &local = size_classes[i];
+    if (local.free_num > 0) {
+      give_blocks(global.size_classes[i], local.free, local.free_num);
+    }
+  }
+  local_cache = nullptr;
+  local_cache_destructed = true;
+}
+
+static SizeClass &size_class_for_size(Global &global, const size_t size, int &r_index)
+{
+  assert(size <= MEM_ARENA_MAX_SIZE);
+  r_index = global.size_class_by_size[(size + 15) >> 4];
+  return global.size_classes[r_index];
+}
+
+void *mem_arena_alloc(const size_t size)
+{
+  Global &global = get_global();
+  int index;
+  SizeClass &size_class = size_class_for_size(global, size, index);
+
+  LocalCache *cache = get_local_cache();
+  if (UNLIKELY(cache == nullptr)) {
+    /* The thread is exiting, use the global pool directly. */
+    int num;
+    FreeBlock *blocks = take_blocks(size_class, num);
+    if (UNLIKELY(blocks == nullptr)) {
+      return nullptr;
+    }
+    if (num > 1) {
+      give_blocks(size_class, blocks->next, num - 1);
+    }
+    return blocks;
+  }
+
+  LocalSizeClass &local = cache->size_classes[index];
+  if (UNLIKELY(local.free == nullptr)) {
+    local.free = take_blocks(size_class, local.free_num);
+    if (UNLIKELY(local.free == nullptr)) {
+      local.free_num = 0;
+      return nullptr;
+    }
+  }
+  FreeBlock *block = local.free;
+  local.free = block->next;
+  local.free_num--;
+  return block;
+}
+
+void mem_arena_free(void *ptr, const size_t size)
+{
+  Global &global = get_global();
+  int index;
+  SizeClass &size_class = size_class_for_size(global, size, index);
+  FreeBlock *block = static_cast<FreeBlock *>(ptr);
+
+  LocalCache *cache = get_local_cache();
+  if (UNLIKELY(cache == nullptr)) {
+    block->next = nullptr;
+    give_blocks(size_class, block, 1);
+    return;
+  }
+
+  LocalSizeClass &local = cache->size_classes[index];
+  block->next = local.free;
+  local.free = block;
+  local.free_num++;
+
+  /* Keep one batch locally, so that alternating allocations and frees don't access the global
+   * pool every time. */
+  if (UNLIKELY(local.free_num >= size_class.batch_size * 2)) {
+    FreeBlock *tail = local.free;
+    for (int i = 1; i < size_class.batch_size; i++) {
+      tail = tail->next;
+    }
+    FreeBlock *batch = local.free;
+    local.free = tail->next;
+    local.free_num -= size_class.batch_size;
+    tail->next = nullptr;
+    give_blocks(size_class, batch, size_class.batch_size);
+  }
+}
@@ -88,6 +88,17 @@ void aligned_free(void *ptr);
 extern bool leak_detector_has_run;
 extern char free_after_leak_detection_message[];
 
+/**
+ * Blocks up to this size (including the #MemHead) are allocated from per-thread size-class arenas
+ * when #MEM_use_lockfree_arena_allocator has been called.
+ */
+#define MEM_ARENA_MAX_SIZE 1024
+
+/** Allocate a block of up to #MEM_ARENA_MAX_SIZE bytes, 16 byte aligned. */
+void *mem_arena_alloc(size_t size);
+/** Free a block allocated with #mem_arena_alloc, \a size has to be the same. */
+void mem_arena_free(void *ptr, size_t size);
+
 void memory_usage_init(void);
 void memory_usage_block_alloc(size_t size);
 void memory_usage_block_free(size_t size);
@@ -95,6 +106,8 @@ size_t memory_usage_block_num(void);
 size_t memory_usage_current(void);
 size_t memory_usage_peak(void);
 void memory_usage_peak_reset(void);
+void memory_usage_tag_alloc(const char *name, size_t size);
+void memory_usage_tag_free(const char *name, size_t size);
 
 /**
  * Clear the listbase of allocated memory blocks.
@@ -153,6 +166,8 @@ void MEM_lockfree_reset_peak_memory(void);
 size_t MEM_lockfree_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
 
 void mem_lockfree_clearmemlist(void);
+void mem_lockfree_use_arenas(bool use);
+void mem_lockfree_use_tags(bool use);
 
 #ifndef NDEBUG
 const char *MEM_lockfree_name_ptr(void *vmemh);
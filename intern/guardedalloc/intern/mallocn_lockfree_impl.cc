@@ -45,7 +45,21 @@ typedef struct MemHeadAligned {
 static_assert(MEM_MIN_CPP_ALIGNMENT <= alignof(MemHeadAligned), "Bad alignment of MemHeadAligned");
 static_assert(MEM_MIN_CPP_ALIGNMENT <= sizeof(MemHeadAligned), "Bad size of MemHeadAligned");
 
+/**
+ * Stored in front of the #MemHead when tag tracking is enabled, see #MEM_use_memory_tag_tracking.
+ * Blocks with a #MemHeadAligned store it at the end of their padding instead.
+ */
+typedef struct MemTag {
+  const char *name;
+} MemTag;
+static_assert(sizeof(MemTag) <= MEMHEAD_ALIGN_PADDING(ALIGNED_MALLOC_MINIMUM_ALIGNMENT),
+              "MemTag does not fit into the padding of MemHeadAligned");
+
 static bool malloc_debug_memset = false;
+/** Allocate small blocks from per-thread arenas, see #MEM_use_lockfree_arena_allocator. */
+static bool use_arenas = false;
+/** Store the name of every block and track memory usage per name. */
+static bool use_tags = false;
 
 static void (*error_callback)(const char *) = nullptr;
 
@@ -73,6 +87,7 @@ enum {
 #define MEMHEAD_IS_ALIGNED(memhead) ((memhead)->len & size_t(MEMHEAD_FLAG_ALIGN))
 #define MEMHEAD_IS_FROM_CPP_NEW(memhead) ((memhead)->len & size_t(MEMHEAD_FLAG_FROM_CPP_NEW))
 #define MEMHEAD_LEN(memhead) ((memhead)->len & ~size_t(MEMHEAD_FLAG_MASK))
+#define MEMTAG_FROM_MEMHEAD(memhead) (((MemTag *)(memhead)) - 1)
 
 #ifdef __GNUC__
 __attribute__((format(printf, 1, 0)))
@@ -121,8 +136,9 @@ report_error_on_address(const void *vmemh, const char *message, ...)
   const MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
   const size_t len = MEMHEAD_LEN(memh);
 
-  const void *address = memh;
-  size_t size = len + sizeof(*memh);
+  const size_t tag_size = use_tags ? sizeof(MemTag) : 0;
+  const void *address = (const char *)memh - tag_size;
+  size_t size = len + sizeof(*memh) + tag_size;
   if (UNLIKELY(MEMHEAD_IS_ALIGNED(memh))) {
     const MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
     address = MEMHEAD_REAL_PTR(memh_aligned);
@@ -131,6 +147,58 @@ report_error_on_address(const void *vmemh, const char *message, ...)
   MEM_trigger_error_on_memory_block(address, size);
 }
 
+/** Size of everything in front of the data of blocks with a #MemHead. */
+static size_t memhead_header_size()
+{
+  return sizeof(MemHead) + (use_tags ? sizeof(MemTag) : 0);
+}
+
+/**
+ * Allocate the memory for a block with a #MemHead (not #MemHeadAligned) and \a len bytes of data.
+ */
+static MemHead *memhead_alloc(const size_t len, const bool clear)
+{
+  const size_t header_size = memhead_header_size();
+  const size_t size = len + header_size;
+  void *ptr;
+  if (use_arenas && size <= MEM_ARENA_MAX_SIZE) {
+    ptr = mem_arena_alloc(size);
+    if (clear && ptr) {
+      memset(ptr, 0, size);
+    }
+  }
+  else {
+    ptr = clear ? calloc(1, size) : malloc(size);
+  }
+  if (UNLIKELY(ptr == nullptr)) {
+    return nullptr;
+  }
+  return ((MemHead *)((char *)ptr + header_size)) - 1;
+}
+
+static void memhead_free(MemHead *memh, const size_t len)
+{
+  const size_t header_size = memhead_header_size();
+  const size_t size = len + header_size;
+  void *ptr = (char *)PTR_FROM_MEMHEAD(memh) - header_size;
+  if (use_arenas && size <= MEM_ARENA_MAX_SIZE) {
+    mem_arena_free(ptr, size);
+  }
+  else {
+    free(ptr);
+  }
+}
+
+/** Name that was passed when the block was allocated. Only available when tags are used. */
+static const char *memhead_tag_name(const void *vmemh)
+{
+  const MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+  if (UNLIKELY(MEMHEAD_IS_ALIGNED(memh))) {
+    return MEMTAG_FROM_MEMHEAD(MEMHEAD_ALIGNED_FROM_PTR(vmemh))->name;
+  }
+  return MEMTAG_FROM_MEMHEAD(memh)->name;
+}
+
 size_t MEM_lockfree_allocN_len(const void *vmemh)
 {
   if (LIKELY(vmemh)) {
@@ -161,6 +229,9 @@ void MEM_lockfree_freeN(void *vmemh, AllocationType allocation_type)
   }
 
   memory_usage_block_free(len);
+  if (UNLIKELY(use_tags)) {
+    memory_usage_tag_free(memhead_tag_name(vmemh), len);
+  }
 
   if (UNLIKELY(malloc_debug_memset && len)) {
     memset(memh + 1, 255, len);
@@ -170,7 +241,7 @@ void MEM_lockfree_freeN(void *vmemh, AllocationType allocation_type)
     aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
   }
   else {
-    free(memh);
+    memhead_free(memh, len);
   }
 }
 
@@ -186,14 +257,16 @@ void *MEM_lockfree_dupallocN(const void *vmemh)
                               "Attempt to use C-style MEM_dupallocN on a pointer created with "
                               "CPP-style MEM_new or new\n");
     }
+    /* Keep the original name, so that the memory usage is attributed to the same tag. */
+    const char *name = use_tags ? memhead_tag_name(vmemh) : "dupli_malloc";
 
     if (UNLIKELY(MEMHEAD_IS_ALIGNED(memh))) {
       const MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
       newp = MEM_lockfree_mallocN_aligned(
-          prev_size, size_t(memh_aligned->alignment), "dupli_malloc", AllocationType::ALLOC_FREE);
+          prev_size, size_t(memh_aligned->alignment), name, AllocationType::ALLOC_FREE);
     }
     else {
-      newp = MEM_lockfree_mallocN(prev_size, "dupli_malloc");
+      newp = MEM_lockfree_mallocN(prev_size, name);
     }
     memcpy(newp, vmemh, prev_size);
   }
@@ -213,14 +286,15 @@ void *MEM_lockfree_reallocN_id(void *vmemh, size_t len, const char *str)
                               "Attempt to use C-style MEM_reallocN on a pointer created with "
                               "CPP-style MEM_new or new\n");
     }
+    const char *name = use_tags ? memhead_tag_name(vmemh) : "realloc";
 
     if (LIKELY(!MEMHEAD_IS_ALIGNED(memh))) {
-      newp = MEM_lockfree_mallocN(len, "realloc");
+      newp = MEM_lockfree_mallocN(len, name);
     }
     else {
       const MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
       newp = MEM_lockfree_mallocN_aligned(
-          len, size_t(memh_aligned->alignment), "realloc", AllocationType::ALLOC_FREE);
+          len, size_t(memh_aligned->alignment), name, AllocationType::ALLOC_FREE);
     }
 
     if (newp) {
@@ -256,14 +330,15 @@ void *MEM_lockfree_recallocN_id(void *vmemh, size_t len, const char *str)
                               "Attempt to use C-style MEM_recallocN on a pointer created with "
                               "CPP-style MEM_new or new\n");
     }
+    const char *name = use_tags ? memhead_tag_name(vmemh) : "recalloc";
 
     if (LIKELY(!MEMHEAD_IS_ALIGNED(memh))) {
-      newp = MEM_lockfree_mallocN(len, "recalloc");
+      newp = MEM_lockfree_mallocN(len, name);
     }
     else {
       const MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
       newp = MEM_lockfree_mallocN_aligned(
-          len, size_t(memh_aligned->alignment), "recalloc", AllocationType::ALLOC_FREE);
+          len, size_t(memh_aligned->alignment), name, AllocationType::ALLOC_FREE);
     }
 
     if (newp) {
@@ -297,11 +372,15 @@ void *MEM_lockfree_callocN(size_t len, const char *str)
 
   len = SIZET_ALIGN_4(len);
 
-  memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+  memh = memhead_alloc(len, true);
 
   if (LIKELY(memh)) {
     memh->len = len;
     memory_usage_block_alloc(len);
+    if (UNLIKELY(use_tags)) {
+      MEMTAG_FROM_MEMHEAD(memh)->name = str;
+      memory_usage_tag_alloc(str, len);
+    }
 
     return PTR_FROM_MEMHEAD(memh);
   }
@@ -339,7 +418,7 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 #endif
   len = SIZET_ALIGN_4(len);
 
-  memh = (MemHead *)malloc(len + sizeof(MemHead));
+  memh = memhead_alloc(len, false);
 
   if (LIKELY(memh)) {
 
@@ -359,6 +438,10 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 
     memh->len = len;
     memory_usage_block_alloc(len);
+    if (UNLIKELY(use_tags)) {
+      MEMTAG_FROM_MEMHEAD(memh)->name = str;
+      memory_usage_tag_alloc(str, len);
+    }
 
     return PTR_FROM_MEMHEAD(memh);
   }
@@ -404,6 +487,18 @@ void *MEM_lockfree_mallocN_aligned(size_t len,
     alignment = ALIGNED_MALLOC_MINIMUM_ALIGNMENT;
   }
 
+  /* Small blocks with the default alignment (most blocks allocated by #MEM_new) can use the
+   * arenas too, because their data is sufficiently aligned with a #MemHead. */
+  if (use_arenas && alignment <= MEM_MIN_CPP_ALIGNMENT &&
+      SIZET_ALIGN_4(len) + memhead_header_size() <= MEM_ARENA_MAX_SIZE)
+  {
+    void *ptr = MEM_lockfree_mallocN(len, str);
+    if (LIKELY(ptr) && allocation_type == AllocationType::NEW_DELETE) {
+      MEMHEAD_FROM_PTR(ptr)->len |= size_t(MEMHEAD_FLAG_FROM_CPP_NEW);
+    }
+    return ptr;
+  }
+
   /* It's possible that MemHead's size is not properly aligned,
    * do extra padding to deal with this.
    *
@@ -446,6 +541,11 @@ void *MEM_lockfree_mallocN_aligned(size_t len,
                                                                        0);
     memh->alignment = short(alignment);
     memory_usage_block_alloc(len);
+    if (UNLIKELY(use_tags)) {
+      /* The padding is always large enough for the tag. */
+      MEMTAG_FROM_MEMHEAD(memh)->name = str;
+      memory_usage_tag_alloc(str, len);
+    }
 
     return PTR_FROM_MEMHEAD(memh);
   }
@@ -502,6 +602,9 @@ void MEM_lockfree_printmemlist_stats()
 {
   printf("\ntotal memory len: %.3f MB\n", double(memory_usage_current()) / double(1024 * 1024));
   printf("peak memory len: %.3f MB\n", double(memory_usage_peak()) / double(1024 * 1024));
+  if (use_tags) {
+    MEM_print_tag_usage();
+  }
   printf(
       "\nFor more detailed per-block statistics run Blender with memory debugging command line "
       "argument.\n");
@@ -522,6 +625,16 @@ bool MEM_lockfree_consistency_check()
   return true;
 }
 
+void mem_lockfree_use_arenas(const bool use)
+{
+  use_arenas = use;
+}
+
+void mem_lockfree_use_tags(const bool use)
+{
+  use_tags = use;
+}
+
 void MEM_lockfree_set_memory_debug()
 {
   malloc_debug_memset = true;
@@ -552,6 +665,9 @@ size_t MEM_lockfree_get_peak_memory()
 const char *MEM_lockfree_name_ptr(void *vmemh)
 {
   if (vmemh) {
+    if (use_tags) {
+      return memhead_tag_name(vmemh);
+    }
     return "unknown block name ptr";
   }
 
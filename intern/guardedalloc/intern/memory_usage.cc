@@ -5,9 +5,14 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <unordered_map>
 #include <vector>
 
 #include "MEM_guardedalloc.h"
@@ -20,6 +25,64 @@ namespace {
 struct Local;
 struct Global;
 
+/**
+ * Allocator for the containers that are used while tracking memory tags. They can't use
+ * guardedalloc themselves, because they are modified during allocations (and C++ `new` may be
+ * overridden to use guardedalloc).
+ */
+template<typename T> struct SystemAllocator {
+  using value_type = T;
+
+  SystemAllocator() = default;
+  template<typename U> SystemAllocator(const SystemAllocator<U> & /*other*/) {}
+
+  T *allocate(const size_t n)
+  {
+    void *ptr = malloc(n * sizeof(T));
+    if (ptr == nullptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, const size_t /*n*/)
+  {
+    free(ptr);
+  }
+
+  friend bool operator==(const SystemAllocator & /*a*/, const SystemAllocator & /*b*/)
+  {
+    return true;
+  }
+  friend bool operator!=(const SystemAllocator & /*a*/, const SystemAllocator & /*b*/)
+  {
+    return false;
+  }
+};
+
+template<typename T> using SystemVector = std::vector<T, SystemAllocator<T>>;
+
+/**
+ * Maps the name pointers passed to the allocation functions to some value. Names are compared by
+ * pointer, which is much cheaper than comparing the strings. Equal strings with different pointers
+ * are only merged when the usage is queried.
+ */
+template<typename T>
+using TagMap = std::unordered_map<const char *,
+                                  T,
+                                  std::hash<const char *>,
+                                  std::equal_to<const char *>,
+                                  SystemAllocator<std::pair<const char *const, T>>>;
+
+/** Memory usage of all blocks with the same name. */
+struct TagCounts {
+  /** Number of bytes, can be negative for the same reasons as #Local::mem_in_use. */
+  int64_t mem_in_use = 0;
+  int64_t blocks_num = 0;
+  /** Same as #Local::mem_in_use_during_peak_update, but for this tag only. */
+  int64_t mem_in_use_during_peak_update = 0;
+};
+
 /**
  * This is stored per thread. Align to cache line size to avoid false sharing.
  */
@@ -55,6 +118,15 @@ struct alignas(128) Local {
    */
   std::atomic<int64_t> mem_in_use_during_peak_update = 0;
 
+  /** Index of the thread in order of creation, used to identify it in reports. */
+  int thread_index = 0;
+  /**
+   * Protects #tags. It's only contended while another thread queries the memory usage per tag.
+   */
+  std::mutex tags_mutex;
+  /** Memory usage per block name. Only used when tag tracking is enabled. */
+  TagMap<TagCounts> tags;
+
   Local();
   ~Local();
 };
@@ -94,6 +166,19 @@ struct Global {
    * Peak memory usage since the last reset.
    */
   std::atomic<size_t> peak = 0;
+
+  /** Number of #Local that have been created. Protected by #locals_mutex. */
+  int threads_num = 0;
+  /**
+   * Memory usage per tag that is not tracked by #Local, for the same reason as
+   * #mem_in_use_outside_locals. Protected by #locals_mutex.
+   */
+  TagMap<TagCounts> tags_outside_locals;
+  /**
+   * Peak memory usage per tag since the last reset. Protected by #locals_mutex. Tags that did not
+   * reach the #peak_update_threshold yet are not in here, their peak is the current usage.
+   */
+  TagMap<size_t> tag_peaks;
 };
 
 }  // namespace
@@ -138,6 +223,7 @@ Local::Local()
      * created through #memory_usage_init. */
     this->is_main = true;
   }
+  this->thread_index = this->global->threads_num++;
   /* Register self in the global list. */
   this->global->locals.push_back(this);
 }
@@ -152,6 +238,15 @@ Local::~Local()
   /* Don't forget the memory counts stored locally. */
   this->global->blocks_num_outside_locals.fetch_add(this->blocks_num, std::memory_order_relaxed);
   this->global->mem_in_use_outside_locals.fetch_add(this->mem_in_use, std::memory_order_relaxed);
+  {
+    std::lock_guard tags_lock{this->tags_mutex};
+    for (const auto &[name, counts] : this->tags) {
+      TagCounts &global_counts = this->global->tags_outside_locals[name];
+      global_counts.mem_in_use += counts.mem_in_use;
+      global_counts.blocks_num += counts.blocks_num;
+    }
+    this->tags.clear();
+  }
 
   if (this->is_main) {
     /* The main thread started shutting down. Use global counters from now on to avoid accessing
@@ -272,4 +367,216 @@ void memory_usage_peak_reset()
 {
   Global &global = get_global();
   global.peak = memory_usage_current();
+
+  std::lock_guard lock{global.locals_mutex};
+  global.tag_peaks.clear();
+}
+
+/** Update the peak memory usage of a single tag, similar to #update_global_peak. */
+static void update_tag_peak(const char *name)
+{
+  Global &global = get_global();
+  std::lock_guard lock{global.locals_mutex};
+
+  int64_t mem_in_use = 0;
+  const auto outside_it = global.tags_outside_locals.find(name);
+  if (outside_it != global.tags_outside_locals.end()) {
+    mem_in_use += outside_it->second.mem_in_use;
+  }
+  for (Local *local : global.locals) {
+    std::lock_guard tags_lock{local->tags_mutex};
+    const auto it = local->tags.find(name);
+    if (it != local->tags.end()) {
+      mem_in_use += it->second.mem_in_use;
+      it->second.mem_in_use_during_peak_update = it->second.mem_in_use;
+    }
+  }
+  size_t &peak = global.tag_peaks[name];
+  peak = std::max(peak, size_t(std::max<int64_t>(mem_in_use, 0)));
+}
+
+void memory_usage_tag_alloc(const char *name, const size_t size)
+{
+  if (LIKELY(use_local_counters.load(std::memory_order_relaxed))) {
+    Local &local = get_local_data();
+    bool update_peak;
+    {
+      /* The mutex is only locked by other threads when the usage is queried. */
+      std::lock_guard lock{local.tags_mutex};
+      TagCounts &counts = local.tags[name];
+      counts.blocks_num++;
+      counts.mem_in_use += int64_t(size);
+      update_peak = counts.mem_in_use - counts.mem_in_use_during_peak_update >
+                    peak_update_threshold;
+    }
+    if (update_peak) {
+      update_tag_peak(name);
+    }
+  }
+  else {
+    Global &global = get_global();
+    std::lock_guard lock{global.locals_mutex};
+    TagCounts &counts = global.tags_outside_locals[name];
+    counts.blocks_num++;
+    counts.mem_in_use += int64_t(size);
+  }
+}
+
+void memory_usage_tag_free(const char *name, const size_t size)
+{
+  if (LIKELY(use_local_counters.load(std::memory_order_relaxed))) {
+    Local &local = get_local_data();
+    std::lock_guard lock{local.tags_mutex};
+    TagCounts &counts = local.tags[name];
+    counts.blocks_num--;
+    counts.mem_in_use -= int64_t(size);
+  }
+  else {
+    Global &global = get_global();
+    std::lock_guard lock{global.locals_mutex};
+    TagCounts &counts = global.tags_outside_locals[name];
+    counts.blocks_num--;
+    counts.mem_in_use -= int64_t(size);
+  }
+}
+
+namespace {
+
+struct ThreadTagCounts {
+  const char *name;
+  int thread_index;
+  TagCounts counts;
+};
+
+}  // namespace
+
+/**
+ * Copy the counts of all threads, so that no lock is held while the callbacks are called (which
+ * may allocate memory themselves).
+ */
+static void collect_tag_counts(SystemVector<ThreadTagCounts> &r_counts, TagMap<size_t> &r_peaks)
+{
+  Global &global = get_global();
+  std::lock_guard lock{global.locals_mutex};
+  for (const auto &[name, counts] : global.tags_outside_locals) {
+    r_counts.push_back({name, -1, counts});
+  }
+  for (Local *local : global.locals) {
+    std::lock_guard tags_lock{local->tags_mutex};
+    for (const auto &[name, counts] : local->tags) {
+      r_counts.push_back({name, local->thread_index, counts});
+    }
+  }
+  r_peaks = global.tag_peaks;
+}
+
+void MEM_foreach_tag_usage(const bool per_thread,
+                           void (*func)(const MEM_TagUsage *usage, void *user_data),
+                           void *user_data)
+{
+  SystemVector<ThreadTagCounts> thread_counts;
+  TagMap<size_t> peaks;
+  collect_tag_counts(thread_counts, peaks);
+
+  if (per_thread) {
+    for (const ThreadTagCounts &item : thread_counts) {
+      if (item.counts.blocks_num == 0 && item.counts.mem_in_use == 0) {
+        continue;
+      }
+      const MEM_TagUsage usage = {
+          item.name, item.thread_index, item.counts.mem_in_use, item.counts.blocks_num, 0};
+      func(&usage, user_data);
+    }
+    return;
+  }
+
+  /* Group by name first and by pointer second, to sum up the usage of all threads. */
+  std::sort(thread_counts.begin(),
+            thread_counts.end(),
+            [](const ThreadTagCounts &a, const ThreadTagCounts &b) {
+              const int cmp = strcmp(a.name, b.name);
+              return cmp < 0 || (cmp == 0 && std::less<const char *>()(a.name, b.name));
+            });
+  for (size_t start = 0; start < thread_counts.size();) {
+    MEM_TagUsage usage = {thread_counts[start].name, -1, 0, 0, 0};
+    size_t end = start;
+    while (end < thread_counts.size() && strcmp(thread_counts[end].name, usage.name) == 0) {
+      const char *name_ptr = thread_counts[end].name;
+      int64_t mem_in_use = 0;
+      for (; end < thread_counts.size() && thread_counts[end].name == name_ptr; end++) {
+        mem_in_use += thread_counts[end].counts.mem_in_use;
+        usage.blocks_num += thread_counts[end].counts.blocks_num;
+      }
+      usage.mem_in_use += mem_in_use;
+      /* Equal names with different pointers may have peaked at different times, so this is an
+       * upper bound for the peak of the name. */
+      const auto peak_it = peaks.find(name_ptr);
+      const int64_t peak = peak_it == peaks.end() ? 0 : int64_t(peak_it->second);
+      usage.peak += std::max(peak, mem_in_use);
+    }
+    start = end;
+    if (usage.blocks_num != 0 || usage.peak != 0) {
+      func(&usage, user_data);
+    }
+  }
+}
+
+void MEM_print_tag_usage()
+{
+  SystemVector<MEM_TagUsage> usages;
+  MEM_foreach_tag_usage(
+      false,
+      [](const MEM_TagUsage *usage, void *user_data) {
+        static_cast<SystemVector<MEM_TagUsage> *>(user_data)->push_back(*usage);
+      },
+      &usages);
+  std::sort(usages.begin(), usages.end(), [](const MEM_TagUsage &a, const MEM_TagUsage &b) {
+    return a.mem_in_use > b.mem_in_use || (a.mem_in_use == b.mem_in_use && a.peak > b.peak);
+  });
+
+  const double mb = double(1024 * 1024);
+  printf("\nMemory usage per block name:\n");
+  printf("%12s %10s %12s  %s\n", "In use (MB)", "Blocks", "Peak (MB)", "Name");
+  for (const MEM_TagUsage &usage : usages) {
+    printf("%12.3f %10lld %12.3f  %s\n",
+           double(usage.mem_in_use) / mb,
+           (long long)usage.blocks_num,
+           double(usage.peak) / mb,
+           usage.name);
+  }
+
+  /* Memory that was allocated minus memory that was freed by every thread. */
+  SystemVector<MEM_TagUsage> thread_usages;
+  MEM_foreach_tag_usage(
+      true,
+      [](const MEM_TagUsage *usage, void *user_data) {
+        SystemVector<MEM_TagUsage> &totals = *static_cast<SystemVector<MEM_TagUsage> *>(
+            user_data);
+        auto it = std::find_if(totals.begin(), totals.end(), [&](const MEM_TagUsage &item) {
+          return item.thread_index == usage->thread_index;
+        });
+        if (it == totals.end()) {
+          totals.push_back({nullptr, usage->thread_index, 0, 0, 0});
+          it = totals.end() - 1;
+        }
+        it->mem_in_use += usage->mem_in_use;
+        it->blocks_num += usage->blocks_num;
+      },
+      &thread_usages);
+  std::sort(thread_usages.begin(),
+            thread_usages.end(),
+            [](const MEM_TagUsage &a, const MEM_TagUsage &b) {
+              return a.thread_index < b.thread_index;
+            });
+
+  printf("\nMemory allocated minus memory freed per thread:\n");
+  for (const MEM_TagUsage &usage : thread_usages) {
+    if (usage.thread_index == -1) {
+      printf("  exited threads: ");
+    }
+    else {
+      printf("  thread %d: ", usage.thread_index);
+    }
+    printf("%.3f MB in %lld blocks\n", double(usage.mem_in_use) / mb, (long long)usage.blocks_num);
+  }
 }
@@ -0,0 +1,114 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "guardedalloc_test_base.h"
+
+namespace {
+
+struct TestObject {
+  int a = 1;
+  double b = 2.0;
+};
+
+}  // namespace
+
+TEST_F(LockFreeArenaAllocatorTest, MemoryInUse)
+{
+  const size_t mem_in_use = MEM_get_memory_in_use();
+  const uint blocks_in_use = MEM_get_memory_blocks_in_use();
+
+  std::vector<void *> ptrs;
+  size_t expected_size = 0;
+  /* Mix of small blocks from the arenas and larger blocks from the system allocator. */
+  for (size_t size : {0, 1, 8, 100, 500, 1016, 1017, 5000, 100000}) {
+    void *ptr = MEM_mallocN(size, __func__);
+    memset(ptr, 1, size);
+    EXPECT_EQ(MEM_allocN_len(ptr), (size + 3) & ~size_t(3));
+    expected_size += MEM_allocN_len(ptr);
+    ptrs.push_back(ptr);
+  }
+  EXPECT_EQ(MEM_get_memory_in_use() - mem_in_use, expected_size);
+  EXPECT_EQ(MEM_get_memory_blocks_in_use() - blocks_in_use, ptrs.size());
+
+  for (void *ptr : ptrs) {
+    MEM_freeN(ptr);
+  }
+  EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+  EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use);
+}
+
+TEST_F(LockFreeArenaAllocatorTest, CallocAndRealloc)
+{
+  /* Reuse the same blocks a few times, to make sure that they are cleared. */
+  for (int i = 0; i < 3; i++) {
+    char *data = static_cast<char *>(MEM_callocN(64, __func__));
+    for (int j = 0; j < 64; j++) {
+      EXPECT_EQ(data[j], 0);
+    }
+    memset(data, 1, 64);
+    data = static_cast<char *>(MEM_reallocN(data, 2000));
+    EXPECT_EQ(data[63], 1);
+    data = static_cast<char *>(MEM_recallocN(data, 32));
+    EXPECT_EQ(data[31], 1);
+    MEM_freeN(data);
+  }
+}
+
+TEST_F(LockFreeArenaAllocatorTest, New)
+{
+  TestObject *object = MEM_new<TestObject>(__func__);
+  EXPECT_EQ(object->a, 1);
+  EXPECT_EQ(object->b, 2.0);
+  EXPECT_EQ(size_t(object) % alignof(TestObject), 0);
+  MEM_delete(object);
+}
+
+TEST_F(LockFreeArenaAllocatorTest, Threads)
+{
+  const size_t mem_in_use = MEM_get_memory_in_use();
+  constexpr int threads_num = 4;
+  constexpr int blocks_num = 10000;
+
+  /* Every thread allocates blocks and frees the blocks allocated by the previous thread. */
+  std::vector<std::vector<int *>> blocks(threads_num);
+  for (const int round : {0, 1}) {
+    std::vector<std::thread> threads;
+    for (int thread_i = 0; thread_i < threads_num; thread_i++) {
+      threads.emplace_back([&, thread_i, round]() {
+        std::vector<int *> &own_blocks = blocks[thread_i];
+        if (round == 0) {
+          for (int i = 0; i < blocks_num; i++) {
+            int *block = static_cast<int *>(MEM_mallocN(sizeof(int) * size_t(1 + i % 50), "test"));
+            *block = i;
+            own_blocks.push_back(block);
+          }
+        }
+        else {
+          for (int *block : blocks[(thread_i + 1) % threads_num]) {
+            MEM_freeN(block);
+          }
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    if (round == 0) {
+      for (const std::vector<int *> &own_blocks : blocks) {
+        for (int i = 0; i < blocks_num; i++) {
+          EXPECT_EQ(*own_blocks[i], i);
+        }
+      }
+    }
+  }
+  EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+}
@@ -0,0 +1,166 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "guardedalloc_test_base.h"
+
+namespace {
+
+struct TestObject {
+  int a = 1;
+};
+
+/** Find the usage of the given name, the result is zero-initialized if it has not been found. */
+MEM_TagUsage find_tag_usage(const char *name, const int thread_index = -1)
+{
+  struct Data {
+    const char *name;
+    int thread_index;
+    MEM_TagUsage result;
+  } data = {name, thread_index, {name, thread_index, 0, 0, 0}};
+  MEM_foreach_tag_usage(
+      thread_index != -1,
+      [](const MEM_TagUsage *usage, void *user_data) {
+        Data &data = *static_cast<Data *>(user_data);
+        if (strcmp(usage->name, data.name) == 0 && usage->thread_index == data.thread_index) {
+          data.result = *usage;
+        }
+      },
+      &data);
+  return data.result;
+}
+
+}  // namespace
+
+TEST_F(LockFreeTagTrackingTest, Usage)
+{
+  void *a = MEM_mallocN(100, "tag test a");
+  void *b = MEM_callocN(20, "tag test b");
+  void *c = MEM_mallocN_aligned(64, 64, "tag test a");
+  EXPECT_EQ(size_t(c) % 64, 0);
+
+  MEM_TagUsage usage_a = find_tag_usage("tag test a");
+  EXPECT_EQ(usage_a.mem_in_use, 164);
+  EXPECT_EQ(usage_a.blocks_num, 2);
+  EXPECT_EQ(usage_a.peak, 164);
+  MEM_TagUsage usage_b = find_tag_usage("tag test b");
+  EXPECT_EQ(usage_b.mem_in_use, 20);
+  EXPECT_EQ(usage_b.blocks_num, 1);
+
+  /* Reallocated and duplicated blocks keep their name. */
+  a = MEM_reallocN(a, 200);
+  b = MEM_recallocN(b, 40);
+  void *d = MEM_dupallocN(c);
+  usage_a = find_tag_usage("tag test a");
+  EXPECT_EQ(usage_a.mem_in_use, 328);
+  EXPECT_EQ(usage_a.blocks_num, 3);
+  usage_b = find_tag_usage("tag test b");
+  EXPECT_EQ(usage_b.mem_in_use, 40);
+
+  MEM_freeN(a);
+  MEM_freeN(b);
+  MEM_freeN(c);
+  MEM_freeN(d);
+  usage_a = find_tag_usage("tag test a");
+  EXPECT_EQ(usage_a.mem_in_use, 0);
+  EXPECT_EQ(usage_a.blocks_num, 0);
+  usage_b = find_tag_usage("tag test b");
+  EXPECT_EQ(usage_b.mem_in_use, 0);
+  EXPECT_EQ(usage_b.blocks_num, 0);
+}
+
+TEST_F(LockFreeTagTrackingTest, Peak)
+{
+  MEM_reset_peak_memory();
+  std::vector<void *> blocks;
+  for (int i = 0; i < 10; i++) {
+    blocks.push_back(MEM_mallocN(1024 * 1024, "tag test peak"));
+  }
+  for (void *block : blocks) {
+    MEM_freeN(block);
+  }
+  const MEM_TagUsage usage = find_tag_usage("tag test peak");
+  EXPECT_EQ(usage.mem_in_use, 0);
+  EXPECT_GE(usage.peak, 9 * 1024 * 1024);
+  EXPECT_LE(usage.peak, 10 * 1024 * 1024);
+
+  MEM_reset_peak_memory();
+  EXPECT_EQ(find_tag_usage("tag test peak").peak, 0);
+}
+
+TEST_F(LockFreeTagTrackingTest, Arenas)
+{
+  MEM_use_memory_tag_tracking(false);
+  MEM_use_lockfree_arena_allocator();
+  MEM_use_memory_tag_tracking(true);
+
+  std::vector<void *> blocks;
+  for (size_t size : {0, 8, 100, 1000, 1008, 1016, 5000}) {
+    void *ptr = MEM_mallocN(size, "tag test arena");
+    memset(ptr, 1, size);
+    blocks.push_back(ptr);
+  }
+  TestObject *object = MEM_new<TestObject>("tag test arena");
+  EXPECT_EQ(object->a, 1);
+  EXPECT_EQ(find_tag_usage("tag test arena").blocks_num, 8);
+
+  MEM_delete(object);
+  for (void *ptr : blocks) {
+    MEM_freeN(ptr);
+  }
+  EXPECT_EQ(find_tag_usage("tag test arena").blocks_num, 0);
+
+  MEM_use_memory_tag_tracking(false);
+  MEM_use_lockfree_allocator();
+}
+
+TEST_F(LockFreeTagTrackingTest, PerThread)
+{
+  /* Every thread allocates blocks that are freed on the main thread. */
+  constexpr int threads_num = 4;
+  std::vector<std::vector<void *>> blocks(threads_num);
+  std::vector<std::thread> threads;
+  for (int thread_i = 0; thread_i < threads_num; thread_i++) {
+    threads.emplace_back([&, thread_i]() {
+      for (int i = 0; i < 1000; i++) {
+        blocks[thread_i].push_back(MEM_mallocN(16, "tag test thread"));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  /* The threads have exited already. */
+  MEM_TagUsage exited_usage = find_tag_usage("tag test thread");
+  EXPECT_EQ(exited_usage.mem_in_use, threads_num * 1000 * 16);
+  EXPECT_EQ(exited_usage.blocks_num, threads_num * 1000);
+
+  for (const std::vector<void *> &thread_blocks : blocks) {
+    for (void *block : thread_blocks) {
+      MEM_freeN(block);
+    }
+  }
+  EXPECT_EQ(find_tag_usage("tag test thread").blocks_num, 0);
+
+  /* Check that frees on this thread are reported per thread. */
+  int main_thread_index = -1;
+  MEM_foreach_tag_usage(
+      true,
+      [](const MEM_TagUsage *usage, void *user_data) {
+        if (strcmp(usage->name, "tag test thread") == 0 && usage->blocks_num < 0) {
+          *static_cast<int *>(user_data) = usage->thread_index;
+        }
+      },
+      &main_thread_index);
+  ASSERT_NE(main_thread_index, -1);
+  EXPECT_EQ(find_tag_usage("tag test thread", main_thread_index).blocks_num, -threads_num * 1000);
+}
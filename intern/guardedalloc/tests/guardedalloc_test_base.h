@@ -17,6 +17,33 @@ class LockFreeAllocatorTest : public ::testing::Test {
   }
 };
 
+class LockFreeArenaAllocatorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp()
+  {
+    MEM_use_lockfree_arena_allocator();
+  }
+
+  virtual void TearDown()
+  {
+    MEM_use_lockfree_allocator();
+  }
+};
+
+class LockFreeTagTrackingTest : public ::testing::Test {
+ protected:
+  virtual void SetUp()
+  {
+    MEM_use_lockfree_allocator();
+    MEM_use_memory_tag_tracking(true);
+  }
+
+  virtual void TearDown()
+  {
+    MEM_use_memory_tag_tracking(false);
+  }
+};
+
 class GuardedAllocatorTest : public ::testing::Test {
  protected:
   virtual void SetUp()
@@ -113,13 +113,18 @@ BVHTree *bvhtree_from_mesh_corner_tris_ex(BVHTreeFromMesh *data,
 /**
  * Builds or queries a BVH-cache for the cache BVH-tree of the request type.
  *
+ * \param balance_flag: #BLI_bvhtree_balance_ex flags, for trees of meshes that don't change and
+ * are queried many times, where a slower build pays off. Only used when the tree isn't cached
+ * yet, cached trees are shared by all callers.
+ *
  * \note This function only fills a cache, and therefore the mesh argument can
  * be considered logically const. Concurrent access is protected by a mutex.
  */
 BVHTree *BKE_bvhtree_from_mesh_get(BVHTreeFromMesh *data,
                                    const Mesh *mesh,
                                    BVHCacheType bvh_cache_type,
-                                   int tree_type);
+                                   int tree_type,
+                                   int balance_flag = 0);
 
 /**
  * Build a bvh tree from the triangles in the mesh that correspond to the faces in the given mask.
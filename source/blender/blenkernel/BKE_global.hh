@@ -43,6 +43,11 @@ struct Global {
   char filepath_last_image[/*FILE_MAX*/ 1024];
   /** Last used location for library link/append. */
   char filepath_last_library[/*FILE_MAX*/ 1024];
+  /**
+   * Output path of the blend-file read profiling JSON report (empty when disabled),
+   * see `--profile-file-read`.
+   */
+  char filepath_read_profile[/*FILE_MAX*/ 1024];
 
   /**
    * Strings of recently opened files to show in the file menu.
@@ -210,6 +215,17 @@ enum {
   G_FLAG_SCRIPT_OVERRIDE_PREF = (1 << 14),
   G_FLAG_SCRIPT_AUTOEXEC_FAIL = (1 << 15),
   G_FLAG_SCRIPT_AUTOEXEC_FAIL_QUIET = (1 << 16),
+
+  /**
+   * Read large data arrays of blend-files lazily: they are only read when looked up while their
+   * ID is read (arrays which are never looked up are skipped), and when possible they directly
+   * reference the memory-mapped file instead of being copied.
+   * Set via the `--lazy-data` command line argument.
+   *
+   * \note Files must not be truncated or modified in-place while they are in use. On Windows
+   * the data is always copied, since a mapped file can't be replaced, e.g. when saving it.
+   */
+  G_FLAG_READFILE_LAZY_DATA = (1 << 17),
 };
 
 #define G_FLAG_INTERNET_OVERRIDE_PREF_ANY \
@@ -219,7 +235,7 @@ enum {
 #define G_FLAG_ALL_RUNTIME \
   (G_FLAG_SCRIPT_AUTOEXEC | G_FLAG_SCRIPT_OVERRIDE_PREF | G_FLAG_INTERNET_ALLOW | \
    G_FLAG_INTERNET_OVERRIDE_PREF_ONLINE | G_FLAG_INTERNET_OVERRIDE_PREF_OFFLINE | \
-   G_FLAG_EVENT_SIMULATE | G_FLAG_USERPREF_NO_SAVE_ON_EXIT | \
+   G_FLAG_EVENT_SIMULATE | G_FLAG_USERPREF_NO_SAVE_ON_EXIT | G_FLAG_READFILE_LAZY_DATA | \
 \
    /* #BPY_python_reset is responsible for resetting these flags on file load. */ \
    G_FLAG_SCRIPT_AUTOEXEC_FAIL | G_FLAG_SCRIPT_AUTOEXEC_FAIL_QUIET)
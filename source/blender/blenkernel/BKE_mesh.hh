@@ -106,6 +106,22 @@ void normals_calc_verts(Span<float3> vert_positions,
                         Span<float3> face_normals,
                         MutableSpan<float3> vert_normals);
 
+/**
+ * Update previously calculated face and vertex normals after only \a changed_verts moved.
+ * Only the normals of faces using those vertices and of the vertices of those faces are
+ * recalculated. \a vert_normals may be empty to only update face normals.
+ *
+ * \note Usually #Mesh::tag_positions_changed_partial() should be used instead, which also falls
+ * back to recalculating all normals when most of the mesh changed.
+ */
+void normals_update_verts(Span<float3> vert_positions,
+                          OffsetIndices<int> faces,
+                          Span<int> corner_verts,
+                          GroupedSpan<int> vert_to_face_map,
+                          const IndexMask &changed_verts,
+                          MutableSpan<float3> face_normals,
+                          MutableSpan<float3> vert_normals);
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -8,6 +8,7 @@
  */
 #include "BLI_compiler_attrs.h"
 #include "BLI_function_ref.hh"
+#include "BLI_index_mask_fwd.hh"
 #include "BLI_math_matrix_types.hh"
 #include "BLI_span.hh"
 
@@ -123,8 +124,15 @@ enum ModifierTypeFlag {
 
   /** Accepts #GreasePencil data input. */
   eModifierTypeFlag_AcceptsGreasePencil = (1 << 12),
+
+  /**
+   * The #ModifierTypeInfo::deform_verts callback tags the mesh itself with the vertices it moved
+   * (see #BKE_modifier_tag_positions_changed), so that normals that are already calculated only
+   * have to be updated around them. For modifiers that often only move a few vertices.
+   */
+  eModifierTypeFlag_TagsChangedPositions = (1 << 13),
 };
-ENUM_OPERATORS(ModifierTypeFlag, eModifierTypeFlag_AcceptsGreasePencil)
+ENUM_OPERATORS(ModifierTypeFlag, eModifierTypeFlag_TagsChangedPositions)
 
 using IDWalkFunc = void (*)(void *user_data, Object *ob, ID **idpoin, int cb_flag);
 using TexWalkFunc = void (*)(void *user_data, Object *ob, ModifierData *md, const char *propname);
@@ -576,6 +584,14 @@ void BKE_modifier_deform_verts(ModifierData *md,
                                Mesh *mesh,
                                blender::MutableSpan<blender::float3> positions);
 
+/**
+ * Tag the \a mesh after moving \a changed_verts of \a positions in a
+ * #ModifierTypeInfo::deform_verts callback, see #eModifierTypeFlag_TagsChangedPositions.
+ */
+void BKE_modifier_tag_positions_changed(Mesh *mesh,
+                                        blender::Span<blender::float3> positions,
+                                        const blender::IndexMask &changed_verts);
+
 void BKE_modifier_deform_vertsEM(ModifierData *md,
                                  const ModifierEvalContext *ctx,
                                  const BMEditMesh *em,
@@ -17,12 +17,15 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_array.hh"
 #include "BLI_listbase.h"
 #include "BLI_math_matrix.h"
 #include "BLI_math_rotation.h"
 #include "BLI_math_vector.h"
+#include "BLI_simd.hh"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
+#include "BLI_vector.hh"
 
 #include "DNA_armature_types.h"
 #include "DNA_gpencil_legacy_types.h"
@@ -51,14 +54,19 @@ static CLG_LogRef LOG = {"bke.armature_deform"};
 /** \name Armature Deform Internal Utilities
  * \{ */
 
-/* Add the effect of one bone or B-Bone segment to the accumulated result. */
+/**
+ * Add the effect of one bone or B-Bone segment to the accumulated result.
+ *
+ * For linear blending the weighted deform matrices are summed, so that the vertex only has to be
+ * transformed once when all influences have been added. The rotation part of the same sum is the
+ * deform matrix of the vertex, so computing it doesn't add any cost per influence.
+ */
 static void pchan_deform_accumulate(const DualQuat *deform_dq,
                                     const float deform_mat[4][4],
                                     const float co_in[3],
                                     const float weight,
-                                    float co_accum[3],
+                                    float mat_accum[4][4],
                                     DualQuat *dq_accum,
-                                    float mat_accum[3][3],
                                     const bool full_deform)
 {
   if (weight == 0.0f) {
@@ -66,32 +74,28 @@ static void pchan_deform_accumulate(const DualQuat *deform_dq,
   }
 
   if (dq_accum) {
-    BLI_assert(!co_accum);
-
     add_weighted_dq_dq_pivot(dq_accum, deform_dq, co_in, weight, full_deform);
   }
   else {
-    float tmp[3];
-    mul_v3_m4v3(tmp, deform_mat, co_in);
-
-    sub_v3_v3(tmp, co_in);
-    madd_v3_v3fl(co_accum, tmp, weight);
-
-    if (full_deform) {
-      float tmpmat[3][3];
-      copy_m3_m4(tmpmat, deform_mat);
-
-      madd_m3_m3m3fl(mat_accum, mat_accum, tmpmat, weight);
+#if BLI_HAVE_SSE2
+    /* The matrices are blended for every influence of every vertex, the generic function is
+     * slower than transforming the vertex for every influence. */
+    const __m128 weight_vec = _mm_set1_ps(weight);
+    for (int i = 0; i < 4; i++) {
+      const __m128 row = _mm_mul_ps(_mm_loadu_ps(deform_mat[i]), weight_vec);
+      _mm_storeu_ps(mat_accum[i], _mm_add_ps(_mm_loadu_ps(mat_accum[i]), row));
     }
+#else
+    madd_m4_m4m4fl(mat_accum, mat_accum, deform_mat, weight);
+#endif
   }
 }
 
 static void b_bone_deform(const bPoseChannel *pchan,
                           const float co[3],
                           const float weight,
-                          float vec[3],
+                          float mat_accum[4][4],
                           DualQuat *dq,
-                          float defmat[3][3],
                           const bool full_deform)
 {
   const DualQuat *quats = pchan->runtime.bbone_dual_quats;
@@ -106,12 +110,11 @@ static void b_bone_deform(const bPoseChannel *pchan,
                           mats[index + 1].mat,
                           co,
                           weight * (1.0f - blend),
-                          vec,
+                          mat_accum,
                           dq,
-                          defmat,
                           full_deform);
   pchan_deform_accumulate(
-      &quats[index + 1], mats[index + 2].mat, co, weight * blend, vec, dq, defmat, full_deform);
+      &quats[index + 1], mats[index + 2].mat, co, weight * blend, mat_accum, dq, full_deform);
 }
 
 float distfactor_to_bone(
@@ -168,9 +171,8 @@ float distfactor_to_bone(
 }
 
 static float dist_bone_deform(const bPoseChannel *pchan,
-                              float vec[3],
+                              float mat_accum[4][4],
                               DualQuat *dq,
-                              float mat[3][3],
                               const float co[3],
                               const bool full_deform)
 {
@@ -189,11 +191,16 @@ static float dist_bone_deform(const bPoseChannel *pchan,
     contrib = fac;
     if (contrib > 0.0f) {
       if (bone->segments > 1 && pchan->runtime.bbone_segments == bone->segments) {
-        b_bone_deform(pchan, co, fac, vec, dq, mat, full_deform);
+        b_bone_deform(pchan, co, fac, mat_accum, dq, full_deform);
       }
       else {
-        pchan_deform_accumulate(
-            &pchan->runtime.deform_dual_quat, pchan->chan_mat, co, fac, vec, dq, mat, full_deform);
+        pchan_deform_accumulate(&pchan->runtime.deform_dual_quat,
+                                pchan->chan_mat,
+                                co,
+                                fac,
+                                mat_accum,
+                                dq,
+                                full_deform);
       }
     }
   }
@@ -202,26 +209,24 @@ static float dist_bone_deform(const bPoseChannel *pchan,
 }
 
 static void pchan_bone_deform(const bPoseChannel *pchan,
+                              const bool use_bbone,
                               const float weight,
-                              float vec[3],
+                              float mat_accum[4][4],
                               DualQuat *dq,
-                              float mat[3][3],
                               const float co[3],
                               const bool full_deform,
                               float *contrib)
 {
-  const Bone *bone = pchan->bone;
-
   if (!weight) {
     return;
   }
 
-  if (bone->segments > 1 && pchan->runtime.bbone_segments == bone->segments) {
-    b_bone_deform(pchan, co, weight, vec, dq, mat, full_deform);
+  if (use_bbone) {
+    b_bone_deform(pchan, co, weight, mat_accum, dq, full_deform);
   }
   else {
     pchan_deform_accumulate(
-        &pchan->runtime.deform_dual_quat, pchan->chan_mat, co, weight, vec, dq, mat, full_deform);
+        &pchan->runtime.deform_dual_quat, pchan->chan_mat, co, weight, mat_accum, dq, full_deform);
   }
 
   (*contrib) += weight;
@@ -235,6 +240,17 @@ static void pchan_bone_deform(const bPoseChannel *pchan,
  * #BKE_armature_deform_coords and related functions.
  * \{ */
 
+/**
+ * The bone deforming the vertices of a vertex group. Resolved once per evaluation, so that the
+ * per-vertex loop doesn't have to look up the bone and its flags for every influence.
+ */
+struct ArmatureDeformGroup {
+  const bPoseChannel *pchan;
+  bool use_bbone;
+  /** Scale the vertex group weight by the envelope, see #BONE_MULT_VG_ENV. */
+  bool use_envelope_multiply;
+};
+
 struct ArmatureUserdata {
   const Object *ob_arm;
   const Mesh *me_target;
@@ -252,9 +268,13 @@ struct ArmatureUserdata {
   const MDeformVert *dverts;
   int dverts_len;
 
-  bPoseChannel **pchan_from_defbase;
+  /** Indexed by the vertex group index, null pose channels don't deform. */
+  const ArmatureDeformGroup *deform_groups;
   int defbase_len;
 
+  /** Deforming pose channels, for envelope deformation. */
+  blender::Span<const bPoseChannel *> envelope_pchans;
+
   float premat[4][4];
   float postmat[4][4];
 
@@ -277,10 +297,8 @@ static void armature_vert_task_with_dvert(const ArmatureUserdata *data,
   const int armature_def_nr = data->armature_def_nr;
 
   DualQuat sumdq, *dq = nullptr;
-  const bPoseChannel *pchan;
   float *co, dco[3];
-  float sumvec[3], summat[3][3];
-  float *vec = nullptr, (*smat)[3] = nullptr;
+  float summat4[4][4], summat[3][3];
   float contrib = 0.0f;
   float armature_weight = 1.0f; /* default to 1 if no overall def group */
   float prevco_weight = 0.0f;   /* weight for optional cached vertexcos */
@@ -292,13 +310,7 @@ static void armature_vert_task_with_dvert(const ArmatureUserdata *data,
     dq = &sumdq;
   }
   else {
-    zero_v3(sumvec);
-    vec = sumvec;
-
-    if (full_deform) {
-      zero_m3(summat);
-      smat = summat;
-    }
+    zero_m4(summat4);
   }
 
   if (armature_def_nr != -1 && dvert) {
@@ -339,43 +351,37 @@ static void armature_vert_task_with_dvert(const ArmatureUserdata *data,
   mul_m4_v3(data->premat, co);
 
   if (use_dverts && dvert && dvert->totweight) { /* use weight groups ? */
-    const MDeformWeight *dw = dvert->dw;
-    int deformed = 0;
-    uint j;
-    for (j = dvert->totweight; j != 0; j--, dw++) {
-      const uint index = dw->def_nr;
-      if (index < data->defbase_len && (pchan = data->pchan_from_defbase[index])) {
-        float weight = dw->weight;
-        const Bone *bone = pchan->bone;
-
-        deformed = 1;
-
-        if (bone && bone->flag & BONE_MULT_VG_ENV) {
-          weight *= distfactor_to_bone(
-              co, bone->arm_head, bone->arm_tail, bone->rad_head, bone->rad_tail, bone->dist);
-        }
+    bool deformed = false;
+    for (const MDeformWeight &dw : blender::Span(dvert->dw, dvert->totweight)) {
+      if (dw.def_nr >= uint(data->defbase_len)) {
+        continue;
+      }
+      const ArmatureDeformGroup &group = data->deform_groups[dw.def_nr];
+      if (group.pchan == nullptr) {
+        continue;
+      }
+      float weight = dw.weight;
+      deformed = true;
 
-        pchan_bone_deform(pchan, weight, vec, dq, smat, co, full_deform, &contrib);
+      if (group.use_envelope_multiply) {
+        const Bone *bone = group.pchan->bone;
+        weight *= distfactor_to_bone(
+            co, bone->arm_head, bone->arm_tail, bone->rad_head, bone->rad_tail, bone->dist);
       }
+
+      pchan_bone_deform(
+          group.pchan, group.use_bbone, weight, summat4, dq, co, full_deform, &contrib);
     }
     /* If there are vertex-groups but not groups with bones (like for soft-body groups). */
-    if (deformed == 0 && use_envelope) {
-      for (pchan = static_cast<const bPoseChannel *>(data->ob_arm->pose->chanbase.first); pchan;
-           pchan = pchan->next)
-      {
-        if (!(pchan->bone->flag & BONE_NO_DEFORM)) {
-          contrib += dist_bone_deform(pchan, vec, dq, smat, co, full_deform);
-        }
+    if (!deformed && use_envelope) {
+      for (const bPoseChannel *pchan : data->envelope_pchans) {
+        contrib += dist_bone_deform(pchan, summat4, dq, co, full_deform);
       }
     }
   }
   else if (use_envelope) {
-    for (pchan = static_cast<const bPoseChannel *>(data->ob_arm->pose->chanbase.first); pchan;
-         pchan = pchan->next)
-    {
-      if (!(pchan->bone->flag & BONE_NO_DEFORM)) {
-        contrib += dist_bone_deform(pchan, vec, dq, smat, co, full_deform);
-      }
+    for (const bPoseChannel *pchan : data->envelope_pchans) {
+      contrib += dist_bone_deform(pchan, summat4, dq, co, full_deform);
     }
   }
 
@@ -394,12 +400,16 @@ static void armature_vert_task_with_dvert(const ArmatureUserdata *data,
       else {
         mul_v3m3_dq(co, full_deform ? summat : nullptr, dq);
       }
-
-      smat = summat;
     }
     else {
-      mul_v3_fl(vec, armature_weight / contrib);
-      add_v3_v3v3(co, vec, co);
+      /* The accumulated weights of the matrices add up to `contrib`. */
+      mul_v3_m4v3(dco, summat4, co);
+      madd_v3_v3fl(dco, co, -contrib);
+      madd_v3_v3fl(co, dco, armature_weight / contrib);
+
+      if (full_deform) {
+        copy_m3_m4(summat, summat4);
+      }
     }
 
     if (full_deform) {
@@ -410,10 +420,10 @@ static void armature_vert_task_with_dvert(const ArmatureUserdata *data,
       copy_m3_m3(tmpmat, vert_deform_mats[i]);
 
       if (!use_quaternion) { /* quaternion already is scale corrected */
-        mul_m3_fl(smat, armature_weight / contrib);
+        mul_m3_fl(summat, armature_weight / contrib);
       }
 
-      mul_m3_series(vert_deform_mats[i], post, smat, pre, tmpmat);
+      mul_m3_series(vert_deform_mats[i], post, summat, pre, tmpmat);
     }
   }
 
@@ -493,7 +503,8 @@ static void armature_deform_coords_impl(const Object *ob_arm,
                                         bGPDstroke *gps_target)
 {
   const bArmature *arm = static_cast<const bArmature *>(ob_arm->data);
-  bPoseChannel **pchan_from_defbase = nullptr;
+  blender::Array<ArmatureDeformGroup> deform_groups;
+  blender::Vector<const bPoseChannel *> envelope_pchans;
   const bool use_envelope = (deformflag & ARM_DEF_ENVELOPE) != 0;
   const bool use_quaternion = (deformflag & ARM_DEF_QUATERNION) != 0;
   const bool invert_vgroup = (deformflag & ARM_DEF_INVERT_VGROUP) != 0;
@@ -557,26 +568,34 @@ static void armature_deform_coords_impl(const Object *ob_arm,
       }
 
       if (use_dverts) {
-        pchan_from_defbase = static_cast<bPoseChannel **>(
-            MEM_callocN(sizeof(*pchan_from_defbase) * defbase_len, "defnrToBone"));
-        /* TODO(sergey): Some considerations here:
-         *
-         * - Check whether keeping this consistent across frames gives speedup.
-         */
+        deform_groups.reinitialize(defbase_len);
         int i;
         LISTBASE_FOREACH_INDEX (bDeformGroup *, dg, defbase, i) {
-          pchan_from_defbase[i] = BKE_pose_channel_find_name(ob_arm->pose, dg->name);
+          ArmatureDeformGroup &group = deform_groups[i];
+          group = {};
+          const bPoseChannel *pchan = BKE_pose_channel_find_name(ob_arm->pose, dg->name);
           /* exclude non-deforming bones */
-          if (pchan_from_defbase[i]) {
-            if (pchan_from_defbase[i]->bone->flag & BONE_NO_DEFORM) {
-              pchan_from_defbase[i] = nullptr;
-            }
+          if (pchan == nullptr || pchan->bone->flag & BONE_NO_DEFORM) {
+            continue;
           }
+          const Bone *bone = pchan->bone;
+          group.pchan = pchan;
+          group.use_bbone = bone->segments > 1 &&
+                            pchan->runtime.bbone_segments == bone->segments;
+          group.use_envelope_multiply = (bone->flag & BONE_MULT_VG_ENV) != 0;
         }
       }
     }
   }
 
+  if (use_envelope) {
+    LISTBASE_FOREACH (const bPoseChannel *, pchan, &ob_arm->pose->chanbase) {
+      if (!(pchan->bone->flag & BONE_NO_DEFORM)) {
+        envelope_pchans.append(pchan);
+      }
+    }
+  }
+
   ArmatureUserdata data{};
   data.ob_arm = ob_arm;
   data.me_target = me_target;
@@ -590,8 +609,9 @@ static void armature_deform_coords_impl(const Object *ob_arm,
   data.armature_def_nr = armature_def_nr;
   data.dverts = dverts.data();
   data.dverts_len = dverts.size();
-  data.pchan_from_defbase = pchan_from_defbase;
-  data.defbase_len = defbase_len;
+  data.deform_groups = deform_groups.data();
+  data.defbase_len = deform_groups.size();
+  data.envelope_pchans = envelope_pchans;
   data.bmesh.cd_dvert_offset = cd_dvert_offset;
 
   float obinv[4][4];
@@ -623,10 +643,6 @@ static void armature_deform_coords_impl(const Object *ob_arm,
     settings.min_iter_per_thread = 32;
     BLI_task_parallel_range(0, vert_coords_len, &data, armature_vert_task, &settings);
   }
-
-  if (pchan_from_defbase) {
-    MEM_freeN(pchan_from_defbase);
-  }
 }
 
 void BKE_armature_deform_coords_with_gpencil_stroke(const Object *ob_arm,
@@ -0,0 +1,230 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include <cstring>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
+#include "BLI_listbase.h"
+#include "BLI_math_matrix.h"
+#include "BLI_math_matrix.hh"
+#include "BLI_math_rotation.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.hh"
+#include "BLI_string.h"
+
+#include "BKE_action.h"
+#include "BKE_armature.hh"
+#include "BKE_deform.hh"
+#include "BKE_idtype.hh"
+#include "BKE_lib_id.hh"
+#include "BKE_main.hh"
+#include "BKE_mesh.hh"
+#include "BKE_object.hh"
+
+#include "DNA_action_types.h"
+#include "DNA_armature_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+
+namespace blender::bke::tests {
+
+static constexpr int bones_num = 4;
+static constexpr int verts_num = 1000;
+
+class ArmatureDeformTest : public testing::Test {
+ protected:
+  Main *bmain = nullptr;
+  Object *ob_arm = nullptr;
+  Object *ob_mesh = nullptr;
+  Mesh *mesh = nullptr;
+  /** Pose channel of every vertex group, null for groups without a bone. */
+  Array<const bPoseChannel *> group_pchans;
+  Array<float3> positions;
+
+  static void SetUpTestSuite()
+  {
+    BKE_idtype_init();
+  }
+
+  void SetUp() override
+  {
+    bmain = BKE_main_new();
+    RandomNumberGenerator rng(0);
+
+    bArmature *arm = BKE_armature_add(bmain, "Armature");
+    for (const int i : IndexRange(bones_num)) {
+      Bone *bone = MEM_cnew<Bone>(__func__);
+      SNPRINTF(bone->name, "Bone%d", i);
+      copy_v3_fl3(bone->head, float(i), 0.0f, 0.0f);
+      copy_v3_fl3(bone->tail, float(i), 1.0f, 0.5f);
+      BLI_addtail(&arm->bonebase, bone);
+    }
+    BKE_armature_where_is(arm);
+
+    ob_arm = BKE_object_add_only_object(bmain, OB_ARMATURE, "Armature");
+    ob_arm->data = arm;
+    BKE_pose_rebuild(nullptr, ob_arm, arm, false);
+
+    /* Pose the bones with rotation, translation and scale, like #BKE_pose_where_is does. */
+    LISTBASE_FOREACH (bPoseChannel *, pchan, &ob_arm->pose->chanbase) {
+      const float loc[3] = {rng.get_float(), rng.get_float(), rng.get_float()};
+      const float eul[3] = {rng.get_float() * 3.0f, rng.get_float() * 3.0f, rng.get_float()};
+      const float scale = 0.8f + rng.get_float() * 0.4f;
+      const float size[3] = {scale, scale, scale};
+      loc_eul_size_to_mat4(pchan->chan_mat, loc, eul, size);
+      mat4_to_dquat(&pchan->runtime.deform_dual_quat, pchan->bone->arm_mat, pchan->chan_mat);
+    }
+
+    /* One group per bone, then a group without a bone and the group of the modifier. */
+    mesh = BKE_mesh_new_nomain(verts_num, 0, 0, 0);
+    group_pchans.reinitialize(bones_num + 2);
+    for (const int i : group_pchans.index_range()) {
+      bDeformGroup *group = MEM_cnew<bDeformGroup>(__func__);
+      if (i < bones_num) {
+        SNPRINTF(group->name, "Bone%d", i);
+        group_pchans[i] = BKE_pose_channel_find_name(ob_arm->pose, group->name);
+      }
+      else {
+        STRNCPY(group->name, i == bones_num ? "NoBone" : "Armature");
+        group_pchans[i] = nullptr;
+      }
+      BLI_addtail(&mesh->vertex_group_names, group);
+    }
+
+    /* Vertices with up to four influences, some of them are not deformed at all. */
+    MutableSpan<MDeformVert> dverts = mesh->deform_verts_for_write();
+    positions.reinitialize(verts_num);
+    for (const int i : IndexRange(verts_num)) {
+      positions[i] = float3(rng.get_float(), rng.get_float(), rng.get_float()) * 4.0f - 2.0f;
+      const int influences_num = rng.get_int32(5);
+      for (const int j : IndexRange(influences_num)) {
+        const int group = (i + j * 3) % (bones_num + 1);
+        BKE_defvert_add_index_notest(&dverts[i], group, rng.get_float());
+      }
+      BKE_defvert_add_index_notest(&dverts[i], bones_num + 1, rng.get_float());
+    }
+
+    ob_mesh = BKE_object_add_only_object(bmain, OB_MESH, "Mesh");
+    ob_mesh->data = mesh;
+  }
+
+  void TearDown() override
+  {
+    BKE_main_free(bmain);
+    BKE_id_free(nullptr, mesh);
+  }
+
+  /**
+   * Deform a vertex like before the deform matrices were blended, by transforming it for every
+   * influence. Both objects are at the origin, so there is no object space conversion.
+   */
+  void deform_vert_reference(const int vert,
+                             const bool use_quaternion,
+                             const bool use_armature_group,
+                             float co[3],
+                             float r_deform_mat[3][3])
+  {
+    const MDeformVert &dvert = mesh->deform_verts()[vert];
+    const float armature_weight = use_armature_group ?
+                                      BKE_defvert_find_weight(&dvert, bones_num + 1) :
+                                      1.0f;
+    unit_m3(r_deform_mat);
+    if (armature_weight == 0.0f) {
+      return;
+    }
+
+    float vec[3] = {0.0f, 0.0f, 0.0f};
+    float summat[3][3];
+    zero_m3(summat);
+    DualQuat dq;
+    memset(&dq, 0, sizeof(DualQuat));
+    float contrib = 0.0f;
+    for (const MDeformWeight &dw : Span(dvert.dw, dvert.totweight)) {
+      const bPoseChannel *pchan = group_pchans[dw.def_nr];
+      if (pchan == nullptr || dw.weight == 0.0f) {
+        continue;
+      }
+      if (use_quaternion) {
+        add_weighted_dq_dq_pivot(&dq, &pchan->runtime.deform_dual_quat, co, dw.weight, true);
+      }
+      else {
+        float tmp[3], tmpmat[3][3];
+        mul_v3_m4v3(tmp, pchan->chan_mat, co);
+        sub_v3_v3(tmp, co);
+        madd_v3_v3fl(vec, tmp, dw.weight);
+        copy_m3_m4(tmpmat, pchan->chan_mat);
+        madd_m3_m3m3fl(summat, summat, tmpmat, dw.weight);
+      }
+      contrib += dw.weight;
+    }
+    if (contrib <= 0.0001f) {
+      return;
+    }
+
+    if (use_quaternion) {
+      normalize_dq(&dq, contrib);
+      float dco[3];
+      copy_v3_v3(dco, co);
+      mul_v3m3_dq(dco, summat, &dq);
+      sub_v3_v3(dco, co);
+      madd_v3_v3fl(co, dco, armature_weight);
+    }
+    else {
+      madd_v3_v3fl(co, vec, armature_weight / contrib);
+      mul_m3_fl(summat, armature_weight / contrib);
+    }
+    copy_m3_m3(r_deform_mat, summat);
+  }
+
+  void expect_deform_matches_reference(const bool use_quaternion, const bool use_armature_group)
+  {
+    Array<float3> coords = positions;
+    Array<float3x3> deform_mats(verts_num, float3x3::identity());
+    const int deformflag = ARM_DEF_VGROUP | (use_quaternion ? ARM_DEF_QUATERNION : 0);
+    BKE_armature_deform_coords_with_mesh(ob_arm,
+                                         ob_mesh,
+                                         reinterpret_cast<float(*)[3]>(coords.data()),
+                                         reinterpret_cast<float(*)[3][3]>(deform_mats.data()),
+                                         verts_num,
+                                         deformflag,
+                                         nullptr,
+                                         use_armature_group ? "Armature" : "",
+                                         mesh);
+
+    for (const int i : IndexRange(verts_num)) {
+      float co[3], deform_mat[3][3];
+      copy_v3_v3(co, positions[i]);
+      deform_vert_reference(i, use_quaternion, use_armature_group, co, deform_mat);
+      EXPECT_V3_NEAR(coords[i], co, 1e-4f);
+      EXPECT_M3_NEAR(deform_mats[i].ptr(), deform_mat, 1e-4f);
+    }
+  }
+};
+
+TEST_F(ArmatureDeformTest, LinearMatchesPerInfluence)
+{
+  expect_deform_matches_reference(false, false);
+}
+
+TEST_F(ArmatureDeformTest, LinearMatchesPerInfluenceWithArmatureGroup)
+{
+  expect_deform_matches_reference(false, true);
+}
+
+TEST_F(ArmatureDeformTest, DualQuaternionMatchesPerInfluence)
+{
+  expect_deform_matches_reference(true, false);
+}
+
+TEST_F(ArmatureDeformTest, DualQuaternionMatchesPerInfluenceWithArmatureGroup)
+{
+  expect_deform_matches_reference(true, true);
+}
+
+}  // namespace blender::bke::tests
@@ -149,7 +149,7 @@ bool BKE_blendfile_library_path_explode(const char *path,
 
 bool BKE_blendfile_is_readable(const char *path, ReportList *reports)
 {
-  BlendFileReadReport readfile_reports;
+  BlendFileReadReport readfile_reports{};
   readfile_reports.reports = reports;
   BlendHandle *bh = BLO_blendhandle_from_file(path, &readfile_reports);
   if (bh != nullptr) {
@@ -145,19 +145,26 @@ void bvhcache_free(BVHCache *bvh_cache)
  * is multithreaded, and we do not want the current thread to start another task
  * that may involve acquiring the same mutex lock that it is waiting for.
  */
+struct BVHTreeBalanceData {
+  BVHTree *tree;
+  int flag;
+};
+
 static void bvhtree_balance_isolated(void *userdata)
 {
-  BLI_bvhtree_balance((BVHTree *)userdata);
+  const BVHTreeBalanceData *data = static_cast<const BVHTreeBalanceData *>(userdata);
+  BLI_bvhtree_balance_ex(data->tree, data->flag);
 }
 
-static void bvhtree_balance(BVHTree *tree, const bool isolate)
+static void bvhtree_balance(BVHTree *tree, const bool isolate, const int flag = 0)
 {
   if (tree) {
     if (isolate) {
-      BLI_task_isolate(bvhtree_balance_isolated, tree);
+      BVHTreeBalanceData data = {tree, flag};
+      BLI_task_isolate(bvhtree_balance_isolated, &data);
     }
     else {
-      BLI_bvhtree_balance(tree);
+      BLI_bvhtree_balance_ex(tree, flag);
     }
   }
 }
@@ -899,7 +906,8 @@ static BitVector<> corner_tris_no_hidden_map_get(const blender::OffsetIndices<in
 BVHTree *BKE_bvhtree_from_mesh_get(BVHTreeFromMesh *data,
                                    const Mesh *mesh,
                                    const BVHCacheType bvh_cache_type,
-                                   const int tree_type)
+                                   const int tree_type,
+                                   const int balance_flag)
 {
   using namespace blender;
   using namespace blender::bke;
@@ -1008,7 +1016,7 @@ BVHTree *BKE_bvhtree_from_mesh_get(BVHTreeFromMesh *data,
       break;
   }
 
-  bvhtree_balance(data->tree, lock_started);
+  bvhtree_balance(data->tree, lock_started, balance_flag);
 
   /* Save on cache for later use */
   // printf("BVHTree built and saved on cache\n");
@@ -5507,6 +5507,22 @@ static void blend_read_layer_data(BlendDataReader *reader, CustomDataLayer &laye
   }
 }
 
+/**
+ * When reading lazily, reference the layer data in the memory-mapped file instead of copying it.
+ * Only possible for types without separately allocated components.
+ */
+static const ImplicitSharingInfo *blend_read_layer_data_mapped(BlendDataReader *reader,
+                                                               CustomDataLayer &layer,
+                                                               const int count)
+{
+  const LayerTypeInfo *type_info = layerType_getInfo(eCustomDataType(layer.type));
+  if (type_info == nullptr || type_info->free != nullptr || type_info->copy != nullptr) {
+    return nullptr;
+  }
+  return BLO_read_mapped(
+      reader, &layer.data, int64_t(type_info->size) * count, int64_t(type_info->alignment));
+}
+
 void CustomData_blend_read(BlendDataReader *reader, CustomData *data, const int count)
 {
   BLO_read_struct_array(reader, CustomDataLayer, data->totlayer, &data->layers);
@@ -5532,6 +5548,11 @@ void CustomData_blend_read(BlendDataReader *reader, CustomData *data, const int
     if (CustomData_verify_versions(data, i)) {
       layer->sharing_info = BLO_read_shared(
           reader, &layer->data, [&]() -> const ImplicitSharingInfo * {
+            if (const ImplicitSharingInfo *info = blend_read_layer_data_mapped(
+                    reader, *layer, count))
+            {
+              return info;
+            }
             blend_read_layer_data(reader, *layer, count);
             if (layer->data == nullptr) {
               return nullptr;
@@ -367,6 +367,14 @@ static void mesh_blend_read_data(BlendDataReader *reader, ID *id)
   if (mesh->face_offset_indices) {
     mesh->runtime->face_offsets_sharing_info = BLO_read_shared(
         reader, &mesh->face_offset_indices, [&]() {
+          if (const blender::ImplicitSharingInfo *info = BLO_read_mapped(
+                  reader,
+                  &mesh->face_offset_indices,
+                  sizeof(int) * (int64_t(mesh->faces_num) + 1),
+                  alignof(int)))
+          {
+            return info;
+          }
           BLO_read_int32_array(reader, mesh->faces_num + 1, &mesh->face_offset_indices);
           return blender::implicit_sharing::info_for_mem_free(mesh->face_offset_indices);
         });
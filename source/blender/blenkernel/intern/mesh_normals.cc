@@ -155,6 +155,30 @@ void normals_calc_faces(const Span<float3> positions,
   });
 }
 
+static float3 normal_calc_vert(const Span<float3> positions,
+                               const OffsetIndices<int> faces,
+                               const Span<int> corner_verts,
+                               const Span<int> vert_faces,
+                               const Span<float3> face_normals,
+                               const int vert)
+{
+  if (vert_faces.is_empty()) {
+    return math::normalize(positions[vert]);
+  }
+
+  float3 vert_normal(0);
+  for (const int face : vert_faces) {
+    const int2 adjacent_verts = face_find_adjacent_verts(faces[face], corner_verts, vert);
+    const float3 dir_prev = math::normalize(positions[adjacent_verts[0]] - positions[vert]);
+    const float3 dir_next = math::normalize(positions[adjacent_verts[1]] - positions[vert]);
+    const float factor = math::safe_acos_approx(math::dot(dir_prev, dir_next));
+
+    vert_normal += face_normals[face] * factor;
+  }
+
+  return math::normalize(vert_normal);
+}
+
 void normals_calc_verts(const Span<float3> vert_positions,
                         const OffsetIndices<int> faces,
                         const Span<int> corner_verts,
@@ -165,25 +189,53 @@ void normals_calc_verts(const Span<float3> vert_positions,
   const Span<float3> positions = vert_positions;
   threading::parallel_for(positions.index_range(), 1024, [&](const IndexRange range) {
     for (const int vert : range) {
-      const Span<int> vert_faces = vert_to_face_map[vert];
-      if (vert_faces.is_empty()) {
-        vert_normals[vert] = math::normalize(positions[vert]);
-        continue;
-      }
+      vert_normals[vert] = normal_calc_vert(
+          positions, faces, corner_verts, vert_to_face_map[vert], face_normals, vert);
+    }
+  });
+}
 
-      float3 vert_normal(0);
-      for (const int face : vert_faces) {
-        const int2 adjacent_verts = face_find_adjacent_verts(faces[face], corner_verts, vert);
-        const float3 dir_prev = math::normalize(positions[adjacent_verts[0]] - positions[vert]);
-        const float3 dir_next = math::normalize(positions[adjacent_verts[1]] - positions[vert]);
-        const float factor = math::safe_acos_approx(math::dot(dir_prev, dir_next));
+void normals_update_verts(const Span<float3> vert_positions,
+                          const OffsetIndices<int> faces,
+                          const Span<int> corner_verts,
+                          const GroupedSpan<int> vert_to_face_map,
+                          const IndexMask &changed_verts,
+                          MutableSpan<float3> face_normals,
+                          MutableSpan<float3> vert_normals)
+{
+  const Span<float3> positions = vert_positions;
 
-        vert_normal += face_normals[face] * factor;
-      }
+  /* Faces using a moved vertex have a different normal. */
+  BitVector<> faces_to_update(faces.size());
+  changed_verts.foreach_index([&](const int vert) {
+    for (const int face : vert_to_face_map[vert]) {
+      faces_to_update[face].set();
+    }
+  });
+  IndexMaskMemory memory;
+  const IndexMask changed_faces = IndexMask::from_bits(faces_to_update, memory);
+  changed_faces.foreach_index(GrainSize(1024), [&](const int face) {
+    face_normals[face] = normal_calc_ngon(positions, corner_verts.slice(faces[face]));
+  });
 
-      vert_normals[vert] = math::normalize(vert_normal);
+  if (vert_normals.is_empty()) {
+    return;
+  }
+
+  /* Vertex normals depend on the normals of the surrounding faces and on the angles of the face
+   * corners, so every vertex of a changed face has to be updated. */
+  BitVector<> verts_to_update(positions.size());
+  changed_verts.to_bits(verts_to_update);
+  changed_faces.foreach_index([&](const int face) {
+    for (const int vert : corner_verts.slice(faces[face])) {
+      verts_to_update[vert].set();
     }
   });
+  const IndexMask verts = IndexMask::from_bits(verts_to_update, memory);
+  verts.foreach_index(GrainSize(1024), [&](const int vert) {
+    vert_normals[vert] = normal_calc_vert(
+        positions, faces, corner_verts, vert_to_face_map[vert], face_normals, vert);
+  });
 }
 
 /** \} */
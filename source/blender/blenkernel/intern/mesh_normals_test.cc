@@ -0,0 +1,148 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_rand.hh"
+
+#include "BKE_idtype.hh"
+#include "BKE_lib_id.hh"
+#include "BKE_mesh.h"
+#include "BKE_mesh.hh"
+
+#include "DNA_mesh_types.h"
+
+namespace blender::bke::tests {
+
+class MeshNormalsTest : public ::testing::Test {
+ public:
+  static void SetUpTestSuite()
+  {
+    BKE_idtype_init();
+  }
+};
+
+/** A grid of quads with some noise, so that the normals are all different. */
+static Mesh *create_noisy_grid(const int size)
+{
+  const int faces_num = (size - 1) * (size - 1);
+  Mesh *mesh = BKE_mesh_new_nomain(size * size, 0, faces_num, faces_num * 4);
+  RandomNumberGenerator rng(0);
+  MutableSpan<float3> positions = mesh->vert_positions_for_write();
+  for (const int y : IndexRange(size)) {
+    for (const int x : IndexRange(size)) {
+      positions[y * size + x] = float3(x, y, rng.get_float());
+    }
+  }
+  MutableSpan<int> face_offsets = mesh->face_offsets_for_write();
+  MutableSpan<int> corner_verts = mesh->corner_verts_for_write();
+  int face = 0;
+  for (const int y : IndexRange(size - 1)) {
+    for (const int x : IndexRange(size - 1)) {
+      face_offsets[face] = face * 4;
+      corner_verts[face * 4 + 0] = y * size + x;
+      corner_verts[face * 4 + 1] = y * size + x + 1;
+      corner_verts[face * 4 + 2] = (y + 1) * size + x + 1;
+      corner_verts[face * 4 + 3] = (y + 1) * size + x;
+      face++;
+    }
+  }
+  face_offsets.last() = face * 4;
+  mesh->tag_topology_changed();
+  return mesh;
+}
+
+/** Move a few vertices, including ones on the boundary, and tag them as changed. */
+static void move_verts_partial(Mesh &mesh)
+{
+  const Array<int> verts = {0, 5, 37, 38, 500, mesh.verts_num - 1};
+  RandomNumberGenerator rng(1);
+  MutableSpan<float3> positions = mesh.vert_positions_for_write();
+  for (const int vert : verts) {
+    positions[vert] += float3(rng.get_float(), rng.get_float(), rng.get_float());
+  }
+  IndexMaskMemory memory;
+  mesh.tag_positions_changed_partial(IndexMask::from_indices<int>(verts, memory));
+}
+
+static void expect_normals_match_full_calc(const Mesh &mesh)
+{
+  Array<float3> face_normals(mesh.faces_num);
+  mesh::normals_calc_faces(mesh.vert_positions(), mesh.faces(), mesh.corner_verts(), face_normals);
+  Array<float3> vert_normals(mesh.verts_num);
+  mesh::normals_calc_verts(mesh.vert_positions(),
+                           mesh.faces(),
+                           mesh.corner_verts(),
+                           mesh.vert_to_face_map(),
+                           face_normals,
+                           vert_normals);
+
+  const Span<float3> mesh_face_normals = mesh.face_normals();
+  for (const int face : face_normals.index_range()) {
+    EXPECT_V3_NEAR(mesh_face_normals[face], face_normals[face], 1e-6f);
+  }
+  const Span<float3> mesh_vert_normals = mesh.vert_normals();
+  for (const int vert : vert_normals.index_range()) {
+    EXPECT_V3_NEAR(mesh_vert_normals[vert], vert_normals[vert], 1e-6f);
+  }
+}
+
+TEST_F(MeshNormalsTest, partial_update_face_and_vert_normals)
+{
+  Mesh *mesh = create_noisy_grid(32);
+  mesh->face_normals();
+  mesh->vert_normals();
+
+  move_verts_partial(*mesh);
+  /* The normals are updated in place instead of being tagged for recalculation. */
+  EXPECT_FALSE(BKE_mesh_face_normals_are_dirty(mesh));
+  EXPECT_FALSE(BKE_mesh_vert_normals_are_dirty(mesh));
+  expect_normals_match_full_calc(*mesh);
+
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(MeshNormalsTest, partial_update_face_normals)
+{
+  Mesh *mesh = create_noisy_grid(32);
+  mesh->face_normals();
+
+  move_verts_partial(*mesh);
+  EXPECT_FALSE(BKE_mesh_face_normals_are_dirty(mesh));
+  EXPECT_TRUE(BKE_mesh_vert_normals_are_dirty(mesh));
+  expect_normals_match_full_calc(*mesh);
+
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(MeshNormalsTest, partial_update_shared_caches)
+{
+  Mesh *mesh_orig = create_noisy_grid(32);
+  mesh_orig->face_normals();
+  mesh_orig->vert_normals();
+  const Array<float3> face_normals_orig(mesh_orig->face_normals());
+  const Array<float3> vert_normals_orig(mesh_orig->vert_normals());
+
+  /* The copy shares the normal caches with the original mesh. */
+  Mesh *mesh = BKE_mesh_copy_for_eval(*mesh_orig);
+  EXPECT_EQ(mesh->face_normals().data(), mesh_orig->face_normals().data());
+
+  move_verts_partial(*mesh);
+  EXPECT_FALSE(BKE_mesh_face_normals_are_dirty(mesh));
+  expect_normals_match_full_calc(*mesh);
+
+  /* The original mesh keeps its normals. */
+  EXPECT_EQ_ARRAY(
+      face_normals_orig.data(), mesh_orig->face_normals().data(), face_normals_orig.size());
+  EXPECT_EQ_ARRAY(
+      vert_normals_orig.data(), mesh_orig->vert_normals().data(), vert_normals_orig.size());
+  expect_normals_match_full_calc(*mesh_orig);
+
+  BKE_id_free(nullptr, mesh);
+  BKE_id_free(nullptr, mesh_orig);
+}
+
+}  // namespace blender::bke::tests
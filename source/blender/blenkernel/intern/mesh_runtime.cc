@@ -390,6 +390,54 @@ void Mesh::tag_positions_changed()
   this->tag_positions_changed_no_normals();
 }
 
+void Mesh::tag_positions_changed_partial(const blender::IndexMask &changed_verts)
+{
+  using namespace blender;
+  using namespace blender::bke;
+  if (changed_verts.is_empty()) {
+    return;
+  }
+  /* When a large part of the mesh moved, finding the affected elements costs more than it saves
+   * compared to recalculating all normals in parallel when they are needed. */
+  if (changed_verts.size() > this->verts_num / 8 ||
+      !this->runtime->face_normals_cache.is_cached())
+  {
+    this->tag_positions_changed();
+    return;
+  }
+
+  const Span<float3> positions = this->vert_positions();
+  const OffsetIndices faces = this->faces();
+  const Span<int> corner_verts = this->corner_verts();
+  const GroupedSpan<int> vert_to_face = this->vert_to_face_map();
+  const bool update_vert_normals = this->runtime->vert_normals_cache.is_cached();
+
+  this->tag_positions_changed_no_normals();
+  this->runtime->corner_normals_cache.tag_dirty();
+
+  /* #SharedCache::update keeps the existing normals, copying them if they are shared with
+   * another mesh, so only the affected ones have to be recalculated. */
+  if (!update_vert_normals) {
+    this->runtime->vert_normals_cache.tag_dirty();
+    this->runtime->face_normals_cache.update([&](Vector<float3> &r_face_normals) {
+      mesh::normals_update_verts(
+          positions, faces, corner_verts, vert_to_face, changed_verts, r_face_normals, {});
+    });
+    return;
+  }
+  this->runtime->face_normals_cache.update([&](Vector<float3> &r_face_normals) {
+    this->runtime->vert_normals_cache.update([&](Vector<float3> &r_vert_normals) {
+      mesh::normals_update_verts(positions,
+                                 faces,
+                                 corner_verts,
+                                 vert_to_face,
+                                 changed_verts,
+                                 r_face_normals,
+                                 r_vert_normals);
+    });
+  });
+}
+
 void Mesh::tag_positions_changed_no_normals()
 {
   free_bvh_cache(*this->runtime);
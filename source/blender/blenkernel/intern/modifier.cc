@@ -34,6 +34,7 @@
 #include "DNA_scene_types.h"
 #include "DNA_screen_types.h"
 
+#include "BLI_index_mask.hh"
 #include "BLI_linklist.h"
 #include "BLI_listbase.h"
 #include "BLI_path_util.h"
@@ -899,7 +900,22 @@ void BKE_modifier_deform_verts(ModifierData *md,
 {
   const ModifierTypeInfo *mti = BKE_modifier_get_info(ModifierType(md->type));
   mti->deform_verts(md, ctx, mesh, positions);
-  if (mesh) {
+  if (mesh && !(mti->flags & eModifierTypeFlag_TagsChangedPositions)) {
+    mesh->tag_positions_changed();
+  }
+}
+
+void BKE_modifier_tag_positions_changed(Mesh *mesh,
+                                        const blender::Span<blender::float3> positions,
+                                        const blender::IndexMask &changed_verts)
+{
+  if (mesh == nullptr) {
+    return;
+  }
+  if (positions.data() == mesh->vert_positions().data()) {
+    mesh->tag_positions_changed_partial(changed_verts);
+  }
+  else {
     mesh->tag_positions_changed();
   }
 }
@@ -907,6 +907,11 @@ void BKE_packedfile_blend_read(BlendDataReader *reader, PackedFile **pf_p)
   }
   /* NOTE: there is no way to handle endianness switch here. */
   pf->sharing_info = BLO_read_shared(reader, &pf->data, [&]() {
+    /* Packed files can be large, reference them directly from the file when possible. */
+    if (const blender::ImplicitSharingInfo *info = BLO_read_mapped(reader, &pf->data, pf->size, 1))
+    {
+      return info;
+    }
     BLO_read_data_address(reader, &pf->data);
     return blender::implicit_sharing::info_for_mem_free(const_cast<void *>(pf->data));
   });
@@ -2655,21 +2655,34 @@ void psys_find_parents(ParticleSimulationData *sim, const bool use_render_params
 
   BLI_kdtree_3d_balance(tree);
 
-  for (; p < totchild; p++, cpa++) {
+  /* Find the parents of all remaining children at once. */
+  const int search_len = max_ii(totchild - p, 0);
+  float(*search_orco)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(search_len, sizeof(*search_orco), __func__));
+  KDTreeNearest_3d *search_nearest = static_cast<KDTreeNearest_3d *>(
+      MEM_malloc_arrayN(search_len, sizeof(*search_nearest), __func__));
+
+  for (int i = 0; i < search_len; i++) {
     psys_particle_on_emitter(sim->psmd,
                              from,
-                             cpa->num,
+                             cpa[i].num,
                              DMCACHE_ISCHILD,
-                             cpa->fuv,
-                             cpa->foffset,
+                             cpa[i].fuv,
+                             cpa[i].foffset,
                              co,
                              nullptr,
                              nullptr,
                              nullptr,
-                             orco);
-    cpa->parent = BLI_kdtree_3d_find_nearest(tree, orco, nullptr);
+                             search_orco[i]);
+  }
+
+  BLI_kdtree_3d_find_nearest_batch(tree, search_orco, search_len, search_nearest);
+  for (int i = 0; i < search_len; i++) {
+    cpa[i].parent = search_nearest[i].index;
   }
 
+  MEM_freeN(search_orco);
+  MEM_freeN(search_nearest);
   BLI_kdtree_3d_free(tree);
 }
 
@@ -0,0 +1,255 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::ConcurrentMap<Key, Value>` is an insert-only associative container that can be
+ * modified from multiple threads at the same time. It is meant for parallel algorithms that
+ * would otherwise have to partition their input by hash or serialize all insertions.
+ *
+ * The map is split into a fixed number of shards. Every shard is a #blender::Map that is protected
+ * by its own mutex, and the shard of a key is determined by its hash. Therefore, threads only
+ * contend when they access the same shard at the same time, which is rare with many shards.
+ *
+ * Some noteworthy information:
+ * - Keys cannot be removed. This keeps the API small and makes it easy to reason about.
+ * - Lookups return copies of the values, because references could be invalidated by concurrent
+ *   insertions into the same shard. Use small values (e.g. indices or pointers).
+ * - Callbacks passed to `lookup_or_add_cb` and `add_or_modify` are called while the shard is
+ *   locked. They should be cheap and must not access the same map.
+ * - `size`, `foreach_item` and `to_map` are not thread-safe with concurrent insertions. They are
+ *   meant to be used after the parallel part of an algorithm has finished.
+ */
+
+#include <array>
+#include <mutex>
+#include <optional>
+
+#include "BLI_map.hh"
+#include "BLI_utility_mixins.hh"
+
+namespace blender {
+
+template<typename Key,
+         typename Value,
+         typename Hash = DefaultHash<Key>,
+         typename IsEqual = DefaultEquality<Key>,
+         typename Allocator = GuardedAllocator>
+class ConcurrentMap : NonCopyable, NonMovable {
+ public:
+  using MapType = Map<Key,
+                      Value,
+                      0,
+                      DefaultProbingStrategy,
+                      Hash,
+                      IsEqual,
+                      typename DefaultMapSlot<Key, Value>::type,
+                      Allocator>;
+
+ private:
+  /** Has to be a power of two. */
+  static constexpr int shard_bits = 6;
+  static constexpr int64_t shards_num = int64_t(1) << shard_bits;
+
+  /** Aligned to avoid false sharing between the mutexes of different shards. */
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    MapType map;
+  };
+
+  BLI_NO_UNIQUE_ADDRESS Hash hash_;
+  std::array<Shard, shards_num> shards_;
+
+ public:
+  ConcurrentMap() = default;
+
+  /**
+   * Reserve space for the given total number of elements, assuming that the keys are distributed
+   * evenly between the shards. Not thread-safe.
+   */
+  void reserve(const int64_t n)
+  {
+    const int64_t n_per_shard = n / shards_num + n / shards_num / 8 + 1;
+    for (Shard &shard : shards_) {
+      shard.map.reserve(n_per_shard);
+    }
+  }
+
+  /**
+   * Insert a new key-value-pair into the map. This invokes undefined behavior when the key is in
+   * the map already.
+   */
+  template<typename ForwardKey, typename... ForwardValue>
+  void add_new(ForwardKey &&key, ForwardValue &&...value)
+  {
+    Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    shard.map.add_new_as(std::forward<ForwardKey>(key), std::forward<ForwardValue>(value)...);
+  }
+
+  /**
+   * Add a key-value-pair to the map. If the map contains the key already, nothing is changed.
+   * Returns true when the key has been newly added.
+   */
+  template<typename ForwardKey, typename... ForwardValue>
+  bool add(ForwardKey &&key, ForwardValue &&...value)
+  {
+    Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.map.add_as(std::forward<ForwardKey>(key), std::forward<ForwardValue>(value)...);
+  }
+
+  /**
+   * Returns a copy of the value corresponding to the key. If the key is not in the map yet, the
+   * value is created by the given callback first.
+   */
+  template<typename ForwardKey, typename CreateValueF>
+  Value lookup_or_add_cb(ForwardKey &&key, const CreateValueF &create_value)
+  {
+    Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.map.lookup_or_add_cb_as(std::forward<ForwardKey>(key), create_value);
+  }
+
+  /**
+   * Returns a copy of the value corresponding to the key. If the key is not in the map yet, the
+   * given value is added first.
+   */
+  template<typename ForwardKey, typename... ForwardValue>
+  Value lookup_or_add(ForwardKey &&key, ForwardValue &&...value)
+  {
+    Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.map.lookup_or_add_as(std::forward<ForwardKey>(key),
+                                      std::forward<ForwardValue>(value)...);
+  }
+
+  /**
+   * Same as #Map::add_or_modify. Both callbacks are called while the shard of the key is locked,
+   * so they can safely modify the value.
+   */
+  template<typename ForwardKey, typename CreateValueF, typename ModifyValueF>
+  auto add_or_modify(ForwardKey &&key,
+                     const CreateValueF &create_value,
+                     const ModifyValueF &modify_value) -> decltype(create_value(nullptr))
+  {
+    Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.map.add_or_modify_as(std::forward<ForwardKey>(key), create_value, modify_value);
+  }
+
+  /**
+   * Returns a copy of the value corresponding to the key, or a value-less optional when the key
+   * is not in the map.
+   */
+  template<typename ForwardKey> std::optional<Value> lookup_try(const ForwardKey &key) const
+  {
+    const Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    if (const Value *value = shard.map.lookup_ptr_as(key)) {
+      return *value;
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * Returns a copy of the value corresponding to the key. This invokes undefined behavior when
+   * the key is not in the map.
+   */
+  template<typename ForwardKey> Value lookup(const ForwardKey &key) const
+  {
+    const Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.map.lookup_as(key);
+  }
+
+  /**
+   * Returns a copy of the value corresponding to the key. If the key is not in the map, the
+   * given default value is returned instead.
+   */
+  template<typename ForwardKey>
+  Value lookup_default(const ForwardKey &key, const Value &default_value) const
+  {
+    const Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.map.lookup_default_as(key, default_value);
+  }
+
+  /**
+   * Returns true if there is a key in the map that compares equal to the given key.
+   */
+  template<typename ForwardKey> bool contains(const ForwardKey &key) const
+  {
+    const Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.map.contains_as(key);
+  }
+
+  /**
+   * Return the number of key-value-pairs in the map. Not thread-safe.
+   */
+  int64_t size() const
+  {
+    int64_t size = 0;
+    for (const Shard &shard : shards_) {
+      size += shard.map.size();
+    }
+    return size;
+  }
+
+  /**
+   * Returns true if there are no elements in the map. Not thread-safe.
+   */
+  bool is_empty() const
+  {
+    return this->size() == 0;
+  }
+
+  /**
+   * Call the function for every key-value-pair in the map. The order is undefined. Not
+   * thread-safe.
+   */
+  template<typename FuncT> void foreach_item(const FuncT &func) const
+  {
+    for (const Shard &shard : shards_) {
+      shard.map.foreach_item(func);
+    }
+  }
+
+  /**
+   * Move all key-value-pairs into a normal map. The concurrent map is empty afterwards. Not
+   * thread-safe.
+   */
+  MapType to_map()
+  {
+    MapType map;
+    map.reserve(this->size());
+    for (Shard &shard : shards_) {
+      for (MutableMapItem<Key, Value> item : shard.map.items()) {
+        map.add_new(item.key, std::move(item.value));
+      }
+      shard.map.clear_and_shrink();
+    }
+    return map;
+  }
+
+ private:
+  template<typename ForwardKey> Shard &shard_for_key(const ForwardKey &key)
+  {
+    return const_cast<Shard &>(const_cast<const ConcurrentMap *>(this)->shard_for_key(key));
+  }
+
+  template<typename ForwardKey> const Shard &shard_for_key(const ForwardKey &key) const
+  {
+    /* Use the high bits of a mixed hash, so that the shard index is independent from the low bits
+     * of the hash, which are used to find the slot within the shard. */
+    const uint64_t hash = hash_(key);
+    return shards_[(hash * 0x9e3779b97f4a7c15) >> (64 - shard_bits)];
+  }
+};
+
+}  // namespace blender
@@ -0,0 +1,150 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::ConcurrentSet<Key>` is an insert-only set that can be modified from multiple threads
+ * at the same time. It works like #blender::ConcurrentMap, see BLI_concurrent_map.hh for details.
+ *
+ * - Keys cannot be removed.
+ * - `size`, `foreach_key` and `to_set` are not thread-safe with concurrent insertions.
+ */
+
+#include <array>
+#include <mutex>
+
+#include "BLI_set.hh"
+#include "BLI_utility_mixins.hh"
+
+namespace blender {
+
+template<typename Key,
+         typename Hash = DefaultHash<Key>,
+         typename IsEqual = DefaultEquality<Key>,
+         typename Allocator = GuardedAllocator>
+class ConcurrentSet : NonCopyable, NonMovable {
+ public:
+  using SetType = Set<Key,
+                      0,
+                      DefaultProbingStrategy,
+                      Hash,
+                      IsEqual,
+                      typename DefaultSetSlot<Key>::type,
+                      Allocator>;
+
+ private:
+  /** Has to be a power of two. */
+  static constexpr int shard_bits = 6;
+  static constexpr int64_t shards_num = int64_t(1) << shard_bits;
+
+  /** Aligned to avoid false sharing between the mutexes of different shards. */
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    SetType set;
+  };
+
+  BLI_NO_UNIQUE_ADDRESS Hash hash_;
+  std::array<Shard, shards_num> shards_;
+
+ public:
+  ConcurrentSet() = default;
+
+  /**
+   * Reserve space for the given total number of keys, assuming that the keys are distributed
+   * evenly between the shards. Not thread-safe.
+   */
+  void reserve(const int64_t n)
+  {
+    const int64_t n_per_shard = n / shards_num + n / shards_num / 8 + 1;
+    for (Shard &shard : shards_) {
+      shard.set.reserve(n_per_shard);
+    }
+  }
+
+  /**
+   * Add a key to the set. Returns true when the key has been newly added.
+   */
+  template<typename ForwardKey> bool add(ForwardKey &&key)
+  {
+    Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.set.add_as(std::forward<ForwardKey>(key));
+  }
+
+  /**
+   * Returns true if the key is in the set.
+   */
+  template<typename ForwardKey> bool contains(const ForwardKey &key) const
+  {
+    const Shard &shard = this->shard_for_key(key);
+    std::lock_guard lock{shard.mutex};
+    return shard.set.contains_as(key);
+  }
+
+  /**
+   * Return the number of keys in the set. Not thread-safe.
+   */
+  int64_t size() const
+  {
+    int64_t size = 0;
+    for (const Shard &shard : shards_) {
+      size += shard.set.size();
+    }
+    return size;
+  }
+
+  /**
+   * Returns true if there are no keys in the set. Not thread-safe.
+   */
+  bool is_empty() const
+  {
+    return this->size() == 0;
+  }
+
+  /**
+   * Call the function for every key in the set. The order is undefined. Not thread-safe.
+   */
+  template<typename FuncT> void foreach_key(const FuncT &func) const
+  {
+    for (const Shard &shard : shards_) {
+      for (const Key &key : shard.set) {
+        func(key);
+      }
+    }
+  }
+
+  /**
+   * Move all keys into a normal set. The concurrent set is empty afterwards. Not thread-safe.
+   */
+  SetType to_set()
+  {
+    SetType set;
+    set.reserve(this->size());
+    for (Shard &shard : shards_) {
+      for (const Key &key : shard.set) {
+        set.add_new(key);
+      }
+      shard.set.clear_and_shrink();
+    }
+    return set;
+  }
+
+ private:
+  template<typename ForwardKey> Shard &shard_for_key(const ForwardKey &key)
+  {
+    return const_cast<Shard &>(const_cast<const ConcurrentSet *>(this)->shard_for_key(key));
+  }
+
+  template<typename ForwardKey> const Shard &shard_for_key(const ForwardKey &key) const
+  {
+    /* See #ConcurrentMap. */
+    const uint64_t hash = hash_(key);
+    return shards_[(hash * 0x9e3779b97f4a7c15) >> (64 - shard_bits)];
+  }
+};
+
+}  // namespace blender
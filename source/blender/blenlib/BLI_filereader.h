@@ -27,6 +27,7 @@ typedef int64_t off64_t;
 extern "C" {
 #endif
 
+struct BLI_mmap_file;
 struct FileReader;
 
 typedef int64_t (*FileReaderReadFn)(struct FileReader *reader, void *buffer, size_t size);
@@ -54,6 +55,13 @@ typedef struct FileReader {
 FileReader *BLI_filereader_new_file(int filedes) ATTR_WARN_UNUSED_RESULT;
 /** Create #FileReader from raw file descriptor using memory-mapped IO. */
 FileReader *BLI_filereader_new_mmap(int filedes) ATTR_WARN_UNUSED_RESULT;
+/** Same as #BLI_filereader_new_mmap, see #BLI_mmap_open_ex for `copy_on_write`. */
+FileReader *BLI_filereader_new_mmap_ex(int filedes, bool copy_on_write) ATTR_WARN_UNUSED_RESULT;
+/**
+ * Get the memory mapping backing a #FileReader created by #BLI_filereader_new_mmap,
+ * NULL for any other kind of #FileReader.
+ */
+struct BLI_mmap_file *BLI_filereader_mmap_file_get(FileReader *reader) ATTR_NONNULL();
 /** Create #FileReader from a region of memory. */
 FileReader *BLI_filereader_new_memory(const void *data, size_t len) ATTR_WARN_UNUSED_RESULT
     ATTR_NONNULL();
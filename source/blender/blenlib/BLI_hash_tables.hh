@@ -12,7 +12,9 @@
 
 #include <algorithm>
 
+#include "BLI_array.hh"
 #include "BLI_memory_utils.hh"
+#include "BLI_probing_strategies.hh"
 #include "BLI_utildefines.h"
 #include "BLI_vector.hh"
 
@@ -213,6 +215,91 @@ template<typename Pointer> struct PointerKeyInfo {
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Slot Metadata
+ *
+ * Probing strategies like #GroupProbingStrategy need one metadata byte per slot, which is stored
+ * in a separate array so that a group of slots can be checked at once. Hash tables store a
+ * #SlotMetadataFor member and update it whenever a slot becomes occupied. Removed slots keep
+ * their metadata, they just never compare equal to a key.
+ *
+ * \{ */
+
+/**
+ * Slot metadata for probing strategies that don't need any. All methods are no-ops.
+ */
+class NoSlotMetadata {
+ public:
+  static constexpr int64_t min_total_slots = 1;
+
+  NoSlotMetadata() = default;
+  template<typename Allocator> NoSlotMetadata(Allocator /*allocator*/) {}
+
+  void reinitialize(int64_t /*total_slots*/) {}
+
+  void occupy(int64_t /*slot_index*/, uint64_t /*hash*/) {}
+
+  const uint8_t *data() const
+  {
+    return nullptr;
+  }
+
+  int64_t size_in_bytes() const
+  {
+    return 0;
+  }
+};
+
+/**
+ * Stores a metadata byte per slot. There are always at least #GroupProbingStrategy::group_size
+ * bytes, so that an empty hash table (which only has a single slot) can be probed as well.
+ */
+template<int64_t InlineBufferCapacity, typename Allocator> class GroupSlotMetadata {
+ public:
+  /** The hash table needs at least one full group of slots. */
+  static constexpr int64_t min_total_slots = GroupProbingStrategy::group_size;
+
+ private:
+  Array<uint8_t, std::max(InlineBufferCapacity, min_total_slots), Allocator> metadata_;
+
+ public:
+  GroupSlotMetadata(Allocator allocator = {}) noexcept : metadata_(allocator)
+  {
+    metadata_.reinitialize(min_total_slots);
+    metadata_.fill(GroupProbingStrategy::empty_metadata);
+  }
+
+  /** Resize to the given number of slots and mark all of them as empty. */
+  void reinitialize(const int64_t total_slots)
+  {
+    metadata_.reinitialize(std::max(total_slots, min_total_slots));
+    metadata_.fill(GroupProbingStrategy::empty_metadata);
+  }
+
+  void occupy(const int64_t slot_index, const uint64_t hash)
+  {
+    metadata_[slot_index] = GroupProbingStrategy::fingerprint(hash);
+  }
+
+  const uint8_t *data() const
+  {
+    return metadata_.data();
+  }
+
+  int64_t size_in_bytes() const
+  {
+    return metadata_.size();
+  }
+};
+
+template<typename ProbingStrategy, int64_t InlineBufferCapacity, typename Allocator>
+using SlotMetadataFor =
+    std::conditional_t<probing_strategy_uses_slot_metadata_v<ProbingStrategy>,
+                       GroupSlotMetadata<InlineBufferCapacity, Allocator>,
+                       NoSlotMetadata>;
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Hash Table Stats
  *
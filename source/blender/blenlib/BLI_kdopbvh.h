@@ -84,12 +84,22 @@ enum {
   /* Use a priority queue to process nodes in the optimal order (for slow callbacks) */
   BVH_NEAREST_OPTIMAL_ORDER = (1 << 0),
 };
+enum {
+  /* Split the leafs with a surface area heuristic instead of the median,
+   * slower to build but faster to query (only for trees using the x, y & z axes). */
+  BVH_BALANCE_SAH = (1 << 0),
+  /* Also store a flattened 4-wide copy of the tree, traversed with SIMD
+   * by #BLI_bvhtree_ray_cast_ex & #BLI_bvhtree_find_nearest_ex (uses more memory). */
+  BVH_BALANCE_FLAT = (1 << 1),
+};
 enum {
   /* calculate IsectRayPrecalc data */
   BVH_RAYCAST_WATERTIGHT = (1 << 0),
 };
 #define BVH_RAYCAST_DEFAULT (BVH_RAYCAST_WATERTIGHT)
 #define BVH_RAYCAST_DIST_MAX (FLT_MAX / 2.0f)
+/** Number of rays traced together by #BLI_bvhtree_ray_cast_packet. */
+#define BVH_RAYCAST_PACKET_SIZE 16
 
 /**
  * Callback must update nearest in case it finds a nearest result.
@@ -137,6 +147,7 @@ void BLI_bvhtree_free(BVHTree *tree);
  * Construct: first insert points, then call balance.
  */
 void BLI_bvhtree_insert(BVHTree *tree, int index, const float co[3], int numpoints);
+void BLI_bvhtree_balance_ex(BVHTree *tree, int flag);
 void BLI_bvhtree_balance(BVHTree *tree);
 
 /**
@@ -247,6 +258,23 @@ int BLI_bvhtree_ray_cast(const BVHTree *tree,
                          BVHTree_RayCastCallback callback,
                          void *userdata);
 
+/**
+ * Cast \a rays_num rays, the result of each ray is the same as with #BLI_bvhtree_ray_cast_ex.
+ * Rays are traced in packets of #BVH_RAYCAST_PACKET_SIZE sharing a single traversal of the tree,
+ * which is faster for coherent rays (nearby origins and similar directions).
+ *
+ * \param hits: The hit of each ray, initialized like for #BLI_bvhtree_ray_cast_ex.
+ */
+void BLI_bvhtree_ray_cast_packet(const BVHTree *tree,
+                                 const float (*co)[3],
+                                 const float (*dir)[3],
+                                 int rays_num,
+                                 float radius,
+                                 BVHTreeRayHit *hits,
+                                 BVHTree_RayCastCallback callback,
+                                 void *userdata,
+                                 int flag);
+
 /**
  * Calls the callback for every ray intersection
  *
@@ -44,6 +44,20 @@ int BLI_kdtree_nd_(find_nearest_n)(const KDTree *tree,
                                    KDTreeNearest *r_nearest,
                                    uint nearest_len_capacity) ATTR_NONNULL(1, 2, 3);
 
+/**
+ * Batched versions of #find_nearest & #find_nearest_n, running the queries in parallel.
+ */
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        uint co_len,
+                                        KDTreeNearest *r_nearest) ATTR_NONNULL(1);
+void BLI_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          uint co_len,
+                                          KDTreeNearest *r_nearest,
+                                          uint nearest_len_capacity,
+                                          int *r_nearest_len) ATTR_NONNULL(1);
+
 int BLI_kdtree_nd_(range_search)(const KDTree *tree,
                                  const float co[KD_DIMS],
                                  KDTreeNearest **r_nearest,
@@ -33,6 +33,8 @@
  * - Pointers to keys and values might be invalidated when the map is changed or moved.
  * - The hash function can be customized. See BLI_hash.hh for details.
  * - The probing strategy can be customized. See BLI_probing_strategies.hh for details.
+ * - Using #GroupProbingStrategy changes the layout of the map: an additional metadata byte is
+ *   stored per slot and groups of slots are probed at once using SIMD instructions.
  * - The slot type can be customized. See BLI_map_slots.hh for details.
  * - Small buffer optimization is enabled by default, if Key and Value are not too large.
  * - The methods `add_new` and `remove_contained` should be used instead of `add` and `remove`
@@ -158,11 +160,20 @@ class Map {
   /** This is called to check equality of two keys. */
   BLI_NO_UNIQUE_ADDRESS IsEqual is_equal_;
 
-  /** The max load factor is 1/2 = 50% by default. */
+  /**
+   * The max load factor is 1/2 = 50% by default. Probing with slot metadata only has to look at
+   * few slots even when the map is almost full, so a higher load factor of 7/8 is used then.
+   */
 #define LOAD_FACTOR 1, 2
-  LoadFactor max_load_factor_ = LoadFactor(LOAD_FACTOR);
+  LoadFactor max_load_factor_ = probing_strategy_uses_slot_metadata_v<ProbingStrategy> ?
+                                    LoadFactor(7, 8) :
+                                    LoadFactor(LOAD_FACTOR);
   using SlotArray =
       Array<Slot, LoadFactor::compute_total_slots(InlineBufferCapacity, LOAD_FACTOR), Allocator>;
+  using SlotMetadata =
+      SlotMetadataFor<ProbingStrategy,
+                      LoadFactor::compute_total_slots(InlineBufferCapacity, LOAD_FACTOR),
+                      Allocator>;
 #undef LOAD_FACTOR
 
   /**
@@ -171,11 +182,18 @@ class Map {
    */
   SlotArray slots_;
 
-  /** Iterate over a slot index sequence for a given hash. */
+  /** Optional metadata byte per slot, depending on the probing strategy. */
+  BLI_NO_UNIQUE_ADDRESS SlotMetadata slot_metadata_;
+
+  /**
+   * Iterate over a slot index sequence for a given hash. The index of the current slot is
+   * available as `SLOT_INDEX`.
+   */
 #define MAP_SLOT_PROBING_BEGIN(HASH, R_SLOT) \
-  SLOT_PROBING_BEGIN (ProbingStrategy, HASH, slot_mask_, SLOT_INDEX) \
+  SLOT_METADATA_PROBING_BEGIN ( \
+      ProbingStrategy, HASH, slot_mask_, slot_metadata_.data(), SLOT_INDEX) \
     auto &R_SLOT = slots_[SLOT_INDEX];
-#define MAP_SLOT_PROBING_END() SLOT_PROBING_END()
+#define MAP_SLOT_PROBING_END() SLOT_METADATA_PROBING_END()
 
  public:
   /**
@@ -190,7 +208,8 @@ class Map {
         slot_mask_(0),
         hash_(),
         is_equal_(),
-        slots_(1, allocator)
+        slots_(1, allocator),
+        slot_metadata_(allocator)
   {
   }
 
@@ -205,10 +224,12 @@ class Map {
   {
     if constexpr (std::is_nothrow_move_constructible_v<SlotArray>) {
       slots_ = std::move(other.slots_);
+      slot_metadata_ = std::move(other.slot_metadata_);
     }
     else {
       try {
         slots_ = std::move(other.slots_);
+        slot_metadata_ = std::move(other.slot_metadata_);
       }
       catch (...) {
         other.noexcept_reset();
@@ -969,7 +990,7 @@ class Map {
    */
   int64_t size_in_bytes() const
   {
-    return int64_t(sizeof(Slot) * slots_.size());
+    return int64_t(sizeof(Slot) * slots_.size()) + slot_metadata_.size_in_bytes();
   }
 
   /**
@@ -992,6 +1013,7 @@ class Map {
       slot.~Slot();
       new (&slot) Slot();
     }
+    slot_metadata_.reinitialize(slots_.size());
 
     removed_slots_ = 0;
     occupied_and_removed_slots_ = 0;
@@ -1047,7 +1069,10 @@ class Map {
   {
     int64_t total_slots, usable_slots;
     max_load_factor_.compute_total_and_usable_slots(
-        SlotArray::inline_buffer_capacity(), min_usable_slots, &total_slots, &usable_slots);
+        std::max(SlotArray::inline_buffer_capacity(), SlotMetadata::min_total_slots),
+        min_usable_slots,
+        &total_slots,
+        &usable_slots);
     BLI_assert(total_slots >= 1);
     const uint64_t new_slot_mask = uint64_t(total_slots) - 1;
 
@@ -1057,6 +1082,7 @@ class Map {
     if (this->size() == 0) {
       try {
         slots_.reinitialize(total_slots);
+        slot_metadata_.reinitialize(total_slots);
       }
       catch (...) {
         this->noexcept_reset();
@@ -1072,13 +1098,16 @@ class Map {
     SlotArray new_slots(total_slots);
 
     try {
+      SlotMetadata new_slot_metadata(slots_.allocator());
+      new_slot_metadata.reinitialize(total_slots);
       for (Slot &slot : slots_) {
         if (slot.is_occupied()) {
-          this->add_after_grow(slot, new_slots, new_slot_mask);
+          this->add_after_grow(slot, new_slots, new_slot_metadata, new_slot_mask);
           slot.remove();
         }
       }
       slots_ = std::move(new_slots);
+      slot_metadata_ = std::move(new_slot_metadata);
     }
     catch (...) {
       this->noexcept_reset();
@@ -1091,17 +1120,23 @@ class Map {
     slot_mask_ = new_slot_mask;
   }
 
-  void add_after_grow(Slot &old_slot, SlotArray &new_slots, uint64_t new_slot_mask)
+  void add_after_grow(Slot &old_slot,
+                      SlotArray &new_slots,
+                      SlotMetadata &new_slot_metadata,
+                      uint64_t new_slot_mask)
   {
     uint64_t hash = old_slot.get_hash(Hash());
-    SLOT_PROBING_BEGIN (ProbingStrategy, hash, new_slot_mask, slot_index) {
+    SLOT_METADATA_PROBING_BEGIN (
+        ProbingStrategy, hash, new_slot_mask, new_slot_metadata.data(), slot_index)
+    {
       Slot &slot = new_slots[slot_index];
       if (slot.is_empty()) {
         slot.occupy(std::move(*old_slot.key()), hash, std::move(*old_slot.value()));
+        new_slot_metadata.occupy(slot_index, hash);
         return;
       }
     }
-    SLOT_PROBING_END();
+    SLOT_METADATA_PROBING_END();
   }
 
   void noexcept_reset() noexcept
@@ -1122,6 +1157,7 @@ class Map {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash, std::forward<ForwardValue>(value)...);
         BLI_assert(hash_(*slot.key()) == hash);
+        slot_metadata_.occupy(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return;
       }
@@ -1138,6 +1174,7 @@ class Map {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash, std::forward<ForwardValue>(value)...);
         BLI_assert(hash_(*slot.key()) == hash);
+        slot_metadata_.occupy(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return true;
       }
@@ -1167,12 +1204,14 @@ class Map {
         if constexpr (std::is_void_v<CreateReturnT>) {
           create_value(value_ptr);
           slot.occupy_no_value(std::forward<ForwardKey>(key), hash);
+          slot_metadata_.occupy(SLOT_INDEX, hash);
           occupied_and_removed_slots_++;
           return;
         }
         else {
           auto &&return_value = create_value(value_ptr);
           slot.occupy_no_value(std::forward<ForwardKey>(key), hash);
+          slot_metadata_.occupy(SLOT_INDEX, hash);
           occupied_and_removed_slots_++;
           return return_value;
         }
@@ -1194,6 +1233,7 @@ class Map {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash, create_value());
         BLI_assert(hash_(*slot.key()) == hash);
+        slot_metadata_.occupy(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return *slot.value();
       }
@@ -1213,6 +1253,7 @@ class Map {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash, std::forward<ForwardValue>(value)...);
         BLI_assert(hash_(*slot.key()) == hash);
+        slot_metadata_.occupy(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return *slot.value();
       }
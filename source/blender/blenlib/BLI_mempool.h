@@ -107,6 +107,11 @@ enum {
    * order of allocation when no chunks have been freed.
    */
   BLI_MEMPOOL_ALLOW_ITER = (1 << 0),
+  /**
+   * Allow allocating and freeing elements from multiple threads at the same time,
+   * either directly (serialized by a lock) or through a #BLI_mempool_thread_cache per thread.
+   */
+  BLI_MEMPOOL_THREAD_CACHE = (1 << 1),
 };
 
 /**
@@ -118,6 +123,44 @@ void BLI_mempool_iternew(BLI_mempool *pool, BLI_mempool_iter *iter) ATTR_NONNULL
  */
 void *BLI_mempool_iterstep(BLI_mempool_iter *iter) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
 
+/**
+ * Thread caches.
+ *
+ * A thread cache keeps a small local free list of elements that it takes from and returns to
+ * the shared pool in batches. This way parallel code can allocate and free elements with
+ * (almost) no contention, e.g. by creating one cache for every range of a parallel loop.
+ *
+ * The pool has to be created with the #BLI_MEMPOOL_THREAD_CACHE flag. A cache must only be used
+ * by one thread at a time. Elements may be freed through any cache of the same pool.
+ *
+ * \note Elements held by caches count as used in #BLI_mempool_len, so all caches have to be
+ * flushed or destroyed before the pool is iterated, cleared or destroyed.
+ */
+
+typedef struct BLI_mempool_thread_cache BLI_mempool_thread_cache;
+
+BLI_mempool_thread_cache *BLI_mempool_thread_cache_create(BLI_mempool *pool)
+    ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_RETURNS_NONNULL ATTR_NONNULL(1);
+void *BLI_mempool_thread_cache_alloc(BLI_mempool_thread_cache *cache)
+    ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_RETURNS_NONNULL ATTR_NONNULL(1);
+void *BLI_mempool_thread_cache_calloc(BLI_mempool_thread_cache *cache)
+    ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_RETURNS_NONNULL ATTR_NONNULL(1);
+/**
+ * Free an element into the local free list of the cache.
+ *
+ * \note doesn't protect against double frees, take care!
+ */
+void BLI_mempool_thread_cache_free(BLI_mempool_thread_cache *cache, void *addr)
+    ATTR_NONNULL(1, 2);
+/**
+ * Return all cached free elements to the pool.
+ */
+void BLI_mempool_thread_cache_flush(BLI_mempool_thread_cache *cache) ATTR_NONNULL(1);
+/**
+ * Flush and free the cache.
+ */
+void BLI_mempool_thread_cache_destroy(BLI_mempool_thread_cache *cache) ATTR_NONNULL(1);
+
 #ifdef __cplusplus
 }
 #endif
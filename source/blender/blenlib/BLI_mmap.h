@@ -25,6 +25,9 @@ typedef struct BLI_mmap_file BLI_mmap_file;
  * May return NULL if the operation fails.
  * Note that this seeks to the end of the file to determine its length. */
 BLI_mmap_file *BLI_mmap_open(int fd) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+/* Same as #BLI_mmap_open, but when `copy_on_write` is set the mapped memory is also writable.
+ * Written pages become private to the process, changes are never written back to the file. */
+BLI_mmap_file *BLI_mmap_open_ex(int fd, bool copy_on_write) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 
 /* Reads length bytes from file at the given offset into dest.
  * Returns whether the operation was successful (may fail when reading beyond the file
@@ -32,9 +35,19 @@ BLI_mmap_file *BLI_mmap_open(int fd) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 bool BLI_mmap_read(BLI_mmap_file *file, void *dest, size_t offset, size_t length)
     ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1);
 
+/* Hint that the given range will be read soon, so that the OS can start reading it from disk in
+ * the background. Does nothing when that is not supported. */
+void BLI_mmap_prefetch(BLI_mmap_file *file, size_t offset, size_t length) ATTR_NONNULL(1);
+
 void *BLI_mmap_get_pointer(BLI_mmap_file *file) ATTR_WARN_UNUSED_RESULT;
 size_t BLI_mmap_get_length(const BLI_mmap_file *file) ATTR_WARN_UNUSED_RESULT;
 
+/* Add a user to the mapping, it is only unmapped once #BLI_mmap_free has been called for each
+ * user (the initial one included). This is used to keep memory referencing the mapping alive
+ * after the code which opened it is done reading. Thread-safe. */
+void BLI_mmap_add_user(BLI_mmap_file *file) ATTR_NONNULL(1);
+
+/* Remove a user of the mapping, unmapping the file when this was the last one. Thread-safe. */
 void BLI_mmap_free(BLI_mmap_file *file) ATTR_NONNULL(1);
 
 #ifdef __cplusplus
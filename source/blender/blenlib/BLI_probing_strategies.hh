@@ -45,6 +45,8 @@
 
 #include <limits>
 
+#include "BLI_math_bits.h"
+#include "BLI_simd.hh"
 #include "BLI_sys_types.h"
 
 namespace blender {
@@ -197,11 +199,174 @@ template<uint64_t LinearSteps = 2, bool PreShuffle = false> class ShuffleProbing
   }
 };
 
+/**
+ * Probes groups of #group_size consecutive slots instead of individual slots, in the style of
+ * "Swiss tables". The hash table stores an additional metadata byte per slot that is either
+ * #empty_metadata or a 7 bit fingerprint of the hash of the key in that slot. The metadata of a
+ * whole group is compared with the fingerprint of the searched key using SIMD instructions, so
+ * that only slots that are empty or have a matching fingerprint have to be checked. This makes
+ * lookups cheap even when the hash table is very full, which allows for a higher load factor.
+ *
+ * Hash tables using this strategy need at least #group_size slots. The groups are visited in a
+ * triangular sequence, which hits every group when the number of groups is a power of two.
+ *
+ * Since many hash functions in Blender are trivial (e.g. for integers), the hash is mixed before
+ * the group and the fingerprint are extracted from it.
+ *
+ * This works best when keys are expensive to compare (e.g. strings) or many lookups fail. For
+ * integer keys with a trivial hash, the default strategy is often faster, because it keeps
+ * consecutive keys in consecutive slots.
+ *
+ * When used in a hash table that does not support slot metadata, this is a linear probing
+ * strategy over groups.
+ */
+class GroupProbingStrategy {
+ private:
+  uint64_t group_start_;
+  uint64_t step_ = 0;
+
+ public:
+  static constexpr int64_t group_size = 16;
+  static constexpr uint8_t empty_metadata = 0x80;
+
+  GroupProbingStrategy(const uint64_t hash) : group_start_((mix(hash) >> 32) * group_size) {}
+
+  void next()
+  {
+    step_ += group_size;
+    group_start_ += step_;
+  }
+
+  uint64_t get() const
+  {
+    return group_start_;
+  }
+
+  int64_t linear_steps() const
+  {
+    return group_size;
+  }
+
+  /** The metadata byte stored for a slot that contains a key with the given hash. */
+  static uint8_t fingerprint(const uint64_t hash)
+  {
+    return uint8_t(mix(hash) >> 57);
+  }
+
+  /**
+   * Get a bit mask of the slots in the group starting at the given metadata that are empty or
+   * have the given fingerprint. Bit i corresponds to the i-th slot in the group.
+   */
+  static uint32_t match_group(const uint8_t *group_metadata, const uint8_t fingerprint)
+  {
+#if BLI_HAVE_SSE2
+    const __m128i metadata = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group_metadata));
+    const __m128i matches = _mm_cmpeq_epi8(metadata, _mm_set1_epi8(char(fingerprint)));
+    /* Only empty slots have the high bit set in the metadata. */
+    return uint32_t(_mm_movemask_epi8(_mm_or_si128(matches, metadata)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < group_size; i++) {
+      if (group_metadata[i] == fingerprint || group_metadata[i] == empty_metadata) {
+        mask |= 1u << i;
+      }
+    }
+    return mask;
+#endif
+  }
+
+ private:
+  static uint64_t mix(const uint64_t hash)
+  {
+    return (hash ^ (hash >> 32)) * 0x9e3779b97f4a7c15;
+  }
+};
+
 /**
  * Having a specified default is convenient.
  */
 using DefaultProbingStrategy = PythonProbingStrategy<>;
 
+/**
+ * True when hash tables should store a metadata byte per slot for the probing strategy.
+ */
+template<typename ProbingStrategy>
+inline constexpr bool probing_strategy_uses_slot_metadata_v = false;
+template<>
+inline constexpr bool probing_strategy_uses_slot_metadata_v<GroupProbingStrategy> = true;
+
+/**
+ * Iterates over the slot indices that have to be checked for the current value of a probing
+ * strategy. Without slot metadata, these are just the linear steps of the probing strategy.
+ */
+template<typename ProbingStrategy> class SlotProbingCandidates {
+ private:
+  uint64_t current_hash_;
+  uint64_t mask_;
+  int64_t linear_offset_ = 0;
+  int64_t linear_steps_;
+
+ public:
+  SlotProbingCandidates(ProbingStrategy &probing_strategy,
+                        const uint64_t /*hash*/,
+                        const uint64_t mask,
+                        const uint8_t * /*metadata*/)
+      : current_hash_(probing_strategy.get()),
+        mask_(mask),
+        linear_steps_(probing_strategy.linear_steps())
+  {
+  }
+
+  int64_t get() const
+  {
+    return int64_t((current_hash_ + uint64_t(linear_offset_)) & mask_);
+  }
+
+  bool next()
+  {
+    return ++linear_offset_ < linear_steps_;
+  }
+};
+
+/**
+ * With slot metadata, only the slots of a group that are empty or have a matching fingerprint
+ * are candidates. Groups without any candidates are skipped entirely. This always terminates,
+ * because a hash table always has at least one empty slot.
+ */
+template<> class SlotProbingCandidates<GroupProbingStrategy> {
+ private:
+  int64_t group_start_;
+  uint32_t candidates_;
+
+ public:
+  SlotProbingCandidates(GroupProbingStrategy &probing_strategy,
+                        const uint64_t hash,
+                        const uint64_t mask,
+                        const uint8_t *metadata)
+  {
+    const uint8_t fingerprint = GroupProbingStrategy::fingerprint(hash);
+    while (true) {
+      group_start_ = int64_t(probing_strategy.get() & mask);
+      candidates_ = GroupProbingStrategy::match_group(metadata + group_start_, fingerprint);
+      if (candidates_ != 0) {
+        break;
+      }
+      probing_strategy.next();
+    }
+  }
+
+  int64_t get() const
+  {
+    return group_start_ + int64_t(bitscan_forward_uint(candidates_));
+  }
+
+  bool next()
+  {
+    candidates_ &= candidates_ - 1;
+    return candidates_ != 0;
+  }
+};
+
 /* Turning off clang format here, because otherwise it will mess up the alignment between the
  * macros. */
 // clang-format off
@@ -232,6 +397,25 @@ using DefaultProbingStrategy = PythonProbingStrategy<>;
     probing_strategy.next(); \
   } while (true)
 
+/**
+ * Same as #SLOT_PROBING_BEGIN, but only iterates over the slots that have to be checked according
+ * to the slot metadata. Without slot metadata (which can be null then), all slots are iterated.
+ *
+ * METADATA: Pointer to the metadata bytes of the slots, see #GroupProbingStrategy.
+ */
+#define SLOT_METADATA_PROBING_BEGIN(PROBING_STRATEGY, HASH, MASK, METADATA, R_SLOT_INDEX) \
+  PROBING_STRATEGY probing_strategy(HASH); \
+  do { \
+    SlotProbingCandidates<PROBING_STRATEGY> probing_candidates( \
+        probing_strategy, HASH, MASK, METADATA); \
+    do { \
+      int64_t R_SLOT_INDEX = probing_candidates.get();
+
+#define SLOT_METADATA_PROBING_END() \
+    } while (probing_candidates.next()); \
+    probing_strategy.next(); \
+  } while (true)
+
 // clang-format on
 
 }  // namespace blender
@@ -32,6 +32,8 @@
  * - Pointers to keys might be invalidated when the set is changed or moved.
  * - The hash function can be customized. See BLI_hash.hh for details.
  * - The probing strategy can be customized. See BLI_probing_stragies.hh for details.
+ * - Using #GroupProbingStrategy changes the layout of the set: an additional metadata byte is
+ *   stored per slot and groups of slots are probed at once using SIMD instructions.
  * - The slot type can be customized. See BLI_set_slots.hh for details.
  * - Small buffer optimization is enabled by default, if the key is not too large.
  * - The methods `add_new` and `remove_contained` should be used instead of `add` and `remove`
@@ -140,11 +142,20 @@ class Set {
   /** This is called to check equality of two keys. */
   BLI_NO_UNIQUE_ADDRESS IsEqual is_equal_;
 
-  /** The max load factor is 1/2 = 50% by default. */
+  /**
+   * The max load factor is 1/2 = 50% by default. Probing with slot metadata only has to look at
+   * few slots even when the set is almost full, so a higher load factor of 7/8 is used then.
+   */
 #define LOAD_FACTOR 1, 2
-  LoadFactor max_load_factor_ = LoadFactor(LOAD_FACTOR);
+  LoadFactor max_load_factor_ = probing_strategy_uses_slot_metadata_v<ProbingStrategy> ?
+                                    LoadFactor(7, 8) :
+                                    LoadFactor(LOAD_FACTOR);
   using SlotArray =
       Array<Slot, LoadFactor::compute_total_slots(InlineBufferCapacity, LOAD_FACTOR), Allocator>;
+  using SlotMetadata =
+      SlotMetadataFor<ProbingStrategy,
+                      LoadFactor::compute_total_slots(InlineBufferCapacity, LOAD_FACTOR),
+                      Allocator>;
 #undef LOAD_FACTOR
 
   /**
@@ -153,11 +164,18 @@ class Set {
    */
   SlotArray slots_;
 
-  /** Iterate over a slot index sequence for a given hash. */
+  /** Optional metadata byte per slot, depending on the probing strategy. */
+  BLI_NO_UNIQUE_ADDRESS SlotMetadata slot_metadata_;
+
+  /**
+   * Iterate over a slot index sequence for a given hash. The index of the current slot is
+   * available as `SLOT_INDEX`.
+   */
 #define SET_SLOT_PROBING_BEGIN(HASH, R_SLOT) \
-  SLOT_PROBING_BEGIN (ProbingStrategy, HASH, slot_mask_, SLOT_INDEX) \
+  SLOT_METADATA_PROBING_BEGIN ( \
+      ProbingStrategy, HASH, slot_mask_, slot_metadata_.data(), SLOT_INDEX) \
     auto &R_SLOT = slots_[SLOT_INDEX];
-#define SET_SLOT_PROBING_END() SLOT_PROBING_END()
+#define SET_SLOT_PROBING_END() SLOT_METADATA_PROBING_END()
 
  public:
   /**
@@ -170,7 +188,8 @@ class Set {
         occupied_and_removed_slots_(0),
         usable_slots_(0),
         slot_mask_(0),
-        slots_(1, allocator)
+        slots_(1, allocator),
+        slot_metadata_(allocator)
   {
   }
 
@@ -196,10 +215,12 @@ class Set {
   {
     if constexpr (std::is_nothrow_move_constructible_v<SlotArray>) {
       slots_ = std::move(other.slots_);
+      slot_metadata_ = std::move(other.slot_metadata_);
     }
     else {
       try {
         slots_ = std::move(other.slots_);
+        slot_metadata_ = std::move(other.slot_metadata_);
       }
       catch (...) {
         other.noexcept_reset();
@@ -535,6 +556,7 @@ class Set {
       slot.~Slot();
       new (&slot) Slot();
     }
+    slot_metadata_.reinitialize(slots_.size());
 
     removed_slots_ = 0;
     occupied_and_removed_slots_ = 0;
@@ -604,7 +626,7 @@ class Set {
    */
   int64_t size_in_bytes() const
   {
-    return sizeof(Slot) * slots_.size();
+    return sizeof(Slot) * slots_.size() + slot_metadata_.size_in_bytes();
   }
 
   /**
@@ -667,7 +689,10 @@ class Set {
   {
     int64_t total_slots, usable_slots;
     max_load_factor_.compute_total_and_usable_slots(
-        SlotArray::inline_buffer_capacity(), min_usable_slots, &total_slots, &usable_slots);
+        std::max(SlotArray::inline_buffer_capacity(), SlotMetadata::min_total_slots),
+        min_usable_slots,
+        &total_slots,
+        &usable_slots);
     BLI_assert(total_slots >= 1);
     const uint64_t new_slot_mask = uint64_t(total_slots) - 1;
 
@@ -677,6 +702,7 @@ class Set {
     if (this->size() == 0) {
       try {
         slots_.reinitialize(total_slots);
+        slot_metadata_.reinitialize(total_slots);
       }
       catch (...) {
         this->noexcept_reset();
@@ -693,13 +719,16 @@ class Set {
     SlotArray new_slots(total_slots);
 
     try {
+      SlotMetadata new_slot_metadata(slots_.allocator());
+      new_slot_metadata.reinitialize(total_slots);
       for (Slot &slot : slots_) {
         if (slot.is_occupied()) {
-          this->add_after_grow(slot, new_slots, new_slot_mask);
+          this->add_after_grow(slot, new_slots, new_slot_metadata, new_slot_mask);
           slot.remove();
         }
       }
       slots_ = std::move(new_slots);
+      slot_metadata_ = std::move(new_slot_metadata);
     }
     catch (...) {
       this->noexcept_reset();
@@ -712,18 +741,24 @@ class Set {
     slot_mask_ = new_slot_mask;
   }
 
-  void add_after_grow(Slot &old_slot, SlotArray &new_slots, const uint64_t new_slot_mask)
+  void add_after_grow(Slot &old_slot,
+                      SlotArray &new_slots,
+                      SlotMetadata &new_slot_metadata,
+                      const uint64_t new_slot_mask)
   {
     const uint64_t hash = old_slot.get_hash(Hash());
 
-    SLOT_PROBING_BEGIN (ProbingStrategy, hash, new_slot_mask, slot_index) {
+    SLOT_METADATA_PROBING_BEGIN (
+        ProbingStrategy, hash, new_slot_mask, new_slot_metadata.data(), slot_index)
+    {
       Slot &slot = new_slots[slot_index];
       if (slot.is_empty()) {
         slot.occupy(std::move(*old_slot.key()), hash);
+        new_slot_metadata.occupy(slot_index, hash);
         return;
       }
     }
-    SLOT_PROBING_END();
+    SLOT_METADATA_PROBING_END();
   }
 
   /**
@@ -788,6 +823,7 @@ class Set {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash);
         BLI_assert(hash_(*slot.key()) == hash);
+        slot_metadata_.occupy(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return;
       }
@@ -803,6 +839,7 @@ class Set {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash);
         BLI_assert(hash_(*slot.key()) == hash);
+        slot_metadata_.occupy(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return true;
       }
@@ -855,6 +892,7 @@ class Set {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash);
         BLI_assert(hash_(*slot.key()) == hash);
+        slot_metadata_.occupy(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return *slot.key();
       }
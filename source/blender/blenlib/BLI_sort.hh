@@ -14,6 +14,8 @@
 #  include <algorithm>
 #endif
 
+#include "BLI_span.hh"
+
 namespace blender {
 
 #ifdef WITH_TBB
@@ -31,4 +33,31 @@ void parallel_sort(RandomAccessIterator begin, RandomAccessIterator end, const C
 }
 #endif
 
+/**
+ * Sort the values in ascending order with a parallel LSD radix sort. This is much faster than
+ * #parallel_sort for large arrays, because the cost per element does not grow with the array
+ * size and there are no unpredictable branches.
+ *
+ * Signed zeros are ordered as `-0.0f < 0.0f` and NaN values are ordered by their bit pattern
+ * (i.e. negative NaNs come first and positive NaNs last).
+ */
+void parallel_radix_sort(MutableSpan<int32_t> values);
+void parallel_radix_sort(MutableSpan<uint32_t> values);
+void parallel_radix_sort(MutableSpan<int64_t> values);
+void parallel_radix_sort(MutableSpan<uint64_t> values);
+void parallel_radix_sort(MutableSpan<float> values);
+
+/**
+ * Reorder the indices so that `keys[indices[i]]` is in ascending order. The sort is stable, so
+ * indices with equal keys keep their relative order. To get the sorted order of all keys, fill
+ * the indices with #array_utils::fill_index_range first.
+ *
+ * Keys are compared the same way as in #parallel_radix_sort.
+ */
+void parallel_radix_sort_indices_by_key(Span<int32_t> keys, MutableSpan<int> indices);
+void parallel_radix_sort_indices_by_key(Span<uint32_t> keys, MutableSpan<int> indices);
+void parallel_radix_sort_indices_by_key(Span<int64_t> keys, MutableSpan<int> indices);
+void parallel_radix_sort_indices_by_key(Span<uint64_t> keys, MutableSpan<int> indices);
+void parallel_radix_sort_indices_by_key(Span<float> keys, MutableSpan<int> indices);
+
 }  // namespace blender
@@ -318,6 +318,18 @@ int BLI_task_parallel_thread_id(const TaskParallelTLS *tls);
  * TaskNode *node_3 = BLI_task_graph_node_create(task_graph, node_exec, task_data, NULL);
  * TaskNode *node_4 = BLI_task_graph_node_create(task_graph, node_exec, task_data, NULL);
  * \endcode
+ *
+ * Scheduling
+ * ----------
+ *
+ * When multiple nodes are ready to run, the nodes on the most expensive remaining path are
+ * started first. Otherwise a long chain of nodes may be delayed behind many cheap nodes and finish
+ * late. By default every node has the same cost, so the longest chain is preferred. Nodes that are
+ * known to be more expensive than others can be given a cost estimate before work is pushed:
+ *
+ * \code{.c}
+ * BLI_task_graph_node_set_cost(node_2, 100);
+ * \endcode
  * \{ */
 
 struct TaskGraph;
@@ -333,6 +345,11 @@ struct TaskNode *BLI_task_graph_node_create(struct TaskGraph *task_graph,
                                             TaskGraphNodeRunFunction run,
                                             void *user_data,
                                             TaskGraphNodeFreeFunction free_func);
+/**
+ * Set the estimated cost of running the node, relative to other nodes in the same graph. The
+ * default cost is 1. This is only a scheduling hint and has to be set before work is pushed.
+ */
+void BLI_task_graph_node_set_cost(struct TaskNode *task_node, int64_t cost);
 bool BLI_task_graph_node_push_work(struct TaskNode *task_node);
 void BLI_task_graph_edge_create(struct TaskNode *from_node, struct TaskNode *to_node);
 
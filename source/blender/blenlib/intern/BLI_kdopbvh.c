@@ -28,11 +28,18 @@
 #include "BLI_alloca.h"
 #include "BLI_heap_simple.h"
 #include "BLI_kdopbvh.h"
+#include "BLI_math_bits.h"
 #include "BLI_math_geom.h"
 #include "BLI_stack.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
 
+#include "atomic_ops.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 #include "BLI_strict_flags.h" /* Keep last. */
 
 /* used for iterative_raycast */
@@ -73,23 +80,42 @@ typedef struct BVHNode {
   char main_axis; /* Axis used to split this node */
 } BVHNode;
 
+#define BVH_FLAT_WIDTH 4
+
+/**
+ * Node of the flattened tree (see #BVH_BALANCE_FLAT), the bounding boxes of up to four children
+ * are stored per axis so they can be tested at once, the node fills two cache lines.
+ */
+typedef struct BVHNode4 {
+  float bb_min[3][BVH_FLAT_WIDTH];
+  float bb_max[3][BVH_FLAT_WIDTH];
+  /** Index of the child in #BVHTree.flat_nodes, -1 for leafs and unused slots. */
+  int child[BVH_FLAT_WIDTH];
+  /** Index of the child in #BVHTree.nodearray, -1 for unused slots. */
+  int node[BVH_FLAT_WIDTH];
+} BVHNode4;
+
+BLI_STATIC_ASSERT(sizeof(BVHNode4) == 128, "BVHNode4 should fill two cache lines")
+
 /* keep under 26 bytes for speed purposes */
 struct BVHTree {
   BVHNode **nodes;
-  BVHNode *nodearray;  /* pre-alloc branch nodes */
-  BVHNode **nodechild; /* pre-alloc children for nodes */
-  float *nodebv;       /* pre-alloc bounding-volumes for nodes */
-  float epsilon;       /* Epsilon is used for inflation of the K-DOP. */
-  int leaf_num;        /* leafs */
+  BVHNode *nodearray;   /* pre-alloc branch nodes */
+  BVHNode **nodechild;  /* pre-alloc children for nodes */
+  float *nodebv;        /* pre-alloc bounding-volumes for nodes */
+  BVHNode4 *flat_nodes; /* optional flattened copy of the branches, root first */
+  float epsilon;        /* Epsilon is used for inflation of the K-DOP. */
+  int leaf_num;         /* leafs */
   int branch_num;
+  int flat_num;
   axis_t start_axis, stop_axis; /* bvhtree_kdop_axes array indices according to axis */
   axis_t axis;                  /* KDOP type (6 => OBB, 7 => AABB, ...) */
   char tree_type;               /* type of tree (4 => quad-tree). */
 };
 
 /* optimization, ensure we stay small */
-BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 48) ||
-                      (sizeof(void *) == 4 && sizeof(BVHTree) <= 32),
+BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 64) ||
+                      (sizeof(void *) == 4 && sizeof(BVHTree) <= 48),
                   "over sized")
 
 /* avoid duplicating vars in BVHOverlapData_Thread */
@@ -856,6 +882,523 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name SAH Build
+ *
+ * Top-down build choosing the split of each branch with a binned surface area heuristic,
+ * see "On fast Construction of SAH-based Bounding Volume Hierarchies" (Wald 2007).
+ * Branches of trees with more than two children are built by repeatedly splitting the
+ * child with the largest surface area.
+ *
+ * Unlike the implicit tree the number of branches depends on the leafs, so branches are taken
+ * from a shared counter as they are created: children always get a bigger index than their
+ * parent, as #BLI_bvhtree_update_tree expects.
+ * \{ */
+
+#define BVH_SAH_BINS 16
+/**
+ * Depth from which branches are split at the median instead,
+ * this bounds the depth of the tree (and the recursion) for degenerate input.
+ */
+#define BVH_SAH_MAX_DEPTH 32
+
+typedef struct BVHSAHBin {
+  float bb_min[3], bb_max[3];
+  int count;
+} BVHSAHBin;
+
+typedef struct BVHSAHRange {
+  int begin, end;
+  /** Used to choose the next child to split. */
+  float area;
+} BVHSAHRange;
+
+typedef struct BVHSAHBuildData {
+  BVHTree *tree;
+  /** Number of used branches, incremented atomically. */
+  int branches_num;
+} BVHSAHBuildData;
+
+typedef struct BVHSAHTaskData {
+  BVHNode *node;
+  int begin, end;
+  int depth;
+} BVHSAHTaskData;
+
+static float bvh_sah_area(const float bb_min[3], const float bb_max[3])
+{
+  float d[3];
+  sub_v3_v3v3(d, bb_max, bb_min);
+  /* Half the surface area, only used for comparisons. */
+  return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+static void bvh_sah_centroid(const BVHNode *node, float r_co[3])
+{
+  r_co[0] = (node->bv[0] + node->bv[1]) * 0.5f;
+  r_co[1] = (node->bv[2] + node->bv[3]) * 0.5f;
+  r_co[2] = (node->bv[4] + node->bv[5]) * 0.5f;
+}
+
+static void bvh_sah_bounds_add(float bb_min[3], float bb_max[3], const float *bv)
+{
+  for (int axis = 0; axis < 3; axis++) {
+    bb_min[axis] = min_ff(bb_min[axis], bv[2 * axis]);
+    bb_max[axis] = max_ff(bb_max[axis], bv[2 * axis + 1]);
+  }
+}
+
+static float bvh_sah_range_area(BVHNode **leafs_array, const int begin, const int end)
+{
+  float bb_min[3], bb_max[3];
+  INIT_MINMAX(bb_min, bb_max);
+  for (int i = begin; i < end; i++) {
+    bvh_sah_bounds_add(bb_min, bb_max, leafs_array[i]->bv);
+  }
+  return bvh_sah_area(bb_min, bb_max);
+}
+
+static int bvh_sah_bin_index(const float co, const float cent_min, const float scale)
+{
+  const int bin = (int)((co - cent_min) * scale);
+  return min_ii(max_ii(bin, 0), BVH_SAH_BINS - 1);
+}
+
+/**
+ * Split the leafs in [begin, end) in two, ordered along \a r_axis.
+ * Falls back to the median along the largest axis when the heuristic can't separate the
+ * leafs, or when \a use_median is set.
+ *
+ * \return the first leaf of the second part.
+ */
+static int bvh_sah_split(BVHNode **leafs_array,
+                         const int begin,
+                         const int end,
+                         const bool use_median,
+                         float r_area[2],
+                         char *r_axis)
+{
+  float cent_min[3], cent_max[3], co[3];
+  INIT_MINMAX(cent_min, cent_max);
+  for (int i = begin; i < end; i++) {
+    bvh_sah_centroid(leafs_array[i], co);
+    minmax_v3v3_v3(cent_min, cent_max, co);
+  }
+
+  int best_axis = -1;
+  int best_bin = -1;
+  float best_scale = 0.0f;
+
+  if (!use_median) {
+    float best_cost = FLT_MAX;
+
+    for (int axis = 0; axis < 3; axis++) {
+      const float extent = cent_max[axis] - cent_min[axis];
+      if (!(extent > 0.0f)) {
+        continue;
+      }
+      const float scale = (float)BVH_SAH_BINS / extent;
+
+      BVHSAHBin bins[BVH_SAH_BINS];
+      for (int b = 0; b < BVH_SAH_BINS; b++) {
+        INIT_MINMAX(bins[b].bb_min, bins[b].bb_max);
+        bins[b].count = 0;
+      }
+      for (int i = begin; i < end; i++) {
+        bvh_sah_centroid(leafs_array[i], co);
+        BVHSAHBin *bin = &bins[bvh_sah_bin_index(co[axis], cent_min[axis], scale)];
+        bvh_sah_bounds_add(bin->bb_min, bin->bb_max, leafs_array[i]->bv);
+        bin->count++;
+      }
+
+      /* Sweep from the right to store the cost of the right side of each split,
+       * then from the left to evaluate the splits. */
+      float right_area[BVH_SAH_BINS];
+      int right_count[BVH_SAH_BINS];
+      float bb_min[3], bb_max[3];
+      int count = 0;
+      INIT_MINMAX(bb_min, bb_max);
+      for (int b = BVH_SAH_BINS - 1; b > 0; b--) {
+        if (bins[b].count) {
+          minmax_v3v3_v3(bb_min, bb_max, bins[b].bb_min);
+          minmax_v3v3_v3(bb_min, bb_max, bins[b].bb_max);
+          count += bins[b].count;
+        }
+        right_count[b] = count;
+        right_area[b] = count ? bvh_sah_area(bb_min, bb_max) : 0.0f;
+      }
+
+      count = 0;
+      INIT_MINMAX(bb_min, bb_max);
+      for (int b = 0; b < BVH_SAH_BINS - 1; b++) {
+        if (bins[b].count) {
+          minmax_v3v3_v3(bb_min, bb_max, bins[b].bb_min);
+          minmax_v3v3_v3(bb_min, bb_max, bins[b].bb_max);
+          count += bins[b].count;
+        }
+        if (count == 0 || right_count[b + 1] == 0) {
+          continue;
+        }
+        const float area = bvh_sah_area(bb_min, bb_max);
+        const float cost = area * (float)count + right_area[b + 1] * (float)right_count[b + 1];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = b;
+          best_scale = scale;
+          r_area[0] = area;
+          r_area[1] = right_area[b + 1];
+        }
+      }
+    }
+  }
+
+  if (best_axis != -1) {
+    int i = begin, j = end;
+    while (i < j) {
+      bvh_sah_centroid(leafs_array[i], co);
+      if (bvh_sah_bin_index(co[best_axis], cent_min[best_axis], best_scale) <= best_bin) {
+        i++;
+      }
+      else {
+        j--;
+        SWAP(BVHNode *, leafs_array[i], leafs_array[j]);
+      }
+    }
+    *r_axis = (char)best_axis;
+    return i;
+  }
+
+  /* Median split, along the largest axis of the centroids. */
+  const float extent[3] = {
+      cent_max[0] - cent_min[0], cent_max[1] - cent_min[1], cent_max[2] - cent_min[2]};
+  const int axis = (extent[0] >= extent[1]) ? ((extent[0] >= extent[2]) ? 0 : 2) :
+                                              ((extent[1] >= extent[2]) ? 1 : 2);
+  const int mid = (begin + end) / 2;
+  partition_nth_element(leafs_array, begin, end, mid, axis * 2);
+  r_area[0] = bvh_sah_range_area(leafs_array, begin, mid);
+  r_area[1] = bvh_sah_range_area(leafs_array, mid, end);
+  *r_axis = (char)axis;
+  return mid;
+}
+
+static void bvh_sah_build_branch(
+    TaskPool *pool, BVHSAHBuildData *data, BVHNode *node, int begin, int end, int depth);
+
+static void bvh_sah_build_task(TaskPool *__restrict pool, void *taskdata)
+{
+  BVHSAHBuildData *data = BLI_task_pool_user_data(pool);
+  const BVHSAHTaskData *task = taskdata;
+  bvh_sah_build_branch(pool, data, task->node, task->begin, task->end, task->depth);
+}
+
+/**
+ * Build the children of \a node from the leafs in [begin, end).
+ * \param pool: Big sub-trees are built as tasks of the pool when not null.
+ */
+static void bvh_sah_build_branch(
+    TaskPool *pool, BVHSAHBuildData *data, BVHNode *node, int begin, int end, int depth)
+{
+  BVHTree *tree = data->tree;
+  BVHNode **leafs_array = tree->nodes;
+  const bool use_median = depth >= BVH_SAH_MAX_DEPTH;
+
+  refit_kdop_hull(tree, node, begin, end);
+  node->main_axis = get_largest_axis(node->bv) / 2;
+
+  BVHSAHRange ranges[MAX_TREETYPE];
+  int ranges_num = 1;
+  ranges[0].begin = begin;
+  ranges[0].end = end;
+  ranges[0].area = FLT_MAX;
+
+  while (ranges_num < tree->tree_type) {
+    /* Split the child with the largest area, or the most leafs past the SAH depth. */
+    int split = -1;
+    float split_key = -1.0f;
+    for (int i = 0; i < ranges_num; i++) {
+      const int count = ranges[i].end - ranges[i].begin;
+      const float key = use_median ? (float)count : ranges[i].area;
+      if (count > 1 && key > split_key) {
+        split = i;
+        split_key = key;
+      }
+    }
+    if (split == -1) {
+      break;
+    }
+
+    float area[2];
+    char axis;
+    const int mid = bvh_sah_split(
+        leafs_array, ranges[split].begin, ranges[split].end, use_median, area, &axis);
+    if (ranges_num == 1) {
+      /* Children are ordered along the first split axis, used to pick the traversal order. */
+      node->main_axis = axis;
+    }
+
+    memmove(&ranges[split + 2],
+            &ranges[split + 1],
+            sizeof(*ranges) * (size_t)(ranges_num - split - 1));
+    ranges[split + 1].begin = mid;
+    ranges[split + 1].end = ranges[split].end;
+    ranges[split + 1].area = area[1];
+    ranges[split].end = mid;
+    ranges[split].area = area[0];
+    ranges_num++;
+  }
+
+  for (int i = 0; i < ranges_num; i++) {
+    BVHNode *child;
+    if (ranges[i].end - ranges[i].begin == 1) {
+      child = leafs_array[ranges[i].begin];
+    }
+    else {
+      const int branch = atomic_fetch_and_add_int32(&data->branches_num, 1);
+      child = &tree->nodearray[tree->leaf_num + branch];
+    }
+    child->parent = node;
+    node->children[i] = child;
+  }
+  node->node_num = (char)ranges_num;
+
+  for (int i = 0; i < ranges_num; i++) {
+    const int count = ranges[i].end - ranges[i].begin;
+    if (count == 1) {
+      continue;
+    }
+    if (pool && count > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+      BVHSAHTaskData *task = MEM_mallocN(sizeof(*task), __func__);
+      task->node = node->children[i];
+      task->begin = ranges[i].begin;
+      task->end = ranges[i].end;
+      task->depth = depth + 1;
+      BLI_task_pool_push(pool, bvh_sah_build_task, task, true, NULL);
+    }
+    else {
+      bvh_sah_build_branch(
+          NULL, data, node->children[i], ranges[i].begin, ranges[i].end, depth + 1);
+    }
+  }
+}
+
+/**
+ * Make room for \a nodes_num nodes (leafs and branches), only valid before balancing.
+ */
+static void bvhtree_ensure_nodes_num(BVHTree *tree, const int nodes_num)
+{
+  const int nodes_num_prev = (int)(MEM_allocN_len(tree->nodearray) / sizeof(*tree->nodearray));
+  if (nodes_num <= nodes_num_prev) {
+    return;
+  }
+
+  tree->nodes = MEM_recallocN(tree->nodes, sizeof(BVHNode *) * (size_t)nodes_num);
+  tree->nodebv = MEM_recallocN(tree->nodebv, sizeof(float) * (size_t)(tree->axis * nodes_num));
+  tree->nodechild = MEM_recallocN(tree->nodechild,
+                                  sizeof(BVHNode *) * (size_t)(tree->tree_type * nodes_num));
+  tree->nodearray = MEM_recallocN(tree->nodearray, sizeof(BVHNode) * (size_t)nodes_num);
+
+  /* Relink the dynamic bv and child links, leafs are still in insertion order. */
+  for (int i = 0; i < nodes_num; i++) {
+    tree->nodearray[i].bv = &tree->nodebv[i * tree->axis];
+    tree->nodearray[i].children = &tree->nodechild[i * tree->tree_type];
+  }
+  for (int i = 0; i < tree->leaf_num; i++) {
+    tree->nodes[i] = &tree->nodearray[i];
+  }
+}
+
+/**
+ * \return the number of branches.
+ */
+static int bvhtree_sah_build(BVHTree *tree)
+{
+  BLI_assert(tree->leaf_num > 1);
+
+  /* Every branch has at least two children. */
+  bvhtree_ensure_nodes_num(tree, tree->leaf_num * 2 - 1);
+
+  BVHSAHBuildData data = {tree, 1};
+  BVHNode *root = &tree->nodearray[tree->leaf_num];
+  root->parent = NULL;
+
+  if (tree->leaf_num > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+    TaskPool *pool = BLI_task_pool_create(&data, TASK_PRIORITY_HIGH);
+    bvh_sah_build_branch(pool, &data, root, 0, tree->leaf_num, 0);
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
+  else {
+    bvh_sah_build_branch(NULL, &data, root, 0, tree->leaf_num, 0);
+  }
+
+  return data.branches_num;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Flattened Tree
+ *
+ * Optional copy of the branches (see #BVH_BALANCE_FLAT) using #BVHNode4, traversed without
+ * recursion by ray-casts and nearest point queries which test all children of a node at once.
+ * Trees with fewer children per node are collapsed by pulling grand-children into their parent.
+ *
+ * Only the x, y & z axes are stored, so this is only built for trees starting with them.
+ * \{ */
+
+/** Traversal stack size, trees which could exceed it don't get a flattened copy. */
+#define BVH_FLAT_STACK_SIZE 256
+
+typedef struct BVHFlatStackItem {
+  /** Index in #BVHTree.flat_nodes, -1 for leafs. */
+  int flat;
+  /** Index in #BVHTree.nodearray. */
+  int node;
+  float dist;
+} BVHFlatStackItem;
+
+static void bvhnode4_slot_set(BVHNode4 *flat, const int slot, const float *bv)
+{
+  for (int axis = 0; axis < 3; axis++) {
+    flat->bb_min[axis][slot] = bv[2 * axis];
+    flat->bb_max[axis][slot] = bv[2 * axis + 1];
+  }
+}
+
+static int bvhtree_flat_build_recursive(BVHTree *tree,
+                                        const BVHNode *node,
+                                        const int depth,
+                                        int *r_height)
+{
+  const BVHNode *slots[BVH_FLAT_WIDTH];
+  int slots_num = node->node_num;
+  for (int i = 0; i < slots_num; i++) {
+    slots[i] = node->children[i];
+  }
+
+  /* Pull up the children of the largest branches while they fit. */
+  while (true) {
+    int open = -1;
+    float open_area = -1.0f;
+    for (int i = 0; i < slots_num; i++) {
+      const BVHNode *child = slots[i];
+      if (child->node_num == 0 || slots_num - 1 + child->node_num > BVH_FLAT_WIDTH) {
+        continue;
+      }
+      const float *bv = child->bv;
+      const float bb_min[3] = {bv[0], bv[2], bv[4]};
+      const float bb_max[3] = {bv[1], bv[3], bv[5]};
+      const float area = bvh_sah_area(bb_min, bb_max);
+      if (area > open_area) {
+        open = i;
+        open_area = area;
+      }
+    }
+    if (open == -1) {
+      break;
+    }
+
+    const BVHNode *child = slots[open];
+    memmove(&slots[open + child->node_num],
+            &slots[open + 1],
+            sizeof(*slots) * (size_t)(slots_num - open - 1));
+    for (int i = 0; i < child->node_num; i++) {
+      slots[open + i] = child->children[i];
+    }
+    slots_num += child->node_num - 1;
+  }
+
+  const int index = tree->flat_num++;
+  BVHNode4 *flat = &tree->flat_nodes[index];
+  for (int i = 0; i < BVH_FLAT_WIDTH; i++) {
+    flat->child[i] = -1;
+    if (i < slots_num) {
+      bvhnode4_slot_set(flat, i, slots[i]->bv);
+      flat->node[i] = (int)(slots[i] - tree->nodearray);
+    }
+    else {
+      /* Never hit, see #bvhnode4_ray_dist & #bvhnode4_nearest_dist_sq. */
+      const float empty_bv[6] = {FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX};
+      bvhnode4_slot_set(flat, i, empty_bv);
+      flat->node[i] = -1;
+    }
+  }
+
+  *r_height = max_ii(*r_height, depth + 1);
+  for (int i = 0; i < slots_num; i++) {
+    if (slots[i]->node_num) {
+      flat->child[i] = bvhtree_flat_build_recursive(tree, slots[i], depth + 1, r_height);
+    }
+  }
+  return index;
+}
+
+static void bvhtree_flat_build(BVHTree *tree)
+{
+  if (tree->tree_type > BVH_FLAT_WIDTH || tree->start_axis != 0 || tree->leaf_num == 0) {
+    return;
+  }
+
+  /* Every flat node uses at least one branch. */
+  tree->flat_nodes = MEM_mallocN_aligned(
+      sizeof(BVHNode4) * (size_t)tree->branch_num, 64, "BVHNode4");
+  tree->flat_num = 0;
+
+  int height = 0;
+  bvhtree_flat_build_recursive(tree, tree->nodes[tree->leaf_num], 0, &height);
+
+  /* Each level leaves at most all but one of the children on the stack. */
+  if (height * (BVH_FLAT_WIDTH - 1) + 1 > BVH_FLAT_STACK_SIZE) {
+    MEM_SAFE_FREE(tree->flat_nodes);
+    tree->flat_num = 0;
+  }
+}
+
+static void bvhtree_flat_refit(BVHTree *tree)
+{
+  for (int i = 0; i < tree->flat_num; i++) {
+    BVHNode4 *flat = &tree->flat_nodes[i];
+    for (int slot = 0; slot < BVH_FLAT_WIDTH && flat->node[slot] != -1; slot++) {
+      bvhnode4_slot_set(flat, slot, tree->nodearray[flat->node[slot]].bv);
+    }
+  }
+}
+
+/**
+ * Push the children with a distance below \a dist_max, the nearest last so it's popped first.
+ */
+static void bvhtree_flat_stack_push(const BVHNode4 *flat,
+                                    const float dist[BVH_FLAT_WIDTH],
+                                    const float dist_max,
+                                    BVHFlatStackItem *stack,
+                                    int *stack_len)
+{
+  int order[BVH_FLAT_WIDTH];
+  int order_num = 0;
+  for (int i = 0; i < BVH_FLAT_WIDTH; i++) {
+    if (flat->node[i] == -1 || !(dist[i] < dist_max)) {
+      continue;
+    }
+    /* Insertion sort, farthest first. */
+    int j = order_num++;
+    for (; j > 0 && dist[order[j - 1]] < dist[i]; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  for (int j = 0; j < order_num; j++) {
+    const int i = order[j];
+    BVHFlatStackItem *item = &stack[(*stack_len)++];
+    item->flat = flat->child[i];
+    item->node = flat->node[i];
+    item->dist = dist[i];
+  }
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree API
  * \{ */
@@ -939,29 +1482,40 @@ void BLI_bvhtree_free(BVHTree *tree)
     MEM_SAFE_FREE(tree->nodearray);
     MEM_SAFE_FREE(tree->nodebv);
     MEM_SAFE_FREE(tree->nodechild);
+    MEM_SAFE_FREE(tree->flat_nodes);
     MEM_freeN(tree);
   }
 }
 
-void BLI_bvhtree_balance(BVHTree *tree)
+void BLI_bvhtree_balance_ex(BVHTree *tree, const int flag)
 {
-  BVHNode **leafs_array = tree->nodes;
-
   /* This function should only be called once
    * (some big bug goes here if its being called more than once per tree) */
   BLI_assert(tree->branch_num == 0);
 
-  /* Build the implicit tree */
-  non_recursive_bvh_div_nodes(
-      tree, tree->nodearray + (tree->leaf_num - 1), leafs_array, tree->leaf_num);
+  /* The SAH build splits on the bounding box (the first 3 axes). */
+  if ((flag & BVH_BALANCE_SAH) && tree->leaf_num > 1 && tree->start_axis == 0) {
+    tree->branch_num = bvhtree_sah_build(tree);
+  }
+  else {
+    BVHNode **leafs_array = tree->nodes;
+
+    /* Build the implicit tree */
+    non_recursive_bvh_div_nodes(
+        tree, tree->nodearray + (tree->leaf_num - 1), leafs_array, tree->leaf_num);
+    tree->branch_num = implicit_needed_branches(tree->tree_type, tree->leaf_num);
+  }
 
   /* current code expects the branches to be linked to the nodes array
    * we perform that linkage here */
-  tree->branch_num = implicit_needed_branches(tree->tree_type, tree->leaf_num);
   for (int i = 0; i < tree->branch_num; i++) {
     tree->nodes[tree->leaf_num + i] = &tree->nodearray[tree->leaf_num + i];
   }
 
+  if (flag & BVH_BALANCE_FLAT) {
+    bvhtree_flat_build(tree);
+  }
+
 #ifdef USE_SKIP_LINKS
   build_skip_links(tree, tree->nodes[tree->leaf_num], NULL, NULL);
 #endif
@@ -975,6 +1529,11 @@ void BLI_bvhtree_balance(BVHTree *tree)
 #endif
 }
 
+void BLI_bvhtree_balance(BVHTree *tree)
+{
+  BLI_bvhtree_balance_ex(tree, 0);
+}
+
 static void bvhtree_node_inflate(const BVHTree *tree, BVHNode *node, const float dist)
 {
   axis_t axis_iter;
@@ -1039,6 +1598,10 @@ void BLI_bvhtree_update_tree(BVHTree *tree)
   for (; index >= root; index--) {
     node_join(tree, *index);
   }
+
+  if (tree->flat_nodes) {
+    bvhtree_flat_refit(tree);
+  }
 }
 int BLI_bvhtree_get_len(const BVHTree *tree)
 {
@@ -1654,6 +2217,76 @@ static void heap_find_nearest_begin(BVHNearestData *data, BVHNode *root)
   }
 }
 
+/* Flattened tree method, see #bvhtree_flat_build. */
+static void bvhnode4_nearest_dist_sq(const float proj[3],
+                                     const BVHNode4 *flat,
+                                     float r_dist_sq[BVH_FLAT_WIDTH])
+{
+  /* Same as #calc_nearest_point_squared for all children. */
+#ifdef __SSE2__
+  __m128 dist_sq = _mm_setzero_ps();
+  for (int axis = 0; axis < 3; axis++) {
+    const __m128 co = _mm_set1_ps(proj[axis]);
+    const __m128 nearest = _mm_min_ps(_mm_max_ps(co, _mm_load_ps(flat->bb_min[axis])),
+                                      _mm_load_ps(flat->bb_max[axis]));
+    const __m128 d = _mm_sub_ps(co, nearest);
+    dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(d, d));
+  }
+  _mm_storeu_ps(r_dist_sq, dist_sq);
+#else
+  for (int i = 0; i < BVH_FLAT_WIDTH; i++) {
+    r_dist_sq[i] = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+      const float nearest = min_ff(max_ff(proj[axis], flat->bb_min[axis][i]),
+                                   flat->bb_max[axis][i]);
+      const float d = proj[axis] - nearest;
+      r_dist_sq[i] += d * d;
+    }
+  }
+#endif
+}
+
+static void bvhtree_flat_find_nearest(BVHNearestData *data)
+{
+  const BVHTree *tree = data->tree;
+  BVHNode *root = tree->nodes[tree->leaf_num];
+  float nearest[3];
+  const float dist_sq = calc_nearest_point_squared(data->proj, root, nearest);
+  if (dist_sq >= data->nearest.dist_sq) {
+    return;
+  }
+
+  BVHFlatStackItem stack[BVH_FLAT_STACK_SIZE];
+  int stack_len = 1;
+  stack[0].flat = 0;
+  stack[0].node = (int)(root - tree->nodearray);
+  stack[0].dist = dist_sq;
+
+  while (stack_len) {
+    const BVHFlatStackItem item = stack[--stack_len];
+    if (item.dist >= data->nearest.dist_sq) {
+      continue;
+    }
+
+    if (item.flat == -1) {
+      BVHNode *node = &tree->nodearray[item.node];
+      if (data->callback) {
+        data->callback(data->userdata, node->index, data->co, &data->nearest);
+      }
+      else {
+        data->nearest.index = node->index;
+        data->nearest.dist_sq = calc_nearest_point_squared(data->proj, node, data->nearest.co);
+      }
+      continue;
+    }
+
+    const BVHNode4 *flat = &tree->flat_nodes[item.flat];
+    float dist[BVH_FLAT_WIDTH];
+    bvhnode4_nearest_dist_sq(data->proj, flat, dist);
+    bvhtree_flat_stack_push(flat, dist, data->nearest.dist_sq, stack, &stack_len);
+  }
+}
+
 int BLI_bvhtree_find_nearest_ex(const BVHTree *tree,
                                 const float co[3],
                                 BVHTreeNearest *nearest,
@@ -1690,6 +2323,9 @@ int BLI_bvhtree_find_nearest_ex(const BVHTree *tree,
     if (flag & BVH_NEAREST_OPTIMAL_ORDER) {
       heap_find_nearest_begin(&data, root);
     }
+    else if (tree->flat_nodes) {
+      bvhtree_flat_find_nearest(&data);
+    }
     else {
       dfs_find_nearest_begin(&data, root);
     }
@@ -1914,6 +2550,118 @@ static void dfs_raycast(BVHRayCastData *data, BVHNode *node)
   }
 }
 
+/* Flattened tree method, see #bvhtree_flat_build. */
+static void bvhnode4_ray_dist(const BVHRayCastData *data,
+                              const BVHNode4 *flat,
+                              float r_dist[BVH_FLAT_WIDTH])
+{
+  if (data->ray.radius != 0.0f) {
+    for (int i = 0; i < BVH_FLAT_WIDTH; i++) {
+      const float bv[6] = {flat->bb_min[0][i],
+                           flat->bb_max[0][i],
+                           flat->bb_min[1][i],
+                           flat->bb_max[1][i],
+                           flat->bb_min[2][i],
+                           flat->bb_max[2][i]};
+      r_dist[i] = ray_nearest_hit(data, bv);
+    }
+    return;
+  }
+
+  /* Same tests as #fast_ray_nearest_hit for all children,
+   * #BVHRayCastData.index tells which bound of each axis is hit first. */
+  const float *bb_near[3], *bb_far[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const bool use_max = data->index[2 * axis] & 1;
+    bb_near[axis] = use_max ? flat->bb_max[axis] : flat->bb_min[axis];
+    bb_far[axis] = use_max ? flat->bb_min[axis] : flat->bb_max[axis];
+  }
+
+#ifdef __SSE2__
+  __m128 t1[3], t2[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const __m128 origin = _mm_set1_ps(data->ray.origin[axis]);
+    const __m128 idot = _mm_set1_ps(data->idot_axis[axis]);
+    t1[axis] = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bb_near[axis]), origin), idot);
+    t2[axis] = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bb_far[axis]), origin), idot);
+  }
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 hit_dist = _mm_set1_ps(data->hit.dist);
+  __m128 miss = _mm_or_ps(_mm_cmpgt_ps(t1[0], t2[1]), _mm_cmplt_ps(t2[0], t1[1]));
+  miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmpgt_ps(t1[0], t2[2]), _mm_cmplt_ps(t2[0], t1[2])));
+  miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmpgt_ps(t1[1], t2[2]), _mm_cmplt_ps(t2[1], t1[2])));
+  for (int axis = 0; axis < 3; axis++) {
+    miss = _mm_or_ps(miss, _mm_cmplt_ps(t2[axis], zero));
+    miss = _mm_or_ps(miss, _mm_cmpgt_ps(t1[axis], hit_dist));
+  }
+
+  const __m128 dist = _mm_max_ps(t1[0], _mm_max_ps(t1[1], t1[2]));
+  _mm_storeu_ps(r_dist,
+                _mm_or_ps(_mm_and_ps(miss, _mm_set1_ps(FLT_MAX)), _mm_andnot_ps(miss, dist)));
+#else
+  for (int i = 0; i < BVH_FLAT_WIDTH; i++) {
+    float t1[3], t2[3];
+    for (int axis = 0; axis < 3; axis++) {
+      t1[axis] = (bb_near[axis][i] - data->ray.origin[axis]) * data->idot_axis[axis];
+      t2[axis] = (bb_far[axis][i] - data->ray.origin[axis]) * data->idot_axis[axis];
+    }
+    if ((t1[0] > t2[1] || t2[0] < t1[1] || t1[0] > t2[2] || t2[0] < t1[2] || t1[1] > t2[2] ||
+         t2[1] < t1[2]) ||
+        (t2[0] < 0.0f || t2[1] < 0.0f || t2[2] < 0.0f) ||
+        (t1[0] > data->hit.dist || t1[1] > data->hit.dist || t1[2] > data->hit.dist))
+    {
+      r_dist[i] = FLT_MAX;
+    }
+    else {
+      r_dist[i] = max_fff(t1[0], t1[1], t1[2]);
+    }
+  }
+#endif
+}
+
+static void bvhtree_flat_raycast(BVHRayCastData *data)
+{
+  const BVHTree *tree = data->tree;
+  BVHNode *root = tree->nodes[tree->leaf_num];
+  const float dist = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, root) :
+                                                  ray_nearest_hit(data, root->bv);
+  if (dist >= data->hit.dist) {
+    return;
+  }
+
+  BVHFlatStackItem stack[BVH_FLAT_STACK_SIZE];
+  int stack_len = 1;
+  stack[0].flat = 0;
+  stack[0].node = (int)(root - tree->nodearray);
+  stack[0].dist = dist;
+
+  while (stack_len) {
+    const BVHFlatStackItem item = stack[--stack_len];
+    if (item.dist >= data->hit.dist) {
+      continue;
+    }
+
+    if (item.flat == -1) {
+      const BVHNode *node = &tree->nodearray[item.node];
+      if (data->callback) {
+        data->callback(data->userdata, node->index, &data->ray, &data->hit);
+      }
+      else {
+        data->hit.index = node->index;
+        data->hit.dist = item.dist;
+        madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, item.dist);
+      }
+      continue;
+    }
+
+    const BVHNode4 *flat = &tree->flat_nodes[item.flat];
+    float child_dist[BVH_FLAT_WIDTH];
+    bvhnode4_ray_dist(data, flat, child_dist);
+    bvhtree_flat_stack_push(flat, child_dist, data->hit.dist, stack, &stack_len);
+  }
+}
+
 /**
  * A version of #dfs_raycast with minor changes to reset the index & dist each ray cast.
  */
@@ -2021,8 +2769,13 @@ int BLI_bvhtree_ray_cast_ex(const BVHTree *tree,
   }
 
   if (root) {
-    dfs_raycast(&data, root);
-    //      iterative_raycast(&data, root);
+    if (tree->flat_nodes) {
+      bvhtree_flat_raycast(&data);
+    }
+    else {
+      dfs_raycast(&data, root);
+      //      iterative_raycast(&data, root);
+    }
   }
 
   if (hit) {
@@ -2119,6 +2872,201 @@ void BLI_bvhtree_ray_cast_all(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_packet
+ *
+ * Rays of a packet are traced together with a single DFS: each node is only visited once,
+ * testing the bounds against all rays of the packet still hitting the parent (4 at a time).
+ * This pays off for coherent rays, which mostly visit the same nodes.
+ *
+ * \{ */
+
+typedef struct BVHRayPacketData {
+  BVHRayCastData rays[BVH_RAYCAST_PACKET_SIZE];
+
+  /** Copy of the rays as a structure of arrays, for the SIMD bounds tests. */
+  float origin[3][BVH_RAYCAST_PACKET_SIZE];
+  float idot_axis[3][BVH_RAYCAST_PACKET_SIZE];
+  /** All bits set when the ray enters the slab of the axis on its maximum, see #index. */
+  int use_max[3][BVH_RAYCAST_PACKET_SIZE];
+} BVHRayPacketData;
+
+/**
+ * Test the rays in \a mask against the bounds of \a node, like #dfs_raycast does for single rays.
+ * \return the rays hitting the bounds before their current hit, with the distances in \a r_dist.
+ */
+static uint ray_packet_nearest_hit(const BVHRayPacketData *data,
+                                   const BVHNode *node,
+                                   const uint mask,
+                                   float r_dist[BVH_RAYCAST_PACKET_SIZE])
+{
+  uint hit_mask = 0;
+
+  if (data->rays[0].ray.radius != 0.0f) {
+    for (uint bits = mask; bits; bits &= bits - 1) {
+      const uint i = bitscan_forward_uint(bits);
+      r_dist[i] = ray_nearest_hit(&data->rays[i], node->bv);
+      if (!(r_dist[i] >= data->rays[i].hit.dist)) {
+        hit_mask |= 1u << i;
+      }
+    }
+    return hit_mask;
+  }
+
+#ifdef __SSE2__
+  /* Same tests as #fast_ray_nearest_hit. */
+  const float *bv = node->bv;
+  for (int group = 0; group < BVH_RAYCAST_PACKET_SIZE; group += 4) {
+    if (((mask >> group) & 0xf) == 0) {
+      continue;
+    }
+
+    __m128 t1[3], t2[3];
+    for (int axis = 0; axis < 3; axis++) {
+      const __m128 use_max = _mm_castsi128_ps(
+          _mm_loadu_si128((const __m128i *)&data->use_max[axis][group]));
+      const __m128 bb_min = _mm_set1_ps(bv[2 * axis]);
+      const __m128 bb_max = _mm_set1_ps(bv[2 * axis + 1]);
+      const __m128 bb_near = _mm_or_ps(_mm_and_ps(use_max, bb_max),
+                                       _mm_andnot_ps(use_max, bb_min));
+      const __m128 bb_far = _mm_or_ps(_mm_and_ps(use_max, bb_min),
+                                      _mm_andnot_ps(use_max, bb_max));
+      const __m128 origin = _mm_loadu_ps(&data->origin[axis][group]);
+      const __m128 idot = _mm_loadu_ps(&data->idot_axis[axis][group]);
+      t1[axis] = _mm_mul_ps(_mm_sub_ps(bb_near, origin), idot);
+      t2[axis] = _mm_mul_ps(_mm_sub_ps(bb_far, origin), idot);
+    }
+
+    const BVHRayCastData *rays = &data->rays[group];
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 hit_dist = _mm_setr_ps(
+        rays[0].hit.dist, rays[1].hit.dist, rays[2].hit.dist, rays[3].hit.dist);
+    __m128 miss = _mm_or_ps(_mm_cmpgt_ps(t1[0], t2[1]), _mm_cmplt_ps(t2[0], t1[1]));
+    miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmpgt_ps(t1[0], t2[2]), _mm_cmplt_ps(t2[0], t1[2])));
+    miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmpgt_ps(t1[1], t2[2]), _mm_cmplt_ps(t2[1], t1[2])));
+    for (int axis = 0; axis < 3; axis++) {
+      miss = _mm_or_ps(miss, _mm_cmplt_ps(t2[axis], zero));
+      miss = _mm_or_ps(miss, _mm_cmpgt_ps(t1[axis], hit_dist));
+    }
+
+    const __m128 dist = _mm_max_ps(t1[0], _mm_max_ps(t1[1], t1[2]));
+    _mm_storeu_ps(&r_dist[group], dist);
+
+    const int lanes = _mm_movemask_ps(_mm_andnot_ps(miss, _mm_cmplt_ps(dist, hit_dist)));
+    hit_mask |= (uint)lanes << group;
+  }
+  return hit_mask & mask;
+#else
+  for (uint bits = mask; bits; bits &= bits - 1) {
+    const uint i = bitscan_forward_uint(bits);
+    r_dist[i] = fast_ray_nearest_hit(&data->rays[i], node);
+    if (!(r_dist[i] >= data->rays[i].hit.dist)) {
+      hit_mask |= 1u << i;
+    }
+  }
+  return hit_mask;
+#endif
+}
+
+static void dfs_raycast_packet(BVHRayPacketData *data, BVHNode *node, uint mask)
+{
+  float dist[BVH_RAYCAST_PACKET_SIZE];
+  mask = ray_packet_nearest_hit(data, node, mask, dist);
+  if (mask == 0) {
+    return;
+  }
+
+  if (node->node_num == 0) {
+    for (uint bits = mask; bits; bits &= bits - 1) {
+      const uint i = bitscan_forward_uint(bits);
+      BVHRayCastData *ray = &data->rays[i];
+      if (ray->callback) {
+        ray->callback(ray->userdata, node->index, &ray->ray, &ray->hit);
+      }
+      else {
+        ray->hit.index = node->index;
+        ray->hit.dist = dist[i];
+        madd_v3_v3v3fl(ray->hit.co, ray->ray.origin, ray->ray.direction, dist[i]);
+      }
+    }
+  }
+  else {
+    /* Pick loop direction from the first ray, others of the packet should go the same way. */
+    const BVHRayCastData *ray = &data->rays[bitscan_forward_uint(mask)];
+    if (ray->ray_dot_axis[node->main_axis] > 0.0f) {
+      for (int i = 0; i != node->node_num; i++) {
+        dfs_raycast_packet(data, node->children[i], mask);
+      }
+    }
+    else {
+      for (int i = node->node_num - 1; i >= 0; i--) {
+        dfs_raycast_packet(data, node->children[i], mask);
+      }
+    }
+  }
+}
+
+void BLI_bvhtree_ray_cast_packet(const BVHTree *tree,
+                                 const float (*co)[3],
+                                 const float (*dir)[3],
+                                 const int rays_num,
+                                 const float radius,
+                                 BVHTreeRayHit *hits,
+                                 BVHTree_RayCastCallback callback,
+                                 void *userdata,
+                                 const int flag)
+{
+  BVHNode *root = tree->nodes[tree->leaf_num];
+  if (root == NULL) {
+    return;
+  }
+
+  BVHRayPacketData data;
+
+  for (int start = 0; start < rays_num; start += BVH_RAYCAST_PACKET_SIZE) {
+    const int packet_len = min_ii(rays_num - start, BVH_RAYCAST_PACKET_SIZE);
+
+    for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+      BVHRayCastData *ray = &data.rays[i];
+      if (i >= packet_len) {
+        /* Never tested, only keep the SIMD loads defined. */
+        ray->hit.dist = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+          data.origin[axis][i] = 0.0f;
+          data.idot_axis[axis][i] = 0.0f;
+          data.use_max[axis][i] = 0;
+        }
+        continue;
+      }
+
+      BLI_ASSERT_UNIT_V3(dir[start + i]);
+
+      ray->tree = tree;
+      ray->callback = callback;
+      ray->userdata = userdata;
+      copy_v3_v3(ray->ray.origin, co[start + i]);
+      copy_v3_v3(ray->ray.direction, dir[start + i]);
+      ray->ray.radius = radius;
+      bvhtree_ray_cast_data_precalc(ray, flag);
+      ray->hit = hits[start + i];
+
+      for (int axis = 0; axis < 3; axis++) {
+        data.origin[axis][i] = ray->ray.origin[axis];
+        data.idot_axis[axis][i] = ray->idot_axis[axis];
+        data.use_max[axis][i] = (ray->index[2 * axis] & 1) ? -1 : 0;
+      }
+    }
+
+    dfs_raycast_packet(&data, root, (1u << packet_len) - 1);
+
+    for (int i = 0; i < packet_len; i++) {
+      hits[start + i] = data.rays[i].hit;
+    }
+  }
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
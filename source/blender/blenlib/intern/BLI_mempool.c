@@ -12,6 +12,8 @@
  * - Freeing chunks.
  * - Iterating over allocated chunks
  *   (optionally when using the #BLI_MEMPOOL_ALLOW_ITER flag).
+ * - Allocating from multiple threads with per-thread caches
+ *   (optionally when using the #BLI_MEMPOOL_THREAD_CACHE flag).
  */
 
 #include <stdlib.h>
@@ -24,10 +26,7 @@
 #include "BLI_asan.h"
 #include "BLI_mempool.h"         /* own include */
 #include "BLI_mempool_private.h" /* own include */
-
-#ifdef WITH_ASAN
-#  include "BLI_threads.h"
-#endif
+#include "BLI_threads.h"
 
 #include "MEM_guardedalloc.h"
 
@@ -79,6 +78,12 @@
 /* optimize pool size */
 #define USE_CHUNK_POW2
 
+/**
+ * Number of elements a #BLI_mempool_thread_cache takes from the pool at once.
+ * A cache returns the same number of elements when it holds twice as many free elements.
+ */
+#define THREAD_CACHE_BATCH 64
+
 #ifndef NDEBUG
 static bool mempool_debug_memset = false;
 #endif
@@ -129,8 +134,10 @@ struct BLI_mempool {
   BLI_freenode *free;
   /** Use to know how many chunks to keep for #BLI_mempool_clear. */
   uint maxchunks;
-  /** Number of elements currently in use. */
+  /** Number of elements currently in use (including elements held by thread caches). */
   uint totused;
+  /** Protects the shared state when using #BLI_MEMPOOL_THREAD_CACHE. */
+  SpinLock thread_cache_lock;
 #ifdef USE_TOTALLOC
   /** Number of elements allocated in total. */
   uint totalloc;
@@ -398,6 +405,10 @@ BLI_mempool *BLI_mempool_create(uint esize, uint elem_num, uint pchunk, uint fla
 #endif
   pool->totused = 0;
 
+  if (flag & BLI_MEMPOOL_THREAD_CACHE) {
+    BLI_spin_init(&pool->thread_cache_lock);
+  }
+
   if (elem_num) {
     /* Allocate the actual chunks. */
     for (i = 0; i < maxchunks; i++) {
@@ -413,7 +424,7 @@ BLI_mempool *BLI_mempool_create(uint esize, uint elem_num, uint pchunk, uint fla
   return pool;
 }
 
-void *BLI_mempool_alloc(BLI_mempool *pool)
+static void *mempool_alloc(BLI_mempool *pool)
 {
   BLI_freenode *free_pop;
 
@@ -454,6 +465,17 @@ void *BLI_mempool_alloc(BLI_mempool *pool)
   return (void *)free_pop;
 }
 
+void *BLI_mempool_alloc(BLI_mempool *pool)
+{
+  if (pool->flag & BLI_MEMPOOL_THREAD_CACHE) {
+    BLI_spin_lock(&pool->thread_cache_lock);
+    void *retval = mempool_alloc(pool);
+    BLI_spin_unlock(&pool->thread_cache_lock);
+    return retval;
+  }
+  return mempool_alloc(pool);
+}
+
 void *BLI_mempool_calloc(BLI_mempool *pool)
 {
   void *retval = BLI_mempool_alloc(pool);
@@ -463,12 +485,7 @@ void *BLI_mempool_calloc(BLI_mempool *pool)
   return retval;
 }
 
-/**
- * Free an element from the mempool.
- *
- * \note doesn't protect against double frees, take care!
- */
-void BLI_mempool_free(BLI_mempool *pool, void *addr)
+static void mempool_free(BLI_mempool *pool, void *addr)
 {
   BLI_freenode *newhead = addr;
 
@@ -560,6 +577,22 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
   }
 }
 
+/**
+ * Free an element from the mempool.
+ *
+ * \note doesn't protect against double frees, take care!
+ */
+void BLI_mempool_free(BLI_mempool *pool, void *addr)
+{
+  if (pool->flag & BLI_MEMPOOL_THREAD_CACHE) {
+    BLI_spin_lock(&pool->thread_cache_lock);
+    mempool_free(pool, addr);
+    BLI_spin_unlock(&pool->thread_cache_lock);
+    return;
+  }
+  mempool_free(pool, addr);
+}
+
 int BLI_mempool_len(const BLI_mempool *pool)
 {
   int ret = (int)pool->totused;
@@ -908,6 +941,10 @@ void BLI_mempool_destroy(BLI_mempool *pool)
 {
   mempool_chunk_free_all(pool->chunks, pool);
 
+  if (pool->flag & BLI_MEMPOOL_THREAD_CACHE) {
+    BLI_spin_end(&pool->thread_cache_lock);
+  }
+
 #ifdef WITH_MEM_VALGRIND
   VALGRIND_DESTROY_MEMPOOL(pool);
 #endif
@@ -915,6 +952,214 @@ void BLI_mempool_destroy(BLI_mempool *pool)
   MEM_freeN(pool);
 }
 
+/* -------------------------------------------------------------------- */
+/* Thread caches. */
+
+struct BLI_mempool_thread_cache {
+  BLI_mempool *pool;
+  /** Local free list, elements are moved between this and #BLI_mempool.free in batches. */
+  BLI_freenode *free;
+  /** Number of elements in #free. */
+  uint free_len;
+};
+
+BLI_mempool_thread_cache *BLI_mempool_thread_cache_create(BLI_mempool *pool)
+{
+  BLI_assert(pool->flag & BLI_MEMPOOL_THREAD_CACHE);
+
+  BLI_mempool_thread_cache *cache = MEM_mallocN(sizeof(*cache), "mempool thread cache");
+  cache->pool = pool;
+  cache->free = NULL;
+  cache->free_len = 0;
+  return cache;
+}
+
+/**
+ * Move up to #THREAD_CACHE_BATCH free elements from the pool into the empty cache,
+ * allocating a new chunk if necessary.
+ */
+static void mempool_thread_cache_refill(BLI_mempool_thread_cache *cache)
+{
+  BLI_mempool *pool = cache->pool;
+  BLI_assert(cache->free == NULL);
+
+  BLI_spin_lock(&pool->thread_cache_lock);
+
+  if (UNLIKELY(pool->free == NULL)) {
+    BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
+    mempool_chunk_add(pool, mpchunk, NULL);
+  }
+
+  BLI_freenode *head = pool->free;
+  BLI_freenode *tail = head;
+  uint len = 1;
+
+  BLI_asan_unpoison(tail, pool->esize - POISON_REDZONE_SIZE);
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MAKE_MEM_DEFINED(tail, pool->esize - POISON_REDZONE_SIZE);
+#endif
+  while (len < THREAD_CACHE_BATCH && tail->next) {
+    BLI_freenode *next = tail->next;
+    BLI_asan_poison(tail, pool->esize);
+#ifdef WITH_MEM_VALGRIND
+    VALGRIND_MAKE_MEM_UNDEFINED(tail, pool->esize);
+#endif
+    tail = next;
+    BLI_asan_unpoison(tail, pool->esize - POISON_REDZONE_SIZE);
+#ifdef WITH_MEM_VALGRIND
+    VALGRIND_MAKE_MEM_DEFINED(tail, pool->esize - POISON_REDZONE_SIZE);
+#endif
+    len++;
+  }
+
+  pool->free = tail->next;
+  pool->totused += len;
+
+  BLI_spin_unlock(&pool->thread_cache_lock);
+
+  tail->next = NULL;
+  BLI_asan_poison(tail, pool->esize);
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MAKE_MEM_UNDEFINED(tail, pool->esize);
+#endif
+
+  cache->free = head;
+  cache->free_len = len;
+}
+
+/**
+ * Move the first \a len free elements of the cache back into the pool.
+ */
+static void mempool_thread_cache_return(BLI_mempool_thread_cache *cache, const uint len)
+{
+  BLI_mempool *pool = cache->pool;
+  BLI_assert(len > 0 && len <= cache->free_len);
+
+  BLI_freenode *head = cache->free;
+  BLI_freenode *tail = head;
+
+  BLI_asan_unpoison(tail, pool->esize - POISON_REDZONE_SIZE);
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MAKE_MEM_DEFINED(tail, pool->esize - POISON_REDZONE_SIZE);
+#endif
+  for (uint i = 1; i < len; i++) {
+    BLI_freenode *next = tail->next;
+    BLI_asan_poison(tail, pool->esize);
+#ifdef WITH_MEM_VALGRIND
+    VALGRIND_MAKE_MEM_UNDEFINED(tail, pool->esize);
+#endif
+    tail = next;
+    BLI_asan_unpoison(tail, pool->esize - POISON_REDZONE_SIZE);
+#ifdef WITH_MEM_VALGRIND
+    VALGRIND_MAKE_MEM_DEFINED(tail, pool->esize - POISON_REDZONE_SIZE);
+#endif
+  }
+
+  cache->free = tail->next;
+  cache->free_len -= len;
+
+  BLI_spin_lock(&pool->thread_cache_lock);
+  tail->next = pool->free;
+  pool->free = head;
+  pool->totused -= len;
+  BLI_spin_unlock(&pool->thread_cache_lock);
+
+  BLI_asan_poison(tail, pool->esize);
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MAKE_MEM_UNDEFINED(tail, pool->esize);
+#endif
+}
+
+void *BLI_mempool_thread_cache_alloc(BLI_mempool_thread_cache *cache)
+{
+  BLI_mempool *pool = cache->pool;
+
+  if (UNLIKELY(cache->free == NULL)) {
+    mempool_thread_cache_refill(cache);
+  }
+
+  BLI_freenode *free_pop = cache->free;
+
+  BLI_asan_unpoison(free_pop, pool->esize - POISON_REDZONE_SIZE);
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize - POISON_REDZONE_SIZE);
+  VALGRIND_MAKE_MEM_DEFINED(free_pop, pool->esize - POISON_REDZONE_SIZE);
+#endif
+
+  if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+    free_pop->freeword = USEDWORD;
+  }
+
+  cache->free = free_pop->next;
+  cache->free_len--;
+
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MAKE_MEM_UNDEFINED(free_pop, pool->esize - POISON_REDZONE_SIZE);
+#endif
+
+  return (void *)free_pop;
+}
+
+void *BLI_mempool_thread_cache_calloc(BLI_mempool_thread_cache *cache)
+{
+  void *retval = BLI_mempool_thread_cache_alloc(cache);
+
+  memset(retval, 0, (size_t)cache->pool->esize - POISON_REDZONE_SIZE);
+
+  return retval;
+}
+
+void BLI_mempool_thread_cache_free(BLI_mempool_thread_cache *cache, void *addr)
+{
+  BLI_mempool *pool = cache->pool;
+  BLI_freenode *newhead = addr;
+
+  /* Unlike #BLI_mempool_free, don't check that the element is in the pool here,
+   * because other threads may add chunks at the same time. */
+#ifndef NDEBUG
+  if (UNLIKELY(mempool_debug_memset)) {
+    memset(addr, 255, pool->esize - POISON_REDZONE_SIZE);
+  }
+#endif
+
+  if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+#ifndef NDEBUG
+    /* This will detect double free's. */
+    BLI_assert(newhead->freeword != FREEWORD);
+#endif
+    newhead->freeword = FREEWORD;
+  }
+
+  newhead->next = cache->free;
+  cache->free = newhead;
+  cache->free_len++;
+
+  BLI_asan_poison(newhead, pool->esize);
+
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MEMPOOL_FREE(pool, addr);
+#endif
+
+  /* Keep some free elements after returning a batch,
+   * so that alternating allocations and frees don't access the pool every time. */
+  if (UNLIKELY(cache->free_len >= THREAD_CACHE_BATCH * 2)) {
+    mempool_thread_cache_return(cache, THREAD_CACHE_BATCH);
+  }
+}
+
+void BLI_mempool_thread_cache_flush(BLI_mempool_thread_cache *cache)
+{
+  if (cache->free_len > 0) {
+    mempool_thread_cache_return(cache, cache->free_len);
+  }
+}
+
+void BLI_mempool_thread_cache_destroy(BLI_mempool_thread_cache *cache)
+{
+  BLI_mempool_thread_cache_flush(cache);
+  MEM_freeN(cache);
+}
+
 #ifndef NDEBUG
 void BLI_mempool_set_memory_debug(void)
 {
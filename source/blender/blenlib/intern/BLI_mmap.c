@@ -9,8 +9,11 @@
 #include "BLI_mmap.h"
 #include "BLI_fileops.h"
 #include "BLI_listbase.h"
+#include "BLI_threads.h"
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include <string.h>
 
 #ifndef WIN32
@@ -33,6 +36,11 @@ struct BLI_mmap_file {
   /* Platform-specific handle for the mapping. */
   void *handle;
 
+  /* Number of users of the mapping, see #BLI_mmap_add_user. */
+  int users;
+  /* The mapped memory is writable, see #BLI_mmap_open_ex. */
+  bool copy_on_write;
+
   /* Flag to indicate IO errors. Needs to be volatile since it's being set from
    * within the signal handler, which is not part of the normal execution flow. */
   volatile bool io_error;
@@ -53,11 +61,14 @@ struct BLI_mmap_file {
  */
 
 static struct error_handler_data {
+  /* Protected by #open_mmaps_lock, except for the signal handler itself. */
   ListBase open_mmaps;
   char configured;
   void (*next_handler)(int, siginfo_t *, void *);
 } error_handler = {0};
 
+static ThreadMutex open_mmaps_lock = BLI_MUTEX_INITIALIZER;
+
 static void sigbus_handler(int sig, siginfo_t *siginfo, void *ptr)
 {
   /* We only handle SIGBUS here for now. */
@@ -73,8 +84,9 @@ static void sigbus_handler(int sig, siginfo_t *siginfo, void *ptr)
       file->io_error = true;
 
       /* Replace the mapped memory with zeroes. */
+      const int prot = file->copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
       const void *mapped_memory = mmap(
-          file->memory, file->length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+          file->memory, file->length, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
       if (mapped_memory == MAP_FAILED) {
         fprintf(stderr, "SIGBUS handler: Error replacing mapped file with zeros\n");
       }
@@ -118,18 +130,27 @@ static bool sigbus_handler_setup(void)
 /* Adds a file to the list that the error handler checks. */
 static void sigbus_handler_add(BLI_mmap_file *file)
 {
+  BLI_mutex_lock(&open_mmaps_lock);
   BLI_addtail(&error_handler.open_mmaps, BLI_genericNodeN(file));
+  BLI_mutex_unlock(&open_mmaps_lock);
 }
 
 /* Removes a file from the list that the error handler checks. */
 static void sigbus_handler_remove(BLI_mmap_file *file)
 {
+  BLI_mutex_lock(&open_mmaps_lock);
   LinkData *link = BLI_findptr(&error_handler.open_mmaps, file, offsetof(LinkData, data));
   BLI_freelinkN(&error_handler.open_mmaps, link);
+  BLI_mutex_unlock(&open_mmaps_lock);
 }
 #endif
 
 BLI_mmap_file *BLI_mmap_open(int fd)
+{
+  return BLI_mmap_open_ex(fd, false);
+}
+
+BLI_mmap_file *BLI_mmap_open_ex(int fd, bool copy_on_write)
 {
   void *memory, *handle = NULL;
   const size_t length = BLI_lseek(fd, 0, SEEK_END);
@@ -144,7 +165,8 @@ BLI_mmap_file *BLI_mmap_open(int fd)
   }
 
   /* Map the given file to memory. */
-  memory = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  const int prot = copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+  memory = mmap(NULL, length, prot, MAP_PRIVATE, fd, 0);
   if (memory == MAP_FAILED) {
     return NULL;
   }
@@ -154,11 +176,12 @@ BLI_mmap_file *BLI_mmap_open(int fd)
   /* Memory mapping on Windows is a two-step process - first we create a mapping,
    * then we create a view into that mapping.
    * In our case, one view that spans the entire file is enough. */
-  handle = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  handle = CreateFileMapping(
+      file_handle, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
   if (handle == NULL) {
     return NULL;
   }
-  memory = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+  memory = MapViewOfFile(handle, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
   if (memory == NULL) {
     CloseHandle(handle);
     return NULL;
@@ -170,6 +193,8 @@ BLI_mmap_file *BLI_mmap_open(int fd)
   file->memory = memory;
   file->handle = handle;
   file->length = length;
+  file->users = 1;
+  file->copy_on_write = copy_on_write;
 
 #ifndef WIN32
   /* Register the file with the error handler. */
@@ -208,6 +233,26 @@ bool BLI_mmap_read(BLI_mmap_file *file, void *dest, size_t offset, size_t length
   return !file->io_error;
 }
 
+void BLI_mmap_prefetch(BLI_mmap_file *file, size_t offset, size_t length)
+{
+  if (file->io_error || offset >= file->length) {
+    return;
+  }
+  length = MIN2(length, file->length - offset);
+
+#ifndef WIN32
+  /* The address has to be aligned to the page size. */
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t start = offset - offset % page_size;
+  madvise(file->memory + start, length + (offset - start), MADV_WILLNEED);
+#elif _WIN32_WINNT >= 0x0602
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = file->memory + offset;
+  range.NumberOfBytes = length;
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+}
+
 void *BLI_mmap_get_pointer(BLI_mmap_file *file)
 {
   return file->memory;
@@ -218,8 +263,17 @@ size_t BLI_mmap_get_length(const BLI_mmap_file *file)
   return file->length;
 }
 
+void BLI_mmap_add_user(BLI_mmap_file *file)
+{
+  atomic_add_and_fetch_int32(&file->users, 1);
+}
+
 void BLI_mmap_free(BLI_mmap_file *file)
 {
+  if (atomic_sub_and_fetch_int32(&file->users, 1) != 0) {
+    return;
+  }
+
 #ifndef WIN32
   munmap((void *)file->memory, file->length);
   sigbus_handler_remove(file);
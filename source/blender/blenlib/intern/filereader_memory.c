@@ -112,7 +112,12 @@ static void memory_close_mmap(FileReader *reader)
 
 FileReader *BLI_filereader_new_mmap(int filedes)
 {
-  BLI_mmap_file *mmap = BLI_mmap_open(filedes);
+  return BLI_filereader_new_mmap_ex(filedes, false);
+}
+
+FileReader *BLI_filereader_new_mmap_ex(int filedes, bool copy_on_write)
+{
+  BLI_mmap_file *mmap = BLI_mmap_open_ex(filedes, copy_on_write);
   if (mmap == NULL) {
     return NULL;
   }
@@ -128,3 +133,11 @@ FileReader *BLI_filereader_new_mmap(int filedes)
 
   return (FileReader *)mem;
 }
+
+BLI_mmap_file *BLI_filereader_mmap_file_get(FileReader *reader)
+{
+  if (reader->read != memory_read_mmap) {
+    return NULL;
+  }
+  return ((MemoryReader *)reader)->mmap;
+}
@@ -11,6 +11,8 @@
 
 #include "BLI_filereader.h"
 #include "BLI_math_base.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #ifdef __BIG_ENDIAN__
 #  include "BLI_endian_switch.h"
@@ -18,6 +20,43 @@
 
 #include "MEM_guardedalloc.h"
 
+/* Maximum number of decompressed frames that are kept around. Library linking jumps back and
+ * forth between a few regions of the file, so caching more than the current frame avoids
+ * repeatedly decompressing the same frames. */
+#define ZSTD_CACHE_FRAMES_MAX 16
+/* Memory budget of the cache (compressed and decompressed data of all cached frames). Files can
+ * be written with large frames, in which case fewer frames are cached, but never less than two. */
+#define ZSTD_CACHE_SIZE (64 << 20)
+/* Maximum number of frames following the current one that are decompressed ahead of time on
+ * worker threads when the file is read sequentially. At most half of the cache is used for
+ * prefetching, so that frames accessed randomly are not evicted all the time. */
+#define ZSTD_PREFETCH_FRAMES 8
+
+typedef enum eZstdFrameState {
+  ZSTD_FRAME_EMPTY = 0,
+  /* Compressed data is loaded, waiting for decompression on a worker thread. */
+  ZSTD_FRAME_PENDING,
+  /* Decompression is running, either on a worker or on the reading thread. */
+  ZSTD_FRAME_DECODING,
+  ZSTD_FRAME_READY,
+  ZSTD_FRAME_FAILED,
+} eZstdFrameState;
+
+typedef struct ZstdCachedFrame {
+  int frame;
+  eZstdFrameState state;
+  /* Value of #ZstdReader.seek.use_counter of the last access, for LRU eviction. */
+  uint64_t last_used;
+
+  char *content;
+  size_t content_alloc_size;
+  char *compressed;
+  size_t compressed_alloc_size;
+
+  /* Decompression context for worker threads, created on first use. */
+  ZSTD_DCtx *ctx;
+} ZstdCachedFrame;
+
 typedef struct {
   FileReader reader;
 
@@ -32,8 +71,18 @@ typedef struct {
     size_t *compressed_ofs;
     size_t *uncompressed_ofs;
 
-    char *cached_content;
-    int cached_frame;
+    ZstdCachedFrame cache[ZSTD_CACHE_FRAMES_MAX];
+    /* Number of used cache entries and prefetched frames, depending on the size of the frames. */
+    int cache_frames_num;
+    int prefetch_frames_num;
+    uint64_t use_counter;
+    int last_frame;
+
+    /* Prefetching, only used when multiple threads are available.
+     * The lock protects the #ZstdCachedFrame.state of all cache entries. */
+    TaskPool *prefetch_pool;
+    ThreadMutex lock;
+    ThreadCondition cond;
   } seek;
 } ZstdReader;
 
@@ -105,6 +154,7 @@ static bool zstd_read_seek_table(ZstdReader *zstd)
 
   size_t compressed_ofs = 0;
   size_t uncompressed_ofs = 0;
+  size_t frame_size_max = 1;
   for (int i = 0; i < frames_num; i++) {
     uint32_t compressed_size, uncompressed_size;
     if (!zstd_read_u32(base, &compressed_size) || !zstd_read_u32(base, &uncompressed_size)) {
@@ -117,6 +167,7 @@ static bool zstd_read_seek_table(ZstdReader *zstd)
     zstd->seek.uncompressed_ofs[i] = uncompressed_ofs;
     compressed_ofs += compressed_size;
     uncompressed_ofs += uncompressed_size;
+    frame_size_max = max_zz(frame_size_max, (size_t)compressed_size + uncompressed_size);
   }
   zstd->seek.compressed_ofs[frames_num] = compressed_ofs;
   zstd->seek.uncompressed_ofs[frames_num] = uncompressed_ofs;
@@ -129,7 +180,15 @@ static bool zstd_read_seek_table(ZstdReader *zstd)
     return false;
   }
 
-  zstd->seek.cached_frame = -1;
+  for (int i = 0; i < ZSTD_CACHE_FRAMES_MAX; i++) {
+    zstd->seek.cache[i].frame = -1;
+  }
+  zstd->seek.cache_frames_num = max_ii(
+      (int)min_zz(ZSTD_CACHE_SIZE / frame_size_max, ZSTD_CACHE_FRAMES_MAX), 2);
+  zstd->seek.prefetch_frames_num = min_ii(ZSTD_PREFETCH_FRAMES, zstd->seek.cache_frames_num / 2);
+  zstd->seek.last_frame = -1;
+  BLI_mutex_init(&zstd->seek.lock);
+  BLI_condition_init(&zstd->seek.cond);
 
   return true;
 }
@@ -157,42 +216,199 @@ static int zstd_frame_from_pos(ZstdReader *zstd, size_t pos)
   return low;
 }
 
-/* Ensure that the currently loaded frame is the correct one. */
-static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
+/* Read the compressed data of a frame into the cache entry. Only called from the reading thread,
+ * since the base reader is not thread-safe. */
+static bool zstd_frame_load_compressed(ZstdReader *zstd, ZstdCachedFrame *entry, int frame)
 {
-  if (zstd->seek.cached_frame == frame) {
-    /* Cached frame matches, so just return it. */
-    return zstd->seek.cached_content;
+  size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] - zstd->seek.compressed_ofs[frame];
+  size_t uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
+                             zstd->seek.uncompressed_ofs[frame];
+
+  /* Frames all have about the same size, so buffers are reused between frames. */
+  if (entry->compressed_alloc_size < compressed_size) {
+    MEM_SAFE_FREE(entry->compressed);
+    entry->compressed = MEM_mallocN(compressed_size, __func__);
+    entry->compressed_alloc_size = compressed_size;
+  }
+  if (entry->content_alloc_size < uncompressed_size) {
+    MEM_SAFE_FREE(entry->content);
+    entry->content = MEM_mallocN(uncompressed_size, __func__);
+    entry->content_alloc_size = uncompressed_size;
   }
 
-  /* Cached frame doesn't match, so discard it and cache the wanted one instead. */
-  MEM_SAFE_FREE(zstd->seek.cached_content);
+  return zstd->base->seek(zstd->base, zstd->seek.compressed_ofs[frame], SEEK_SET) >= 0 &&
+         zstd->base->read(zstd->base, entry->compressed, compressed_size) >= compressed_size;
+}
 
+static bool zstd_frame_decompress(ZstdReader *zstd, ZstdCachedFrame *entry, ZSTD_DCtx *ctx)
+{
+  const int frame = entry->frame;
   size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] - zstd->seek.compressed_ofs[frame];
   size_t uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
                              zstd->seek.uncompressed_ofs[frame];
 
-  char *uncompressed_data = MEM_mallocN(uncompressed_size, __func__);
-  char *compressed_data = MEM_mallocN(compressed_size, __func__);
-  if (zstd->base->seek(zstd->base, zstd->seek.compressed_ofs[frame], SEEK_SET) < 0 ||
-      zstd->base->read(zstd->base, compressed_data, compressed_size) < compressed_size)
-  {
-    MEM_freeN(compressed_data);
-    MEM_freeN(uncompressed_data);
-    return NULL;
+  size_t res = ZSTD_decompressDCtx(
+      ctx, entry->content, uncompressed_size, entry->compressed, compressed_size);
+  return !ZSTD_isError(res) && res >= uncompressed_size;
+}
+
+static void zstd_frame_decompress_task(TaskPool *__restrict pool, void *taskdata)
+{
+  ZstdReader *zstd = BLI_task_pool_user_data(pool);
+  ZstdCachedFrame *entry = taskdata;
+
+  BLI_mutex_lock(&zstd->seek.lock);
+  if (entry->state != ZSTD_FRAME_PENDING) {
+    /* The reading thread needed the frame before this task started and decompressed it. */
+    BLI_mutex_unlock(&zstd->seek.lock);
+    return;
   }
+  entry->state = ZSTD_FRAME_DECODING;
+  BLI_mutex_unlock(&zstd->seek.lock);
 
-  size_t res = ZSTD_decompressDCtx(
-      zstd->ctx, uncompressed_data, uncompressed_size, compressed_data, compressed_size);
-  MEM_freeN(compressed_data);
-  if (ZSTD_isError(res) || res < uncompressed_size) {
-    MEM_freeN(uncompressed_data);
-    return NULL;
+  if (entry->ctx == NULL) {
+    entry->ctx = ZSTD_createDCtx();
   }
+  const bool success = zstd_frame_decompress(zstd, entry, entry->ctx);
 
-  zstd->seek.cached_frame = frame;
-  zstd->seek.cached_content = uncompressed_data;
-  return uncompressed_data;
+  BLI_mutex_lock(&zstd->seek.lock);
+  entry->state = success ? ZSTD_FRAME_READY : ZSTD_FRAME_FAILED;
+  BLI_condition_notify_all(&zstd->seek.cond);
+  BLI_mutex_unlock(&zstd->seek.lock);
+}
+
+/* Find the cache entry of the given frame. Must be called with the lock held. */
+static ZstdCachedFrame *zstd_cache_lookup(ZstdReader *zstd, int frame)
+{
+  for (int i = 0; i < zstd->seek.cache_frames_num; i++) {
+    if (zstd->seek.cache[i].frame == frame) {
+      return &zstd->seek.cache[i];
+    }
+  }
+  return NULL;
+}
+
+/* Find the least recently used entry that is not being worked on. Must be called with the lock
+ * held. */
+static ZstdCachedFrame *zstd_cache_evict(ZstdReader *zstd, const ZstdCachedFrame *keep)
+{
+  ZstdCachedFrame *victim = NULL;
+  for (int i = 0; i < zstd->seek.cache_frames_num; i++) {
+    ZstdCachedFrame *entry = &zstd->seek.cache[i];
+    if (entry == keep || ELEM(entry->state, ZSTD_FRAME_PENDING, ZSTD_FRAME_DECODING)) {
+      continue;
+    }
+    if (victim == NULL || entry->last_used < victim->last_used) {
+      victim = entry;
+    }
+  }
+  return victim;
+}
+
+/* Start decompressing the frames following the given one on worker threads. */
+static void zstd_prefetch(ZstdReader *zstd, const ZstdCachedFrame *current)
+{
+  if (zstd->seek.prefetch_pool == NULL) {
+    if (BLI_task_scheduler_num_threads() <= 1) {
+      return;
+    }
+    zstd->seek.prefetch_pool = BLI_task_pool_create(zstd, TASK_PRIORITY_HIGH);
+  }
+
+  const int last_frame = min_ii(current->frame + zstd->seek.prefetch_frames_num,
+                                zstd->seek.frames_num - 1);
+  for (int frame = current->frame + 1; frame <= last_frame; frame++) {
+    BLI_mutex_lock(&zstd->seek.lock);
+    ZstdCachedFrame *entry = zstd_cache_lookup(zstd, frame);
+    if (entry != NULL && entry->state != ZSTD_FRAME_FAILED) {
+      entry->last_used = ++zstd->seek.use_counter;
+      BLI_mutex_unlock(&zstd->seek.lock);
+      continue;
+    }
+    if (entry == NULL) {
+      entry = zstd_cache_evict(zstd, current);
+    }
+    if (entry == NULL) {
+      BLI_mutex_unlock(&zstd->seek.lock);
+      break;
+    }
+    entry->frame = -1;
+    entry->state = ZSTD_FRAME_EMPTY;
+    BLI_mutex_unlock(&zstd->seek.lock);
+
+    /* Entries that are not pending or decoding are only accessed by the reading thread, so the
+     * compressed data can be loaded without holding the lock. */
+    if (!zstd_frame_load_compressed(zstd, entry, frame)) {
+      break;
+    }
+
+    BLI_mutex_lock(&zstd->seek.lock);
+    entry->frame = frame;
+    entry->state = ZSTD_FRAME_PENDING;
+    entry->last_used = ++zstd->seek.use_counter;
+    BLI_mutex_unlock(&zstd->seek.lock);
+
+    BLI_task_pool_push(zstd->seek.prefetch_pool, zstd_frame_decompress_task, entry, false, NULL);
+  }
+}
+
+/* Ensure that the given frame is decompressed and cached, and return its content. */
+static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
+{
+  BLI_mutex_lock(&zstd->seek.lock);
+  ZstdCachedFrame *entry = zstd_cache_lookup(zstd, frame);
+  if (entry != NULL && entry->state == ZSTD_FRAME_PENDING) {
+    /* Prefetched but not started yet, so rather decompress it here than wait for a worker. */
+    entry->state = ZSTD_FRAME_DECODING;
+    BLI_mutex_unlock(&zstd->seek.lock);
+
+    const bool success = zstd_frame_decompress(zstd, entry, zstd->ctx);
+
+    BLI_mutex_lock(&zstd->seek.lock);
+    entry->state = success ? ZSTD_FRAME_READY : ZSTD_FRAME_FAILED;
+  }
+  while (entry != NULL && entry->state == ZSTD_FRAME_DECODING) {
+    BLI_condition_wait(&zstd->seek.cond, &zstd->seek.lock);
+  }
+
+  if (entry == NULL || entry->state != ZSTD_FRAME_READY) {
+    /* Frame isn't cached, so evict the least recently used one and decompress it here. */
+    if (entry == NULL) {
+      entry = zstd_cache_evict(zstd, NULL);
+      while (entry == NULL) {
+        /* All cache entries are being decompressed by prefetch tasks, wait for one of them. */
+        BLI_condition_wait(&zstd->seek.cond, &zstd->seek.lock);
+        entry = zstd_cache_evict(zstd, NULL);
+      }
+    }
+    entry->frame = -1;
+    entry->state = ZSTD_FRAME_EMPTY;
+    BLI_mutex_unlock(&zstd->seek.lock);
+
+    if (!zstd_frame_load_compressed(zstd, entry, frame)) {
+      return NULL;
+    }
+    entry->frame = frame;
+    const bool success = zstd_frame_decompress(zstd, entry, zstd->ctx);
+
+    BLI_mutex_lock(&zstd->seek.lock);
+    entry->state = success ? ZSTD_FRAME_READY : ZSTD_FRAME_FAILED;
+    if (!success) {
+      entry->frame = -1;
+      BLI_mutex_unlock(&zstd->seek.lock);
+      return NULL;
+    }
+  }
+  entry->last_used = ++zstd->seek.use_counter;
+  BLI_mutex_unlock(&zstd->seek.lock);
+
+  /* Only prefetch when reading sequentially, random access only benefits from the cache. */
+  if (frame == zstd->seek.last_frame + 1) {
+    zstd_prefetch(zstd, entry);
+  }
+  zstd->seek.last_frame = frame;
+
+  return entry->content;
 }
 
 static int64_t zstd_read_seekable(FileReader *reader, void *buffer, size_t size)
@@ -285,10 +501,21 @@ static void zstd_close(FileReader *reader)
   if (zstd->reader.seek) {
     MEM_freeN(zstd->seek.uncompressed_ofs);
     MEM_freeN(zstd->seek.compressed_ofs);
-    /* When an error has occurred this may be NULL, see: #99744. */
-    if (zstd->seek.cached_content) {
-      MEM_freeN(zstd->seek.cached_content);
+    if (zstd->seek.prefetch_pool) {
+      BLI_task_pool_cancel(zstd->seek.prefetch_pool);
+      BLI_task_pool_free(zstd->seek.prefetch_pool);
+    }
+    for (int i = 0; i < ZSTD_CACHE_FRAMES_MAX; i++) {
+      ZstdCachedFrame *entry = &zstd->seek.cache[i];
+      /* When an error has occurred these may be NULL, see: #99744. */
+      MEM_SAFE_FREE(entry->content);
+      MEM_SAFE_FREE(entry->compressed);
+      if (entry->ctx) {
+        ZSTD_freeDCtx(entry->ctx);
+      }
     }
+    BLI_condition_end(&zstd->seek.cond);
+    BLI_mutex_end(&zstd->seek.lock);
   }
   else {
     MEM_freeN((void *)zstd->in_buf.src);
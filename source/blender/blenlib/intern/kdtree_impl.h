@@ -10,6 +10,7 @@
 
 #include "BLI_kdtree_impl.h"
 #include "BLI_math_base.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include <string.h>
@@ -50,6 +51,11 @@ struct KDTree {
 
 #define KD_NODE_UNSET ((uint)-1)
 
+/** Balance sub-trees with more nodes than this in separate tasks. */
+#define KD_BALANCE_THREAD_MIN 16384
+/** Run batched queries with more points than this in parallel. */
+#define KD_BATCH_THREAD_MIN 1024
+
 /**
  * When set we know all values are unbalanced,
  * otherwise clear them when re-balancing: see #62210.
@@ -139,7 +145,47 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+typedef struct KDTreeBalanceTask {
+  KDTreeNode *nodes;
+  uint nodes_len;
+  uint axis;
+  uint ofs;
+  /** Where to store the root of the balanced sub-tree. */
+  uint *r_root;
+} KDTreeBalanceTask;
+
+static uint kdtree_balance(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs);
+
+static void kdtree_balance_task(TaskPool *__restrict pool, void *taskdata)
+{
+  const KDTreeBalanceTask *task = taskdata;
+  *task->r_root = kdtree_balance(pool, task->nodes, task->nodes_len, task->axis, task->ofs);
+}
+
+/**
+ * Balance a sub-tree into \a r_root, as a task of \a pool (when not null) if it's big enough.
+ * The sub-trees don't overlap in the nodes array, so they can be balanced in parallel.
+ */
+static void kdtree_balance_subtree(
+    TaskPool *pool, uint *r_root, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  if (pool && nodes_len > KD_BALANCE_THREAD_MIN) {
+    KDTreeBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+    task->nodes = nodes;
+    task->nodes_len = nodes_len;
+    task->axis = axis;
+    task->ofs = ofs;
+    task->r_root = r_root;
+    BLI_task_pool_push(pool, kdtree_balance_task, task, true, NULL);
+  }
+  else {
+    *r_root = kdtree_balance(pool, nodes, nodes_len, axis, ofs);
+  }
+}
+
+static uint kdtree_balance(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
 {
   KDTreeNode *node;
   float co;
@@ -188,9 +234,13 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   node = &nodes[median];
   node->d = axis;
   axis = (axis + 1) % KD_DIMS;
-  node->left = kdtree_balance(nodes, median, axis, ofs);
-  node->right = kdtree_balance(
-      nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+  kdtree_balance_subtree(pool, &node->left, nodes, median, axis, ofs);
+  kdtree_balance_subtree(pool,
+                         &node->right,
+                         nodes + median + 1,
+                         (nodes_len - (median + 1)),
+                         axis,
+                         (median + 1) + ofs);
 
   return median + ofs;
 }
@@ -204,7 +254,15 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
     }
   }
 
-  tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  if (tree->nodes_len > KD_BALANCE_THREAD_MIN) {
+    TaskPool *pool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+    kdtree_balance_subtree(pool, &tree->root, tree->nodes, tree->nodes_len, 0, 0);
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
+  else {
+    tree->root = kdtree_balance(NULL, tree->nodes, tree->nodes_len, 0, 0);
+  }
 
 #ifndef NDEBUG
   tree->is_balanced = true;
@@ -800,6 +858,102 @@ finally:
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_kdtree_3d_find_nearest_batch
+ * \{ */
+
+typedef struct KDTreeBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  KDTreeNearest *r_nearest;
+  uint nearest_len_capacity;
+  int *r_nearest_len;
+} KDTreeBatchData;
+
+static void kdtree_batch_settings(TaskParallelSettings *settings, const uint co_len)
+{
+  BLI_parallel_range_settings_defaults(settings);
+  settings->use_threading = co_len > KD_BATCH_THREAD_MIN;
+  settings->min_iter_per_thread = 256;
+}
+
+static void kdtree_find_nearest_batch_cb(void *__restrict userdata,
+                                         const int i,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  KDTreeNearest *nearest = &data->r_nearest[i];
+  if (BLI_kdtree_nd_(find_nearest)(data->tree, data->co[i], nearest) == -1) {
+    nearest->index = -1;
+    nearest->dist = FLT_MAX;
+  }
+}
+
+/**
+ * Find the nearest point of each of \a co, in parallel for big batches.
+ *
+ * \param r_nearest: An array sized \a co_len,
+ * the index of the results is -1 when the tree is empty.
+ */
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        KDTreeNearest *r_nearest)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .r_nearest = r_nearest,
+  };
+  TaskParallelSettings settings;
+  kdtree_batch_settings(&settings, co_len);
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_find_nearest_batch_cb, &settings);
+}
+
+static void kdtree_find_nearest_n_batch_cb(void *__restrict userdata,
+                                           const int i,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  const int nearest_len = BLI_kdtree_nd_(find_nearest_n)(
+      data->tree,
+      data->co[i],
+      &data->r_nearest[(size_t)i * data->nearest_len_capacity],
+      data->nearest_len_capacity);
+  if (data->r_nearest_len) {
+    data->r_nearest_len[i] = nearest_len;
+  }
+}
+
+/**
+ * Find the \a nearest_len_capacity nearest points of each of \a co,
+ * in parallel for big batches.
+ *
+ * \param r_nearest: An array sized \a co_len * \a nearest_len_capacity,
+ * the results of each point are stored after each other.
+ * \param r_nearest_len: Optional array sized \a co_len, the number of results of each point.
+ */
+void BLI_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          const uint co_len,
+                                          KDTreeNearest *r_nearest,
+                                          const uint nearest_len_capacity,
+                                          int *r_nearest_len)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .r_nearest = r_nearest,
+      .nearest_len_capacity = nearest_len_capacity,
+      .r_nearest_len = r_nearest_len,
+  };
+  TaskParallelSettings settings;
+  kdtree_batch_settings(&settings, co_len);
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_find_nearest_n_batch_cb, &settings);
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
@@ -0,0 +1,263 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bli
+ *
+ * Parallel least significant digit radix sort. Every pass sorts the keys by one digit. The input
+ * is split into fixed size chunks, so that the result does not depend on the number of threads:
+ * - Every chunk counts how often every digit occurs in it.
+ * - A prefix sum over all buckets (and over the chunks within each bucket) gives every chunk the
+ *   position where it writes the elements of each bucket. Iterating over the chunks in order
+ *   within a bucket keeps the sort stable, which is required for the next pass.
+ * - Every chunk scatters its elements into the output buffer.
+ *
+ * Passes in which all keys have the same digit are skipped. That is common for the upper digits,
+ * e.g. when sorting indices or other small integers.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+#include "BLI_array.hh"
+#include "BLI_sort.hh"
+#include "BLI_task.hh"
+
+namespace blender {
+
+namespace radix_sort_detail {
+
+static constexpr int digit_bits = 8;
+static constexpr int buckets_num = 1 << digit_bits;
+static constexpr int64_t chunk_size = 1 << 16;
+/** Below this size a comparison sort is faster than the radix sort. */
+static constexpr int64_t comparison_sort_threshold = 1 << 10;
+
+/**
+ * Map every key to an unsigned integer of the same size that has the same order.
+ */
+static uint32_t to_radix(const uint32_t value)
+{
+  return value;
+}
+static uint64_t to_radix(const uint64_t value)
+{
+  return value;
+}
+static uint32_t to_radix(const int32_t value)
+{
+  return uint32_t(value) ^ (uint32_t(1) << 31);
+}
+static uint64_t to_radix(const int64_t value)
+{
+  return uint64_t(value) ^ (uint64_t(1) << 63);
+}
+static uint32_t to_radix(const float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(float));
+  /* Flip all bits of negative values, so that larger magnitudes come first. Only flip the sign
+   * bit of positive values, so that they come after all negative values. */
+  const uint32_t mask = uint32_t(-int32_t(bits >> 31)) | (uint32_t(1) << 31);
+  return bits ^ mask;
+}
+
+template<typename T> using RadixType = decltype(to_radix(std::declval<T>()));
+
+/**
+ * Inverse of #to_radix.
+ */
+template<typename T> static T from_radix(const RadixType<T> value)
+{
+  using UInt = RadixType<T>;
+  constexpr UInt sign_bit = UInt(1) << (sizeof(UInt) * 8 - 1);
+  if constexpr (std::is_same_v<T, float>) {
+    /* The sign bit is set for values that were positive originally. */
+    const uint32_t bits = value ^ ((value & sign_bit) ? sign_bit : ~uint32_t(0));
+    float result;
+    memcpy(&result, &bits, sizeof(float));
+    return result;
+  }
+  else if constexpr (std::is_signed_v<T>) {
+    return T(value ^ sign_bit);
+  }
+  else {
+    return value;
+  }
+}
+
+/**
+ * Sort the keys and reorder the indices in the same way (if there are any). Both are double
+ * buffered. The spans are swapped as necessary, so that they reference the sorted data in the end.
+ */
+template<typename UInt>
+static void radix_sort(MutableSpan<UInt> &keys,
+                       MutableSpan<UInt> &keys_buffer,
+                       MutableSpan<int> &indices,
+                       MutableSpan<int> &indices_buffer)
+{
+  const bool use_indices = !indices.is_empty();
+  const int64_t size = keys.size();
+  const int64_t chunks_num = (size + chunk_size - 1) / chunk_size;
+  Array<int64_t> chunk_offsets(chunks_num * buckets_num);
+
+  for (int shift = 0; shift < int(sizeof(UInt)) * 8; shift += digit_bits) {
+    const auto digit = [&](const UInt key) { return int((key >> shift) & (buckets_num - 1)); };
+
+    threading::parallel_for(IndexRange(chunks_num), 1, [&](const IndexRange chunks) {
+      for (const int64_t chunk : chunks) {
+        MutableSpan<int64_t> counts = chunk_offsets.as_mutable_span().slice(
+            chunk * buckets_num, buckets_num);
+        counts.fill(0);
+        for (const UInt key : keys.slice_safe(chunk * chunk_size, chunk_size)) {
+          counts[digit(key)]++;
+        }
+      }
+    });
+
+    /* Turn the counts into offsets, ordered by bucket first and chunk second. */
+    bool all_in_one_bucket = false;
+    int64_t offset = 0;
+    for (const int bucket : IndexRange(buckets_num)) {
+      const int64_t bucket_start = offset;
+      for (const int64_t chunk : IndexRange(chunks_num)) {
+        int64_t &value = chunk_offsets[chunk * buckets_num + bucket];
+        const int64_t count = value;
+        value = offset;
+        offset += count;
+      }
+      if (offset - bucket_start == size) {
+        all_in_one_bucket = true;
+        break;
+      }
+    }
+    if (all_in_one_bucket) {
+      continue;
+    }
+
+    threading::parallel_for(IndexRange(chunks_num), 1, [&](const IndexRange chunks) {
+      for (const int64_t chunk : chunks) {
+        std::array<int64_t, buckets_num> offsets;
+        std::copy_n(&chunk_offsets[chunk * buckets_num], buckets_num, offsets.begin());
+        const IndexRange range = IndexRange(chunk * chunk_size,
+                                            std::min(chunk_size, size - chunk * chunk_size));
+        for (const int64_t i : range) {
+          const UInt key = keys[i];
+          const int64_t dst = offsets[digit(key)]++;
+          keys_buffer[dst] = key;
+          if (use_indices) {
+            indices_buffer[dst] = indices[i];
+          }
+        }
+      }
+    });
+    std::swap(keys, keys_buffer);
+    std::swap(indices, indices_buffer);
+  }
+}
+
+template<typename T> static void sort_values(MutableSpan<T> values)
+{
+  using UInt = RadixType<T>;
+  if (values.size() < comparison_sort_threshold) {
+    std::sort(values.begin(), values.end(), [](const T a, const T b) {
+      return to_radix(a) < to_radix(b);
+    });
+    return;
+  }
+  Array<UInt> keys_data(values.size(), NoInitialization());
+  Array<UInt> keys_buffer_data(values.size(), NoInitialization());
+  threading::parallel_for(values.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      keys_data[i] = to_radix(values[i]);
+    }
+  });
+  MutableSpan<UInt> keys = keys_data;
+  MutableSpan<UInt> keys_buffer = keys_buffer_data;
+  MutableSpan<int> indices;
+  MutableSpan<int> indices_buffer;
+  radix_sort(keys, keys_buffer, indices, indices_buffer);
+  threading::parallel_for(values.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      values[i] = from_radix<T>(keys[i]);
+    }
+  });
+}
+
+template<typename T> static void sort_indices_by_key(const Span<T> keys, MutableSpan<int> indices)
+{
+  using UInt = RadixType<T>;
+  if (indices.size() < comparison_sort_threshold) {
+    std::stable_sort(indices.begin(), indices.end(), [&](const int a, const int b) {
+      return to_radix(keys[a]) < to_radix(keys[b]);
+    });
+    return;
+  }
+  Array<UInt> sort_keys_data(indices.size(), NoInitialization());
+  Array<UInt> sort_keys_buffer_data(indices.size(), NoInitialization());
+  Array<int> indices_buffer_data(indices.size(), NoInitialization());
+  threading::parallel_for(indices.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      sort_keys_data[i] = to_radix(keys[indices[i]]);
+    }
+  });
+  MutableSpan<UInt> sort_keys = sort_keys_data;
+  MutableSpan<UInt> sort_keys_buffer = sort_keys_buffer_data;
+  MutableSpan<int> sorted_indices = indices;
+  MutableSpan<int> indices_buffer = indices_buffer_data;
+  radix_sort(sort_keys, sort_keys_buffer, sorted_indices, indices_buffer);
+  if (sorted_indices.data() != indices.data()) {
+    threading::parallel_for(indices.index_range(), 4096, [&](const IndexRange range) {
+      indices.slice(range).copy_from(sorted_indices.slice(range));
+    });
+  }
+}
+
+}  // namespace radix_sort_detail
+
+void parallel_radix_sort(MutableSpan<int32_t> values)
+{
+  radix_sort_detail::sort_values(values);
+}
+void parallel_radix_sort(MutableSpan<uint32_t> values)
+{
+  radix_sort_detail::sort_values(values);
+}
+void parallel_radix_sort(MutableSpan<int64_t> values)
+{
+  radix_sort_detail::sort_values(values);
+}
+void parallel_radix_sort(MutableSpan<uint64_t> values)
+{
+  radix_sort_detail::sort_values(values);
+}
+void parallel_radix_sort(MutableSpan<float> values)
+{
+  radix_sort_detail::sort_values(values);
+}
+
+void parallel_radix_sort_indices_by_key(const Span<int32_t> keys, MutableSpan<int> indices)
+{
+  radix_sort_detail::sort_indices_by_key(keys, indices);
+}
+void parallel_radix_sort_indices_by_key(const Span<uint32_t> keys, MutableSpan<int> indices)
+{
+  radix_sort_detail::sort_indices_by_key(keys, indices);
+}
+void parallel_radix_sort_indices_by_key(const Span<int64_t> keys, MutableSpan<int> indices)
+{
+  radix_sort_detail::sort_indices_by_key(keys, indices);
+}
+void parallel_radix_sort_indices_by_key(const Span<uint64_t> keys, MutableSpan<int> indices)
+{
+  radix_sort_detail::sort_indices_by_key(keys, indices);
+}
+void parallel_radix_sort_indices_by_key(const Span<float> keys, MutableSpan<int> indices)
+{
+  radix_sort_detail::sort_indices_by_key(keys, indices);
+}
+
+}  // namespace blender
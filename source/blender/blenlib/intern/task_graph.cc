@@ -14,6 +14,8 @@
 
 #include "BLI_task.h"
 
+#include <algorithm>
+#include <climits>
 #include <memory>
 #include <vector>
 
@@ -27,6 +29,12 @@ struct TaskGraph {
   tbb::flow::graph tbb_graph;
 #endif
   std::vector<std::unique_ptr<TaskNode>> nodes;
+#ifdef WITH_TBB
+  /* Nodes without TBB node, and nodes with successors that are not connected in TBB yet. Both
+   * are handled on the next push, so that a push only costs time for what was added since. */
+  std::vector<TaskNode *> new_nodes;
+  std::vector<TaskNode *> new_edges_nodes;
+#endif
 
 #ifdef WITH_CXX_GUARDEDALLOC
   MEM_CXX_CLASS_ALLOC_FUNCS("task_graph:TaskGraph")
@@ -35,13 +43,22 @@ struct TaskGraph {
 
 /* TaskNode - a node in the task graph. */
 struct TaskNode {
-  /* TBB Node. */
+  TaskGraph *task_graph;
 #ifdef WITH_TBB
-  tbb::flow::continue_node<tbb::flow::continue_msg> tbb_node;
+  /* TBB Node. It's only created when work is pushed for the first time, because its priority
+   * depends on the nodes that come after it. */
+  std::unique_ptr<tbb::flow::continue_node<tbb::flow::continue_msg>> tbb_node;
+  /* Number of #successors that have been connected to the TBB node already. */
+  int64_t tbb_edges_num = 0;
 #endif
-  /* Successors to execute after this task, for serial execution fallback. */
+  /* Successors to execute after this task. */
   std::vector<TaskNode *> successors;
 
+  /* Estimated cost of running this node, see #BLI_task_graph_node_set_cost. */
+  int64_t cost = 1;
+  /* Cost of the most expensive path starting at this node, -1 when not computed yet. */
+  int64_t path_cost = -1;
+
   /* User function to be executed with given task data. */
   TaskGraphNodeRunFunction run_func;
   void *task_data;
@@ -53,19 +70,8 @@ struct TaskNode {
            TaskGraphNodeRunFunction run_func,
            void *task_data,
            TaskGraphNodeFreeFunction free_func)
-      :
-#ifdef WITH_TBB
-        tbb_node(task_graph->tbb_graph,
-                 tbb::flow::unlimited,
-                 [&](const tbb::flow::continue_msg input) { run(input); }),
-#endif
-        run_func(run_func),
-        task_data(task_data),
-        free_func(free_func)
+      : task_graph(task_graph), run_func(run_func), task_data(task_data), free_func(free_func)
   {
-#ifndef WITH_TBB
-    UNUSED_VARS(task_graph);
-#endif
   }
 
   TaskNode(const TaskNode &other) = delete;
@@ -99,6 +105,73 @@ struct TaskNode {
 #endif
 };
 
+#ifdef WITH_TBB
+
+/**
+ * Compute the cost of the most expensive path starting at every new node. Nodes on that path are
+ * on the critical path, delaying them delays the entire graph.
+ *
+ * Nodes that already have a TBB node are not updated for new successors, since their priority
+ * can't change anymore.
+ */
+static void task_graph_compute_path_costs(TaskGraph *task_graph)
+{
+  /* Iterative depth-first search, because chains of nodes can be very long. */
+  std::vector<std::pair<TaskNode *, int64_t>> stack;
+  for (TaskNode *node : task_graph->new_nodes) {
+    if (node->path_cost != -1) {
+      continue;
+    }
+    stack.emplace_back(node, 0);
+    while (!stack.empty()) {
+      auto &[current, next_successor] = stack.back();
+      if (next_successor < int64_t(current->successors.size())) {
+        TaskNode *successor = current->successors[next_successor++];
+        if (successor->path_cost == -1) {
+          stack.emplace_back(successor, 0);
+        }
+        continue;
+      }
+      int64_t successors_cost = 0;
+      for (const TaskNode *successor : current->successors) {
+        /* Still -1 for successors that are on the stack, which only happens for cycles. */
+        successors_cost = std::max(successors_cost, successor->path_cost);
+      }
+      current->path_cost = current->cost + successors_cost;
+      stack.pop_back();
+    }
+  }
+}
+
+/**
+ * Create the TBB nodes and edges that don't exist yet. More expensive paths get a higher
+ * priority, so that they are started as early as possible. Without priorities, one long chain of
+ * nodes can be delayed behind many cheap nodes which would make the graph finish later.
+ */
+static void task_graph_ensure_tbb_nodes(TaskGraph *task_graph)
+{
+  task_graph_compute_path_costs(task_graph);
+  for (TaskNode *node : task_graph->new_nodes) {
+    /* Zero is #tbb::flow::no_priority. */
+    const tbb::flow::node_priority_t priority = tbb::flow::node_priority_t(
+        std::clamp<int64_t>(node->path_cost, 1, UINT_MAX));
+    node->tbb_node = std::make_unique<tbb::flow::continue_node<tbb::flow::continue_msg>>(
+        task_graph->tbb_graph,
+        tbb::flow::unlimited,
+        [node](const tbb::flow::continue_msg input) { return node->run(input); },
+        priority);
+  }
+  task_graph->new_nodes.clear();
+  for (TaskNode *node : task_graph->new_edges_nodes) {
+    for (; node->tbb_edges_num < int64_t(node->successors.size()); node->tbb_edges_num++) {
+      tbb::flow::make_edge(*node->tbb_node, *node->successors[node->tbb_edges_num]->tbb_node);
+    }
+  }
+  task_graph->new_edges_nodes.clear();
+}
+
+#endif
+
 TaskGraph *BLI_task_graph_create()
 {
   return new TaskGraph();
@@ -125,14 +198,27 @@ TaskNode *BLI_task_graph_node_create(TaskGraph *task_graph,
 {
   TaskNode *task_node = new TaskNode(task_graph, run, user_data, free_func);
   task_graph->nodes.push_back(std::unique_ptr<TaskNode>(task_node));
+#ifdef WITH_TBB
+  task_graph->new_nodes.push_back(task_node);
+#endif
   return task_node;
 }
 
+void BLI_task_graph_node_set_cost(TaskNode *task_node, const int64_t cost)
+{
+  task_node->cost = std::max<int64_t>(cost, 1);
+}
+
 bool BLI_task_graph_node_push_work(TaskNode *task_node)
 {
 #ifdef WITH_TBB
   if (BLI_task_scheduler_num_threads() > 1) {
-    return task_node->tbb_node.try_put(tbb::flow::continue_msg());
+    if (!task_node->task_graph->new_nodes.empty() ||
+        !task_node->task_graph->new_edges_nodes.empty())
+    {
+      task_graph_ensure_tbb_nodes(task_node->task_graph);
+    }
+    return task_node->tbb_node->try_put(tbb::flow::continue_msg());
   }
 #endif
 
@@ -143,11 +229,10 @@ bool BLI_task_graph_node_push_work(TaskNode *task_node)
 void BLI_task_graph_edge_create(TaskNode *from_node, TaskNode *to_node)
 {
 #ifdef WITH_TBB
-  if (BLI_task_scheduler_num_threads() > 1) {
-    tbb::flow::make_edge(from_node->tbb_node, to_node->tbb_node);
-    return;
+  if (from_node->tbb_edges_num == int64_t(from_node->successors.size())) {
+    /* First edge of the node that isn't connected yet. */
+    from_node->task_graph->new_edges_nodes.push_back(from_node);
   }
 #endif
-
   from_node->successors.push_back(to_node);
 }
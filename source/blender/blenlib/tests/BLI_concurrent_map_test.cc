@@ -0,0 +1,177 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include <mutex>
+
+#include "testing/testing.h"
+
+#include "BLI_concurrent_map.hh"
+#include "BLI_concurrent_set.hh"
+#include "BLI_rand.hh"
+#include "BLI_string_ref.hh"
+#include "BLI_task.hh"
+#include "BLI_timeit.hh"
+#include "BLI_vector.hh"
+
+#include "BLI_strict_flags.h" /* Keep last. */
+
+namespace blender::tests {
+
+TEST(concurrent_map, AddAndLookup)
+{
+  ConcurrentMap<int, int> map;
+  EXPECT_TRUE(map.is_empty());
+  EXPECT_TRUE(map.add(1, 10));
+  EXPECT_FALSE(map.add(1, 20));
+  map.add_new(2, 30);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.lookup(1), 10);
+  EXPECT_EQ(map.lookup(2), 30);
+  EXPECT_EQ(map.lookup_default(3, -1), -1);
+  EXPECT_FALSE(map.lookup_try(3).has_value());
+  EXPECT_EQ(*map.lookup_try(2), 30);
+  EXPECT_TRUE(map.contains(2));
+  EXPECT_FALSE(map.contains(3));
+  EXPECT_EQ(map.lookup_or_add(3, 40), 40);
+  EXPECT_EQ(map.lookup_or_add(3, 50), 40);
+  EXPECT_EQ(map.lookup_or_add_cb(4, []() { return 60; }), 60);
+  EXPECT_EQ(map.size(), 4);
+}
+
+TEST(concurrent_map, StringKeys)
+{
+  ConcurrentMap<std::string, int> map;
+  map.add("a", 1);
+  map.add(std::string("b"), 2);
+  EXPECT_EQ(map.lookup(StringRef("a")), 1);
+  EXPECT_EQ(map.lookup("b"), 2);
+  EXPECT_FALSE(map.contains("c"));
+}
+
+TEST(concurrent_map, ParallelAdd)
+{
+  ConcurrentMap<int, int> map;
+  threading::parallel_for(IndexRange(100000), 1024, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      /* Every key is added by multiple threads. */
+      map.add(int(i % 10000), int(i % 10000) * 2);
+    }
+  });
+  EXPECT_EQ(map.size(), 10000);
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_EQ(map.lookup(i), i * 2);
+  }
+}
+
+TEST(concurrent_map, ParallelAddOrModify)
+{
+  ConcurrentMap<int, int> map;
+  threading::parallel_for(IndexRange(100000), 1024, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      map.add_or_modify(
+          int(i % 100), [](int *value) { *value = 1; }, [](int *value) { (*value)++; });
+    }
+  });
+  EXPECT_EQ(map.size(), 100);
+  int64_t sum = 0;
+  map.foreach_item([&](const int /*key*/, const int value) {
+    EXPECT_EQ(value, 1000);
+    sum += value;
+  });
+  EXPECT_EQ(sum, 100000);
+}
+
+TEST(concurrent_map, ToMap)
+{
+  ConcurrentMap<int, int> map;
+  for (int i = 0; i < 1000; i++) {
+    map.add_new(i, i + 1);
+  }
+  ConcurrentMap<int, int>::MapType result = map.to_map();
+  EXPECT_TRUE(map.is_empty());
+  EXPECT_EQ(result.size(), 1000);
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(result.lookup(i), i + 1);
+  }
+}
+
+TEST(concurrent_set, ParallelAdd)
+{
+  ConcurrentSet<int> set;
+  std::atomic<int> added_num = 0;
+  threading::parallel_for(IndexRange(100000), 1024, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      if (set.add(int(i % 5000))) {
+        added_num++;
+      }
+    }
+  });
+  EXPECT_EQ(added_num, 5000);
+  EXPECT_EQ(set.size(), 5000);
+  EXPECT_TRUE(set.contains(4999));
+  EXPECT_FALSE(set.contains(5000));
+
+  int64_t sum = 0;
+  set.foreach_key([&](const int key) { sum += key; });
+  EXPECT_EQ(sum, 4999 * 5000 / 2);
+
+  ConcurrentSet<int>::SetType result = set.to_set();
+  EXPECT_TRUE(set.is_empty());
+  EXPECT_EQ(result.size(), 5000);
+}
+
+/**
+ * Set this to 1 to activate the benchmark. It is disabled by default, because it prints a lot.
+ */
+#if 0
+static Vector<int> random_keys(const int amount, const int max_key)
+{
+  RandomNumberGenerator rng(0);
+  Vector<int> keys(amount);
+  for (int &key : keys) {
+    key = rng.get_int32(max_key);
+  }
+  return keys;
+}
+
+TEST(concurrent_map, Benchmark)
+{
+  for (const int max_key : {1000, 1000000, 100000000}) {
+    const Vector<int> keys = random_keys(10000000, max_key);
+    std::cout << "Max key: " << max_key << "\n";
+    for (int i = 0; i < 3; i++) {
+      {
+        SCOPED_TIMER("  Map (serial)      ");
+        Map<int, int> map;
+        for (const int key : keys) {
+          map.add(key, key);
+        }
+      }
+      {
+        SCOPED_TIMER("  Map (one mutex)   ");
+        Map<int, int> map;
+        std::mutex mutex;
+        threading::parallel_for(keys.index_range(), 4096, [&](const IndexRange range) {
+          for (const int key : keys.as_span().slice(range)) {
+            std::lock_guard lock{mutex};
+            map.add(key, key);
+          }
+        });
+      }
+      {
+        SCOPED_TIMER("  ConcurrentMap     ");
+        ConcurrentMap<int, int> map;
+        threading::parallel_for(keys.index_range(), 4096, [&](const IndexRange range) {
+          for (const int key : keys.as_span().slice(range)) {
+            map.add(key, key);
+          }
+        });
+      }
+    }
+  }
+}
+
+#endif /* Benchmark */
+
+}  // namespace blender::tests
@@ -0,0 +1,161 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include <zstd.h>
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_filereader.h"
+#include "BLI_rand.hh"
+#include "BLI_task.h"
+#include "BLI_vector.hh"
+
+namespace blender::tests {
+
+/** Deterministic data which compresses somewhat, but not to almost nothing. */
+static Vector<char> create_data(const int64_t size)
+{
+  Vector<char> data(size);
+  RandomNumberGenerator rng(0);
+  for (const int64_t i : data.index_range()) {
+    data[i] = char(i / 64 + rng.get_int32(4));
+  }
+  return data;
+}
+
+static void append_u32(Vector<char> &r_data, const uint32_t value)
+{
+  for (int i = 0; i < 4; i++) {
+    r_data.append(char((value >> (i * 8)) & 0xff));
+  }
+}
+
+/**
+ * Compress the data into one frame per \a frame_size bytes followed by a seek table, like
+ * blend-files are written.
+ */
+static Vector<char> compress_seekable(const Span<char> data, const int64_t frame_size)
+{
+  Vector<char> result;
+  Vector<std::pair<uint32_t, uint32_t>> frame_sizes;
+  for (int64_t start = 0; start < data.size(); start += frame_size) {
+    const int64_t size = std::min(frame_size, data.size() - start);
+    const int64_t offset = result.size();
+    result.resize(offset + ZSTD_compressBound(size));
+    const size_t compressed_size = ZSTD_compress(
+        result.data() + offset, result.size() - offset, data.data() + start, size, 1);
+    EXPECT_FALSE(ZSTD_isError(compressed_size));
+    result.resize(offset + compressed_size);
+    frame_sizes.append({uint32_t(compressed_size), uint32_t(size)});
+  }
+
+  /* Seek table frame, without checksums. */
+  append_u32(result, 0x184D2A5E);
+  append_u32(result, uint32_t(frame_sizes.size() * 8 + 9));
+  for (const std::pair<uint32_t, uint32_t> &sizes : frame_sizes) {
+    append_u32(result, sizes.first);
+    append_u32(result, sizes.second);
+  }
+  append_u32(result, uint32_t(frame_sizes.size()));
+  result.append(0);
+  append_u32(result, 0x8F92EAB1);
+  return result;
+}
+
+class FileReaderZstdTest : public testing::Test {
+ protected:
+  static void SetUpTestSuite()
+  {
+    /* Without this, frames are never prefetched on worker threads. */
+    BLI_task_scheduler_init();
+  }
+
+  FileReader *reader_open(const Span<char> compressed)
+  {
+    FileReader *base = BLI_filereader_new_memory(compressed.data(), compressed.size());
+    FileReader *reader = BLI_filereader_new_zstd(base);
+    EXPECT_NE(reader->seek, nullptr);
+    return reader;
+  }
+
+  static void expect_read(FileReader *reader,
+                          const Span<char> data,
+                          const int64_t offset,
+                          const int64_t size)
+  {
+    Vector<char> buffer(size);
+    ASSERT_EQ(reader->seek(reader, offset, SEEK_SET), offset);
+    ASSERT_EQ(reader->read(reader, buffer.data(), size), size);
+    EXPECT_EQ_ARRAY(data.slice(offset, size).data(), buffer.data(), size);
+  }
+};
+
+TEST_F(FileReaderZstdTest, SequentialRead)
+{
+  const Vector<char> data = create_data(40 * 65536 + 123);
+  const Vector<char> compressed = compress_seekable(data, 65536);
+  FileReader *reader = reader_open(compressed);
+
+  /* Read sizes that don't line up with frames, so that reads span across frames. */
+  const int64_t read_size = 10000;
+  for (int64_t offset = 0; offset < data.size(); offset += read_size) {
+    expect_read(reader, data, offset, std::min(read_size, data.size() - offset));
+  }
+  char end;
+  EXPECT_EQ(reader->read(reader, &end, 1), 0);
+
+  reader->close(reader);
+}
+
+TEST_F(FileReaderZstdTest, RandomAccess)
+{
+  const Vector<char> data = create_data(40 * 65536);
+  const Vector<char> compressed = compress_seekable(data, 65536);
+  FileReader *reader = reader_open(compressed);
+
+  /* Like library linking, read sequentially (which prefetches the following frames) while
+   * jumping back and forth to other regions of the file. */
+  RandomNumberGenerator rng(1);
+  int64_t sequential_offset = 0;
+  for (int i = 0; i < 200; i++) {
+    const int64_t size = rng.get_int32(3 * 65536);
+    if (i % 3 == 0) {
+      const int64_t offset = rng.get_int32(int(data.size() - size));
+      expect_read(reader, data, offset, size);
+    }
+    else {
+      sequential_offset = std::min(sequential_offset, data.size() - size);
+      expect_read(reader, data, sequential_offset, size);
+      sequential_offset = (sequential_offset + size) % data.size();
+    }
+  }
+
+  reader->close(reader);
+}
+
+TEST_F(FileReaderZstdTest, CacheMemoryLimit)
+{
+  /* With large frames, caching the maximum number of frames would use too much memory. */
+  const int64_t frame_size = 8 << 20;
+  const Vector<char> data = create_data(20 * frame_size);
+  const Vector<char> compressed = compress_seekable(data, frame_size);
+
+  const size_t memory_before = MEM_get_memory_in_use();
+  FileReader *reader = reader_open(compressed);
+  const int64_t read_size = 1 << 20;
+  size_t memory_max = 0;
+  for (int64_t offset = 0; offset < data.size(); offset += read_size) {
+    expect_read(reader, data, offset, read_size);
+    memory_max = std::max(memory_max, MEM_get_memory_in_use() - memory_before);
+  }
+  reader->close(reader);
+
+  /* The cache budget (#ZSTD_CACHE_SIZE), with some margin for the reader itself and the read
+   * buffer. */
+  EXPECT_LT(memory_max, size_t(64 + 4) << 20);
+}
+
+}  // namespace blender::tests
@@ -12,6 +12,7 @@
 #include "BLI_kdopbvh.h"
 #include "BLI_math_vector.h"
 #include "BLI_rand.h"
+#include "BLI_timeit.hh"
 
 /* -------------------------------------------------------------------- */
 /* Helper Functions */
@@ -68,11 +69,16 @@ static void optimal_check_callback(void *userdata,
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(
-    int points_len, float scale, int round, int random_seed, bool optimal = false)
+static void find_nearest_points_test(int points_len,
+                                     float scale,
+                                     int round,
+                                     int random_seed,
+                                     bool optimal = false,
+                                     int tree_type = 8,
+                                     int balance_flag = 0)
 {
   RNG *rng = BLI_rng_new(random_seed);
-  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, tree_type, 8);
 
   void *mem = MEM_mallocN(sizeof(float[3]) * points_len, __func__);
   float(*points)[3] = (float(*)[3])mem;
@@ -81,7 +87,7 @@ static void find_nearest_points_test(
     rng_v3_round(points[i], 3, rng, round, scale);
     BLI_bvhtree_insert(tree, i, points[i], 1);
   }
-  BLI_bvhtree_balance(tree);
+  BLI_bvhtree_balance_ex(tree, balance_flag);
 
   /* first find each point */
   BVHTree_NearestPointCallback callback = optimal ? optimal_check_callback : nullptr;
@@ -134,3 +140,218 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+TEST(kdopbvh, SAHFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, 8, BVH_BALANCE_SAH);
+}
+TEST(kdopbvh, FlatFindNearest_1)
+{
+  find_nearest_points_test(1, 1.0, 1000, 1234, false, 4, BVH_BALANCE_SAH | BVH_BALANCE_FLAT);
+}
+TEST(kdopbvh, FlatFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, 4, BVH_BALANCE_SAH | BVH_BALANCE_FLAT);
+}
+TEST(kdopbvh, FlatBinaryFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, 2, BVH_BALANCE_FLAT);
+}
+
+/**
+ * Cast the same rays on trees balanced with and without \a balance_flag,
+ * the boxes are only hit by their bounds so both should find the same distance.
+ */
+static void ray_cast_compare_test(
+    int boxes_len, int rays_len, int random_seed, int tree_type, int balance_flag, float radius)
+{
+  RNG *rng = BLI_rng_new(random_seed);
+  BVHTree *tree_ref = BLI_bvhtree_new(boxes_len, 0.0, tree_type, 6);
+  BVHTree *tree = BLI_bvhtree_new(boxes_len, 0.0, tree_type, 6);
+
+  for (int i = 0; i < boxes_len; i++) {
+    float box[2][3];
+    rng_v3_round(box[0], 3, rng, 1000, 1.0f);
+    copy_v3_v3(box[1], box[0]);
+    add_v3_fl(box[1], 0.01f);
+    BLI_bvhtree_insert(tree_ref, i, box[0], 2);
+    BLI_bvhtree_insert(tree, i, box[0], 2);
+  }
+  BLI_bvhtree_balance(tree_ref);
+  BLI_bvhtree_balance_ex(tree, balance_flag);
+
+  for (int i = 0; i < rays_len; i++) {
+    float co[3], dir[3];
+    rng_v3_round(co, 3, rng, 1000, 2.0f);
+    BLI_rng_get_float_unit_v3(rng, dir);
+
+    BVHTreeRayHit hit_ref = {-1}, hit = {-1};
+    hit_ref.dist = hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree_ref, co, dir, radius, &hit_ref, nullptr, nullptr);
+    BLI_bvhtree_ray_cast(tree, co, dir, radius, &hit, nullptr, nullptr);
+
+    EXPECT_EQ(hit_ref.index == -1, hit.index == -1);
+    EXPECT_EQ(hit_ref.dist, hit.dist);
+  }
+
+  BLI_bvhtree_free(tree_ref);
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, SAHRayCast_1000)
+{
+  ray_cast_compare_test(1000, 1000, 12, 4, BVH_BALANCE_SAH, 0.0f);
+}
+TEST(kdopbvh, FlatRayCast_1)
+{
+  ray_cast_compare_test(1, 100, 1234, 4, BVH_BALANCE_SAH | BVH_BALANCE_FLAT, 0.0f);
+}
+TEST(kdopbvh, FlatRayCast_1000)
+{
+  ray_cast_compare_test(1000, 1000, 12, 4, BVH_BALANCE_SAH | BVH_BALANCE_FLAT, 0.0f);
+}
+TEST(kdopbvh, FlatBinaryRayCast_1000)
+{
+  ray_cast_compare_test(1000, 1000, 12, 2, BVH_BALANCE_SAH | BVH_BALANCE_FLAT, 0.0f);
+}
+TEST(kdopbvh, FlatRayCastRadius_1000)
+{
+  ray_cast_compare_test(1000, 1000, 12, 4, BVH_BALANCE_SAH | BVH_BALANCE_FLAT, 0.05f);
+}
+
+/**
+ * Coherent rays: a grid of origins above the boxes, with similar directions.
+ */
+static void rays_grid(RNG *rng, int rays_len, float (*co)[3], float (*dir)[3])
+{
+  const int grid_len = int(sqrtf(float(rays_len))) + 1;
+  for (int i = 0; i < rays_len; i++) {
+    co[i][0] = float(i % grid_len) / float(grid_len) * 2.0f - 1.0f;
+    co[i][1] = float(i / grid_len) / float(grid_len) * 2.0f - 1.0f;
+    co[i][2] = 2.0f;
+    dir[i][0] = 0.2f + BLI_rng_get_float(rng) * 0.05f;
+    dir[i][1] = 0.1f + BLI_rng_get_float(rng) * 0.05f;
+    dir[i][2] = -1.0f;
+    normalize_v3(dir[i]);
+  }
+}
+
+static BVHTree *boxes_tree_create(RNG *rng, int boxes_len, int tree_type)
+{
+  BVHTree *tree = BLI_bvhtree_new(boxes_len, 0.0, tree_type, 6);
+  for (int i = 0; i < boxes_len; i++) {
+    float box[2][3];
+    rng_v3_round(box[0], 3, rng, 1000, 1.0f);
+    copy_v3_v3(box[1], box[0]);
+    add_v3_fl(box[1], 0.01f);
+    BLI_bvhtree_insert(tree, i, box[0], 2);
+  }
+  BLI_bvhtree_balance(tree);
+  return tree;
+}
+
+static void ray_cast_packet_test(int boxes_len, int rays_len, int tree_type, float radius)
+{
+  RNG *rng = BLI_rng_new(12);
+  BVHTree *tree = boxes_tree_create(rng, boxes_len, tree_type);
+
+  float(*co)[3] = static_cast<float(*)[3]>(MEM_mallocN(sizeof(float[3]) * rays_len, __func__));
+  float(*dir)[3] = static_cast<float(*)[3]>(MEM_mallocN(sizeof(float[3]) * rays_len, __func__));
+  rays_grid(rng, rays_len, co, dir);
+
+  BVHTreeRayHit *hits = static_cast<BVHTreeRayHit *>(
+      MEM_mallocN(sizeof(BVHTreeRayHit) * rays_len, __func__));
+  for (int i = 0; i < rays_len; i++) {
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+  BLI_bvhtree_ray_cast_packet(
+      tree, co, dir, rays_len, radius, hits, nullptr, nullptr, BVH_RAYCAST_DEFAULT);
+
+  for (int i = 0; i < rays_len; i++) {
+    BVHTreeRayHit hit = {-1};
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree, co[i], dir[i], radius, &hit, nullptr, nullptr);
+    EXPECT_EQ(hit.index, hits[i].index);
+    EXPECT_EQ(hit.dist, hits[i].dist);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(co);
+  MEM_freeN(dir);
+  MEM_freeN(hits);
+}
+
+TEST(kdopbvh, RayCastPacket_1)
+{
+  ray_cast_packet_test(1, 100, 4, 0.0f);
+}
+TEST(kdopbvh, RayCastPacket_1000)
+{
+  /* Not a multiple of the packet size. */
+  ray_cast_packet_test(1000, 1003, 4, 0.0f);
+}
+TEST(kdopbvh, RayCastPacketBinary_1000)
+{
+  ray_cast_packet_test(1000, 1003, 2, 0.0f);
+}
+TEST(kdopbvh, RayCastPacketRadius_1000)
+{
+  ray_cast_packet_test(1000, 1003, 4, 0.05f);
+}
+
+/**
+ * Set this to 1 to activate the benchmark. It is disabled by default, because it prints a lot.
+ */
+#if 0
+TEST(kdopbvh, RayCastPacketBenchmark)
+{
+  const int boxes_len = 200000;
+  const int rays_len = 1000000;
+
+  RNG *rng = BLI_rng_new(0);
+  BVHTree *tree = boxes_tree_create(rng, boxes_len, 4);
+
+  float(*co)[3] = static_cast<float(*)[3]>(MEM_mallocN(sizeof(float[3]) * rays_len, __func__));
+  float(*dir)[3] = static_cast<float(*)[3]>(MEM_mallocN(sizeof(float[3]) * rays_len, __func__));
+  rays_grid(rng, rays_len, co, dir);
+
+  BVHTreeRayHit *hits = static_cast<BVHTreeRayHit *>(
+      MEM_mallocN(sizeof(BVHTreeRayHit) * rays_len, __func__));
+
+  for (int iter = 0; iter < 3; iter++) {
+    int hits_num = 0;
+    {
+      SCOPED_TIMER("Single rays");
+      for (int i = 0; i < rays_len; i++) {
+        hits[i].index = -1;
+        hits[i].dist = BVH_RAYCAST_DIST_MAX;
+        BLI_bvhtree_ray_cast(tree, co[i], dir[i], 0.0f, &hits[i], nullptr, nullptr);
+        hits_num += hits[i].index != -1;
+      }
+    }
+    {
+      SCOPED_TIMER("Packets");
+      for (int i = 0; i < rays_len; i++) {
+        hits[i].index = -1;
+        hits[i].dist = BVH_RAYCAST_DIST_MAX;
+      }
+      BLI_bvhtree_ray_cast_packet(
+          tree, co, dir, rays_len, 0.0f, hits, nullptr, nullptr, BVH_RAYCAST_DEFAULT);
+      for (int i = 0; i < rays_len; i++) {
+        hits_num -= hits[i].index != -1;
+      }
+    }
+    /* Print the value for simple error checking and to avoid some compiler optimizations. */
+    std::cout << "Hits difference: " << hits_num << "\n";
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(co);
+  MEM_freeN(dir);
+  MEM_freeN(hits);
+}
+#endif /* Benchmark */
@@ -5,6 +5,7 @@
 #include "testing/testing.h"
 
 #include "BLI_kdtree.h"
+#include "BLI_rand.h"
 
 #include <cmath>
 
@@ -63,3 +64,72 @@ TEST(kdtree, Deduplicate)
 {
   deduplicate_test();
 }
+
+/**
+ * Batched queries should give the same results as single queries,
+ * use enough points to balance and query in parallel.
+ */
+static void batch_test(int tree_size, int queries_len, int nearest_len_capacity)
+{
+  RNG *rng = BLI_rng_new(tree_size);
+  KDTree_3d *tree = BLI_kdtree_3d_new(tree_size);
+  for (int i = 0; i < tree_size; i++) {
+    float co[3];
+    BLI_rng_get_float_unit_v3(rng, co);
+    BLI_kdtree_3d_insert(tree, i, co);
+  }
+  BLI_kdtree_3d_balance(tree);
+
+  float(*co)[3] = new float[queries_len][3];
+  for (int i = 0; i < queries_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, co[i]);
+  }
+
+  KDTreeNearest_3d *nearest = new KDTreeNearest_3d[queries_len * nearest_len_capacity];
+  int *nearest_len = new int[queries_len];
+
+  BLI_kdtree_3d_find_nearest_batch(tree, co, queries_len, nearest);
+  for (int i = 0; i < queries_len; i++) {
+    EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, co[i], nullptr), nearest[i].index);
+  }
+
+  BLI_kdtree_3d_find_nearest_n_batch(
+      tree, co, queries_len, nearest, nearest_len_capacity, nearest_len);
+  KDTreeNearest_3d *nearest_single = new KDTreeNearest_3d[nearest_len_capacity];
+  for (int i = 0; i < queries_len; i++) {
+    const int len = BLI_kdtree_3d_find_nearest_n(
+        tree, co[i], nearest_single, nearest_len_capacity);
+    EXPECT_EQ(len, nearest_len[i]);
+    for (int j = 0; j < len; j++) {
+      EXPECT_EQ(nearest_single[j].index, nearest[i * nearest_len_capacity + j].index);
+    }
+  }
+
+  delete[] nearest_single;
+  delete[] nearest_len;
+  delete[] nearest;
+  delete[] co;
+  BLI_kdtree_3d_free(tree);
+  BLI_rng_free(rng);
+}
+
+TEST(kdtree, BatchEmpty)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(0);
+  BLI_kdtree_3d_balance(tree);
+  float co[1][3] = {{0.0f, 0.0f, 0.0f}};
+  KDTreeNearest_3d nearest;
+  BLI_kdtree_3d_find_nearest_batch(tree, co, 1, &nearest);
+  EXPECT_EQ(nearest.index, -1);
+  BLI_kdtree_3d_free(tree);
+}
+
+TEST(kdtree, BatchSmall)
+{
+  batch_test(100, 50, 4);
+}
+
+TEST(kdtree, BatchLarge)
+{
+  batch_test(100000, 5000, 4);
+}
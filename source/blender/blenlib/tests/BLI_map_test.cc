@@ -711,6 +711,89 @@ TEST(map, Equality)
   EXPECT_NE(a, b);
 }
 
+template<typename Key, typename Value>
+using GroupProbingMap = Map<Key,
+                            Value,
+                            default_inline_buffer_capacity(sizeof(Key) + sizeof(Value)),
+                            GroupProbingStrategy>;
+
+TEST(map, GroupProbing)
+{
+  GroupProbingMap<int, int> map;
+  EXPECT_FALSE(map.contains(0));
+  EXPECT_EQ(map.lookup_ptr(5), nullptr);
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(map.add(i * 3, i));
+  }
+  EXPECT_FALSE(map.add(3, 0));
+  EXPECT_EQ(map.size(), 1000);
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(map.lookup(i * 3), i);
+    EXPECT_FALSE(map.contains(i * 3 + 1));
+  }
+  for (int i = 0; i < 500; i++) {
+    EXPECT_TRUE(map.remove(i * 6));
+  }
+  EXPECT_EQ(map.size(), 500);
+  int64_t sum = 0;
+  for (const int value : map.values()) {
+    EXPECT_EQ(value % 2, 1);
+    sum += value;
+  }
+  EXPECT_EQ(sum, 250000);
+  EXPECT_EQ(map.lookup_or_add(6, -1), -1);
+  EXPECT_EQ(map.lookup_or_add(9, -1), 3);
+}
+
+TEST(map, GroupProbingRemoveAndAddMany)
+{
+  GroupProbingMap<int, int> map;
+  /* Keep the number of keys constant, so that removed slots pile up until the map is rebuilt. */
+  for (int i = 0; i < 10000; i++) {
+    map.add_new(i, i);
+    if (i >= 10) {
+      EXPECT_EQ(map.pop(i - 10), i - 10);
+    }
+  }
+  EXPECT_EQ(map.size(), 10);
+  for (int i = 9990; i < 10000; i++) {
+    EXPECT_EQ(map.lookup(i), i);
+  }
+  EXPECT_FALSE(map.contains(9989));
+}
+
+TEST(map, GroupProbingClearAndMove)
+{
+  GroupProbingMap<std::string, int> map;
+  for (int i = 0; i < 100; i++) {
+    map.add(std::to_string(i), i);
+  }
+  GroupProbingMap<std::string, int> moved_map = std::move(map);
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_FALSE(map.contains("1"));
+  EXPECT_EQ(moved_map.lookup("42"), 42);
+  GroupProbingMap<std::string, int> copied_map = moved_map;
+  moved_map.clear();
+  EXPECT_FALSE(moved_map.contains("42"));
+  moved_map.add("42", 0);
+  EXPECT_EQ(moved_map.lookup("42"), 0);
+  EXPECT_EQ(copied_map.lookup("42"), 42);
+  EXPECT_EQ(copied_map.size(), 100);
+}
+
+TEST(map, GroupProbingPointerKeys)
+{
+  Array<int> values(100);
+  GroupProbingMap<int *, int> map;
+  for (int i = 0; i < 100; i++) {
+    map.add_new(&values[i], i);
+  }
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(map.lookup(&values[i]), i);
+  }
+  EXPECT_FALSE(map.contains(nullptr));
+}
+
 /**
  * Set this to 1 to activate the benchmark. It is disabled by default, because it prints a lot.
  */
@@ -821,6 +904,7 @@ TEST(map, Benchmark)
 {
   for (int i = 0; i < 3; i++) {
     benchmark_random_ints<blender::Map<int, int>>("blender::Map          ", 1000000, 1);
+    benchmark_random_ints<GroupProbingMap<int, int>>("blender::Map (groups) ", 1000000, 1);
     benchmark_random_ints<blender::StdUnorderedMapWrapper<int, int>>(
         "std::unordered_map", 1000000, 1);
   }
@@ -828,6 +912,8 @@ TEST(map, Benchmark)
   for (int i = 0; i < 3; i++) {
     uint32_t factor = (3 << 10);
     benchmark_random_ints<blender::Map<int, int>>("blender::Map          ", 1000000, factor);
+    benchmark_random_ints<GroupProbingMap<int, int>>(
+        "blender::Map (groups) ", 1000000, factor);
     benchmark_random_ints<blender::StdUnorderedMapWrapper<int, int>>(
         "std::unordered_map", 1000000, factor);
   }
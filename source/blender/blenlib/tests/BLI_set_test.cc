@@ -626,6 +626,32 @@ TEST(set, Equality)
   EXPECT_NE(f, a);
 }
 
+TEST(set, GroupProbing)
+{
+  Set<int, 4, GroupProbingStrategy> set;
+  EXPECT_FALSE(set.contains(3));
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(set.add(i * 7));
+  }
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_FALSE(set.add(i * 7));
+  }
+  for (int i = 0; i < 500; i++) {
+    EXPECT_TRUE(set.remove(i * 7));
+  }
+  EXPECT_EQ(set.size(), 500);
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(set.contains(i * 7), i >= 500);
+  }
+  Set<int, 4, GroupProbingStrategy> moved_set = std::move(set);
+  EXPECT_EQ(moved_set.size(), 500);
+  EXPECT_TRUE(set.is_empty());
+  EXPECT_FALSE(set.contains(3500));
+  moved_set.clear();
+  EXPECT_FALSE(moved_set.contains(3500));
+  EXPECT_TRUE(moved_set.add(3500));
+}
+
 /**
  * Set this to 1 to activate the benchmark. It is disabled by default, because it prints a lot.
  */
@@ -0,0 +1,189 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_array_utils.hh"
+#include "BLI_rand.hh"
+#include "BLI_sort.hh"
+#include "BLI_timeit.hh"
+
+#include "BLI_strict_flags.h" /* Keep last. */
+
+namespace blender::tests {
+
+TEST(radix_sort, Empty)
+{
+  Array<int> values;
+  parallel_radix_sort(values.as_mutable_span());
+  EXPECT_TRUE(values.is_empty());
+}
+
+TEST(radix_sort, SmallInt)
+{
+  Array<int> values = {5, -3, 2, 0, std::numeric_limits<int>::min(), 7, -3};
+  parallel_radix_sort(values.as_mutable_span());
+  EXPECT_EQ_ARRAY(
+      values.data(), Span<int>({std::numeric_limits<int>::min(), -3, -3, 0, 2, 5, 7}).data(), 7);
+}
+
+template<typename T> static void test_sort_random(const int size, const uint32_t seed)
+{
+  RandomNumberGenerator rng(seed);
+  Array<T> values(size);
+  for (T &value : values) {
+    const uint64_t bits = (uint64_t(rng.get_uint32()) << 32) | rng.get_uint32();
+    value = T(bits);
+  }
+  Array<T> expected = values;
+  std::sort(expected.begin(), expected.end());
+  parallel_radix_sort(values.as_mutable_span());
+  EXPECT_EQ_ARRAY(values.data(), expected.data(), size_t(size));
+}
+
+TEST(radix_sort, RandomIntegers)
+{
+  for (const int size : {10, 5000, 200000}) {
+    test_sort_random<int32_t>(size, 0);
+    test_sort_random<uint32_t>(size, 1);
+    test_sort_random<int64_t>(size, 2);
+    test_sort_random<uint64_t>(size, 3);
+  }
+}
+
+TEST(radix_sort, SmallRange)
+{
+  /* All upper digits are equal, so most passes are skipped. */
+  RandomNumberGenerator rng(0);
+  Array<int> values(100000);
+  for (int &value : values) {
+    value = rng.get_int32(100);
+  }
+  Array<int> expected = values;
+  std::sort(expected.begin(), expected.end());
+  parallel_radix_sort(values.as_mutable_span());
+  EXPECT_EQ_ARRAY(values.data(), expected.data(), size_t(values.size()));
+}
+
+TEST(radix_sort, Float)
+{
+  for (const int size : {10, 200000}) {
+    RandomNumberGenerator rng(0);
+    Array<float> values(size);
+    for (float &value : values) {
+      value = (rng.get_float() - 0.5f) * 1000.0f;
+    }
+    values[0] = std::numeric_limits<float>::infinity();
+    values[1] = -std::numeric_limits<float>::infinity();
+    values[2] = -0.0f;
+    values[3] = std::numeric_limits<float>::lowest();
+    Array<float> expected = values;
+    std::sort(expected.begin(), expected.end());
+    parallel_radix_sort(values.as_mutable_span());
+    EXPECT_EQ_ARRAY(values.data(), expected.data(), size_t(size));
+    EXPECT_TRUE(std::signbit(values[0]) && std::isinf(values[0]));
+  }
+}
+
+TEST(radix_sort, SignedZero)
+{
+  Array<float> values = {0.0f, -0.0f, 1.0f, -1.0f};
+  parallel_radix_sort(values.as_mutable_span());
+  EXPECT_EQ(values[0], -1.0f);
+  EXPECT_TRUE(std::signbit(values[1]));
+  EXPECT_FALSE(std::signbit(values[2]));
+  EXPECT_EQ(values[3], 1.0f);
+}
+
+TEST(radix_sort, IndicesByKey)
+{
+  for (const int size : {100, 300000}) {
+    RandomNumberGenerator rng(0);
+    Array<int> keys(size);
+    for (int &key : keys) {
+      /* Many duplicates, to check that the sort is stable. */
+      key = rng.get_int32(1000) - 500;
+    }
+    Array<int> indices(size);
+    array_utils::fill_index_range<int>(indices);
+    parallel_radix_sort_indices_by_key(keys.as_span(), indices.as_mutable_span());
+
+    Array<int> expected(size);
+    array_utils::fill_index_range<int>(expected);
+    std::stable_sort(expected.begin(), expected.end(), [&](const int a, const int b) {
+      return keys[a] < keys[b];
+    });
+    EXPECT_EQ_ARRAY(indices.data(), expected.data(), size_t(size));
+  }
+}
+
+TEST(radix_sort, IndicesSubsetByFloatKey)
+{
+  RandomNumberGenerator rng(0);
+  Array<float> keys(500000);
+  for (float &key : keys) {
+    key = rng.get_float();
+  }
+  /* Only sort every third index. */
+  Array<int> indices(keys.size() / 3);
+  for (int i = 0; i < indices.size(); i++) {
+    indices[i] = i * 3;
+  }
+  parallel_radix_sort_indices_by_key(keys.as_span(), indices.as_mutable_span());
+  for (int i = 0; i < indices.size() - 1; i++) {
+    EXPECT_LE(keys[indices[i]], keys[indices[i + 1]]);
+    EXPECT_EQ(indices[i] % 3, 0);
+  }
+}
+
+/**
+ * Set this to 1 to activate the benchmark. It is disabled by default, because it prints a lot.
+ */
+#if 0
+TEST(radix_sort, Benchmark)
+{
+  for (const int size : {100000, 10000000}) {
+    RandomNumberGenerator rng(0);
+    Array<int> keys(size);
+    for (int &key : keys) {
+      key = rng.get_int32(size);
+    }
+    std::cout << "Size: " << size << "\n";
+    for (int i = 0; i < 3; i++) {
+      {
+        Array<int> values = keys;
+        SCOPED_TIMER("  parallel_sort        ");
+        parallel_sort(values.begin(), values.end());
+      }
+      {
+        Array<int> values = keys;
+        SCOPED_TIMER("  parallel_radix_sort  ");
+        parallel_radix_sort(values.as_mutable_span());
+      }
+      {
+        Array<int> indices(size);
+        array_utils::fill_index_range<int>(indices);
+        SCOPED_TIMER("  parallel_sort (by key)");
+        parallel_sort(indices.begin(), indices.end(), [&](const int a, const int b) {
+          return keys[a] < keys[b];
+        });
+      }
+      {
+        Array<int> indices(size);
+        array_utils::fill_index_range<int>(indices);
+        SCOPED_TIMER("  radix sort (by key)   ");
+        parallel_radix_sort_indices_by_key(keys.as_span(), indices.as_mutable_span());
+      }
+    }
+  }
+}
+
+#endif /* Benchmark */
+
+}  // namespace blender::tests
@@ -2,6 +2,11 @@
  *
  * SPDX-License-Identifier: Apache-2.0 */
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
 #include "testing/testing.h"
 
 #include "MEM_guardedalloc.h"
@@ -190,3 +195,99 @@ TEST(task, GraphTaskData)
   EXPECT_EQ(1, data.value);
   EXPECT_EQ(0, data.store);
 }
+
+struct CriticalPathData {
+  /* Order in which the nodes start running. */
+  std::atomic<int> counter = 0;
+  std::vector<int> chain_order;
+};
+
+static void CriticalPathData_leaf(void *taskdata)
+{
+  CriticalPathData *data = (CriticalPathData *)taskdata;
+  data->counter++;
+  /* Keep the threads busy, so that the order in which nodes start matters. */
+  std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+static void CriticalPathData_chain(void *taskdata)
+{
+  CriticalPathData *data = (CriticalPathData *)taskdata;
+  data->chain_order.push_back(data->counter++);
+}
+
+TEST(task, GraphCriticalPath)
+{
+  /* Without this, the graph is run serially and the priorities aren't used. */
+  BLI_task_scheduler_init();
+  if (BLI_task_scheduler_num_threads() <= 1) {
+    GTEST_SKIP() << "Scheduling order can only be tested with multiple threads";
+  }
+
+  const int leaves_num = 200;
+  const int chain_num = 5;
+  CriticalPathData data;
+  TaskGraph *graph = BLI_task_graph_create();
+  TaskNode *root = BLI_task_graph_node_create(graph, CriticalPathData_leaf, &data, nullptr);
+
+  /* One expensive chain and many cheap nodes that depend on the same root. The chain is added
+   * first, without priorities it would start after most cheap nodes because TBB runs the most
+   * recently spawned tasks first. */
+  TaskNode *prev = root;
+  for (int i = 0; i < chain_num; i++) {
+    TaskNode *node = BLI_task_graph_node_create(graph, CriticalPathData_chain, &data, nullptr);
+    BLI_task_graph_node_set_cost(node, 100);
+    BLI_task_graph_edge_create(prev, node);
+    prev = node;
+  }
+  for (int i = 0; i < leaves_num; i++) {
+    TaskNode *leaf = BLI_task_graph_node_create(graph, CriticalPathData_leaf, &data, nullptr);
+    BLI_task_graph_edge_create(root, leaf);
+  }
+
+  EXPECT_TRUE(BLI_task_graph_node_push_work(root));
+  BLI_task_graph_work_and_wait(graph);
+  EXPECT_EQ(data.counter, 1 + leaves_num + chain_num);
+  ASSERT_EQ(data.chain_order.size(), chain_num);
+  /* The chain starts before most of the cheap nodes. */
+  EXPECT_LT(data.chain_order.front(), leaves_num / 2);
+  BLI_task_graph_free(graph);
+}
+
+static void AtomicInt_increase(void *taskdata)
+{
+  std::atomic<int> *value = (std::atomic<int> *)taskdata;
+  (*value)++;
+}
+
+TEST(task, GraphAddAfterPush)
+{
+  std::atomic<int> value_a = 0;
+  std::atomic<int> value_b = 0;
+  std::atomic<int> value_c = 0;
+  TaskGraph *graph = BLI_task_graph_create();
+  TaskNode *node_a = BLI_task_graph_node_create(
+      graph, AtomicInt_increase, &value_a, nullptr);
+  EXPECT_TRUE(BLI_task_graph_node_push_work(node_a));
+  BLI_task_graph_work_and_wait(graph);
+  EXPECT_EQ(value_a, 1);
+
+  /* Nodes and edges that are added after work has been pushed are scheduled too. */
+  TaskNode *node_b = BLI_task_graph_node_create(
+      graph, AtomicInt_increase, &value_b, nullptr);
+  BLI_task_graph_node_set_cost(node_b, 5);
+  BLI_task_graph_edge_create(node_a, node_b);
+  EXPECT_TRUE(BLI_task_graph_node_push_work(node_a));
+  BLI_task_graph_work_and_wait(graph);
+  EXPECT_EQ(value_a, 2);
+  EXPECT_EQ(value_b, 1);
+
+  TaskNode *node_c = BLI_task_graph_node_create(
+      graph, AtomicInt_increase, &value_c, nullptr);
+  EXPECT_TRUE(BLI_task_graph_node_push_work(node_c));
+  BLI_task_graph_work_and_wait(graph);
+  EXPECT_EQ(value_a, 2);
+  EXPECT_EQ(value_b, 1);
+  EXPECT_EQ(value_c, 1);
+  BLI_task_graph_free(graph);
+}
@@ -12,6 +12,7 @@
 
 #include "BLI_utildefines.h"
 
+#include "BLI_array.hh"
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
@@ -234,6 +235,73 @@ TEST(task, MempoolIterTLS)
   BLI_threadapi_exit();
 }
 
+/* *** Parallel allocations from a mempool with thread caches. *** */
+
+TEST(task, MempoolThreadCache)
+{
+  const int items_num = ITEMS_NUM * 10;
+  BLI_mempool *mempool = BLI_mempool_create(
+      sizeof(int), 0, 32, BLI_MEMPOOL_ALLOW_ITER | BLI_MEMPOOL_THREAD_CACHE);
+  blender::Array<int *> data(items_num);
+
+  blender::threading::parallel_for(
+      blender::IndexRange(items_num), 256, [&](const blender::IndexRange range) {
+        BLI_mempool_thread_cache *cache = BLI_mempool_thread_cache_create(mempool);
+        for (const int i : range) {
+          int *elem = (int *)BLI_mempool_thread_cache_alloc(cache);
+          *elem = i;
+          data[i] = elem;
+          if (i % 3 == 0) {
+            BLI_mempool_thread_cache_free(cache, elem);
+            data[i] = nullptr;
+          }
+        }
+        BLI_mempool_thread_cache_destroy(cache);
+      });
+
+  int expected_num = 0;
+  int64_t expected_sum = 0;
+  for (int i = 0; i < items_num; i++) {
+    if (data[i] != nullptr) {
+      EXPECT_EQ(*data[i], i);
+      expected_num++;
+      expected_sum += i;
+    }
+  }
+  EXPECT_EQ(BLI_mempool_len(mempool), expected_num);
+
+  /* Check that freed elements are skipped when iterating. */
+  int64_t sum = 0;
+  BLI_mempool_iter iter;
+  BLI_mempool_iternew(mempool, &iter);
+  while (int *elem = (int *)BLI_mempool_iterstep(&iter)) {
+    sum += *elem;
+  }
+  EXPECT_EQ(sum, expected_sum);
+
+  /* Free in a different order than the elements were allocated, partially without a cache. */
+  blender::threading::parallel_for(
+      blender::IndexRange(items_num), 100, [&](const blender::IndexRange range) {
+        BLI_mempool_thread_cache *cache = BLI_mempool_thread_cache_create(mempool);
+        for (const int i : range) {
+          int *elem = data[items_num - 1 - i];
+          if (elem == nullptr) {
+            continue;
+          }
+          if (i % 2 == 0) {
+            BLI_mempool_thread_cache_free(cache, elem);
+          }
+          else {
+            BLI_mempool_free(mempool, elem);
+          }
+        }
+        BLI_mempool_thread_cache_destroy(cache);
+      });
+  EXPECT_EQ(BLI_mempool_len(mempool), 0);
+
+  BLI_mempool_destroy(mempool);
+}
+
 TEST(task, ParallelInvoke)
 {
   std::atomic<int> counter = 0;
@@ -358,6 +358,34 @@ const blender::ImplicitSharingInfo *BLO_read_shared(
   return shared_data.sharing_info;
 }
 
+blender::ImplicitSharingInfoAndData blo_read_mapped_impl(BlendDataReader *reader,
+                                                         const void *old_address,
+                                                         int64_t size_in_bytes,
+                                                         int64_t alignment);
+
+/**
+ * When reading lazily (see #G_FLAG_READFILE_LAZY_DATA), try to reference the stored array
+ * directly in the memory-mapped blend-file instead of copying it. Meant to be used in the
+ * `read_fn` of #BLO_read_shared, for arrays of trivial types that need no further processing
+ * after reading.
+ *
+ * \return The sharing-info owning the referenced data, in which case `*data_ptr` is updated. If
+ * null, the array could not be referenced and has to be read as usual.
+ */
+template<typename T>
+const blender::ImplicitSharingInfo *BLO_read_mapped(BlendDataReader *reader,
+                                                    T **data_ptr,
+                                                    const int64_t size_in_bytes,
+                                                    const int64_t alignment)
+{
+  blender::ImplicitSharingInfoAndData mapped_data = blo_read_mapped_impl(
+      reader, *data_ptr, size_in_bytes, alignment);
+  if (mapped_data.sharing_info) {
+    *data_ptr = const_cast<T *>(static_cast<const T *>(mapped_data.data));
+  }
+  return mapped_data.sharing_info;
+}
+
 int BLO_read_fileversion_get(BlendDataReader *reader);
 bool BLO_read_requires_endian_switch(BlendDataReader *reader);
 bool BLO_read_data_is_undo(BlendDataReader *reader);
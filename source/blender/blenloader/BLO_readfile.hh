@@ -13,6 +13,7 @@
 
 struct AssetMetaData;
 struct BHead;
+struct BlendFileReadProfile;
 struct BlendHandle;
 struct BlendThumbnail;
 struct FileData;
@@ -138,6 +139,9 @@ struct BlendFileReadReport {
   int resynced_lib_overrides_libraries_count;
   bool do_resynced_lib_overrides_libraries_list;
   LinkNode *resynced_lib_overrides_libraries;
+
+  /** Load-time profiling data, only set while reading with #Global.filepath_read_profile. */
+  BlendFileReadProfile *profile;
 };
 
 /** Skip reading some data-block types (may want to skip screen data too). */
@@ -36,6 +36,12 @@ struct MemFileChunk {
   size_t size;
   /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
   bool is_identical;
+  /**
+   * When true, this chunk doesn't own the memory either, it's shared with a chunk with the same
+   * content found by its #hash. Unlike #is_identical this doesn't mean that the data at this
+   * position is unchanged compared to the previous step.
+   */
+  bool is_shared;
   /** When true, this chunk is also identical to the one in the next step (used by undo code to
    * detect unchanged IDs).
    * Defined when writing the next step (i.e. last undo step has those always false). */
@@ -43,6 +49,13 @@ struct MemFileChunk {
   /** Session UID of the ID being currently written (MAIN_ID_SESSION_UID_UNSET when not writing
    * ID-related data). Used to find matching chunks in previous memundo step. */
   uint id_session_uid;
+  /** Hash of the content of #buf, used to share identical buffers regardless of position. */
+  uint64_t hash;
+  /**
+   * When non-zero, #buf holds zstd compressed data of this size instead of #size bytes of raw
+   * data, see #BLO_memfile_compress. Only chunks owning their buffer get compressed.
+   */
+  size_t compressed_size;
 };
 
 struct MemFile {
@@ -64,6 +77,12 @@ struct MemFileWriteData {
 
   /** Maps an ID session uid to its first reference MemFileChunk, if existing. */
   blender::Map<uint, MemFileChunk *> id_session_uid_mapping;
+  /**
+   * Maps content hashes to chunks of the reference and written memfiles. Only chunks of the
+   * previous step can be shared, so buffers stay owned by a step that is merged into the next
+   * one, see #BLO_memfile_merge.
+   */
+  blender::Map<uint64_t, MemFileChunk *> chunk_hash_mapping;
 };
 
 struct MemFileUndoData {
@@ -108,6 +127,22 @@ void BLO_memfile_merge(MemFile *first, MemFile *second);
  * Clear is_identical_future before adding next memfile.
  */
 void BLO_memfile_clear_future(MemFile *memfile);
+/**
+ * Compress the buffers owned by `memfile` that are not shared with any other chunk, to reduce the
+ * memory used by old undo steps. `next_memfile` is the memfile of the following undo step, the
+ * only one that can share buffers with `memfile`.
+ *
+ * Compressed chunks are decompressed again when the memfile is read or used as reference for
+ * writing a new memfile.
+ */
+void BLO_memfile_compress(MemFile *memfile, const MemFile *next_memfile);
+/**
+ * Decompress all chunks of the memfile, see #BLO_memfile_compress.
+ *
+ * \return False if some chunks could not be decompressed. These stay compressed, and are not
+ * shared with chunks of a new memfile written with this one as reference.
+ */
+bool BLO_memfile_decompress(MemFile *memfile);
 
 /* Utilities. */
 
@@ -43,6 +43,13 @@ struct BlendFileWriteParams {
   uint use_save_as_copy : 1;
   uint use_userdef : 1;
   const BlendThumbnail *thumb;
+  /**
+   * Zstandard compression level when writing with #G_FILE_COMPRESS, zero for the default.
+   * Low levels save faster, high levels give smaller files.
+   */
+  int compress_level;
+  /** Size in bytes of independently compressed chunks, zero for the default (1 MiB). */
+  int compress_chunk_size;
 };
 
 /**
@@ -309,6 +309,12 @@ BlendFileData *BLO_read_from_file(const char *filepath,
   BlendFileData *bfd = nullptr;
   FileData *fd;
 
+  /* Libraries are read as part of this file, so they share its profile. */
+  BlendFileReadProfile *profile = reports->profile ? nullptr : blo_read_profile_begin();
+  if (profile) {
+    reports->profile = profile;
+  }
+
   fd = blo_filedata_from_file(filepath, reports);
   if (fd) {
     fd->skip_flags = skip_flags;
@@ -316,6 +322,11 @@ BlendFileData *BLO_read_from_file(const char *filepath,
     blo_filedata_free(fd);
   }
 
+  if (profile) {
+    reports->profile = nullptr;
+    blo_read_profile_end(profile, filepath);
+  }
+
   return bfd;
 }
 
@@ -6,6 +6,7 @@
  * \ingroup blenloader
  */
 
+#include <atomic>
 #include <cctype> /* for isdigit. */
 #include <cerrno>
 #include <climits>
@@ -50,6 +51,7 @@
 #include "MEM_alloc_string_storage.hh"
 #include "MEM_guardedalloc.h"
 
+#include "BLI_bit_vector.hh"
 #include "BLI_blenlib.h"
 #include "BLI_endian_defines.h"
 #include "BLI_endian_switch.h"
@@ -58,6 +60,8 @@
 #include "BLI_map.hh"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
+#include "BLI_mmap.h"
+#include "BLI_task.hh"
 #include "BLI_threads.h"
 #include "BLI_time.h"
 
@@ -177,6 +181,12 @@
 /** Use #GHash for restoring pointers by name. */
 #define USE_GHASH_RESTORE_POINTER
 
+/**
+ * Decode the data blocks of an ID (endian switching and DNA struct reconstruction) in parallel,
+ * see #read_data_into_datamap_parallel.
+ */
+#define USE_PARALLEL_DATA_DECODE
+
 static CLG_LogRef LOG = {"blo.readfile"};
 static CLG_LogRef LOG_UNDO = {"blo.readfile.undo"};
 
@@ -325,6 +335,16 @@ static void oldnewmap_free(OldNewMap *onm)
   MEM_delete(onm);
 }
 
+/** Clear all data read for the current ID, see #read_data_into_datamap. */
+static void datamap_clear(FileData *fd)
+{
+  oldnewmap_clear(fd->datamap);
+  if (fd->lazymap) {
+    /* Lazy data which was never accessed is simply never read. */
+    fd->lazymap->map.clear();
+  }
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -495,14 +515,14 @@ static bool blo_bhead_is_id_valid_type(const BHead *bhead)
 #ifdef USE_GHASH_BHEAD
 static void read_file_bhead_idname_map_create(FileData *fd)
 {
-  BHead *bhead;
-
   /* dummy values */
   bool is_link = false;
   int code_prev = BLO_CODE_ENDB;
-  uint reserve = 0;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  /* Collect the linkable ID blocks in a single pass over the blocks of the file, libraries with
+   * many assets can have a very large number of data blocks. */
+  blender::Vector<BHead *> link_bheads;
+  for (BHead *bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (code_prev != bhead->code) {
       code_prev = bhead->code;
       is_link = blo_bhead_is_id_valid_type(bhead) ?
@@ -511,25 +531,16 @@ static void read_file_bhead_idname_map_create(FileData *fd)
     }
 
     if (is_link) {
-      reserve += 1;
+      link_bheads.append(bhead);
     }
   }
 
   BLI_assert(fd->bhead_idname_hash == nullptr);
 
-  fd->bhead_idname_hash = BLI_ghash_str_new_ex(__func__, reserve);
+  fd->bhead_idname_hash = BLI_ghash_str_new_ex(__func__, uint(link_bheads.size()));
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
-    if (code_prev != bhead->code) {
-      code_prev = bhead->code;
-      is_link = blo_bhead_is_id_valid_type(bhead) ?
-                    BKE_idtype_idcode_is_linkable(short(code_prev)) :
-                    false;
-    }
-
-    if (is_link) {
-      BLI_ghash_insert(fd->bhead_idname_hash, (void *)blo_bhead_id_name(fd, bhead), bhead);
-    }
+  for (BHead *bhead : link_bheads) {
+    BLI_ghash_insert(fd->bhead_idname_hash, (void *)blo_bhead_id_name(fd, bhead), bhead);
   }
 }
 #endif
@@ -1214,8 +1225,9 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   /* Check if we have a regular file. */
   if (memcmp(header, "BLENDER", sizeof(header)) == 0) {
-    /* Try opening the file with memory-mapped IO. */
-    file = BLI_filereader_new_mmap(filedes);
+    /* Try opening the file with memory-mapped IO. Lazily read data may reference the mapping
+     * directly, which then has to be writable by its owners (without affecting the file). */
+    file = BLI_filereader_new_mmap_ex(filedes, (G.f & G_FLAG_READFILE_LAZY_DATA) != 0);
     if (file == nullptr) {
       /* `mmap` failed, so just keep using `rawfile`. */
       file = rawfile;
@@ -1247,6 +1259,17 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   FileData *fd = filedata_new(reports);
   fd->file = file;
 
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  if ((G.f & G_FLAG_READFILE_LAZY_DATA) && file->seek != nullptr) {
+    fd->lazymap = oldnewmap_new();
+#  ifndef WIN32
+    /* Windows doesn't allow replacing a mapped file, referencing it would prevent saving over
+     * the file that is open. */
+    fd->lazy_mmap = BLI_filereader_mmap_file_get(file);
+#  endif
+  }
+#endif
+
   return fd;
 }
 
@@ -1358,6 +1381,9 @@ void blo_filedata_free(FileData *fd)
     MEM_freeN(new_bhead);
   }
 #endif
+  if (fd->reports && fd->reports->profile && fd->relabase[0] != '\0') {
+    blo_read_profile_file_add(fd->reports->profile, fd->relabase, fd->file->offset);
+  }
   fd->file->close(fd->file);
 
   if (fd->filesdna) {
@@ -1379,6 +1405,9 @@ void blo_filedata_free(FileData *fd)
   if (fd->libmap) {
     oldnewmap_free(fd->libmap);
   }
+  if (fd->lazymap) {
+    oldnewmap_free(fd->lazymap);
+  }
   if (fd->old_idmap_uid != nullptr) {
     BKE_main_idmap_destroy(fd->old_idmap_uid);
   }
@@ -1449,16 +1478,46 @@ short BLO_version_from_file(const char *filepath)
 /** \name Old/New Pointer Map
  * \{ */
 
+/**
+ * Read a data block which was deferred by #read_data_defer, now that it is accessed.
+ * The result is then stored in the #FileData.datamap like for any other data block.
+ */
+static void *read_data_lazy_ensure(FileData *fd, const void *adr, const bool increase_users)
+{
+  const NewAddress *entry = fd->lazymap->map.lookup_ptr(adr);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  BHead *bhead = static_cast<BHead *>(entry->newp);
+  const int id_type_index = entry->nr;
+  fd->lazymap->map.remove(adr);
+
+  void *data = read_struct(fd, bhead, fd->lazy_allocname, id_type_index);
+  if (data == nullptr) {
+    return nullptr;
+  }
+  oldnewmap_insert(fd->datamap, adr, data, increase_users ? 1 : 0);
+  return data;
+}
+
 /* Only direct data-blocks. */
 static void *newdataadr(FileData *fd, const void *adr)
 {
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
+  void *newp = oldnewmap_lookup_and_inc(fd->datamap, adr, true);
+  if (newp == nullptr && adr != nullptr && fd->lazymap != nullptr) {
+    newp = read_data_lazy_ensure(fd, adr, true);
+  }
+  return newp;
 }
 
 /* Only direct data-blocks. */
 static void *newdataadr_no_us(FileData *fd, const void *adr)
 {
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, false);
+  void *newp = oldnewmap_lookup_and_inc(fd->datamap, adr, false);
+  if (newp == nullptr && adr != nullptr && fd->lazymap != nullptr) {
+    newp = read_data_lazy_ensure(fd, adr, false);
+  }
+  return newp;
 }
 
 void *blo_read_get_new_globaldata_address(FileData *fd, const void *adr)
@@ -1791,6 +1850,45 @@ static const char *get_alloc_name(FileData *fd,
 #endif
 }
 
+/* Minimum number and total size of structs in a block to reconstruct them in parallel. */
+#define PARALLEL_RECONSTRUCT_MIN_STRUCTS 4096
+#define PARALLEL_RECONSTRUCT_MIN_SIZE (1 << 18)
+
+/**
+ * Reconstruct the structs of a block in the current DNA (see #DNA_struct_reconstruct). Large
+ * arrays of structs, typically geometry in files from old versions, are reconstructed in
+ * parallel.
+ */
+static void *read_struct_reconstruct(const FileData *fd, const BHead *bh, const char *alloc_name)
+{
+  if (bh->nr < PARALLEL_RECONSTRUCT_MIN_STRUCTS || bh->len < PARALLEL_RECONSTRUCT_MIN_SIZE) {
+    return DNA_struct_reconstruct(fd->reconstruct_info, bh->SDNAnr, bh->nr, (bh + 1), alloc_name);
+  }
+
+  const int new_struct_index = DNA_reconstruct_new_struct_index(fd->reconstruct_info,
+                                                                bh->SDNAnr);
+  if (new_struct_index == -1) {
+    return nullptr;
+  }
+  const int64_t old_size = DNA_struct_size(fd->filesdna, bh->SDNAnr);
+  const int64_t new_size = DNA_struct_size(fd->memsdna, new_struct_index);
+  const int alignment = DNA_struct_alignment(fd->memsdna, new_struct_index);
+
+  const char *old_blocks = reinterpret_cast<const char *>(bh + 1);
+  char *new_blocks = static_cast<char *>(
+      MEM_calloc_arrayN_aligned(size_t(bh->nr), size_t(new_size), alignment, alloc_name));
+  blender::threading::parallel_for(
+      blender::IndexRange(bh->nr), 1024, [&](const blender::IndexRange range) {
+        DNA_struct_reconstruct_into(fd->reconstruct_info,
+                                    bh->SDNAnr,
+                                    new_struct_index,
+                                    int(range.size()),
+                                    old_blocks + range.start() * old_size,
+                                    new_blocks + range.start() * new_size);
+      });
+  return new_blocks;
+}
+
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname, const int id_type_index)
 {
   void *temp = nullptr;
@@ -1826,8 +1924,7 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname, const i
           }
         }
 #endif
-        temp = DNA_struct_reconstruct(
-            fd->reconstruct_info, bh->SDNAnr, bh->nr, (bh + 1), alloc_name);
+        temp = read_struct_reconstruct(fd, bh, alloc_name);
       }
       else {
         /* SDNA_CMP_EQUAL */
@@ -1862,6 +1959,298 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname, const i
   return temp;
 }
 
+/**
+ * Whether the given block needs more than a plain copy to be read, i.e. when it is affected by
+ * endian switching or by differences between the file and the current SDNA.
+ */
+static bool read_struct_needs_decode(const FileData *fd, const BHead *bh)
+{
+  if (bh->len == 0 || fd->compflags[bh->SDNAnr] == SDNA_CMP_REMOVED) {
+    return false;
+  }
+  if (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN)) {
+    return true;
+  }
+  return fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL;
+}
+
+/**
+ * Minimum size (in bytes) of a data block for it to be read lazily, see
+ * #G_FLAG_READFILE_LAZY_DATA.
+ */
+#define LAZY_DATA_MIN_SIZE (1 << 16)
+
+/**
+ * When reading lazily, register large data blocks which would only be copied from the file in
+ * #FileData.lazymap instead of reading them, see #read_data_lazy_ensure and
+ * #blo_read_mapped_impl.
+ *
+ * \return Whether reading the block has been deferred.
+ */
+static bool read_data_defer(FileData *fd,
+                            BHead *bhead,
+                            const char *allocname,
+                            const int id_type_index)
+{
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  if (fd->lazymap == nullptr || bhead->len < LAZY_DATA_MIN_SIZE) {
+    return false;
+  }
+  if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
+    /* Raw arrays are only switched by their reader (e.g. #BLO_read_int32_array), which the
+     * mapped reading bypasses. */
+    return false;
+  }
+  if (BHEADN_FROM_BHEAD(bhead)->has_data) {
+    /* Already in memory, nothing to gain. */
+    return false;
+  }
+  if (fd->compflags[bhead->SDNAnr] == SDNA_CMP_REMOVED || read_struct_needs_decode(fd, bhead)) {
+    return false;
+  }
+  /* All deferred blocks belong to the ID being read, see #datamap_clear. */
+  fd->lazy_allocname = allocname;
+  oldnewmap_insert(fd->lazymap, bhead->old, bhead, id_type_index);
+  return true;
+#else
+  UNUSED_VARS(fd, bhead, allocname, id_type_index);
+  return false;
+#endif
+}
+
+static bool use_parallel_data_decode = true;
+
+void blo_read_parallel_data_decode_set(const bool enable)
+{
+  use_parallel_data_decode = enable;
+}
+
+#ifdef USE_PARALLEL_DATA_DECODE
+
+/**
+ * Minimum accumulated size (in bytes) of the data blocks of an ID which are read in parallel, for
+ * the parallel reading to be used.
+ */
+#  define PARALLEL_DATA_DECODE_MIN_SIZE (1 << 16)
+
+/** How a data block is read by #read_data_into_datamap_parallel. */
+enum class BHeadReadMode : uint8_t {
+  /** Read right away with #read_struct, e.g. because its data is already in memory. */
+  Serial,
+  /** Needs endian switching or DNA reconstruction, done in parallel. */
+  Decode,
+  /** A plain copy from the memory mapped file, done in parallel. */
+  CopyMapped,
+};
+
+/** A single data block of an ID, decoded separately from the file reading itself. */
+struct BHeadDecodeTask {
+  /** The block as stored in the #FileData BHead list, used for the old address. */
+  BHead *bhead;
+  /**
+   * The block holding the file data to decode, either #bhead itself or a temporary copy of it
+   * when its data was not read yet (see #USE_BHEAD_READ_ON_DEMAND).
+   */
+  BHead *bhead_data;
+  BHeadReadMode mode;
+  const char *alloc_name;
+  void *data;
+};
+
+/**
+ * Thread-safe part of #read_struct: only operates on already read data and on the read-only
+ * DNA information of the #FileData.
+ */
+static void *read_struct_decode(const FileData *fd, BHead *bh, const char *alloc_name)
+{
+  if (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN)) {
+    switch_endian_structs(fd->filesdna, bh);
+  }
+  if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+    return read_struct_reconstruct(fd, bh, alloc_name);
+  }
+  const int alignment = DNA_struct_alignment(fd->filesdna, bh->SDNAnr);
+  void *temp = MEM_mallocN_aligned(bh->len, alignment, alloc_name);
+  memcpy(temp, (bh + 1), bh->len);
+  return temp;
+}
+
+#  ifdef USE_BHEAD_READ_ON_DEMAND
+/**
+ * Thread-safe equivalent of #read_struct for blocks which are only copied, reading them from the
+ * memory mapped file directly instead of through the #FileReader.
+ */
+static void *read_struct_copy_mapped(const FileData *fd,
+                                     BLI_mmap_file *mmap,
+                                     const BHead *bh,
+                                     const char *alloc_name)
+{
+  const int alignment = DNA_struct_alignment(fd->filesdna, bh->SDNAnr);
+  void *temp = MEM_mallocN_aligned(bh->len, alignment, alloc_name);
+  if (!BLI_mmap_read(mmap, temp, size_t(BHEADN_FROM_BHEAD(bh)->file_offset), size_t(bh->len))) {
+    MEM_freeN(temp);
+    return nullptr;
+  }
+  return temp;
+}
+#  endif
+
+static BHeadReadMode read_data_parallel_mode(const FileData *fd,
+                                             BLI_mmap_file *mmap,
+                                             const BHead *bh)
+{
+  if (read_struct_needs_decode(fd, bh)) {
+    return BHeadReadMode::Decode;
+  }
+#  ifdef USE_BHEAD_READ_ON_DEMAND
+  if (mmap && bh->len && fd->compflags[bh->SDNAnr] != SDNA_CMP_REMOVED &&
+      BHEADN_FROM_BHEAD(bh)->has_data == false)
+  {
+    return BHeadReadMode::CopyMapped;
+  }
+#  else
+  UNUSED_VARS(mmap);
+#  endif
+  return BHeadReadMode::Serial;
+}
+
+/**
+ * Same as #read_data_into_datamap, but splits the reading of the data blocks in three steps:
+ * - Read the raw data of the blocks which need decoding (serial, since #FileReader is not
+ *   thread-safe).
+ * - Decode the blocks which need it (endian switch, DNA reconstruction) in parallel. Blocks of
+ *   memory mapped files which are only copied (the typical current-version file) are copied
+ *   from the mapping in parallel as well.
+ * - Insert the results into the #FileData.datamap, in file order so that the result is
+ *   deterministic and identical to the serial reading.
+ *
+ * \return The first BHead after the data blocks of the ID. When there is too little data for
+ * parallel reading to be worth it, nothing is read and \a r_is_handled is set to false.
+ */
+static BHead *read_data_into_datamap_parallel(FileData *fd,
+                                              BHead *bhead,
+                                              const char *allocname,
+                                              const int id_type_index,
+                                              bool *r_is_handled)
+{
+  using namespace blender;
+
+  *r_is_handled = false;
+  if (!use_parallel_data_decode) {
+    return nullptr;
+  }
+
+  BLI_mmap_file *mmap = BLI_filereader_mmap_file_get(fd->file);
+
+  /* Quick pre-check to avoid any overhead for IDs with little data. */
+  int64_t parallel_size = 0;
+  int64_t parallel_num = 0;
+  Vector<BHeadReadMode> modes;
+  for (BHead *bh = blo_bhead_next(fd, bhead); bh && bh->code == BLO_CODE_DATA;
+       bh = blo_bhead_next(fd, bh))
+  {
+    const BHeadReadMode mode = read_data_parallel_mode(fd, mmap, bh);
+    modes.append(mode);
+    if (mode != BHeadReadMode::Serial) {
+      parallel_size += bh->len;
+      parallel_num++;
+    }
+  }
+  if (parallel_num < 2 || parallel_size < PARALLEL_DATA_DECODE_MIN_SIZE) {
+    return nullptr;
+  }
+  *r_is_handled = true;
+
+  Vector<BHeadDecodeTask> tasks;
+  tasks.reserve(modes.size());
+  Vector<int64_t> parallel_indices;
+  parallel_indices.reserve(parallel_num);
+
+  bhead = blo_bhead_next(fd, bhead);
+  for (int64_t bhead_index = 0; bhead && bhead->code == BLO_CODE_DATA;
+       bhead = blo_bhead_next(fd, bhead), bhead_index++)
+  {
+    BHeadDecodeTask task{};
+    task.bhead = bhead;
+    task.bhead_data = bhead;
+    task.mode = modes[bhead_index];
+    if (task.mode != BHeadReadMode::Decode) {
+      if (read_data_defer(fd, bhead, allocname, id_type_index)) {
+        continue;
+      }
+    }
+    if (task.mode == BHeadReadMode::Serial) {
+      task.data = read_struct(fd, bhead, allocname, id_type_index);
+      tasks.append(task);
+      continue;
+    }
+#  ifdef USE_BHEAD_READ_ON_DEMAND
+    if (task.mode == BHeadReadMode::Decode && BHEADN_FROM_BHEAD(bhead)->has_data == false) {
+      task.bhead_data = blo_bhead_read_full(fd, bhead);
+      if (UNLIKELY(task.bhead_data == nullptr)) {
+        fd->flags &= ~FD_FLAGS_FILE_OK;
+        continue;
+      }
+    }
+#  endif
+    /* The allocation name storage is thread-local, so it has to be accessed here. */
+    task.alloc_name = get_alloc_name(fd, task.bhead_data, allocname, id_type_index);
+    parallel_indices.append(tasks.size());
+    tasks.append(task);
+  }
+
+  std::atomic<bool> read_failed = false;
+  threading::parallel_for(
+      parallel_indices.index_range(),
+      PARALLEL_DATA_DECODE_MIN_SIZE,
+      [&](const IndexRange range) {
+        for (const int64_t i : range) {
+          BHeadDecodeTask &task = tasks[parallel_indices[i]];
+#  ifdef USE_BHEAD_READ_ON_DEMAND
+          if (task.mode == BHeadReadMode::CopyMapped) {
+            task.data = read_struct_copy_mapped(fd, mmap, task.bhead, task.alloc_name);
+            if (task.data == nullptr) {
+              read_failed = true;
+            }
+            continue;
+          }
+#  endif
+          task.data = read_struct_decode(fd, task.bhead_data, task.alloc_name);
+        }
+      },
+      threading::individual_task_sizes(
+          [&](const int64_t i) { return int64_t(tasks[parallel_indices[i]].bhead->len); },
+          parallel_size));
+  if (read_failed) {
+    fd->flags &= ~FD_FLAGS_FILE_OK;
+  }
+
+  /* The insertion itself stays serial, it is cheap compared to reading the data and keeps the
+   * order of the map independent from the scheduling. */
+  fd->datamap->map.reserve(fd->datamap->map.size() + tasks.size());
+  for (BHeadDecodeTask &task : tasks) {
+#  ifdef USE_BHEAD_READ_ON_DEMAND
+    if (task.bhead_data != task.bhead) {
+      MEM_freeN(BHEADN_FROM_BHEAD(task.bhead_data));
+    }
+#  endif
+    if (task.data == nullptr) {
+      continue;
+    }
+    const bool is_new = oldnewmap_insert(fd->datamap, task.bhead->old, task.data, 0);
+    if (!is_new) {
+      CLOG_ERROR(&LOG,
+                 "Blendfile corruption: Invalid, or multiple `bhead` with same old address "
+                 "value (%p) for a given ID.",
+                 task.bhead->old);
+    }
+  }
+
+  return bhead;
+}
+
+#endif /* USE_PARALLEL_DATA_DECODE */
+
 /* Like read_struct, but gets a pointer without allocating. Only works for
  * undo since DNA must match. */
 static const void *peek_struct_undo(FileData *fd, BHead *bhead)
@@ -2464,9 +2853,25 @@ static BHead *read_data_into_datamap(FileData *fd,
                                      const char *allocname,
                                      const int id_type_index)
 {
+#ifdef USE_PARALLEL_DATA_DECODE
+  /* Undo memfiles always match the current SDNA, no decoding is ever needed. */
+  if ((fd->flags & FD_FLAGS_IS_MEMFILE) == 0) {
+    bool is_handled;
+    BHead *bhead_next = read_data_into_datamap_parallel(
+        fd, bhead, allocname, id_type_index, &is_handled);
+    if (is_handled) {
+      return bhead_next;
+    }
+  }
+#endif
+
   bhead = blo_bhead_next(fd, bhead);
 
   while (bhead && bhead->code == BLO_CODE_DATA) {
+    if (read_data_defer(fd, bhead, allocname, id_type_index)) {
+      bhead = blo_bhead_next(fd, bhead);
+      continue;
+    }
     void *data = read_struct(fd, bhead, allocname, id_type_index);
     if (data) {
       const bool is_new = oldnewmap_insert(fd->datamap, bhead->old, data, 0);
@@ -2858,12 +3263,12 @@ static bool read_libblock_undo_restore(
  * When reading for undo, libraries, linked datablocks and unchanged datablocks
  * will be restored from the old database. Only new or changed datablocks will
  * actually be read. */
-static BHead *read_libblock(FileData *fd,
-                            Main *main,
-                            BHead *bhead,
-                            int id_tag,
-                            const bool placeholder_set_indirect_extern,
-                            ID **r_id)
+static BHead *read_libblock_impl(FileData *fd,
+                                 Main *main,
+                                 BHead *bhead,
+                                 int id_tag,
+                                 const bool placeholder_set_indirect_extern,
+                                 ID **r_id)
 {
   const bool do_partial_undo = (fd->skip_flags & BLO_READ_SKIP_UNDO_OLD_MAIN) == 0;
 
@@ -2958,7 +3363,7 @@ static BHead *read_libblock(FileData *fd,
    * Use convenient malloc name for debugging and better memory link prints. */
   bhead = read_data_into_datamap(fd, bhead, blockname, id_type_index);
   const bool success = direct_link_id(fd, main, id_tag, id, id_old);
-  oldnewmap_clear(fd->datamap);
+  datamap_clear(fd);
 
   if (!success) {
     /* XXX This is probably working OK currently given the very limited scope of that flag.
@@ -2986,6 +3391,40 @@ static BHead *read_libblock(FileData *fd,
   return bhead;
 }
 
+/** Same as #read_libblock_impl, also recording it in the load-time profile when enabled. */
+static BHead *read_libblock(FileData *fd,
+                            Main *main,
+                            BHead *bhead,
+                            int id_tag,
+                            const bool placeholder_set_indirect_extern,
+                            ID **r_id)
+{
+  BlendFileReadProfile *profile = fd->reports ? fd->reports->profile : nullptr;
+  if (profile == nullptr) {
+    return read_libblock_impl(fd, main, bhead, id_tag, placeholder_set_indirect_extern, r_id);
+  }
+
+  const short idcode = bhead->code;
+  const double start_time = BLI_time_now_seconds();
+  const uint memory_blocks = MEM_get_memory_blocks_in_use();
+
+  BHead *bhead_next = read_libblock_impl(
+      fd, main, bhead, id_tag, placeholder_set_indirect_extern, r_id);
+
+  const double duration = BLI_time_now_seconds() - start_time;
+  int64_t bytes = 0;
+  for (BHead *bh = bhead; bh && bh != bhead_next; bh = blo_bhead_next(fd, bh)) {
+    bytes += sizeof(BHead) + bh->len;
+  }
+  blo_read_profile_id_add(profile,
+                          idcode,
+                          duration,
+                          bytes,
+                          int64_t(MEM_get_memory_blocks_in_use()) - int64_t(memory_blocks));
+
+  return bhead_next;
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -3002,7 +3441,7 @@ BHead *blo_read_asset_data_block(FileData *fd, BHead *bhead, AssetMetaData **r_a
   BLO_read_struct(&reader, AssetMetaData, r_asset_data);
   BKE_asset_metadata_read(&reader, *r_asset_data);
 
-  oldnewmap_clear(fd->datamap);
+  datamap_clear(fd);
 
   return bhead;
 }
@@ -3099,6 +3538,55 @@ static void do_versions_userdef(FileData * /*fd*/, BlendFileData *bfd)
   blo_do_versions_userdef(user);
 }
 
+/**
+ * Whether the data of \a main was written by this version of Blender (or a newer one).
+ *
+ * All versioning code is guarded by file version checks, except for a few steps that have to run
+ * on every file load (see #blo_do_versions_280 and #blo_do_versions_400). So such data can skip
+ * the versioning stack almost entirely. Since each library is versioned in its own #Main, this is
+ * tracked for each ID according to the file it was read from.
+ */
+static bool main_version_is_current(const Main *main)
+{
+  return MAIN_VERSION_FILE_ATLEAST(main, BLENDER_FILE_VERSION, BLENDER_FILE_SUBVERSION);
+}
+
+/** Same as #main_version_is_current, also checking all libraries used by \a main. */
+static bool main_and_libraries_version_is_current(const Main *main)
+{
+  if (!main_version_is_current(main)) {
+    return false;
+  }
+  LISTBASE_FOREACH (const Library *, lib, &main->libraries) {
+    if (!LIBRARY_VERSION_FILE_ATLEAST(lib, BLENDER_FILE_VERSION, BLENDER_FILE_SUBVERSION)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Adds the duration of its scope to a versioning step of the read profile, if any. */
+class VersioningProfileScope {
+  BlendFileReadProfile *profile_;
+  const char *name_;
+  double start_time_;
+
+ public:
+  VersioningProfileScope(FileData *fd, const char *name)
+      : profile_(fd->reports ? fd->reports->profile : nullptr),
+        name_(name),
+        start_time_(profile_ ? BLI_time_now_seconds() : 0.0)
+  {
+  }
+
+  ~VersioningProfileScope()
+  {
+    if (profile_) {
+      blo_read_profile_versioning_add(profile_, name_, BLI_time_now_seconds() - start_time_);
+    }
+  }
+};
+
 static void do_versions(FileData *fd, Library *lib, Main *main)
 {
   /* WATCH IT!!!: pointers from libdata have not been converted */
@@ -3127,28 +3615,40 @@ static void do_versions(FileData *fd, Library *lib, Main *main)
               main->build_hash);
   }
 
-  if (!main->is_read_invalid) {
+  /* Only the steps containing versioning code that runs regardless of the file version are needed
+   * for current files. */
+  const bool is_current = main_version_is_current(main);
+
+  if (!main->is_read_invalid && !is_current) {
+    VersioningProfileScope profile_scope(fd, "blo_do_versions_pre250");
     blo_do_versions_pre250(fd, lib, main);
   }
-  if (!main->is_read_invalid) {
+  if (!main->is_read_invalid && !is_current) {
+    VersioningProfileScope profile_scope(fd, "blo_do_versions_250");
     blo_do_versions_250(fd, lib, main);
   }
-  if (!main->is_read_invalid) {
+  if (!main->is_read_invalid && !is_current) {
+    VersioningProfileScope profile_scope(fd, "blo_do_versions_260");
     blo_do_versions_260(fd, lib, main);
   }
-  if (!main->is_read_invalid) {
+  if (!main->is_read_invalid && !is_current) {
+    VersioningProfileScope profile_scope(fd, "blo_do_versions_270");
     blo_do_versions_270(fd, lib, main);
   }
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "blo_do_versions_280");
     blo_do_versions_280(fd, lib, main);
   }
-  if (!main->is_read_invalid) {
+  if (!main->is_read_invalid && !is_current) {
+    VersioningProfileScope profile_scope(fd, "blo_do_versions_290");
     blo_do_versions_290(fd, lib, main);
   }
-  if (!main->is_read_invalid) {
+  if (!main->is_read_invalid && !is_current) {
+    VersioningProfileScope profile_scope(fd, "blo_do_versions_300");
     blo_do_versions_300(fd, lib, main);
   }
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "blo_do_versions_400");
     blo_do_versions_400(fd, lib, main);
   }
 
@@ -3172,28 +3672,41 @@ static void do_versions_after_linking(FileData *fd, Main *main)
             main->versionfile,
             main->subversionfile);
 
+  if (main_version_is_current(main)) {
+    /* None of the steps below contains versioning code that runs regardless of the file
+     * version. */
+    return;
+  }
+
   /* Don't allow versioning to create new data-blocks. */
   main->is_locked_for_linking = true;
 
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "do_versions_after_linking_250");
     do_versions_after_linking_250(main);
   }
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "do_versions_after_linking_260");
     do_versions_after_linking_260(main);
   }
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "do_versions_after_linking_270");
     do_versions_after_linking_270(main);
   }
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "do_versions_after_linking_280");
     do_versions_after_linking_280(fd, main);
   }
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "do_versions_after_linking_290");
     do_versions_after_linking_290(fd, main);
   }
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "do_versions_after_linking_300");
     do_versions_after_linking_300(fd, main);
   }
   if (!main->is_read_invalid) {
+    VersioningProfileScope profile_scope(fd, "do_versions_after_linking_400");
     do_versions_after_linking_400(fd, main);
   }
 
@@ -3441,7 +3954,7 @@ static BHead *read_userdef(BlendFileData *bfd, FileData *fd, BHead *bhead)
   user->edit_studio_light = 0;
 
   /* free fd->datamap again */
-  oldnewmap_clear(fd->datamap);
+  datamap_clear(fd);
 
   return bhead;
 }
@@ -3692,27 +4205,29 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
       /* Note that we can't recompute user-counts at this point in undo case, we play too much with
        * IDs from different memory realms, and Main database is not in a fully valid state yet.
        */
-      /* Some versioning code does expect some proper user-reference-counting, e.g. in conversion
-       * from groups to collections... We could optimize out that first call when we are reading a
-       * current version file, but again this is really not a bottle neck currently.
-       * So not worth it. */
-      BKE_main_id_refcount_recompute(bfd->main, false);
+      /* When the file and all its libraries are current, none of them needs
+       * `do_versions_after_linking()`, see #main_version_is_current. */
+      if (!main_and_libraries_version_is_current(bfd->main)) {
+        /* Some versioning code does expect some proper user-reference-counting, e.g. in
+         * conversion from groups to collections... */
+        BKE_main_id_refcount_recompute(bfd->main, false);
+
+        /* Necessary to allow 2.80 layer collections conversion code to work. */
+        BKE_layer_collection_resync_allow();
+
+        /* Yep, second splitting... but this is a very cheap operation, so no big deal. */
+        blo_split_main(&mainlist, bfd->main);
+        LISTBASE_FOREACH (Main *, mainvar, &mainlist) {
+          BLI_assert(mainvar->versionfile != 0);
+          do_versions_after_linking((mainvar->curlib && mainvar->curlib->runtime.filedata) ?
+                                        mainvar->curlib->runtime.filedata :
+                                        fd,
+                                    mainvar);
+        }
+        blo_join_main(&mainlist);
 
-      /* Necessary to allow 2.80 layer collections conversion code to work. */
-      BKE_layer_collection_resync_allow();
-
-      /* Yep, second splitting... but this is a very cheap operation, so no big deal. */
-      blo_split_main(&mainlist, bfd->main);
-      LISTBASE_FOREACH (Main *, mainvar, &mainlist) {
-        BLI_assert(mainvar->versionfile != 0);
-        do_versions_after_linking((mainvar->curlib && mainvar->curlib->runtime.filedata) ?
-                                      mainvar->curlib->runtime.filedata :
-                                      fd,
-                                  mainvar);
+        BKE_layer_collection_resync_forbid();
       }
-      blo_join_main(&mainlist);
-
-      BKE_layer_collection_resync_forbid();
 
       /* And we have to compute those user-reference-counts again, as `do_versions_after_linking()`
        * does not always properly handle user counts, and/or that function does not take into
@@ -3824,28 +4339,25 @@ static int verg_bheadsort(const void *v1, const void *v2)
 
 static void sort_bhead_old_map(FileData *fd)
 {
-  BHead *bhead;
-  BHeadSort *bhs;
-  int tot = 0;
-
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
-    tot++;
+  /* Only ID pointers are looked up (see #expand_doit_library), so leave out all other blocks.
+   * This keeps the map small for libraries containing many assets. */
+  blender::Vector<BHeadSort> id_bheads;
+  for (BHead *bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+    if (blo_bhead_is_id(bhead)) {
+      id_bheads.append({bhead, bhead->old});
+    }
   }
 
-  fd->tot_bheadmap = tot;
-  if (tot == 0) {
+  fd->tot_bheadmap = int(id_bheads.size());
+  if (id_bheads.is_empty()) {
     return;
   }
 
-  bhs = fd->bheadmap = static_cast<BHeadSort *>(
-      MEM_malloc_arrayN(tot, sizeof(BHeadSort), "BHeadSort"));
-
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead), bhs++) {
-    bhs->bhead = bhead;
-    bhs->old = bhead->old;
-  }
+  fd->bheadmap = static_cast<BHeadSort *>(
+      MEM_malloc_arrayN(id_bheads.size(), sizeof(BHeadSort), "BHeadSort"));
+  memcpy(fd->bheadmap, id_bheads.data(), sizeof(BHeadSort) * id_bheads.size());
 
-  qsort(fd->bheadmap, tot, sizeof(BHeadSort), verg_bheadsort);
+  qsort(fd->bheadmap, fd->tot_bheadmap, sizeof(BHeadSort), verg_bheadsort);
 }
 
 static BHead *find_previous_lib(FileData *fd, BHead *bhead)
@@ -3864,6 +4376,7 @@ static BHead *find_previous_lib(FileData *fd, BHead *bhead)
   return bhead;
 }
 
+/** Find the ID block with the given old address. */
 static BHead *find_bhead(FileData *fd, void *old)
 {
 #if 0
@@ -5085,6 +5598,80 @@ blender::ImplicitSharingInfoAndData blo_read_shared_impl(
   return shared_data;
 }
 
+namespace {
+
+/**
+ * Owns data directly referencing a memory-mapped blend-file, keeping the mapping alive.
+ * The mapping is copy-on-write, so the single owner may still modify the data in place.
+ */
+class MappedDataSharingInfo : public blender::ImplicitSharingInfo {
+ private:
+  BLI_mmap_file *mmap_;
+
+ public:
+  MappedDataSharingInfo(BLI_mmap_file *mmap) : mmap_(mmap)
+  {
+    BLI_mmap_add_user(mmap_);
+  }
+
+  BLI_mmap_file *mmap() const
+  {
+    return mmap_;
+  }
+
+ private:
+  void delete_self_with_data() override
+  {
+    BLI_mmap_free(mmap_);
+    MEM_delete(this);
+  }
+};
+
+}  // namespace
+
+blender::ImplicitSharingInfoAndData blo_read_mapped_impl(BlendDataReader *reader,
+                                                         const void *old_address,
+                                                         const int64_t size_in_bytes,
+                                                         const int64_t alignment)
+{
+  FileData *fd = reader->fd;
+  if (fd->lazy_mmap == nullptr || old_address == nullptr) {
+    return {};
+  }
+  if (BLO_read_requires_endian_switch(reader)) {
+    /* The stored data can't be used as is. */
+    return {};
+  }
+  const NewAddress *entry = fd->lazymap->map.lookup_ptr(old_address);
+  if (entry == nullptr) {
+    return {};
+  }
+  BHead *bhead = static_cast<BHead *>(entry->newp);
+  /* Stored raw data may be padded, but never smaller than what the caller expects. */
+  if (bhead->len < size_in_bytes) {
+    return {};
+  }
+  const char *data = static_cast<const char *>(BLI_mmap_get_pointer(fd->lazy_mmap)) +
+                     BHEADN_FROM_BHEAD(bhead)->file_offset;
+  if ((uintptr_t(data) & uintptr_t(alignment - 1)) != 0) {
+    return {};
+  }
+  fd->lazymap->map.remove(old_address);
+  return {MEM_new<MappedDataSharingInfo>(__func__, fd->lazy_mmap), data};
+}
+
+bool blo_read_data_is_mapped(const blender::ImplicitSharingInfo *sharing_info, const void *data)
+{
+  const MappedDataSharingInfo *mapped_info = dynamic_cast<const MappedDataSharingInfo *>(
+      sharing_info);
+  if (mapped_info == nullptr) {
+    return false;
+  }
+  const char *begin = static_cast<const char *>(BLI_mmap_get_pointer(mapped_info->mmap()));
+  const char *end = begin + BLI_mmap_get_length(mapped_info->mmap());
+  return data >= begin && data < end;
+}
+
 bool BLO_read_data_is_undo(BlendDataReader *reader)
 {
   return (reader->fd->flags & FD_FLAGS_IS_MEMFILE);
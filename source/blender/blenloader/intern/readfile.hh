@@ -22,8 +22,14 @@
 
 #include "BLO_readfile.hh"
 
+namespace blender {
+class ImplicitSharingInfo;
+}
+
+struct BLI_mmap_file;
 struct BlendFileData;
 struct BlendFileReadParams;
+struct BlendFileReadProfile;
 struct BlendFileReadReport;
 struct BLOCacheStorage;
 struct BHeadSort;
@@ -115,6 +121,19 @@ struct FileData {
    */
   OldNewMap *libmap;
 
+  /**
+   * Data blocks of the ID being read, which are only read once they are actually accessed, see
+   * #G_FLAG_READFILE_LAZY_DATA. Maps their old address to their #BHead, with the ID type index
+   * stored as `nr`. Null when not reading lazily.
+   */
+  OldNewMap *lazymap;
+  /**
+   * Memory mapping of the file, when lazily read data can directly reference it (owned by #file).
+   */
+  BLI_mmap_file *lazy_mmap;
+  /** Allocation name of the blocks in #lazymap, used once they are read. */
+  const char *lazy_allocname;
+
   BLOCacheStorage *cache_storage;
 
   BHeadSort *bheadmap;
@@ -153,6 +172,17 @@ struct FileData {
 void blo_join_main(ListBase *mainlist);
 void blo_split_main(ListBase *mainlist, Main *main);
 
+/**
+ * Whether the data blocks of IDs may be read in parallel, enabled by default. Only meant to
+ * compare with the serial reading in tests.
+ */
+void blo_read_parallel_data_decode_set(bool enable);
+/**
+ * Whether \a data directly references a memory-mapped blend-file and is owned by
+ * \a sharing_info, see #BLO_read_mapped. Only meant to be used in tests.
+ */
+bool blo_read_data_is_mapped(const blender::ImplicitSharingInfo *sharing_info, const void *data);
+
 BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath) ATTR_NONNULL(1, 2);
 
 /**
@@ -194,6 +224,25 @@ const char *blo_bhead_id_name(const FileData *fd, const BHead *bhead);
  */
 AssetMetaData *blo_bhead_id_asset_data_address(const FileData *fd, const BHead *bhead);
 
+/* Load-time profiling, see #Global.filepath_read_profile. */
+
+/** Return null when profiling is disabled. */
+BlendFileReadProfile *blo_read_profile_begin();
+/** Write the JSON report for the read of \a filepath, and free the profile. */
+void blo_read_profile_end(BlendFileReadProfile *profile, const char *filepath) ATTR_NONNULL(1, 2);
+void blo_read_profile_id_add(BlendFileReadProfile *profile,
+                             short idcode,
+                             double duration,
+                             int64_t bytes,
+                             int64_t memory_blocks) ATTR_NONNULL(1);
+/** \a name must be a static string. */
+void blo_read_profile_versioning_add(BlendFileReadProfile *profile,
+                                     const char *name,
+                                     double duration) ATTR_NONNULL(1, 2);
+void blo_read_profile_file_add(BlendFileReadProfile *profile,
+                               const char *filepath,
+                               int64_t stream_bytes) ATTR_NONNULL(1, 2);
+
 /* do versions stuff */
 
 /**
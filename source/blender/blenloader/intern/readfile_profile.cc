@@ -0,0 +1,165 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup blenloader
+ *
+ * Optional load-time profiling of blend-file reading, written as a JSON report.
+ * See the `--profile-file-read` command line argument.
+ */
+
+#include <string>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
+#include "BLI_fileops.h"
+#include "BLI_serialize.hh"
+#include "BLI_string.h"
+#include "BLI_time.h"
+#include "BLI_vector.hh"
+
+#include "BKE_global.hh"
+#include "BKE_idtype.hh"
+
+#include "DNA_ID.h"
+
+#include "BLO_readfile.hh"
+
+#include "readfile.hh"
+
+#include "CLG_log.h"
+
+static CLG_LogRef LOG = {"blo.readfile.profile"};
+
+namespace serialize = blender::io::serialize;
+
+struct BlendFileReadProfile {
+  struct IDTypeStats {
+    int64_t count = 0;
+    double duration = 0.0;
+    /** Size of the read blocks (ID and its data), headers included. */
+    int64_t bytes = 0;
+    /** Net number of memory blocks allocated while reading. */
+    int64_t memory_blocks = 0;
+  };
+
+  struct VersioningStats {
+    const char *name;
+    int64_t count = 0;
+    double duration = 0.0;
+  };
+
+  struct FileStats {
+    std::string filepath;
+    /** Size of the file on disk. */
+    int64_t file_size = 0;
+    /** Bytes read from the (possibly decompressed) file stream. */
+    int64_t stream_bytes = 0;
+  };
+
+  double start_time = 0.0;
+
+  /** Indexed by ID type index, the last item is used for linked placeholders. */
+  blender::Array<IDTypeStats> id_types{INDEX_ID_MAX + 1};
+  blender::Vector<VersioningStats> versioning;
+  blender::Vector<FileStats> files;
+};
+
+BlendFileReadProfile *blo_read_profile_begin()
+{
+  if (G.filepath_read_profile[0] == '\0') {
+    return nullptr;
+  }
+  BlendFileReadProfile *profile = MEM_new<BlendFileReadProfile>(__func__);
+  profile->start_time = BLI_time_now_seconds();
+  return profile;
+}
+
+void blo_read_profile_id_add(BlendFileReadProfile *profile,
+                             const short idcode,
+                             const double duration,
+                             const int64_t bytes,
+                             const int64_t memory_blocks)
+{
+  const int index = BKE_idtype_idcode_to_index(idcode);
+  BlendFileReadProfile::IDTypeStats &stats = profile->id_types[index >= 0 ? index : INDEX_ID_MAX];
+  stats.count++;
+  stats.duration += duration;
+  stats.bytes += bytes;
+  stats.memory_blocks += memory_blocks;
+}
+
+void blo_read_profile_versioning_add(BlendFileReadProfile *profile,
+                                     const char *name,
+                                     const double duration)
+{
+  /* Only a handful of steps, a linear search keeps them in execution order. */
+  for (BlendFileReadProfile::VersioningStats &stats : profile->versioning) {
+    if (STREQ(stats.name, name)) {
+      stats.count++;
+      stats.duration += duration;
+      return;
+    }
+  }
+  profile->versioning.append({name, 1, duration});
+}
+
+void blo_read_profile_file_add(BlendFileReadProfile *profile,
+                               const char *filepath,
+                               const int64_t stream_bytes)
+{
+  BlendFileReadProfile::FileStats stats;
+  stats.filepath = filepath;
+  stats.file_size = BLI_file_size(filepath);
+  stats.stream_bytes = stream_bytes;
+  profile->files.append(std::move(stats));
+}
+
+void blo_read_profile_end(BlendFileReadProfile *profile, const char *filepath)
+{
+  const double duration = BLI_time_now_seconds() - profile->start_time;
+
+  serialize::DictionaryValue root;
+  root.append_str("filepath", filepath);
+  root.append_double("duration", duration);
+
+  serialize::ArrayValue &files = *root.append_array("files");
+  for (const BlendFileReadProfile::FileStats &stats : profile->files) {
+    serialize::DictionaryValue &file = *files.append_dict();
+    file.append_str("filepath", stats.filepath);
+    file.append_int("file_size", stats.file_size);
+    file.append_int("stream_bytes", stats.stream_bytes);
+  }
+
+  serialize::ArrayValue &id_types = *root.append_array("id_types");
+  for (const int index : profile->id_types.index_range()) {
+    const BlendFileReadProfile::IDTypeStats &stats = profile->id_types[index];
+    if (stats.count == 0) {
+      continue;
+    }
+    serialize::DictionaryValue &id_type = *id_types.append_dict();
+    id_type.append_str("name",
+                       index < INDEX_ID_MAX ?
+                           BKE_idtype_idcode_to_name(BKE_idtype_index_to_idcode(index)) :
+                           "LinkPlaceholder");
+    id_type.append_int("count", stats.count);
+    id_type.append_double("duration", stats.duration);
+    id_type.append_int("bytes", stats.bytes);
+    id_type.append_int("memory_blocks", stats.memory_blocks);
+  }
+
+  serialize::ArrayValue &versioning = *root.append_array("versioning");
+  for (const BlendFileReadProfile::VersioningStats &stats : profile->versioning) {
+    serialize::DictionaryValue &step = *versioning.append_dict();
+    step.append_str("name", stats.name);
+    step.append_int("count", stats.count);
+    step.append_double("duration", stats.duration);
+  }
+
+  serialize::write_json_file(G.filepath_read_profile, root);
+  CLOG_INFO(&LOG, 0, "Wrote read profile of '%s' to '%s'", filepath, G.filepath_read_profile);
+
+  MEM_delete(profile);
+}
@@ -26,6 +26,12 @@
 
 #include "BLI_blenlib.h"
 #include "BLI_implicit_sharing.hh"
+#include "BLI_set.hh"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
+
+#include <xxhash.h>
+#include <zstd.h>
 
 #include "BLO_readfile.hh"
 #include "BLO_undofile.hh"
@@ -38,10 +44,15 @@
 
 /* **************** support for memory-write, for undo buffers *************** */
 
+static bool memfile_chunk_owns_buffer(const MemFileChunk *chunk)
+{
+  return !(chunk->is_identical || chunk->is_shared);
+}
+
 void BLO_memfile_free(MemFile *memfile)
 {
   while (MemFileChunk *chunk = static_cast<MemFileChunk *>(BLI_pophead(&memfile->chunks))) {
-    if (chunk->is_identical == false) {
+    if (memfile_chunk_owns_buffer(chunk)) {
       MEM_freeN((void *)chunk->buf);
     }
     MEM_freeN(chunk);
@@ -67,7 +78,7 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
 
   /* First, detect all memchunks in second memfile that are not owned by it. */
   LISTBASE_FOREACH (MemFileChunk *, sc, &second->chunks) {
-    if (sc->is_identical) {
+    if (!memfile_chunk_owns_buffer(sc)) {
       buffer_to_second_memchunk.add(sc->buf, sc);
     }
   }
@@ -75,10 +86,11 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
   /* Now, check all chunks from first memfile (the one we are removing), and if a memchunk owned by
    * it is also used by the second memfile, transfer the ownership. */
   LISTBASE_FOREACH (MemFileChunk *, fc, &first->chunks) {
-    if (!fc->is_identical) {
+    if (memfile_chunk_owns_buffer(fc)) {
       if (MemFileChunk *sc = buffer_to_second_memchunk.lookup_default(fc->buf, nullptr)) {
-        BLI_assert(sc->is_identical);
+        BLI_assert(!memfile_chunk_owns_buffer(sc));
         sc->is_identical = false;
+        sc->is_shared = false;
         fc->is_identical = true;
       }
       /* Note that if the second memfile does not use that chunk, we assume that the first one
@@ -97,10 +109,101 @@ void BLO_memfile_clear_future(MemFile *memfile)
   }
 }
 
+/* Favor speed, undo pushes should stay interactive. */
+#define MEMFILE_COMPRESSION_LEVEL 1
+
+void BLO_memfile_compress(MemFile *memfile, const MemFile *next_memfile)
+{
+  /* Buffers that are also used by other chunks cannot be compressed, since these read them
+   * directly. Only the next memfile and the memfile itself can share buffers of this one. */
+  blender::Set<const char *> shared_buffers;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &next_memfile->chunks) {
+    if (!memfile_chunk_owns_buffer(chunk)) {
+      shared_buffers.add(chunk->buf);
+    }
+  }
+  blender::Vector<MemFileChunk *> chunks;
+  LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+    if (!memfile_chunk_owns_buffer(chunk)) {
+      shared_buffers.add(chunk->buf);
+    }
+  }
+  LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+    if (memfile_chunk_owns_buffer(chunk) && chunk->compressed_size == 0 &&
+        !shared_buffers.contains(chunk->buf))
+    {
+      chunks.append(chunk);
+    }
+  }
+
+  blender::threading::parallel_for(chunks.index_range(), 8, [&](const blender::IndexRange range) {
+    for (MemFileChunk *chunk : chunks.as_mutable_span().slice(range)) {
+      const size_t bound = ZSTD_compressBound(chunk->size);
+      void *compressed = MEM_mallocN(bound, "Chunk buffer compressed");
+      const size_t compressed_size = ZSTD_compress(
+          compressed, bound, chunk->buf, chunk->size, MEMFILE_COMPRESSION_LEVEL);
+      if (ZSTD_isError(compressed_size) || compressed_size >= chunk->size) {
+        MEM_freeN(compressed);
+        continue;
+      }
+      MEM_freeN((void *)chunk->buf);
+      chunk->buf = static_cast<const char *>(MEM_reallocN(compressed, compressed_size));
+      chunk->compressed_size = compressed_size;
+    }
+  });
+
+  for (const MemFileChunk *chunk : chunks) {
+    if (chunk->compressed_size != 0) {
+      memfile->size -= chunk->size - chunk->compressed_size;
+    }
+  }
+}
+
+static bool memfile_chunk_decompress(MemFile *memfile, MemFileChunk *chunk)
+{
+  BLI_assert(chunk->compressed_size != 0);
+  char *buf_new = static_cast<char *>(MEM_mallocN(chunk->size, "Chunk buffer"));
+  const size_t size = ZSTD_decompress(buf_new, chunk->size, chunk->buf, chunk->compressed_size);
+  if (ZSTD_isError(size) || size != chunk->size) {
+    MEM_freeN(buf_new);
+    return false;
+  }
+  MEM_freeN((void *)chunk->buf);
+  chunk->buf = buf_new;
+  memfile->size += chunk->size - chunk->compressed_size;
+  chunk->compressed_size = 0;
+  return true;
+}
+
+bool BLO_memfile_decompress(MemFile *memfile)
+{
+  bool success = true;
+  LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+    if (chunk->compressed_size != 0 && !memfile_chunk_decompress(memfile, chunk)) {
+      success = false;
+    }
+  }
+  return success;
+}
+
+/** Whether the raw data of the chunk is available, so it can be compared with new chunks. */
+static bool memfile_chunk_is_shareable(const MemFileChunk *chunk)
+{
+  return chunk->compressed_size == 0;
+}
+
 void BLO_memfile_write_init(MemFileWriteData *mem_data,
                             MemFile *written_memfile,
                             MemFile *reference_memfile)
 {
+  if (reference_memfile != nullptr) {
+    /* Chunks are compared with the reference data directly. Chunks which failed to decompress
+     * are never shared, see #memfile_chunk_is_shareable. */
+    if (!BLO_memfile_decompress(reference_memfile)) {
+      printf("%s: failed to decompress undo memory, it won't be shared\n", __func__);
+    }
+  }
+
   mem_data->written_memfile = written_memfile;
   mem_data->reference_memfile = reference_memfile;
   mem_data->reference_current_chunk = reference_memfile ? static_cast<MemFileChunk *>(
@@ -119,6 +222,9 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
         current_session_uid = mem_chunk->id_session_uid;
         mem_data->id_session_uid_mapping.add_new(current_session_uid, mem_chunk);
       }
+      if (memfile_chunk_is_shareable(mem_chunk)) {
+        mem_data->chunk_hash_mapping.add(mem_chunk->hash, mem_chunk);
+      }
     }
   }
 }
@@ -126,6 +232,7 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
 void BLO_memfile_write_finalize(MemFileWriteData *mem_data)
 {
   mem_data->id_session_uid_mapping.clear_and_shrink();
+  mem_data->chunk_hash_mapping.clear_and_shrink();
 }
 
 void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t size)
@@ -138,6 +245,9 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
   curchunk->size = size;
   curchunk->buf = nullptr;
   curchunk->is_identical = false;
+  curchunk->is_shared = false;
+  curchunk->hash = XXH3_64bits(buf, size);
+  curchunk->compressed_size = 0;
   /* This is unsafe in the sense that an app handler or other code that does not
    * perform an undo push may make changes after the last undo push that
    * will then not be undo. Though it's not entirely clear that is wrong behavior. */
@@ -148,7 +258,9 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
   /* we compare compchunk with buf */
   if (*compchunk_step != nullptr) {
     MemFileChunk *compchunk = *compchunk_step;
-    if (compchunk->size == curchunk->size) {
+    if (compchunk->size == curchunk->size && compchunk->hash == curchunk->hash &&
+        memfile_chunk_is_shareable(compchunk))
+    {
       if (memcmp(compchunk->buf, buf, size) == 0) {
         curchunk->buf = compchunk->buf;
         curchunk->is_identical = true;
@@ -158,6 +270,19 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
     *compchunk_step = static_cast<MemFileChunk *>(compchunk->next);
   }
 
+  /* Not equal, but the same content may still exist elsewhere (e.g. when IDs were added or
+   * re-ordered, or when data is shifted within an ID). */
+  if (curchunk->buf == nullptr) {
+    if (const MemFileChunk *hashchunk = mem_data->chunk_hash_mapping.lookup_default(curchunk->hash,
+                                                                                      nullptr))
+    {
+      if (hashchunk->size == size && memcmp(hashchunk->buf, buf, size) == 0) {
+        curchunk->buf = hashchunk->buf;
+        curchunk->is_shared = true;
+      }
+    }
+  }
+
   /* not equal... */
   if (curchunk->buf == nullptr) {
     char *buf_new = static_cast<char *>(MEM_mallocN(size, "Chunk buffer"));
@@ -165,6 +290,8 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
     curchunk->buf = buf_new;
     memfile->size += size;
   }
+
+  mem_data->chunk_hash_mapping.add(curchunk->hash, curchunk);
 }
 
 Main *BLO_memfile_main_get(MemFile *memfile, Main *bmain, Scene **r_scene)
@@ -232,6 +359,12 @@ static int64_t undo_read(FileReader *reader, void *buffer, size_t size)
         return 0;
       }
 
+      /* Old undo steps may be compressed, see #BLO_memfile_compress. */
+      if (chunk->compressed_size != 0 && !memfile_chunk_decompress(undo->memfile, chunk)) {
+        printf("illegal read, chunk decompression failed\n");
+        return 0;
+      }
+
       chunkoffset = seek - offset;
       readsize = size - totread;
 
@@ -98,6 +98,7 @@
 #include "BLI_mempool.h"
 #include "BLI_set.hh"
 #include "BLI_threads.h"
+#include "BLI_time.h"
 
 #include "MEM_guardedalloc.h" /* MEM_freeN */
 
@@ -144,6 +145,11 @@
 #define ZSTD_BUFFER_SIZE (1 << 21) /* 2mb */
 #define ZSTD_CHUNK_SIZE (1 << 20)  /* 1mb */
 
+/* Range of #BlendFileWriteParams.compress_chunk_size, the seek table stores 32 bit frame sizes
+ * and small frames compress badly. */
+#define ZSTD_CHUNK_SIZE_MIN (1 << 16) /* 64kb */
+#define ZSTD_CHUNK_SIZE_MAX (1 << 26) /* 64mb */
+
 #define ZSTD_COMPRESSION_LEVEL 3
 
 static CLG_LogRef LOG = {"blo.writefile"};
@@ -170,6 +176,8 @@ class WriteWrap {
 
   /** Buffer output (we only want when output isn't already buffered). */
   bool use_buf = true;
+  /** Size of the chunks passed to #write when buffering, see #WriteData.buffer. */
+  size_t chunk_size = ZSTD_CHUNK_SIZE;
 };
 
 class RawWriteWrap : public WriteWrap {
@@ -218,8 +226,28 @@ class ZstdWriteWrap : public WriteWrap {
 
   bool write_error = false;
 
+  int compression_level = ZSTD_COMPRESSION_LEVEL;
+  int num_threads = 1;
+
+  /* Statistics, reported when closing. */
+  double time_start = 0.0;
+  size_t uncompressed_size_total = 0;
+  size_t compressed_size_total = 0;
+
  public:
-  ZstdWriteWrap(WriteWrap &base_wrap) : base_wrap(base_wrap) {}
+  ZstdWriteWrap(WriteWrap &base_wrap, const BlendFileWriteParams *params) : base_wrap(base_wrap)
+  {
+    if (params) {
+      if (params->compress_level != 0) {
+        compression_level = clamp_i(
+            params->compress_level, ZSTD_minCLevel(), ZSTD_maxCLevel());
+      }
+      if (params->compress_chunk_size != 0) {
+        chunk_size = clamp_i(
+            params->compress_chunk_size, ZSTD_CHUNK_SIZE_MIN, ZSTD_CHUNK_SIZE_MAX);
+      }
+    }
+  }
 
   bool open(const char *filepath) override;
   bool close() override;
@@ -252,7 +280,7 @@ void ZstdWriteWrap::write_task(ZstdWriteBlockTask *task)
   size_t out_buf_len = ZSTD_compressBound(task->size);
   void *out_buf = MEM_mallocN(out_buf_len, "Zstd out buffer");
   size_t out_size = ZSTD_compress(
-      out_buf, out_buf_len, task->data, task->size, ZSTD_COMPRESSION_LEVEL);
+      out_buf, out_buf_len, task->data, task->size, compression_level);
 
   MEM_freeN(task->data);
 
@@ -272,6 +300,8 @@ void ZstdWriteWrap::write_task(ZstdWriteBlockTask *task)
       frameinfo->uncompressed_size = task->size;
       frameinfo->compressed_size = out_size;
       BLI_addtail(&frames, frameinfo);
+      uncompressed_size_total += task->size;
+      compressed_size_total += out_size;
     }
     else {
       write_error = true;
@@ -292,12 +322,16 @@ bool ZstdWriteWrap::open(const char *filepath)
     return false;
   }
 
-  /* Leave one thread open for the main writing logic, unless we only have one HW thread. */
-  int num_threads = max_ii(1, BLI_system_thread_count() - 1);
+  /* Leave one thread open for the main writing logic, unless we only have one HW thread.
+   * The number of threads also bounds the number of chunks held in memory, since writing waits
+   * for the oldest chunk when all threads are busy. */
+  num_threads = max_ii(1, BLI_system_thread_count() - 1);
   BLI_threadpool_init(&threadpool, ZstdWriteBlockTask::write_task, num_threads);
   BLI_mutex_init(&mutex);
   BLI_condition_init(&condition);
 
+  time_start = BLI_time_now_seconds();
+
   return true;
 }
 
@@ -353,6 +387,20 @@ bool ZstdWriteWrap::close()
   write_seekable_frames();
   BLI_freelistN(&frames);
 
+  const double duration = BLI_time_now_seconds() - time_start;
+  CLOG_INFO(&LOG,
+            1,
+            "Compressed %.2f MiB to %.2f MiB in %.3fs (%.1f MiB/s, level %d, %d KiB chunks, "
+            "%d threads)",
+            double(uncompressed_size_total) / (1024.0 * 1024.0),
+            double(compressed_size_total) / (1024.0 * 1024.0),
+            duration,
+            duration > 0.0 ? double(uncompressed_size_total) / (1024.0 * 1024.0) / duration :
+                             0.0,
+            compression_level,
+            int(chunk_size / 1024),
+            num_threads);
+
   return base_wrap.close() && !write_error;
 }
 
@@ -473,8 +521,8 @@ static WriteData *writedata_new(WriteWrap *ww)
       wd->buffer.chunk_size = MEM_CHUNK_SIZE;
     }
     else {
-      wd->buffer.max_size = ZSTD_BUFFER_SIZE;
-      wd->buffer.chunk_size = ZSTD_CHUNK_SIZE;
+      wd->buffer.max_size = max_zz(ZSTD_BUFFER_SIZE, ww->chunk_size * 2);
+      wd->buffer.chunk_size = ww->chunk_size;
     }
     wd->buffer.buf = static_cast<uchar *>(MEM_mallocN(wd->buffer.max_size, "wd->buffer.buf"));
   }
@@ -1764,7 +1812,7 @@ bool BLO_write_file(Main *mainvar,
   RawWriteWrap raw_wrap;
 
   if (write_flags & G_FILE_COMPRESS) {
-    ZstdWriteWrap zstd_wrap(raw_wrap);
+    ZstdWriteWrap zstd_wrap(raw_wrap, params);
     return BLO_write_file_impl(mainvar, filepath, write_flags, params, reports, zstd_wrap);
   }
 
@@ -0,0 +1,286 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#include "blendfile_loading_base_test.h"
+
+#include <cstring>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
+#include "BLI_endian_defines.h"
+#include "BLI_endian_switch.h"
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_span.hh"
+#include "BLI_string.h"
+#include "BLI_system.h"
+#include "BLI_tempfile.h"
+#include BLI_SYSTEM_PID_H
+
+#include "BKE_customdata.hh"
+#include "BKE_global.hh"
+#include "BKE_lib_id.hh"
+#include "BKE_main.hh"
+#include "BKE_mesh.hh"
+#include "BKE_mesh_types.hh"
+
+#include "BLO_blend_defs.hh"
+#include "BLO_readfile.hh"
+#include "BLO_writefile.hh"
+
+#include "DNA_genfile.h"
+#include "DNA_mesh_types.h"
+#include "DNA_sdna_types.h"
+
+#include "intern/readfile.hh"
+
+namespace blender::blenloader::tests {
+
+/** Enough faces for the face offsets to be read lazily. */
+static constexpr int faces_num = 1 << 15;
+
+class BlendfileLazyDataTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath_[FILE_MAX];
+
+  void SetUp() override
+  {
+    char temp_dir[FILE_MAX];
+    BLI_temp_directory_path_get(temp_dir, sizeof(temp_dir));
+    /* Unique per test and process, so that tests running concurrently don't share the file. */
+    const ::testing::TestInfo *test_info =
+        ::testing::UnitTest::GetInstance()->current_test_info();
+    char filename[FILE_MAXFILE];
+    SNPRINTF(filename, "blendfile_lazy_data_test_%s_%d.blend", test_info->name(), getpid());
+    BLI_path_join(filepath_, sizeof(filepath_), temp_dir, filename);
+  }
+
+  void TearDown() override
+  {
+    G.f &= ~G_FLAG_READFILE_LAZY_DATA;
+    BLI_delete(filepath_, false, false);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  /** Write a file containing a single mesh with many separate triangles. */
+  bool write_mesh_file()
+  {
+    Main *bmain = BKE_main_new();
+    Mesh *mesh = BKE_mesh_add(bmain, "Mesh");
+    id_fake_user_set(&mesh->id);
+
+    Mesh *mesh_src = BKE_mesh_new_nomain(faces_num * 3, faces_num * 3, faces_num, faces_num * 3);
+    MutableSpan<float3> positions = mesh_src->vert_positions_for_write();
+    MutableSpan<int2> edges = mesh_src->edges_for_write();
+    MutableSpan<int> face_offsets = mesh_src->face_offsets_for_write();
+    MutableSpan<int> corner_verts = mesh_src->corner_verts_for_write();
+    MutableSpan<int> corner_edges = mesh_src->corner_edges_for_write();
+    for (const int face : IndexRange(faces_num)) {
+      face_offsets[face] = face * 3;
+      for (const int i : IndexRange(3)) {
+        const int corner = face * 3 + i;
+        positions[corner] = float3(face, i, corner);
+        edges[corner] = int2(corner, face * 3 + (i + 1) % 3);
+        corner_verts[corner] = corner;
+        corner_edges[corner] = corner;
+      }
+    }
+    face_offsets.last() = faces_num * 3;
+    BKE_mesh_nomain_to_mesh(mesh_src, mesh, nullptr);
+
+    BlendFileWriteParams params{};
+    params.remap_mode = BLO_WRITE_PATH_REMAP_NONE;
+    const bool success = BLO_write_file(bmain, filepath_, 0, &params, nullptr);
+    BKE_main_free(bmain);
+    return success;
+  }
+
+  void read_and_check_mesh()
+  {
+    BlendFileReadReport reports{};
+    bfile = BLO_read_from_file(filepath_, BLO_READ_SKIP_NONE, &reports);
+    ASSERT_NE(bfile, nullptr);
+    ASSERT_EQ(BLI_listbase_count(&bfile->main->meshes), 1);
+    const Mesh *mesh = static_cast<const Mesh *>(bfile->main->meshes.first);
+    ASSERT_EQ(mesh->faces_num, faces_num);
+    const Span<int> face_offsets = mesh->face_offsets();
+    for (const int i : face_offsets.index_range()) {
+      ASSERT_EQ(face_offsets[i], i * 3);
+    }
+    EXPECT_EQ(mesh->corner_verts()[4], 4);
+  }
+
+  /** Check whether the large arrays of the mesh directly reference the file mapping. */
+  void expect_mesh_data_mapped(const bool is_mapped)
+  {
+    const Mesh *mesh = static_cast<const Mesh *>(bfile->main->meshes.first);
+    EXPECT_EQ(blo_read_data_is_mapped(mesh->runtime->face_offsets_sharing_info,
+                                      mesh->face_offset_indices),
+              is_mapped);
+    const int layer_index = CustomData_get_named_layer_index(
+        &mesh->vert_data, CD_PROP_FLOAT3, "position");
+    ASSERT_NE(layer_index, -1);
+    const CustomDataLayer &layer = mesh->vert_data.layers[layer_index];
+    EXPECT_EQ(blo_read_data_is_mapped(layer.sharing_info, layer.data), is_mapped);
+  }
+};
+
+static void sdna_switch_endian(char *data)
+{
+  char *cp = data + 8; /* "SDNA" and "NAME". */
+  const auto switch_count = [&]() {
+    int count;
+    memcpy(&count, cp, sizeof(int));
+    BLI_endian_switch_int32(reinterpret_cast<int *>(cp));
+    cp += sizeof(int);
+    return count;
+  };
+  const auto skip_strings = [&](const int strings_num) {
+    for (int i = 0; i < strings_num; i++) {
+      cp += strlen(cp) + 1;
+    }
+    cp = data + ((cp - data + 3) & ~3);
+  };
+
+  skip_strings(switch_count());
+  cp += 4; /* "TYPE". */
+  const int types_num = switch_count();
+  skip_strings(types_num);
+  cp += 4; /* "TLEN". */
+  BLI_endian_switch_int16_array(reinterpret_cast<short *>(cp), types_num);
+  cp += sizeof(short) * (types_num + (types_num & 1));
+  cp += 4; /* "STRC". */
+  const int structs_num = switch_count();
+  for (int i = 0; i < structs_num; i++) {
+    short *sp = reinterpret_cast<short *>(cp);
+    const int members_num = sp[1];
+    BLI_endian_switch_int16_array(sp, 2 + members_num * 2);
+    cp += sizeof(short) * (2 + members_num * 2);
+  }
+}
+
+/**
+ * Convert an uncompressed blend-file written by the current version (with 8 byte pointers) to
+ * big-endian, as if it was written on a big-endian system. Raw data blocks are assumed to be
+ * arrays of 4 byte values.
+ */
+static bool blendfile_switch_endian(char *file_data, const size_t file_size)
+{
+  if (file_size < 12 || !STREQLEN(file_data, "BLENDER-v", 9)) {
+    return false;
+  }
+  file_data[8] = 'V';
+
+  const SDNA *sdna = DNA_sdna_current_get();
+  size_t offset = 12;
+  while (offset + sizeof(BHead8) <= file_size) {
+    BHead8 *bhead = reinterpret_cast<BHead8 *>(file_data + offset);
+    if (bhead->code == BLO_CODE_ENDB) {
+      return true;
+    }
+    char *data = reinterpret_cast<char *>(bhead + 1);
+    if (bhead->code == BLO_CODE_DNA1) {
+      sdna_switch_endian(data);
+    }
+    else if (bhead->SDNAnr != 0) {
+      const int struct_size = DNA_struct_size(sdna, bhead->SDNAnr);
+      for (int i = 0; i < bhead->nr; i++) {
+        DNA_struct_switch_endian(sdna, bhead->SDNAnr, data + i * struct_size);
+      }
+    }
+    else if (bhead->len % 4 == 0) {
+      BLI_endian_switch_int32_array(reinterpret_cast<int *>(data), bhead->len / 4);
+    }
+    else {
+      return false;
+    }
+    offset += sizeof(BHead8) + bhead->len;
+
+    /* Two character ID codes are stored in the upper bytes on big-endian systems. */
+    if ((bhead->code >> 16) == 0) {
+      bhead->code <<= 16;
+    }
+    BLI_endian_switch_int32(&bhead->len);
+    BLI_endian_switch_int32(&bhead->SDNAnr);
+    BLI_endian_switch_int32(&bhead->nr);
+  }
+  return false;
+}
+
+TEST_F(BlendfileLazyDataTest, MappedMeshOffsets)
+{
+  ASSERT_TRUE(write_mesh_file());
+  read_and_check_mesh();
+  expect_mesh_data_mapped(false);
+  blendfile_free();
+
+  G.f |= G_FLAG_READFILE_LAZY_DATA;
+  read_and_check_mesh();
+#ifdef WIN32
+  /* The file is never kept mapped, so that it can still be saved over. */
+  expect_mesh_data_mapped(false);
+#else
+  expect_mesh_data_mapped(true);
+#endif
+}
+
+TEST_F(BlendfileLazyDataTest, ParallelMatchesSerial)
+{
+  ASSERT_TRUE(write_mesh_file());
+
+  /* The mesh arrays are large enough to be read in parallel, see
+   * #read_data_into_datamap_parallel. */
+  blo_read_parallel_data_decode_set(false);
+  BlendFileReadReport reports{};
+  bfile = BLO_read_from_file(filepath_, BLO_READ_SKIP_NONE, &reports);
+  blo_read_parallel_data_decode_set(true);
+  ASSERT_NE(bfile, nullptr);
+  const Mesh *mesh_serial = static_cast<const Mesh *>(bfile->main->meshes.first);
+  const Array<float3> positions(mesh_serial->vert_positions());
+  const Array<int2> edges(mesh_serial->edges());
+  const Array<int> face_offsets(mesh_serial->face_offsets());
+  const Array<int> corner_verts(mesh_serial->corner_verts());
+  const Array<int> corner_edges(mesh_serial->corner_edges());
+  blendfile_free();
+
+  bfile = BLO_read_from_file(filepath_, BLO_READ_SKIP_NONE, &reports);
+  ASSERT_NE(bfile, nullptr);
+  const Mesh *mesh = static_cast<const Mesh *>(bfile->main->meshes.first);
+  ASSERT_EQ(positions.size(), mesh->vert_positions().size());
+  EXPECT_EQ_ARRAY(positions.data(), mesh->vert_positions().data(), positions.size());
+  ASSERT_EQ(edges.size(), mesh->edges().size());
+  EXPECT_EQ_ARRAY(edges.data(), mesh->edges().data(), edges.size());
+  ASSERT_EQ(face_offsets.size(), mesh->face_offsets().size());
+  EXPECT_EQ_ARRAY(face_offsets.data(), mesh->face_offsets().data(), face_offsets.size());
+  ASSERT_EQ(corner_verts.size(), mesh->corner_verts().size());
+  EXPECT_EQ_ARRAY(corner_verts.data(), mesh->corner_verts().data(), corner_verts.size());
+  ASSERT_EQ(corner_edges.size(), mesh->corner_edges().size());
+  EXPECT_EQ_ARRAY(corner_edges.data(), mesh->corner_edges().data(), corner_edges.size());
+}
+
+TEST_F(BlendfileLazyDataTest, SwitchEndian)
+{
+  if (sizeof(void *) != 8 || ENDIAN_ORDER != L_ENDIAN) {
+    GTEST_SKIP() << "Converting files is only implemented for 64-bit little-endian systems";
+  }
+  ASSERT_TRUE(write_mesh_file());
+
+  size_t file_size;
+  char *file_data = static_cast<char *>(BLI_file_read_binary_as_mem(filepath_, 0, &file_size));
+  ASSERT_NE(file_data, nullptr);
+  const bool converted = blendfile_switch_endian(file_data, file_size);
+  FILE *file = BLI_fopen(filepath_, "wb");
+  fwrite(file_data, 1, file_size, file);
+  fclose(file);
+  MEM_freeN(file_data);
+  ASSERT_TRUE(converted);
+
+  /* Raw arrays of big-endian files must not be referenced in the mapped file. */
+  G.f |= G_FLAG_READFILE_LAZY_DATA;
+  read_and_check_mesh();
+  expect_mesh_data_mapped(false);
+}
+
+}  // namespace blender::blenloader::tests
@@ -0,0 +1,159 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_system.h"
+#include "BLI_tempfile.h"
+#include "BLI_vector.hh"
+#include BLI_SYSTEM_PID_H
+
+#include "BKE_global.hh"
+#include "BKE_lib_id.hh"
+#include "BKE_main.hh"
+#include "BKE_mesh.hh"
+
+#include "BLO_readfile.hh"
+#include "BLO_writefile.hh"
+
+#include "DNA_mesh_types.h"
+
+namespace blender::blenloader::tests {
+
+/** Enough vertices for the positions to be larger than the default chunk size. */
+static constexpr int verts_num = 1 << 17;
+
+static uint32_t read_u32_le(const char *data)
+{
+  const uchar *bytes = reinterpret_cast<const uchar *>(data);
+  return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) |
+         (uint32_t(bytes[3]) << 24);
+}
+
+class BlendfileWriteTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath_[FILE_MAX];
+
+  void SetUp() override
+  {
+    char temp_dir[FILE_MAX];
+    BLI_temp_directory_path_get(temp_dir, sizeof(temp_dir));
+    /* Unique per test and process, so that tests running concurrently don't share the file. */
+    const ::testing::TestInfo *test_info =
+        ::testing::UnitTest::GetInstance()->current_test_info();
+    char filename[FILE_MAXFILE];
+    SNPRINTF(filename, "blendfile_write_test_%s_%d.blend", test_info->name(), getpid());
+    BLI_path_join(filepath_, sizeof(filepath_), temp_dir, filename);
+  }
+
+  void TearDown() override
+  {
+    BLI_delete(filepath_, false, false);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  /** Write a compressed file containing a single mesh, return the size of the file. */
+  size_t write_compressed_mesh_file(const int compress_level, const int compress_chunk_size)
+  {
+    Main *bmain = BKE_main_new();
+    Mesh *mesh = BKE_mesh_add(bmain, "Mesh");
+    id_fake_user_set(&mesh->id);
+
+    Mesh *mesh_src = BKE_mesh_new_nomain(verts_num, 0, 0, 0);
+    MutableSpan<float3> positions = mesh_src->vert_positions_for_write();
+    for (const int i : positions.index_range()) {
+      positions[i] = float3(i % 256, i / 256, 0.0f);
+    }
+    BKE_mesh_nomain_to_mesh(mesh_src, mesh, nullptr);
+
+    BlendFileWriteParams params{};
+    params.remap_mode = BLO_WRITE_PATH_REMAP_NONE;
+    params.compress_level = compress_level;
+    params.compress_chunk_size = compress_chunk_size;
+    const bool success = BLO_write_file(bmain, filepath_, G_FILE_COMPRESS, &params, nullptr);
+    BKE_main_free(bmain);
+    EXPECT_TRUE(success);
+    return BLI_file_size(filepath_);
+  }
+
+  /** Uncompressed sizes of the frames, from the seek table at the end of the file. */
+  Vector<uint32_t> read_frame_sizes()
+  {
+    size_t file_size;
+    char *file_data = static_cast<char *>(BLI_file_read_binary_as_mem(filepath_, 0, &file_size));
+    EXPECT_NE(file_data, nullptr);
+    Vector<uint32_t> frame_sizes;
+    if (file_data == nullptr) {
+      return frame_sizes;
+    }
+    /* The seek table ends with the number of frames, a flags byte and a magic number. It is
+     * preceded by the compressed and uncompressed size of each frame. */
+    const uint32_t frames_num = read_u32_le(file_data + file_size - 9);
+    const char *frames = file_data + file_size - 9 - size_t(frames_num) * 8;
+    for (const int i : IndexRange(frames_num)) {
+      frame_sizes.append(read_u32_le(frames + i * 8 + 4));
+    }
+    MEM_freeN(file_data);
+    return frame_sizes;
+  }
+
+  void read_and_check_mesh()
+  {
+    BlendFileReadReport reports{};
+    bfile = BLO_read_from_file(filepath_, BLO_READ_SKIP_NONE, &reports);
+    ASSERT_NE(bfile, nullptr);
+    ASSERT_EQ(BLI_listbase_count(&bfile->main->meshes), 1);
+    const Mesh *mesh = static_cast<const Mesh *>(bfile->main->meshes.first);
+    const Span<float3> positions = mesh->vert_positions();
+    ASSERT_EQ(positions.size(), verts_num);
+    for (const int i : positions.index_range()) {
+      ASSERT_EQ(positions[i], float3(i % 256, i / 256, 0.0f));
+    }
+    blendfile_free();
+  }
+};
+
+TEST_F(BlendfileWriteTest, CompressionLevel)
+{
+  const size_t size_fast = write_compressed_mesh_file(1, 0);
+  read_and_check_mesh();
+  const size_t size_small = write_compressed_mesh_file(19, 0);
+  read_and_check_mesh();
+  EXPECT_LT(size_small, size_fast);
+
+  /* Out of range levels are clamped. */
+  EXPECT_GT(write_compressed_mesh_file(1000, 0), size_t(0));
+  read_and_check_mesh();
+}
+
+TEST_F(BlendfileWriteTest, CompressionChunkSize)
+{
+  /* The positions are larger than the chunk size, so they are split into chunks. */
+  write_compressed_mesh_file(0, 1 << 16);
+  read_and_check_mesh();
+  Vector<uint32_t> frame_sizes = read_frame_sizes();
+  EXPECT_TRUE(frame_sizes.contains(1 << 16));
+  EXPECT_FALSE(frame_sizes.contains(1 << 20));
+
+  /* The default chunk size is 1 MiB. */
+  write_compressed_mesh_file(0, 0);
+  read_and_check_mesh();
+  frame_sizes = read_frame_sizes();
+  EXPECT_TRUE(frame_sizes.contains(1 << 20));
+  EXPECT_FALSE(frame_sizes.contains(1 << 16));
+
+  /* Too small chunks are clamped to 64 KiB. */
+  write_compressed_mesh_file(0, 1024);
+  read_and_check_mesh();
+  frame_sizes = read_frame_sizes();
+  EXPECT_TRUE(frame_sizes.contains(1 << 16));
+  EXPECT_FALSE(frame_sizes.contains(1024));
+}
+
+}  // namespace blender::blenloader::tests
@@ -0,0 +1,170 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#include "testing/testing.h"
+
+#include <cstring>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_vector.hh"
+
+#include "BKE_lib_id.hh"
+#include "BKE_undo_system.hh"
+
+#include "BLO_undofile.hh"
+
+namespace blender::blenloader::tests {
+
+/** A chunk of data that compresses well, which differs for every \a seed. */
+static Vector<char> chunk_data(const int seed, const int64_t size = 4096)
+{
+  Vector<char> data(size);
+  for (const int64_t i : data.index_range()) {
+    data[i] = char(seed + i / 256);
+  }
+  return data;
+}
+
+/** Write a memfile made of the given chunks, like an undo push. */
+static void memfile_write(MemFile &memfile,
+                          MemFile *reference_memfile,
+                          const Span<Vector<char>> chunks)
+{
+  MemFileWriteData mem_data;
+  BLO_memfile_write_init(&mem_data, &memfile, reference_memfile);
+  mem_data.current_id_session_uid = MAIN_ID_SESSION_UID_UNSET;
+  for (const Vector<char> &chunk : chunks) {
+    BLO_memfile_chunk_add(&mem_data, chunk.data(), size_t(chunk.size()));
+  }
+  BLO_memfile_write_finalize(&mem_data);
+}
+
+static MemFileChunk *memfile_chunk(MemFile &memfile, const int index)
+{
+  return static_cast<MemFileChunk *>(BLI_findlink(&memfile.chunks, index));
+}
+
+/** Read the whole content of the memfile, like when undoing. */
+static Vector<char> memfile_read(MemFile &memfile, const int64_t size)
+{
+  Vector<char> data(size);
+  FileReader *reader = BLO_memfile_new_filereader(&memfile, STEP_UNDO);
+  EXPECT_EQ(reader->read(reader, data.data(), size_t(size)), size);
+  reader->close(reader);
+  return data;
+}
+
+static Vector<char> concat(const Span<Vector<char>> chunks)
+{
+  Vector<char> data;
+  for (const Vector<char> &chunk : chunks) {
+    data.extend(chunk);
+  }
+  return data;
+}
+
+TEST(memfile, ChunkSharing)
+{
+  const Vector<char> a = chunk_data(0), b = chunk_data(1), c = chunk_data(2), d = chunk_data(3);
+
+  MemFile first{};
+  memfile_write(first, nullptr, {a, b, c});
+  EXPECT_EQ(first.size, size_t(a.size() + b.size() + c.size()));
+
+  /* The first chunk is unchanged, the others were reordered or are new. */
+  MemFile second{};
+  memfile_write(second, &first, {a, c, d, b});
+  EXPECT_TRUE(memfile_chunk(second, 0)->is_identical);
+  EXPECT_EQ(memfile_chunk(second, 0)->buf, memfile_chunk(first, 0)->buf);
+  /* Found by their content, so they share the buffer but are not identical. */
+  EXPECT_FALSE(memfile_chunk(second, 1)->is_identical);
+  EXPECT_TRUE(memfile_chunk(second, 1)->is_shared);
+  EXPECT_EQ(memfile_chunk(second, 1)->buf, memfile_chunk(first, 2)->buf);
+  EXPECT_TRUE(memfile_chunk(second, 3)->is_shared);
+  EXPECT_EQ(memfile_chunk(second, 3)->buf, memfile_chunk(first, 1)->buf);
+  /* Only the new chunk takes memory. */
+  EXPECT_FALSE(memfile_chunk(second, 2)->is_identical || memfile_chunk(second, 2)->is_shared);
+  EXPECT_EQ(second.size, size_t(d.size()));
+
+  const Vector<char> expected = concat({a, c, d, b});
+  EXPECT_EQ_ARRAY(expected.data(), memfile_read(second, expected.size()).data(), expected.size());
+
+  /* Removing the first step transfers ownership of the shared buffers. */
+  BLO_memfile_merge(&first, &second);
+  EXPECT_FALSE(memfile_chunk(second, 0)->is_identical);
+  EXPECT_FALSE(memfile_chunk(second, 1)->is_shared);
+  EXPECT_EQ_ARRAY(expected.data(), memfile_read(second, expected.size()).data(), expected.size());
+
+  BLO_memfile_free(&second);
+}
+
+TEST(memfile, CompressRoundTrip)
+{
+  const Vector<char> a = chunk_data(0), b = chunk_data(1), c = chunk_data(2), d = chunk_data(3);
+
+  MemFile first{};
+  memfile_write(first, nullptr, {a, b, c});
+  MemFile second{};
+  memfile_write(second, &first, {a, d});
+  const size_t size_uncompressed = first.size;
+
+  /* The buffer shared with the next step must stay readable as is. */
+  BLO_memfile_compress(&first, &second);
+  EXPECT_EQ(memfile_chunk(first, 0)->compressed_size, size_t(0));
+  EXPECT_NE(memfile_chunk(first, 1)->compressed_size, size_t(0));
+  EXPECT_NE(memfile_chunk(first, 2)->compressed_size, size_t(0));
+  EXPECT_LT(first.size, size_uncompressed);
+
+  /* Reading decompresses the chunks as needed. */
+  const Vector<char> expected = concat({a, b, c});
+  EXPECT_EQ_ARRAY(expected.data(), memfile_read(first, expected.size()).data(), expected.size());
+
+  BLO_memfile_compress(&first, &second);
+  EXPECT_TRUE(BLO_memfile_decompress(&first));
+  EXPECT_EQ(memfile_chunk(first, 1)->compressed_size, size_t(0));
+  EXPECT_EQ(first.size, size_uncompressed);
+  EXPECT_EQ_ARRAY(expected.data(), memfile_read(first, expected.size()).data(), expected.size());
+
+  /* Compressed chunks are decompressed when used as reference, so they can still be shared. */
+  BLO_memfile_compress(&first, &second);
+  MemFile third{};
+  memfile_write(third, &first, {a, b});
+  EXPECT_TRUE(memfile_chunk(third, 1)->is_identical);
+
+  BLO_memfile_free(&first);
+  BLO_memfile_free(&second);
+  BLO_memfile_free(&third);
+}
+
+TEST(memfile, DecompressFailure)
+{
+  const Vector<char> a = chunk_data(0), b = chunk_data(1);
+
+  MemFile first{};
+  memfile_write(first, nullptr, {a, b});
+  MemFile second{};
+  memfile_write(second, &first, {a});
+  BLO_memfile_compress(&first, &second);
+
+  /* Corrupt the compressed data. */
+  MemFileChunk *chunk = memfile_chunk(first, 1);
+  ASSERT_NE(chunk->compressed_size, size_t(0));
+  memset(const_cast<char *>(chunk->buf), 0, chunk->compressed_size);
+  EXPECT_FALSE(BLO_memfile_decompress(&first));
+  EXPECT_NE(chunk->compressed_size, size_t(0));
+
+  /* The chunk that failed to decompress is never compared with new data. */
+  MemFile third{};
+  memfile_write(third, &first, {a, b});
+  EXPECT_TRUE(memfile_chunk(third, 0)->is_identical);
+  EXPECT_FALSE(memfile_chunk(third, 1)->is_identical || memfile_chunk(third, 1)->is_shared);
+  const Vector<char> expected = concat({a, b});
+  EXPECT_EQ_ARRAY(expected.data(), memfile_read(third, expected.size()).data(), expected.size());
+
+  BLO_memfile_free(&first);
+  BLO_memfile_free(&second);
+  BLO_memfile_free(&third);
+}
+
+}  // namespace blender::blenloader::tests
@@ -101,6 +101,22 @@ static bool any_attr_requested(const MeshBufferList &buffers)
   return false;
 }
 
+/**
+ * Create a node of the extraction sub-graph of a mesh. Extraction time is mostly proportional to
+ * the mesh size, giving nodes that cost lets the nodes of the largest meshes start first, so that
+ * they don't finish last after all the small meshes.
+ */
+static TaskNode *extract_task_node_create(TaskGraph &task_graph,
+                                          const MeshRenderData &mr,
+                                          TaskGraphNodeRunFunction run,
+                                          void *task_data,
+                                          TaskGraphNodeFreeFunction free_func)
+{
+  TaskNode *task_node = BLI_task_graph_node_create(&task_graph, run, task_data, free_func);
+  BLI_task_graph_node_set_cost(task_node, int64_t(mr.verts_num) + int64_t(mr.corners_num));
+  return task_node;
+}
+
 void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
                                         MeshBatchCache &cache,
                                         MeshBufferCache &mbc,
@@ -200,8 +216,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
   double rdata_end = BLI_time_now_seconds();
 #endif
 
-  TaskNode *task_node_mesh_render_data = BLI_task_graph_node_create(
-      &task_graph,
+  TaskNode *task_node_mesh_render_data = extract_task_node_create(
+      task_graph,
+      *mr,
       mesh_extract_render_data_node_exec,
       new MeshRenderDataUpdateTaskData{std::move(mr_ptr), mbc},
       [](void *task_data) { delete static_cast<MeshRenderDataUpdateTaskData *>(task_data); });
@@ -211,8 +228,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferCache &mbc;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_positions(data.mr, *data.mbc.buff.vbo.pos);
@@ -226,8 +244,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferCache &mbc;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_face_dots_position(data.mr, *data.mbc.buff.vbo.fdots_pos);
@@ -242,8 +261,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferCache &mbc;
       bool do_hq_normals;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_normals(data.mr, data.do_hq_normals, *data.mbc.buff.vbo.nor);
@@ -257,8 +277,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_vert_normals(data.mr, *data.buffers.vbo.vnor);
@@ -273,8 +294,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferCache &mbc;
       bool do_hq_normals;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_face_dot_normals(data.mr, data.do_hq_normals, *data.mbc.buff.vbo.fdots_nor);
@@ -288,8 +310,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferCache &mbc;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edge_factor(data.mr, *data.mbc.buff.vbo.edge_fac);
@@ -304,8 +327,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferCache &mbc;
       MeshBatchCache &cache;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           const SortedFaceData &face_sorted = mesh_render_data_faces_sorted_ensure(data.mr,
@@ -322,8 +346,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferList &buffers;
       MeshBatchCache &cache;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_lines(data.mr,
@@ -340,8 +365,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_points(data.mr, *data.buffers.ibo.points);
@@ -355,8 +381,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_face_dots(data.mr, *data.buffers.ibo.fdots);
@@ -370,8 +397,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edit_data(data.mr, *data.buffers.vbo.edit_data);
@@ -387,8 +415,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBatchCache &cache;
       bool do_hq_normals;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_tangents(data.mr, data.cache, data.do_hq_normals, *data.buffers.vbo.tan);
@@ -404,8 +433,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           if (DRW_vbo_requested(data.buffers.vbo.vert_idx)) {
@@ -431,8 +461,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferList &buffers;
       MeshBatchCache &cache;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_weights(data.mr, data.cache, *data.buffers.vbo.weights);
@@ -446,8 +477,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_face_dots_uv(data.mr, *data.buffers.vbo.fdots_uv);
@@ -461,8 +493,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_face_dots_edituv_data(data.mr, *data.buffers.vbo.fdots_edituv_data);
@@ -477,8 +510,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferList &buffers;
       MeshBatchCache &cache;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_uv_maps(data.mr, data.cache, *data.buffers.vbo.uv);
@@ -493,8 +527,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferList &buffers;
       MeshBatchCache &cache;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edituv_stretch_area(data.mr,
@@ -511,8 +546,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edituv_stretch_angle(data.mr, *data.buffers.vbo.edituv_stretch_angle);
@@ -526,8 +562,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edituv_data(data.mr, *data.buffers.vbo.edituv_data);
@@ -541,8 +578,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edituv_tris(data.mr, *data.buffers.ibo.edituv_tris);
@@ -556,8 +594,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edituv_lines(data.mr, *data.buffers.ibo.edituv_lines);
@@ -571,8 +610,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edituv_points(data.mr, *data.buffers.ibo.edituv_points);
@@ -586,8 +626,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_edituv_face_dots(data.mr, *data.buffers.ibo.edituv_fdots);
@@ -601,8 +642,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_lines_paint_mask(data.mr, *data.buffers.ibo.lines_paint_mask);
@@ -617,8 +659,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferList &buffers;
       MeshBatchCache &cache;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_lines_adjacency(
@@ -633,8 +676,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_skin_roots(data.mr, *data.buffers.vbo.skin_roots);
@@ -648,8 +692,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_sculpt_data(data.mr, *data.buffers.vbo.sculpt_data);
@@ -663,8 +708,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_orco(data.mr, *data.buffers.vbo.orco);
@@ -678,8 +724,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_mesh_analysis(data.mr, *data.buffers.vbo.mesh_analysis);
@@ -694,8 +741,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshBufferList &buffers;
       MeshBatchCache &cache;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_attributes(data.mr,
@@ -711,8 +759,9 @@ void mesh_buffer_cache_create_requested(TaskGraph &task_graph,
       MeshRenderData &mr;
       MeshBufferList &buffers;
     };
-    TaskNode *task_node = BLI_task_graph_node_create(
-        &task_graph,
+    TaskNode *task_node = extract_task_node_create(
+        task_graph,
+        *mr,
         [](void *__restrict task_data) {
           const TaskData &data = *static_cast<TaskData *>(task_data);
           extract_attr_viewer(data.mr, *data.buffers.vbo.attr_viewer);
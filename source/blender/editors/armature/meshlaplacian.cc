@@ -12,6 +12,8 @@
 #include "DNA_mesh_types.h"
 #include "DNA_object_types.h"
 
+#include "BLI_enumerable_thread_specific.hh"
+#include "BLI_linear_allocator.hh"
 #include "BLI_map.hh"
 #include "BLI_math_geom.h"
 #include "BLI_math_matrix.h"
@@ -20,6 +22,7 @@
 #include "BLI_memarena.h"
 #include "BLI_ordered_edge.hh"
 #include "BLI_string.h"
+#include "BLI_task.hh"
 
 #include "BLT_translation.hh"
 
@@ -901,6 +904,8 @@ struct MeshDeformBind {
 
   /* grids */
   MemArena *memarena;
+  /** Boundary intersections are computed on multiple threads, each with its own allocator. */
+  blender::threading::EnumerableThreadSpecific<blender::LinearAllocator<>> isect_allocators;
   MDefBoundIsect *(*boundisect)[6];
   int *semibound;
   int *tag;
@@ -991,45 +996,58 @@ static void harmonic_ray_callback(void *userdata,
   }
 }
 
-static MDefBoundIsect *meshdeform_ray_tree_intersect(MeshDeformBind *mdb,
-                                                     const float co1[3],
-                                                     const float co2[3])
+/**
+ * Cast a ray from \a co1 to \a co2 against the cage.
+ * \return The index of the hit triangle or -1.
+ */
+static int meshdeform_ray_tree_cast(const MeshDeformBind *mdb,
+                                    const float co1[3],
+                                    const float co2[3],
+                                    MeshDeformIsect *r_isect_mdef)
 {
   BVHTreeRayHit hit;
-  MeshDeformIsect isect_mdef;
   MeshRayCallbackData data = {
-      mdb,
-      &isect_mdef,
+      const_cast<MeshDeformBind *>(mdb),
+      r_isect_mdef,
   };
   float end[3], vec_normal[3];
 
   /* happens binding when a cage has no faces */
   if (UNLIKELY(mdb->bvhtree == nullptr)) {
-    return nullptr;
+    return -1;
   }
 
   /* setup isec */
-  memset(&isect_mdef, 0, sizeof(isect_mdef));
-  isect_mdef.lambda = 1e10f;
+  memset(r_isect_mdef, 0, sizeof(*r_isect_mdef));
+  r_isect_mdef->lambda = 1e10f;
 
-  copy_v3_v3(isect_mdef.start, co1);
+  copy_v3_v3(r_isect_mdef->start, co1);
   copy_v3_v3(end, co2);
-  sub_v3_v3v3(isect_mdef.vec, end, isect_mdef.start);
-  isect_mdef.vec_length = normalize_v3_v3(vec_normal, isect_mdef.vec);
+  sub_v3_v3v3(r_isect_mdef->vec, end, r_isect_mdef->start);
+  r_isect_mdef->vec_length = normalize_v3_v3(vec_normal, r_isect_mdef->vec);
 
   hit.index = -1;
   hit.dist = BVH_RAYCAST_DIST_MAX;
-  if (BLI_bvhtree_ray_cast_ex(mdb->bvhtree,
-                              isect_mdef.start,
-                              vec_normal,
-                              0.0,
-                              &hit,
-                              harmonic_ray_callback,
-                              &data,
-                              BVH_RAYCAST_WATERTIGHT) != -1)
-  {
+  return BLI_bvhtree_ray_cast_ex(mdb->bvhtree,
+                                 r_isect_mdef->start,
+                                 vec_normal,
+                                 0.0,
+                                 &hit,
+                                 harmonic_ray_callback,
+                                 &data,
+                                 BVH_RAYCAST_WATERTIGHT);
+}
+
+static MDefBoundIsect *meshdeform_ray_tree_intersect(const MeshDeformBind *mdb,
+                                                     blender::LinearAllocator<> &allocator,
+                                                     const float co1[3],
+                                                     const float co2[3])
+{
+  MeshDeformIsect isect_mdef;
+  const int hit_index = meshdeform_ray_tree_cast(mdb, co1, co2, &isect_mdef);
+  if (hit_index != -1) {
     const blender::Span<int> corner_verts = mdb->cagemesh_cache.corner_verts;
-    const int face_i = mdb->cagemesh_cache.tri_faces[hit.index];
+    const int face_i = mdb->cagemesh_cache.tri_faces[hit_index];
     const blender::IndexRange face = mdb->cagemesh_cache.faces[face_i];
     const float(*cagecos)[3] = mdb->cagecos;
     const float len = isect_mdef.lambda;
@@ -1038,8 +1056,8 @@ static MDefBoundIsect *meshdeform_ray_tree_intersect(MeshDeformBind *mdb,
     blender::Array<blender::float3, 64> mp_cagecos(face.size());
 
     /* create MDefBoundIsect, and extra for 'poly_weights[]' */
-    isect = static_cast<MDefBoundIsect *>(
-        BLI_memarena_alloc(mdb->memarena, sizeof(*isect) + (sizeof(float) * face.size())));
+    isect = static_cast<MDefBoundIsect *>(allocator.allocate(
+        int64_t(sizeof(*isect) + (sizeof(float) * face.size())), alignof(MDefBoundIsect)));
 
     /* compute intersection coordinate */
     madd_v3_v3v3fl(isect->co, co1, isect_mdef.vec, len);
@@ -1066,9 +1084,9 @@ static MDefBoundIsect *meshdeform_ray_tree_intersect(MeshDeformBind *mdb,
   return nullptr;
 }
 
-static int meshdeform_inside_cage(MeshDeformBind *mdb, float *co)
+static int meshdeform_inside_cage(const MeshDeformBind *mdb, const float *co)
 {
-  MDefBoundIsect *isect;
+  MeshDeformIsect isect_mdef;
   float outside[3], start[3], dir[3];
   int i;
 
@@ -1081,8 +1099,8 @@ static int meshdeform_inside_cage(MeshDeformBind *mdb, float *co)
     sub_v3_v3v3(dir, outside, start);
     normalize_v3(dir);
 
-    isect = meshdeform_ray_tree_intersect(mdb, start, outside);
-    if (isect && !isect->facing) {
+    /* Only the facing of the intersection is needed, so skip the interpolation weights. */
+    if (meshdeform_ray_tree_cast(mdb, start, outside, &isect_mdef) != -1 && !isect_mdef.isect) {
       return 1;
     }
   }
@@ -1125,7 +1143,11 @@ BLI_INLINE void meshdeform_cell_center(
   center[2] = mdb->min[2] + z * mdb->width[2] + mdb->halfwidth[2];
 }
 
-static void meshdeform_add_intersections(MeshDeformBind *mdb, int x, int y, int z)
+static void meshdeform_add_intersections(MeshDeformBind *mdb,
+                                         blender::LinearAllocator<> &allocator,
+                                         int x,
+                                         int y,
+                                         int z)
 {
   MDefBoundIsect *isect;
   float center[3], ncenter[3];
@@ -1142,7 +1164,7 @@ static void meshdeform_add_intersections(MeshDeformBind *mdb, int x, int y, int
 
     meshdeform_cell_center(mdb, x, y, z, i, ncenter);
 
-    isect = meshdeform_ray_tree_intersect(mdb, center, ncenter);
+    isect = meshdeform_ray_tree_intersect(mdb, allocator, center, ncenter);
     if (isect) {
       mdb->boundisect[a][i - 1] = isect;
       mdb->tag[a] = MESHDEFORM_TAG_BOUNDARY;
@@ -1454,7 +1476,6 @@ static void meshdeform_matrix_add_exterior_phi(
 static void meshdeform_matrix_solve(MeshDeformModifierData *mmd, MeshDeformBind *mdb)
 {
   LinearSolver *context;
-  float vec[3], gridvec[3];
   int a, b, x, y, z, totvar;
   char message[256];
 
@@ -1495,41 +1516,57 @@ static void meshdeform_matrix_solve(MeshDeformModifierData *mmd, MeshDeformBind
     }
 
     if (EIG_linear_solver_solve(context)) {
-      for (z = 0; z < mdb->size; z++) {
-        for (y = 0; y < mdb->size; y++) {
-          for (x = 0; x < mdb->size; x++) {
-            meshdeform_matrix_add_semibound_phi(mdb, x, y, z, a);
-          }
-        }
-      }
-
-      for (z = 0; z < mdb->size; z++) {
-        for (y = 0; y < mdb->size; y++) {
-          for (x = 0; x < mdb->size; x++) {
-            meshdeform_matrix_add_exterior_phi(mdb, x, y, z, a);
-          }
-        }
-      }
-
-      for (b = 0; b < mdb->size3; b++) {
-        if (mdb->tag[b] != MESHDEFORM_TAG_EXTERIOR) {
-          mdb->phi[b] = EIG_linear_solver_variable_get(context, 0, mdb->varidx[b]);
-        }
-        mdb->totalphi[b] += mdb->phi[b];
-      }
+      /* Cells only write their own value in each of these passes, the exterior pass reads the
+       * values of semi-bound cells which are finished at that point. */
+      blender::threading::parallel_for(
+          blender::IndexRange(mdb->size), 1, [&](const blender::IndexRange range) {
+            for (const int iz : range) {
+              for (int iy = 0; iy < mdb->size; iy++) {
+                for (int ix = 0; ix < mdb->size; ix++) {
+                  meshdeform_matrix_add_semibound_phi(mdb, ix, iy, iz, a);
+                }
+              }
+            }
+          });
+
+      blender::threading::parallel_for(
+          blender::IndexRange(mdb->size), 1, [&](const blender::IndexRange range) {
+            for (const int iz : range) {
+              for (int iy = 0; iy < mdb->size; iy++) {
+                for (int ix = 0; ix < mdb->size; ix++) {
+                  meshdeform_matrix_add_exterior_phi(mdb, ix, iy, iz, a);
+                }
+              }
+            }
+          });
+
+      blender::threading::parallel_for(
+          blender::IndexRange(mdb->size3), 4096, [&](const blender::IndexRange range) {
+            for (const int cell : range) {
+              if (mdb->tag[cell] != MESHDEFORM_TAG_EXTERIOR) {
+                mdb->phi[cell] = EIG_linear_solver_variable_get(context, 0, mdb->varidx[cell]);
+              }
+              mdb->totalphi[cell] += mdb->phi[cell];
+            }
+          });
 
       if (mdb->weights) {
         /* static bind : compute weights for each vertex */
-        for (b = 0; b < mdb->verts_num; b++) {
-          if (mdb->inside[b]) {
-            copy_v3_v3(vec, mdb->vertexcos[b]);
-            gridvec[0] = (vec[0] - mdb->min[0] - mdb->halfwidth[0]) / mdb->width[0];
-            gridvec[1] = (vec[1] - mdb->min[1] - mdb->halfwidth[1]) / mdb->width[1];
-            gridvec[2] = (vec[2] - mdb->min[2] - mdb->halfwidth[2]) / mdb->width[2];
-
-            mdb->weights[b * mdb->cage_verts_num + a] = meshdeform_interp_w(mdb, gridvec, vec, a);
-          }
-        }
+        blender::threading::parallel_for(
+            blender::IndexRange(mdb->verts_num), 1024, [&](const blender::IndexRange range) {
+              for (const int vert : range) {
+                if (mdb->inside[vert]) {
+                  float vec[3], gridvec[3];
+                  copy_v3_v3(vec, mdb->vertexcos[vert]);
+                  gridvec[0] = (vec[0] - mdb->min[0] - mdb->halfwidth[0]) / mdb->width[0];
+                  gridvec[1] = (vec[1] - mdb->min[1] - mdb->halfwidth[1]) / mdb->width[1];
+                  gridvec[2] = (vec[2] - mdb->min[2] - mdb->halfwidth[2]) / mdb->width[2];
+
+                  mdb->weights[vert * mdb->cage_verts_num + a] = meshdeform_interp_w(
+                      mdb, gridvec, vec, a);
+                }
+              }
+            });
       }
       else {
         MDefBindInfluence *inf;
@@ -1584,8 +1621,8 @@ static void harmonic_coordinates_bind(MeshDeformModifierData *mmd, MeshDeformBin
   MDefBindInfluence *inf;
   MDefInfluence *mdinf;
   MDefCell *cell;
-  float center[3], vec[3], maxwidth, totweight;
-  int a, b, x, y, z, totinside, offset;
+  float center[3], maxwidth, totweight;
+  int a, b, x, y, z, offset;
 
   /* compute bounding box of the cage mesh */
   INIT_MINMAX(mdb->min, mdb->max);
@@ -1654,33 +1691,31 @@ static void harmonic_coordinates_bind(MeshDeformModifierData *mmd, MeshDeformBin
 
   progress_bar(0, "Setting up mesh deform system");
 
-  totinside = 0;
-  for (a = 0; a < mdb->verts_num; a++) {
-    copy_v3_v3(vec, mdb->vertexcos[a]);
-    mdb->inside[a] = meshdeform_inside_cage(mdb, vec);
-    if (mdb->inside[a]) {
-      totinside++;
-    }
-  }
-  (void)totinside; /* Quiet set-but-unused warning (may be removed). */
-
-  /* free temporary MDefBoundIsects */
-  BLI_memarena_free(mdb->memarena);
-  mdb->memarena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, "harmonic coords arena");
+  blender::threading::parallel_for(
+      blender::IndexRange(mdb->verts_num), 256, [&](const blender::IndexRange range) {
+        for (const int i : range) {
+          mdb->inside[i] = meshdeform_inside_cage(mdb, mdb->vertexcos[i]);
+        }
+      });
 
   /* start with all cells untyped */
   for (a = 0; a < mdb->size3; a++) {
     mdb->tag[a] = MESHDEFORM_TAG_UNTYPED;
   }
 
-  /* detect intersections and tag boundary cells */
-  for (z = 0; z < mdb->size; z++) {
-    for (y = 0; y < mdb->size; y++) {
-      for (x = 0; x < mdb->size; x++) {
-        meshdeform_add_intersections(mdb, x, y, z);
-      }
-    }
-  }
+  /* Detect intersections and tag boundary cells. Every cell only writes its own intersections and
+   * tag, so slices of the grid are processed in parallel. */
+  blender::threading::parallel_for(
+      blender::IndexRange(mdb->size), 1, [&](const blender::IndexRange range) {
+        blender::LinearAllocator<> &allocator = mdb->isect_allocators.local();
+        for (const int iz : range) {
+          for (int iy = 0; iy < mdb->size; iy++) {
+            for (int ix = 0; ix < mdb->size; ix++) {
+              meshdeform_add_intersections(mdb, allocator, ix, iy, iz);
+            }
+          }
+        }
+      });
 
   /* compute exterior and interior tags */
   meshdeform_bind_floodfill(mdb);
@@ -32,12 +32,15 @@ static void snap_object_data_mesh_get(const Mesh *mesh_eval,
                                       bool skip_hidden,
                                       BVHTreeFromMesh *r_treedata)
 {
-  /* The BVHTree from corner_tris is always required. */
+  /* The BVHTree from corner_tris is always required. The target mesh doesn't change while
+   * snapping and is ray-cast on every mouse move, so a slower build with faster queries pays
+   * off. */
   BKE_bvhtree_from_mesh_get(r_treedata,
                             mesh_eval,
                             skip_hidden ? BVHTREE_FROM_CORNER_TRIS_NO_HIDDEN :
                                           BVHTREE_FROM_CORNER_TRIS,
-                            4);
+                            4,
+                            BVH_BALANCE_SAH | BVH_BALANCE_FLAT);
 }
 
 /** \} */
@@ -54,6 +54,12 @@ struct MemFileUndoStep {
   MemFileUndoData *data;
 };
 
+/**
+ * Number of memfile steps before the latest one that stay uncompressed, older steps are
+ * compressed to reduce memory usage of long undo stacks, see #BLO_memfile_compress.
+ */
+#define MEMFILE_UNDO_UNCOMPRESSED_STEPS 4
+
 static bool memfile_undosys_poll(bContext *C)
 {
   /* other poll functions must run first, this is a catch-all. */
@@ -86,6 +92,27 @@ static bool memfile_undosys_step_encode(bContext * /*C*/, Main *bmain, UndoStep
       ustack, BKE_UNDOSYS_TYPE_MEMFILE);
   us->data = BKE_memfile_undo_encode(bmain, us_prev ? us_prev->data : nullptr);
   us->step.data_size = us->data->undo_size;
+  if (us_prev != nullptr) {
+    /* Writing decompresses the reference step. */
+    us_prev->data->undo_size = us_prev->data->memfile.size;
+    us_prev->step.data_size = us_prev->data->undo_size;
+  }
+
+  /* Compress the step that just became old enough. Each push only compresses a single step, so
+   * the cost stays proportional to the changes of that step. */
+  MemFileUndoStep *us_old = us_prev;
+  for (int i = 1; us_old != nullptr && i < MEMFILE_UNDO_UNCOMPRESSED_STEPS; i++) {
+    us_old = (MemFileUndoStep *)BKE_undosys_step_same_type_prev(&us_old->step);
+  }
+  if (us_old != nullptr) {
+    MemFileUndoStep *us_old_next = (MemFileUndoStep *)BKE_undosys_step_same_type_next(
+        &us_old->step);
+    if (us_old_next != nullptr) {
+      BLO_memfile_compress(&us_old->data->memfile, &us_old_next->data->memfile);
+      us_old->data->undo_size = us_old->data->memfile.size;
+      us_old->step.data_size = us_old->data->undo_size;
+    }
+  }
 
   /* Store the fact that we should not re-use old data with that undo step, and reset the Main
    * flag. */
@@ -204,6 +231,9 @@ static void memfile_undosys_step_decode(
 
   MemFileUndoStep *us = (MemFileUndoStep *)us_p;
   BKE_memfile_undo_decode(us->data, undo_direction, use_old_bmain_data, C);
+  /* Reading decompresses the step. */
+  us->data->undo_size = us->data->memfile.size;
+  us_p->data_size = us->data->undo_size;
 
   for (UndoStep *us_iter = us_p->next; us_iter; us_iter = us_iter->next) {
     if (BKE_UNDOSYS_TYPE_IS_MEMFILE_SKIP(us_iter->type)) {
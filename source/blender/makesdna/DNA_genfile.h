@@ -160,6 +160,23 @@ void *DNA_struct_reconstruct(const struct DNA_ReconstructInfo *reconstruct_info,
                              int blocks,
                              const void *old_blocks,
                              const char *alloc_name);
+/**
+ * \return The index in newsdna of the struct that \a old_struct_index is reconstructed into,
+ * or -1 when it doesn't exist anymore.
+ */
+int DNA_reconstruct_new_struct_index(const struct DNA_ReconstructInfo *reconstruct_info,
+                                     int old_struct_index);
+/**
+ * Same as #DNA_struct_reconstruct, but writes into \a new_blocks, which must be zero initialized
+ * and large enough for \a blocks structs of \a new_struct_index. This allows reconstructing
+ * parts of large arrays from multiple threads.
+ */
+void DNA_struct_reconstruct_into(const struct DNA_ReconstructInfo *reconstruct_info,
+                                 int old_struct_index,
+                                 int new_struct_index,
+                                 int blocks,
+                                 const void *old_blocks,
+                                 void *new_blocks);
 
 /**
  * A version of #DNA_struct_member_offset_by_name_with_alias that uses the non-aliased name.
@@ -22,6 +22,10 @@
 
 namespace blender {
 template<typename T> struct Bounds;
+namespace index_mask {
+class IndexMask;
+}  // namespace index_mask
+using index_mask::IndexMask;
 namespace offset_indices {
 template<typename T> struct GroupedSpan;
 template<typename T> class OffsetIndices;
@@ -397,6 +401,12 @@ typedef struct Mesh {
 
   /** Call after changing vertex positions to tag lazily calculated caches for recomputation. */
   void tag_positions_changed();
+  /**
+   * Like #tag_positions_changed, for when only \a changed_verts moved. Normals that are already
+   * calculated are updated for the affected faces and vertices instead of being recalculated
+   * entirely later on. Positions must already be modified when this is called.
+   */
+  void tag_positions_changed_partial(const blender::IndexMask &changed_verts);
   /** Call after moving every mesh vertex by the same translation. */
   void tag_positions_changed_uniformly();
   /** Like #tag_positions_changed but doesn't tag normals; they must be updated separately. */
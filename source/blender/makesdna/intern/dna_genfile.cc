@@ -1260,6 +1260,85 @@ static void reconstruct_struct(const DNA_ReconstructInfo *reconstruct_info,
   }
 }
 
+/**
+ * Number of structs that are reconstructed together by #reconstruct_structs_batch. Small enough
+ * for the old and new data to stay in cache while all steps are executed.
+ */
+#define RECONSTRUCT_BATCH_SIZE 64
+
+/**
+ * Same as calling #reconstruct_struct for every block, but executes every step for all blocks
+ * before moving on to the next step. This avoids the dispatch overhead of every step for every
+ * struct in large arrays, and gives tight loops with fixed sizes and strides.
+ */
+static void reconstruct_structs_batch(const DNA_ReconstructInfo *reconstruct_info,
+                                      const int blocks,
+                                      const int new_struct_index,
+                                      const int old_block_size,
+                                      const int new_block_size,
+                                      const char *old_blocks,
+                                      char *new_blocks)
+{
+  const ReconstructStep *steps = reconstruct_info->steps[new_struct_index];
+  const int step_count = reconstruct_info->step_counts[new_struct_index];
+
+  for (int a = 0; a < step_count; a++) {
+    const ReconstructStep *step = &steps[a];
+    switch (step->type) {
+      case RECONSTRUCT_STEP_MEMCPY: {
+        const char *old_data = old_blocks + step->data.memcpy.old_offset;
+        char *new_data = new_blocks + step->data.memcpy.new_offset;
+        const int size = step->data.memcpy.size;
+        for (int b = 0; b < blocks; b++) {
+          memcpy(new_data + b * new_block_size, old_data + b * old_block_size, size);
+        }
+        break;
+      }
+      case RECONSTRUCT_STEP_CAST_PRIMITIVE:
+        for (int b = 0; b < blocks; b++) {
+          cast_primitive_type(
+              step->data.cast_primitive.old_type,
+              step->data.cast_primitive.new_type,
+              step->data.cast_primitive.array_len,
+              old_blocks + b * old_block_size + step->data.cast_primitive.old_offset,
+              new_blocks + b * new_block_size + step->data.cast_primitive.new_offset);
+        }
+        break;
+      case RECONSTRUCT_STEP_CAST_POINTER_TO_32:
+        for (int b = 0; b < blocks; b++) {
+          cast_pointer_64_to_32(
+              step->data.cast_pointer.array_len,
+              (const uint64_t *)(old_blocks + b * old_block_size +
+                                 step->data.cast_pointer.old_offset),
+              (uint32_t *)(new_blocks + b * new_block_size + step->data.cast_pointer.new_offset));
+        }
+        break;
+      case RECONSTRUCT_STEP_CAST_POINTER_TO_64:
+        for (int b = 0; b < blocks; b++) {
+          cast_pointer_32_to_64(
+              step->data.cast_pointer.array_len,
+              (const uint32_t *)(old_blocks + b * old_block_size +
+                                 step->data.cast_pointer.old_offset),
+              (uint64_t *)(new_blocks + b * new_block_size + step->data.cast_pointer.new_offset));
+        }
+        break;
+      case RECONSTRUCT_STEP_SUBSTRUCT:
+        for (int b = 0; b < blocks; b++) {
+          reconstruct_structs(reconstruct_info,
+                              step->data.substruct.array_len,
+                              step->data.substruct.old_struct_index,
+                              step->data.substruct.new_struct_index,
+                              old_blocks + b * old_block_size + step->data.substruct.old_offset,
+                              new_blocks + b * new_block_size + step->data.substruct.new_offset);
+        }
+        break;
+      case RECONSTRUCT_STEP_INIT_ZERO:
+        /* Do nothing, see #reconstruct_struct. */
+        break;
+    }
+  }
+}
+
 /** Reconstructs an array of structs. */
 static void reconstruct_structs(const DNA_ReconstructInfo *reconstruct_info,
                                 const int blocks,
@@ -1274,10 +1353,19 @@ static void reconstruct_structs(const DNA_ReconstructInfo *reconstruct_info,
   const int old_block_size = reconstruct_info->oldsdna->types_size[old_struct->type_index];
   const int new_block_size = reconstruct_info->newsdna->types_size[new_struct->type_index];
 
-  for (int a = 0; a < blocks; a++) {
-    const char *old_block = old_blocks + a * old_block_size;
-    char *new_block = new_blocks + a * new_block_size;
-    reconstruct_struct(reconstruct_info, new_struct_index, old_block, new_block);
+  if (blocks == 1) {
+    reconstruct_struct(reconstruct_info, new_struct_index, old_blocks, new_blocks);
+    return;
+  }
+
+  for (int a = 0; a < blocks; a += RECONSTRUCT_BATCH_SIZE) {
+    reconstruct_structs_batch(reconstruct_info,
+                              std::min(RECONSTRUCT_BATCH_SIZE, blocks - a),
+                              new_struct_index,
+                              old_block_size,
+                              new_block_size,
+                              old_blocks + int64_t(a) * old_block_size,
+                              new_blocks + int64_t(a) * new_block_size);
   }
 }
 
@@ -1313,6 +1401,32 @@ void *DNA_struct_reconstruct(const DNA_ReconstructInfo *reconstruct_info,
   return new_blocks;
 }
 
+int DNA_reconstruct_new_struct_index(const DNA_ReconstructInfo *reconstruct_info,
+                                     const int old_struct_index)
+{
+  const SDNA *oldsdna = reconstruct_info->oldsdna;
+  const SDNA_Struct *old_struct = oldsdna->structs[old_struct_index];
+  const char *type_name = oldsdna->types[old_struct->type_index];
+  return DNA_struct_find_index_without_alias(reconstruct_info->newsdna, type_name);
+}
+
+void DNA_struct_reconstruct_into(const DNA_ReconstructInfo *reconstruct_info,
+                                 const int old_struct_index,
+                                 const int new_struct_index,
+                                 const int blocks,
+                                 const void *old_blocks,
+                                 void *new_blocks)
+{
+  BLI_assert(new_struct_index ==
+             DNA_reconstruct_new_struct_index(reconstruct_info, old_struct_index));
+  reconstruct_structs(reconstruct_info,
+                      blocks,
+                      old_struct_index,
+                      new_struct_index,
+                      static_cast<const char *>(old_blocks),
+                      static_cast<char *>(new_blocks));
+}
+
 /** Finds a member in the given struct with the given name. */
 static const SDNA_StructMember *find_member_with_matching_name(const SDNA *sdna,
                                                                const SDNA_Struct *struct_info,
@@ -11,6 +11,8 @@
 #include "BLI_math_base.hh"
 #include "BLI_math_matrix.h"
 #include "BLI_math_vector.h"
+#include "BLI_math_vector.hh"
+#include "BLI_task.hh"
 #include "BLI_utildefines.h"
 
 #include "BLT_translation.hh"
@@ -25,6 +27,8 @@
 
 #include "BKE_deform.hh"
 #include "BKE_editmesh.hh"
+#include "BKE_mesh.hh"
+#include "BKE_mesh_mapping.hh"
 
 #include "UI_interface.hh"
 #include "UI_resources.hh"
@@ -106,18 +110,19 @@ static void mesh_get_weights(const MDeformVert *dvert,
                              const bool use_invert_vgroup,
                              float *smooth_weights)
 {
-  uint i;
-
-  for (i = 0; i < verts_num; i++, dvert++) {
-    const float w = BKE_defvert_find_weight(dvert, defgrp_index);
-
-    if (use_invert_vgroup == false) {
-      smooth_weights[i] = w;
-    }
-    else {
-      smooth_weights[i] = 1.0f - w;
-    }
-  }
+  blender::threading::parallel_for(
+      blender::IndexRange(verts_num), 4096, [&](const blender::IndexRange range) {
+        for (const int64_t i : range) {
+          const float w = BKE_defvert_find_weight(&dvert[i], defgrp_index);
+
+          if (use_invert_vgroup == false) {
+            smooth_weights[i] = w;
+          }
+          else {
+            smooth_weights[i] = 1.0f - w;
+          }
+        }
+      });
 }
 
 static void mesh_get_boundaries(Mesh *mesh, float *smooth_weights)
@@ -151,177 +156,120 @@ static void mesh_get_boundaries(Mesh *mesh, float *smooth_weights)
 /* Simple Weighted Smoothing
  *
  * (average of surrounding verts)
+ *
+ * Every iteration reads the positions of the previous iteration and writes the result into a
+ * second buffer, so that vertices can be smoothed independently of each other.
  */
 static void smooth_iter__simple(CorrectiveSmoothModifierData *csmd,
-                                Mesh *mesh,
+                                const blender::Span<blender::int2> edges,
+                                const blender::GroupedSpan<int> vert_to_edge_map,
                                 blender::MutableSpan<blender::float3> vertexCos,
                                 const float *smooth_weights,
                                 uint iterations)
 {
+  using namespace blender;
   const float lambda = csmd->lambda;
-  int i;
-
-  const int edges_num = mesh->edges_num;
-  const blender::Span<blender::int2> edges = mesh->edges();
-
-  struct SmoothingData_Simple {
-    float delta[3];
-  };
-  SmoothingData_Simple *smooth_data = MEM_cnew_array<SmoothingData_Simple>(
-      size_t(vertexCos.size()), __func__);
-
-  float *vertex_edge_count_div = static_cast<float *>(
-      MEM_calloc_arrayN(size_t(vertexCos.size()), sizeof(float), __func__));
-
-  /* calculate as floats to avoid int->float conversion in #smooth_iter */
-  for (i = 0; i < edges_num; i++) {
-    vertex_edge_count_div[edges[i][0]] += 1.0f;
-    vertex_edge_count_div[edges[i][1]] += 1.0f;
-  }
 
   /* a little confusing, but we can include 'lambda' and smoothing weight
    * here to avoid multiplying for every iteration */
-  if (smooth_weights == nullptr) {
-    for (i = 0; i < vertexCos.size(); i++) {
-      vertex_edge_count_div[i] = lambda * (vertex_edge_count_div[i] ?
-                                               (1.0f / vertex_edge_count_div[i]) :
-                                               1.0f);
+  Array<float> vertex_edge_count_div(vertexCos.size());
+  threading::parallel_for(vertexCos.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      const int edges_num = int(vert_to_edge_map[i].size());
+      const float weight = smooth_weights ? smooth_weights[i] * lambda : lambda;
+      vertex_edge_count_div[i] = weight * (edges_num ? (1.0f / float(edges_num)) : 1.0f);
     }
-  }
-  else {
-    for (i = 0; i < vertexCos.size(); i++) {
-      vertex_edge_count_div[i] = smooth_weights[i] * lambda *
-                                 (vertex_edge_count_div[i] ? (1.0f / vertex_edge_count_div[i]) :
-                                                             1.0f);
-    }
-  }
+  });
 
   /* -------------------------------------------------------------------- */
   /* Main Smoothing Loop */
 
-  while (iterations--) {
-    for (i = 0; i < edges_num; i++) {
-      SmoothingData_Simple *sd_v1;
-      SmoothingData_Simple *sd_v2;
-      float edge_dir[3];
-
-      sub_v3_v3v3(edge_dir, vertexCos[edges[i][1]], vertexCos[edges[i][0]]);
-
-      sd_v1 = &smooth_data[edges[i][0]];
-      sd_v2 = &smooth_data[edges[i][1]];
-
-      add_v3_v3(sd_v1->delta, edge_dir);
-      sub_v3_v3(sd_v2->delta, edge_dir);
-    }
+  Array<float3> vertexCos_next(vertexCos.size());
+  MutableSpan<float3> src = vertexCos;
+  MutableSpan<float3> dst = vertexCos_next;
 
-    for (i = 0; i < vertexCos.size(); i++) {
-      SmoothingData_Simple *sd = &smooth_data[i];
-      madd_v3_v3fl(vertexCos[i], sd->delta, vertex_edge_count_div[i]);
-      /* zero for the next iteration (saves memset on entire array) */
-      memset(sd, 0, sizeof(*sd));
-    }
+  while (iterations--) {
+    threading::parallel_for(src.index_range(), 1024, [&](const IndexRange range) {
+      for (const int64_t vert : range) {
+        const float3 &co = src[vert];
+        float3 delta(0.0f);
+        for (const int edge : vert_to_edge_map[vert]) {
+          delta += src[bke::mesh::edge_other_vert(edges[edge], int(vert))] - co;
+        }
+        dst[vert] = co + delta * vertex_edge_count_div[vert];
+      }
+    });
+    std::swap(src, dst);
   }
 
-  MEM_freeN(vertex_edge_count_div);
-  MEM_freeN(smooth_data);
+  if (src.data() != vertexCos.data()) {
+    vertexCos.copy_from(src);
+  }
 }
 
 /* -------------------------------------------------------------------- */
 /* Edge-Length Weighted Smoothing
  */
 static void smooth_iter__length_weight(CorrectiveSmoothModifierData *csmd,
-                                       Mesh *mesh,
+                                       const blender::Span<blender::int2> edges,
+                                       const blender::GroupedSpan<int> vert_to_edge_map,
                                        blender::MutableSpan<blender::float3> vertexCos,
                                        const float *smooth_weights,
                                        uint iterations)
 {
+  using namespace blender;
   const float eps = FLT_EPSILON * 10.0f;
-  const uint edges_num = uint(mesh->edges_num);
   /* NOTE: the way this smoothing method works, its approx half as strong as the simple-smooth,
    * and 2.0 rarely spikes, double the value for consistent behavior. */
   const float lambda = csmd->lambda * 2.0f;
-  const blender::Span<blender::int2> edges = mesh->edges();
-  uint i;
-
-  struct SmoothingData_Weighted {
-    float delta[3];
-    float edge_length_sum;
-  };
-  SmoothingData_Weighted *smooth_data = MEM_cnew_array<SmoothingData_Weighted>(
-      size_t(vertexCos.size()), __func__);
-
-  /* calculate as floats to avoid int->float conversion in #smooth_iter */
-  float *vertex_edge_count = static_cast<float *>(
-      MEM_calloc_arrayN(size_t(vertexCos.size()), sizeof(float), __func__));
-  for (i = 0; i < edges_num; i++) {
-    vertex_edge_count[edges[i][0]] += 1.0f;
-    vertex_edge_count[edges[i][1]] += 1.0f;
-  }
 
   /* -------------------------------------------------------------------- */
   /* Main Smoothing Loop */
 
-  while (iterations--) {
-    for (i = 0; i < edges_num; i++) {
-      SmoothingData_Weighted *sd_v1;
-      SmoothingData_Weighted *sd_v2;
-      float edge_dir[3];
-      float edge_dist;
-
-      sub_v3_v3v3(edge_dir, vertexCos[edges[i][1]], vertexCos[edges[i][0]]);
-      edge_dist = len_v3(edge_dir);
+  Array<float3> vertexCos_next(vertexCos.size());
+  MutableSpan<float3> src = vertexCos;
+  MutableSpan<float3> dst = vertexCos_next;
+  /* Computed once per edge instead of once for each of its vertices. */
+  Array<float> edge_lengths(edges.size());
 
-      /* weight by distance */
-      mul_v3_fl(edge_dir, edge_dist);
-
-      sd_v1 = &smooth_data[edges[i][0]];
-      sd_v2 = &smooth_data[edges[i][1]];
-
-      add_v3_v3(sd_v1->delta, edge_dir);
-      sub_v3_v3(sd_v2->delta, edge_dir);
-
-      sd_v1->edge_length_sum += edge_dist;
-      sd_v2->edge_length_sum += edge_dist;
-    }
+  while (iterations--) {
+    threading::parallel_for(edges.index_range(), 4096, [&](const IndexRange range) {
+      for (const int64_t edge : range) {
+        edge_lengths[edge] = math::distance(src[edges[edge][0]], src[edges[edge][1]]);
+      }
+    });
+    threading::parallel_for(src.index_range(), 1024, [&](const IndexRange range) {
+      for (const int64_t vert : range) {
+        const Span<int> vert_edges = vert_to_edge_map[vert];
+        const float3 &co = src[vert];
+        float3 delta(0.0f);
+        float edge_length_sum = 0.0f;
+        for (const int edge : vert_edges) {
+          const float3 edge_dir = src[bke::mesh::edge_other_vert(edges[edge], int(vert))] - co;
+          const float edge_dist = edge_lengths[edge];
+          /* weight by distance */
+          delta += edge_dir * edge_dist;
+          edge_length_sum += edge_dist;
+        }
 
-    if (smooth_weights == nullptr) {
-      /* fast-path */
-      for (i = 0; i < vertexCos.size(); i++) {
-        SmoothingData_Weighted *sd = &smooth_data[i];
         /* Divide by sum of all neighbor distances (weighted) and amount of neighbors,
          * (mean average). */
-        const float div = sd->edge_length_sum * vertex_edge_count[i];
+        const float div = edge_length_sum * float(vert_edges.size());
         if (div > eps) {
-#if 0
-          /* first calculate the new location */
-          mul_v3_fl(sd->delta, 1.0f / div);
-          /* then interpolate */
-          madd_v3_v3fl(vertexCos[i], sd->delta, lambda);
-#else
-          /* do this in one step */
-          madd_v3_v3fl(vertexCos[i], sd->delta, lambda / div);
-#endif
+          const float lambda_w = smooth_weights ? lambda * smooth_weights[vert] : lambda;
+          dst[vert] = co + delta * (lambda_w / div);
         }
-        /* zero for the next iteration (saves memset on entire array) */
-        memset(sd, 0, sizeof(*sd));
-      }
-    }
-    else {
-      for (i = 0; i < vertexCos.size(); i++) {
-        SmoothingData_Weighted *sd = &smooth_data[i];
-        const float div = sd->edge_length_sum * vertex_edge_count[i];
-        if (div > eps) {
-          const float lambda_w = lambda * smooth_weights[i];
-          madd_v3_v3fl(vertexCos[i], sd->delta, lambda_w / div);
+        else {
+          dst[vert] = co;
         }
-
-        memset(sd, 0, sizeof(*sd));
       }
-    }
+    });
+    std::swap(src, dst);
   }
 
-  MEM_freeN(vertex_edge_count);
-  MEM_freeN(smooth_data);
+  if (src.data() != vertexCos.data()) {
+    vertexCos.copy_from(src);
+  }
 }
 
 static void smooth_iter(CorrectiveSmoothModifierData *csmd,
@@ -330,14 +278,22 @@ static void smooth_iter(CorrectiveSmoothModifierData *csmd,
                         const float *smooth_weights,
                         uint iterations)
 {
+  const blender::Span<blender::int2> edges = mesh->edges();
+
+  blender::Array<int> vert_to_edge_offsets;
+  blender::Array<int> vert_to_edge_indices;
+  const blender::GroupedSpan<int> vert_to_edge_map = blender::bke::mesh::build_vert_to_edge_map(
+      edges, int(vertexCos.size()), vert_to_edge_offsets, vert_to_edge_indices);
+
   switch (csmd->smooth_type) {
     case MOD_CORRECTIVESMOOTH_SMOOTH_LENGTH_WEIGHT:
-      smooth_iter__length_weight(csmd, mesh, vertexCos, smooth_weights, iterations);
+      smooth_iter__length_weight(
+          csmd, edges, vert_to_edge_map, vertexCos, smooth_weights, iterations);
       break;
 
     /* case MOD_CORRECTIVESMOOTH_SMOOTH_SIMPLE: */
     default:
-      smooth_iter__simple(csmd, mesh, vertexCos, smooth_weights, iterations);
+      smooth_iter__simple(csmd, edges, vert_to_edge_map, vertexCos, smooth_weights, iterations);
       break;
   }
 }
@@ -415,70 +371,66 @@ static bool calc_tangent_loop(const float v_dir_prev[3],
 /**
  * \param r_tangent_spaces: Loop aligned array of tangents.
  * \param r_tangent_weights: Loop aligned array of weights (may be nullptr).
- * \param r_tangent_weights_per_vertex: Vertex aligned array, accumulating weights for each loop
- * (may be nullptr).
  */
 static void calc_tangent_spaces(const Mesh *mesh,
                                 blender::Span<blender::float3> vertexCos,
                                 float (*r_tangent_spaces)[3][3],
-                                float *r_tangent_weights,
-                                float *r_tangent_weights_per_vertex)
+                                float *r_tangent_weights)
 {
-  const uint mvert_num = uint(mesh->verts_num);
   const blender::OffsetIndices faces = mesh->faces();
   blender::Span<int> corner_verts = mesh->corner_verts();
 
-  if (r_tangent_weights_per_vertex != nullptr) {
-    copy_vn_fl(r_tangent_weights_per_vertex, int(mvert_num), 0.0f);
-  }
-
-  for (const int64_t i : faces.index_range()) {
-    const blender::IndexRange face = faces[i];
-    int next_corner = int(face.start());
-    int term_corner = next_corner + int(face.size());
-    int prev_corner = term_corner - 2;
-    int curr_corner = term_corner - 1;
-
-    /* loop directions */
-    float v_dir_prev[3], v_dir_next[3];
-
-    /* needed entering the loop */
-    sub_v3_v3v3(
-        v_dir_prev, vertexCos[corner_verts[prev_corner]], vertexCos[corner_verts[curr_corner]]);
-    normalize_v3(v_dir_prev);
-
-    for (; next_corner != term_corner;
-         prev_corner = curr_corner, curr_corner = next_corner, next_corner++)
-    {
-      float(*ts)[3] = r_tangent_spaces[curr_corner];
-
-      /* re-use the previous value */
+  blender::threading::parallel_for(
+      faces.index_range(), 1024, [&](const blender::IndexRange range) {
+        for (const int64_t i : range) {
+          const blender::IndexRange face = faces[i];
+          int next_corner = int(face.start());
+          int term_corner = next_corner + int(face.size());
+          int prev_corner = term_corner - 2;
+          int curr_corner = term_corner - 1;
+
+          /* loop directions */
+          float v_dir_prev[3], v_dir_next[3];
+
+          /* needed entering the loop */
+          sub_v3_v3v3(v_dir_prev,
+                      vertexCos[corner_verts[prev_corner]],
+                      vertexCos[corner_verts[curr_corner]]);
+          normalize_v3(v_dir_prev);
+
+          for (; next_corner != term_corner;
+               prev_corner = curr_corner, curr_corner = next_corner, next_corner++)
+          {
+            float(*ts)[3] = r_tangent_spaces[curr_corner];
+
+            /* re-use the previous value */
 #if 0
-      sub_v3_v3v3(
-          v_dir_prev, vertexCos[corner_verts[prev_corner]], vertexCos[corner_verts[curr_corner]]);
-      normalize_v3(v_dir_prev);
+            sub_v3_v3v3(v_dir_prev,
+                        vertexCos[corner_verts[prev_corner]],
+                        vertexCos[corner_verts[curr_corner]]);
+            normalize_v3(v_dir_prev);
 #endif
-      sub_v3_v3v3(
-          v_dir_next, vertexCos[corner_verts[curr_corner]], vertexCos[corner_verts[next_corner]]);
-      normalize_v3(v_dir_next);
-
-      if (calc_tangent_loop(v_dir_prev, v_dir_next, ts)) {
-        if (r_tangent_weights != nullptr) {
-          const float weight = fabsf(
-              blender::math::safe_acos_approx(dot_v3v3(v_dir_next, v_dir_prev)));
-          r_tangent_weights[curr_corner] = weight;
-          r_tangent_weights_per_vertex[corner_verts[curr_corner]] += weight;
+            sub_v3_v3v3(v_dir_next,
+                        vertexCos[corner_verts[curr_corner]],
+                        vertexCos[corner_verts[next_corner]]);
+            normalize_v3(v_dir_next);
+
+            if (calc_tangent_loop(v_dir_prev, v_dir_next, ts)) {
+              if (r_tangent_weights != nullptr) {
+                r_tangent_weights[curr_corner] = fabsf(
+                    blender::math::safe_acos_approx(dot_v3v3(v_dir_next, v_dir_prev)));
+              }
+            }
+            else {
+              if (r_tangent_weights != nullptr) {
+                r_tangent_weights[curr_corner] = 0;
+              }
+            }
+
+            copy_v3_v3(v_dir_prev, v_dir_next);
+          }
         }
-      }
-      else {
-        if (r_tangent_weights != nullptr) {
-          r_tangent_weights[curr_corner] = 0;
-        }
-      }
-
-      copy_v3_v3(v_dir_prev, v_dir_next);
-    }
-  }
+      });
 }
 
 static void store_cache_settings(CorrectiveSmoothModifierData *csmd)
@@ -512,8 +464,6 @@ static void calc_deltas(CorrectiveSmoothModifierData *csmd,
 
   blender::Array<blender::float3> smooth_vertex_coords(rest_coords);
 
-  uint l_index;
-
   float(*tangent_spaces)[3][3] = static_cast<float(*)[3][3]>(
       MEM_malloc_arrayN(size_t(corner_verts.size()), sizeof(float[3][3]), __func__));
 
@@ -530,21 +480,22 @@ static void calc_deltas(CorrectiveSmoothModifierData *csmd,
 
   smooth_verts(csmd, mesh, dvert, defgrp_index, smooth_vertex_coords);
 
-  calc_tangent_spaces(mesh, smooth_vertex_coords, tangent_spaces, nullptr, nullptr);
-
-  copy_vn_fl(&csmd->delta_cache.deltas[0][0], int(corner_verts.size()) * 3, 0.0f);
+  calc_tangent_spaces(mesh, smooth_vertex_coords, tangent_spaces, nullptr);
 
-  for (l_index = 0; l_index < corner_verts.size(); l_index++) {
-    const int v_index = corner_verts[l_index];
-    float delta[3];
-    sub_v3_v3v3(delta, rest_coords[v_index], smooth_vertex_coords[v_index]);
+  blender::threading::parallel_for(
+      corner_verts.index_range(), 4096, [&](const blender::IndexRange range) {
+        for (const int64_t l_index : range) {
+          const int v_index = corner_verts[l_index];
+          float delta[3];
+          sub_v3_v3v3(delta, rest_coords[v_index], smooth_vertex_coords[v_index]);
 
-    float imat[3][3];
-    if (UNLIKELY(!invert_m3_m3(imat, tangent_spaces[l_index]))) {
-      transpose_m3_m3(imat, tangent_spaces[l_index]);
-    }
-    mul_v3_m3v3(csmd->delta_cache.deltas[l_index], imat, delta);
-  }
+          float imat[3][3];
+          if (UNLIKELY(!invert_m3_m3(imat, tangent_spaces[l_index]))) {
+            transpose_m3_m3(imat, tangent_spaces[l_index]);
+          }
+          mul_v3_m3v3(csmd->delta_cache.deltas[l_index], imat, delta);
+        }
+      });
 
   MEM_SAFE_FREE(tangent_spaces);
 }
@@ -695,29 +646,37 @@ static void correctivesmooth_modifier_do(ModifierData *md,
         MEM_malloc_arrayN(size_t(corner_verts.size()), sizeof(float[3][3]), __func__));
     float *tangent_weights = static_cast<float *>(
         MEM_malloc_arrayN(size_t(corner_verts.size()), sizeof(float), __func__));
-    float *tangent_weights_per_vertex = static_cast<float *>(
-        MEM_malloc_arrayN(size_t(vertexCos.size()), sizeof(float), __func__));
 
-    calc_tangent_spaces(
-        mesh, vertexCos, tangent_spaces, tangent_weights, tangent_weights_per_vertex);
-
-    for (const int64_t l_index : corner_verts.index_range()) {
-      const int v_index = corner_verts[l_index];
-      const float weight = tangent_weights[l_index] / tangent_weights_per_vertex[v_index];
-      if (UNLIKELY(!(weight > 0.0f))) {
-        /* Catches zero & divide by zero. */
-        continue;
-      }
-
-      float delta[3];
-      mul_v3_m3v3(delta, tangent_spaces[l_index], csmd->delta_cache.deltas[l_index]);
-      mul_v3_fl(delta, weight);
-      madd_v3_v3fl(vertexCos[v_index], delta, scale);
-    }
+    calc_tangent_spaces(mesh, vertexCos, tangent_spaces, tangent_weights);
+
+    /* Gather the corners of every vertex, so that vertices can be offset independently. */
+    const blender::GroupedSpan<int> vert_to_corner_map = mesh->vert_to_corner_map();
+    blender::threading::parallel_for(
+        vertexCos.index_range(), 1024, [&](const blender::IndexRange range) {
+          for (const int64_t v_index : range) {
+            const blender::Span<int> vert_corners = vert_to_corner_map[v_index];
+            float tangent_weights_sum = 0.0f;
+            for (const int l_index : vert_corners) {
+              tangent_weights_sum += tangent_weights[l_index];
+            }
+
+            for (const int l_index : vert_corners) {
+              const float weight = tangent_weights[l_index] / tangent_weights_sum;
+              if (UNLIKELY(!(weight > 0.0f))) {
+                /* Catches zero & divide by zero. */
+                continue;
+              }
+
+              float delta[3];
+              mul_v3_m3v3(delta, tangent_spaces[l_index], csmd->delta_cache.deltas[l_index]);
+              mul_v3_fl(delta, weight);
+              madd_v3_v3fl(vertexCos[v_index], delta, scale);
+            }
+          }
+        });
 
     MEM_freeN(tangent_spaces);
     MEM_freeN(tangent_weights);
-    MEM_freeN(tangent_weights_per_vertex);
   }
 
 #ifdef DEBUG_TIME
@@ -6,7 +6,9 @@
  * \ingroup modifiers
  */
 
+#include "BLI_array.hh"
 #include "BLI_math_geom.h"
+#include "BLI_task.hh"
 #include "BLI_utildefines.h"
 
 #include "BLT_translation.hh"
@@ -19,6 +21,8 @@
 #include "MEM_guardedalloc.h"
 
 #include "BKE_deform.hh"
+#include "BKE_mesh.hh"
+#include "BKE_mesh_mapping.hh"
 #include "BKE_modifier.hh"
 
 #include "UI_interface.hh"
@@ -47,6 +51,9 @@ struct LaplacianSystem {
   blender::Span<blender::int2> edges;
   blender::OffsetIndices<int> faces;
   blender::Span<int> corner_verts;
+  blender::Span<int> corner_to_face_map;
+  blender::GroupedSpan<int> vert_to_corner_map;
+  blender::GroupedSpan<int> vert_to_edge_map;
   LinearSolver *context;
 
   /* Data. */
@@ -107,22 +114,28 @@ static float compute_volume(const float center[3],
                             const blender::OffsetIndices<int> faces,
                             const blender::Span<int> corner_verts)
 {
-  float vol = 0.0f;
-
-  for (const int i : faces.index_range()) {
-    const blender::IndexRange face = faces[i];
-    int corner_first = face.start();
-    int corner_prev = corner_first + 1;
-    int corner_curr = corner_first + 2;
-    int corner_term = corner_first + face.size();
-
-    for (; corner_curr != corner_term; corner_prev = corner_curr, corner_curr++) {
-      vol += volume_tetrahedron_signed_v3(center,
-                                          vertexCos[corner_verts[corner_first]],
-                                          vertexCos[corner_verts[corner_prev]],
-                                          vertexCos[corner_verts[corner_curr]]);
-    }
-  }
+  const float vol = blender::threading::parallel_reduce(
+      faces.index_range(),
+      1024,
+      0.0f,
+      [&](const blender::IndexRange range, float vol) {
+        for (const int i : range) {
+          const blender::IndexRange face = faces[i];
+          int corner_first = face.start();
+          int corner_prev = corner_first + 1;
+          int corner_curr = corner_first + 2;
+          int corner_term = corner_first + face.size();
+
+          for (; corner_curr != corner_term; corner_prev = corner_curr, corner_curr++) {
+            vol += volume_tetrahedron_signed_v3(center,
+                                                vertexCos[corner_verts[corner_first]],
+                                                vertexCos[corner_verts[corner_prev]],
+                                                vertexCos[corner_verts[corner_curr]]);
+          }
+        }
+        return vol;
+      },
+      std::plus<>());
 
   return fabsf(vol);
 }
@@ -130,108 +143,128 @@ static float compute_volume(const float center[3],
 static void volume_preservation(LaplacianSystem *sys, float vini, float vend, short flag)
 {
   float beta;
-  int i;
 
   if (vend != 0.0f) {
     beta = pow(vini / vend, 1.0f / 3.0f);
-    for (i = 0; i < sys->verts_num; i++) {
-      if (flag & MOD_LAPLACIANSMOOTH_X) {
-        sys->vertexCos[i][0] = (sys->vertexCos[i][0] - sys->vert_centroid[0]) * beta +
-                               sys->vert_centroid[0];
-      }
-      if (flag & MOD_LAPLACIANSMOOTH_Y) {
-        sys->vertexCos[i][1] = (sys->vertexCos[i][1] - sys->vert_centroid[1]) * beta +
-                               sys->vert_centroid[1];
-      }
-      if (flag & MOD_LAPLACIANSMOOTH_Z) {
-        sys->vertexCos[i][2] = (sys->vertexCos[i][2] - sys->vert_centroid[2]) * beta +
-                               sys->vert_centroid[2];
-      }
-    }
+    blender::threading::parallel_for(
+        blender::IndexRange(sys->verts_num), 4096, [&](const blender::IndexRange range) {
+          for (const int i : range) {
+            if (flag & MOD_LAPLACIANSMOOTH_X) {
+              sys->vertexCos[i][0] = (sys->vertexCos[i][0] - sys->vert_centroid[0]) * beta +
+                                     sys->vert_centroid[0];
+            }
+            if (flag & MOD_LAPLACIANSMOOTH_Y) {
+              sys->vertexCos[i][1] = (sys->vertexCos[i][1] - sys->vert_centroid[1]) * beta +
+                                     sys->vert_centroid[1];
+            }
+            if (flag & MOD_LAPLACIANSMOOTH_Z) {
+              sys->vertexCos[i][2] = (sys->vertexCos[i][2] - sys->vert_centroid[2]) * beta +
+                                     sys->vert_centroid[2];
+            }
+          }
+        });
   }
 }
 
+/**
+ * The weights are computed per edge and per corner first, then gathered for every vertex through
+ * the vertex to edge and vertex to corner maps, so that no two threads write to the same vertex.
+ */
 static void init_laplacian_matrix(LaplacianSystem *sys)
 {
-  float *v1, *v2;
-  float w1, w2, w3;
-  float areaf;
-  int i;
-  uint idv1, idv2;
-
-  for (i = 0; i < sys->edges.size(); i++) {
-    idv1 = sys->edges[i][0];
-    idv2 = sys->edges[i][1];
-
-    v1 = sys->vertexCos[idv1];
-    v2 = sys->vertexCos[idv2];
-
-    sys->ne_ed_num[idv1] = sys->ne_ed_num[idv1] + 1;
-    sys->ne_ed_num[idv2] = sys->ne_ed_num[idv2] + 1;
-    w1 = len_v3v3(v1, v2);
-    if (w1 < sys->min_area) {
-      sys->zerola[idv1] = true;
-      sys->zerola[idv2] = true;
-    }
-    else {
-      w1 = 1.0f / w1;
+  using namespace blender;
+  const Span<int2> edges = sys->edges;
+  const OffsetIndices<int> faces = sys->faces;
+  const Span<int> corner_verts = sys->corner_verts;
+
+  threading::parallel_for(edges.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      const float w1 = len_v3v3(sys->vertexCos[edges[i][0]], sys->vertexCos[edges[i][1]]);
+      sys->eweights[i] = (w1 < sys->min_area) ? w1 : 1.0f / w1;
     }
+  });
+
+  Array<float> corner_areas(corner_verts.size());
+  threading::parallel_for(faces.index_range(), 1024, [&](const IndexRange range) {
+    for (const int i : range) {
+      const IndexRange face = faces[i];
+      int corner_next = face.start();
+      int corner_term = corner_next + face.size();
+      int corner_prev = corner_term - 2;
+      int corner_curr = corner_term - 1;
+
+      for (; corner_next != corner_term;
+           corner_prev = corner_curr, corner_curr = corner_next, corner_next++)
+      {
+        const float *v_prev = sys->vertexCos[corner_verts[corner_prev]];
+        const float *v_curr = sys->vertexCos[corner_verts[corner_curr]];
+        const float *v_next = sys->vertexCos[corner_verts[corner_next]];
 
-    sys->eweights[i] = w1;
-  }
-
-  const blender::Span<int> corner_verts = sys->corner_verts;
-
-  for (const int i : sys->faces.index_range()) {
-    const blender::IndexRange face = sys->faces[i];
-    int corner_next = face.start();
-    int corner_term = corner_next + face.size();
-    int corner_prev = corner_term - 2;
-    int corner_curr = corner_term - 1;
-
-    for (; corner_next != corner_term;
-         corner_prev = corner_curr, corner_curr = corner_next, corner_next++)
-    {
-      const float *v_prev = sys->vertexCos[corner_verts[corner_prev]];
-      const float *v_curr = sys->vertexCos[corner_verts[corner_curr]];
-      const float *v_next = sys->vertexCos[corner_verts[corner_next]];
-
-      sys->ne_fa_num[corner_verts[corner_curr]] += 1;
-
-      areaf = area_tri_v3(v_prev, v_curr, v_next);
+        corner_areas[corner_curr] = area_tri_v3(v_prev, v_curr, v_next);
 
-      if (areaf < sys->min_area) {
-        sys->zerola[corner_verts[corner_curr]] = true;
+        sys->fweights[corner_curr][0] = cotangent_tri_weight_v3(v_curr, v_next, v_prev) / 2.0f;
+        sys->fweights[corner_curr][1] = cotangent_tri_weight_v3(v_next, v_prev, v_curr) / 2.0f;
+        sys->fweights[corner_curr][2] = cotangent_tri_weight_v3(v_prev, v_curr, v_next) / 2.0f;
+      }
+    }
+  });
+
+  threading::parallel_for(IndexRange(sys->verts_num), 1024, [&](const IndexRange range) {
+    for (const int i : range) {
+      const Span<int> vert_edges = sys->vert_to_edge_map[i];
+      const Span<int> vert_corners = sys->vert_to_corner_map[i];
+      bool zerola = false;
+
+      for (const int edge : vert_edges) {
+        if (len_v3v3(sys->vertexCos[edges[edge][0]], sys->vertexCos[edges[edge][1]]) <
+            sys->min_area)
+        {
+          zerola = true;
+        }
       }
 
-      sys->ring_areas[corner_verts[corner_prev]] += areaf;
-      sys->ring_areas[corner_verts[corner_curr]] += areaf;
-      sys->ring_areas[corner_verts[corner_next]] += areaf;
-
-      w1 = cotangent_tri_weight_v3(v_curr, v_next, v_prev) / 2.0f;
-      w2 = cotangent_tri_weight_v3(v_next, v_prev, v_curr) / 2.0f;
-      w3 = cotangent_tri_weight_v3(v_prev, v_curr, v_next) / 2.0f;
-
-      sys->fweights[corner_curr][0] += w1;
-      sys->fweights[corner_curr][1] += w2;
-      sys->fweights[corner_curr][2] += w3;
+      /* The vertex is the current corner of its own triangle, the next corner of the triangle
+       * of the previous corner and the previous corner of the triangle of the next corner. */
+      float ring_area = 0.0f;
+      float vweight = 0.0f;
+      for (const int corner : vert_corners) {
+        const IndexRange face = faces[sys->corner_to_face_map[corner]];
+        const int corner_prev = bke::mesh::face_corner_prev(face, corner);
+        const int corner_next = bke::mesh::face_corner_next(face, corner);
+
+        if (corner_areas[corner] < sys->min_area) {
+          zerola = true;
+        }
+        ring_area += corner_areas[corner_prev] + corner_areas[corner] + corner_areas[corner_next];
+        vweight += sys->fweights[corner][1] + sys->fweights[corner][2];
+        vweight += sys->fweights[corner_prev][0] + sys->fweights[corner_prev][2];
+        vweight += sys->fweights[corner_next][0] + sys->fweights[corner_next][1];
+      }
 
-      sys->vweights[corner_verts[corner_curr]] += w2 + w3;
-      sys->vweights[corner_verts[corner_next]] += w1 + w3;
-      sys->vweights[corner_verts[corner_prev]] += w1 + w2;
+      sys->ne_ed_num[i] = short(vert_edges.size());
+      sys->ne_fa_num[i] = short(vert_corners.size());
+      sys->zerola[i] = zerola;
+      sys->ring_areas[i] = ring_area;
+      sys->vweights[i] = vweight;
     }
-  }
-  for (i = 0; i < sys->edges.size(); i++) {
-    idv1 = sys->edges[i][0];
-    idv2 = sys->edges[i][1];
-    /* if is boundary, apply scale-dependent umbrella operator only with neighbors in boundary */
-    if (sys->ne_ed_num[idv1] != sys->ne_fa_num[idv1] &&
-        sys->ne_ed_num[idv2] != sys->ne_fa_num[idv2])
-    {
-      sys->vlengths[idv1] += sys->eweights[i];
-      sys->vlengths[idv2] += sys->eweights[i];
+  });
+
+  threading::parallel_for(IndexRange(sys->verts_num), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      /* if is boundary, apply scale-dependent umbrella operator only with neighbors in boundary */
+      if (sys->ne_ed_num[i] == sys->ne_fa_num[i]) {
+        continue;
+      }
+      float vlength = 0.0f;
+      for (const int edge : sys->vert_to_edge_map[i]) {
+        const int other = bke::mesh::edge_other_vert(edges[edge], i);
+        if (sys->ne_ed_num[other] != sys->ne_fa_num[other]) {
+          vlength += sys->eweights[edge];
+        }
+      }
+      sys->vlengths[i] = vlength;
     }
-  }
+  });
 }
 
 static void fill_laplacian_matrix(LaplacianSystem *sys)
@@ -316,31 +349,36 @@ static void fill_laplacian_matrix(LaplacianSystem *sys)
 
 static void validate_solution(LaplacianSystem *sys, short flag, float lambda, float lambda_border)
 {
-  int i;
-  float lam;
   float vini = 0.0f, vend = 0.0f;
 
   if (flag & MOD_LAPLACIANSMOOTH_PRESERVE_VOLUME) {
     vini = compute_volume(sys->vert_centroid, sys->vertexCos, sys->faces, sys->corner_verts);
   }
-  for (i = 0; i < sys->verts_num; i++) {
-    if (sys->zerola[i] == false) {
-      lam = sys->ne_ed_num[i] == sys->ne_fa_num[i] ? (lambda >= 0.0f ? 1.0f : -1.0f) :
-                                                     (lambda_border >= 0.0f ? 1.0f : -1.0f);
-      if (flag & MOD_LAPLACIANSMOOTH_X) {
-        sys->vertexCos[i][0] += lam * (float(EIG_linear_solver_variable_get(sys->context, 0, i)) -
+  blender::threading::parallel_for(
+      blender::IndexRange(sys->verts_num), 4096, [&](const blender::IndexRange range) {
+        for (const int i : range) {
+          if (sys->zerola[i] == false) {
+            const float lam = sys->ne_ed_num[i] == sys->ne_fa_num[i] ?
+                                  (lambda >= 0.0f ? 1.0f : -1.0f) :
+                                  (lambda_border >= 0.0f ? 1.0f : -1.0f);
+            if (flag & MOD_LAPLACIANSMOOTH_X) {
+              sys->vertexCos[i][0] += lam *
+                                      (float(EIG_linear_solver_variable_get(sys->context, 0, i)) -
                                        sys->vertexCos[i][0]);
-      }
-      if (flag & MOD_LAPLACIANSMOOTH_Y) {
-        sys->vertexCos[i][1] += lam * (float(EIG_linear_solver_variable_get(sys->context, 1, i)) -
+            }
+            if (flag & MOD_LAPLACIANSMOOTH_Y) {
+              sys->vertexCos[i][1] += lam *
+                                      (float(EIG_linear_solver_variable_get(sys->context, 1, i)) -
                                        sys->vertexCos[i][1]);
-      }
-      if (flag & MOD_LAPLACIANSMOOTH_Z) {
-        sys->vertexCos[i][2] += lam * (float(EIG_linear_solver_variable_get(sys->context, 2, i)) -
+            }
+            if (flag & MOD_LAPLACIANSMOOTH_Z) {
+              sys->vertexCos[i][2] += lam *
+                                      (float(EIG_linear_solver_variable_get(sys->context, 2, i)) -
                                        sys->vertexCos[i][2]);
-      }
-    }
-  }
+            }
+          }
+        }
+      });
   if (flag & MOD_LAPLACIANSMOOTH_PRESERVE_VOLUME) {
     vend = compute_volume(sys->vert_centroid, sys->vertexCos, sys->faces, sys->corner_verts);
     volume_preservation(sys, vini, vend, flag);
@@ -366,6 +404,12 @@ static void laplaciansmoothModifier_do(
   sys->edges = mesh->edges();
   sys->faces = mesh->faces();
   sys->corner_verts = mesh->corner_verts();
+  sys->corner_to_face_map = mesh->corner_to_face_map();
+  sys->vert_to_corner_map = mesh->vert_to_corner_map();
+  blender::Array<int> vert_to_edge_offsets;
+  blender::Array<int> vert_to_edge_indices;
+  sys->vert_to_edge_map = blender::bke::mesh::build_vert_to_edge_map(
+      sys->edges, verts_num, vert_to_edge_offsets, vert_to_edge_indices);
   sys->vertexCos = vertexCos;
   sys->min_area = 0.00001f;
   MOD_get_vgroup(ob, mesh, smd->defgrp_name, &dvert, &defgrp_index);
@@ -6,9 +6,28 @@
  * \ingroup modifiers
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+
+#include "BLI_endian_switch.h"
+#include "BLI_fileops.h"
 #include "BLI_math_base.h"
+#include "BLI_math_vector.h"
+#include "BLI_mmap.h"
+#include "BLI_task.hh"
 #include "BLI_utildefines.h"
 
+#ifdef WIN32
+#  include "BLI_winstuff.h"
+#else
+#  include <unistd.h>
+#endif
+
+#include "BLT_translation.hh"
+
 #include "DNA_modifier_types.h"
 
 #include "MOD_meshcache_util.hh"
@@ -49,3 +68,185 @@ void MOD_meshcache_calc_range(const float frame,
     }
   }
 }
+
+MeshCacheFile::~MeshCacheFile()
+{
+  if (mmap_file) {
+    BLI_mmap_free(mmap_file);
+  }
+}
+
+void MOD_meshcache_file_free(MeshCacheFile *file)
+{
+  MEM_delete(file);
+}
+
+/** Identifies the file on disk, zero where it is not available. */
+static uint64_t file_inode(const BLI_stat_t &st)
+{
+#ifdef WIN32
+  UNUSED_VARS(st);
+  return 0;
+#else
+  return uint64_t(st.st_ino);
+#endif
+}
+
+static size_t file_head_size(const char type)
+{
+  switch (type) {
+    case MOD_MESHCACHE_TYPE_MDD:
+      return MOD_meshcache_mdd_head_size();
+    case MOD_MESHCACHE_TYPE_PC2:
+      return MOD_meshcache_pc2_head_size();
+  }
+  return 0;
+}
+
+MeshCacheFile *MOD_meshcache_file_ensure(MeshCacheFile **file_p,
+                                         const char *filepath,
+                                         const char type,
+                                         const char **err_str)
+{
+  BLI_stat_t st;
+  errno = 0;
+  if (BLI_stat(filepath, &st) != 0) {
+    MOD_meshcache_file_free(*file_p);
+    *file_p = nullptr;
+    *err_str = errno ? strerror(errno) : RPT_("Unknown error opening file");
+    return nullptr;
+  }
+
+  MeshCacheFile *file = *file_p;
+  if (file && file->type == type && file->filepath == filepath &&
+      file->mtime == int64_t(st.st_mtime) && file->size == int64_t(st.st_size) &&
+      file->inode == file_inode(st))
+  {
+    return file;
+  }
+  MOD_meshcache_file_free(file);
+  *file_p = nullptr;
+
+  const int fd = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+  if (fd == -1) {
+    *err_str = errno ? strerror(errno) : RPT_("Unknown error opening file");
+    return nullptr;
+  }
+  /* The file may have been replaced since it was checked above, use what was actually opened. */
+  if (BLI_fstat(fd, &st) != 0) {
+    *err_str = errno ? strerror(errno) : RPT_("Unknown error opening file");
+    close(fd);
+    return nullptr;
+  }
+  /* Empty files can't be mapped, report them like any other file that is too short. */
+  if (size_t(st.st_size) < file_head_size(type)) {
+    *err_str = RPT_("Missing header");
+    close(fd);
+    return nullptr;
+  }
+  /* The mapping stays valid after the file has been closed. */
+  BLI_mmap_file *mmap_file = BLI_mmap_open(fd);
+  close(fd);
+  if (mmap_file == nullptr) {
+    *err_str = RPT_("Failed to map file");
+    return nullptr;
+  }
+
+  file = MEM_new<MeshCacheFile>(__func__);
+  file->filepath = filepath;
+  file->type = type;
+  file->mtime = int64_t(st.st_mtime);
+  file->size = int64_t(st.st_size);
+  file->inode = file_inode(st);
+  file->mmap_file = mmap_file;
+
+  bool ok;
+  switch (type) {
+    case MOD_MESHCACHE_TYPE_MDD:
+      ok = MOD_meshcache_read_mdd_head(file, err_str);
+      break;
+    case MOD_MESHCACHE_TYPE_PC2:
+      ok = MOD_meshcache_read_pc2_head(file, err_str);
+      break;
+    default:
+      ok = false;
+      break;
+  }
+  if (!ok) {
+    MOD_meshcache_file_free(file);
+    return nullptr;
+  }
+
+  *file_p = file;
+  return file;
+}
+
+/** Number of vertices that are interpolated at once, their positions fit into the L1 cache. */
+static constexpr int64_t interp_chunk_size = 1024;
+
+bool MOD_meshcache_read_frame(MeshCacheFile *file,
+                              float (*vertexCos)[3],
+                              const int verts_tot,
+                              const char interp,
+                              const float frame,
+                              const char **err_str)
+{
+  using namespace blender;
+  if (file->verts_tot != verts_tot) {
+    *err_str = RPT_("Vertex count mismatch");
+    return false;
+  }
+
+  int index_range[2];
+  float factor;
+  MOD_meshcache_calc_range(frame, interp, file->frame_tot, index_range, &factor);
+
+  const size_t frame_size = sizeof(float[3]) * size_t(verts_tot);
+  const size_t offset_a = file->frames_offset + frame_size * size_t(index_range[0]);
+  const size_t offset_b = file->frames_offset + frame_size * size_t(index_range[1]);
+  const bool use_interp = index_range[0] != index_range[1];
+
+  /* Copy whole ranges of positions instead of reading them one by one, and blend the second frame
+   * in small chunks that are still in the cache. */
+  std::atomic<bool> ok = true;
+  threading::parallel_for(IndexRange(verts_tot), 4096, [&](const IndexRange range) {
+    for (int64_t start = range.start(); start < range.one_after_last();
+         start += interp_chunk_size)
+    {
+      const int64_t size = std::min(interp_chunk_size, range.one_after_last() - start);
+      float(*dst)[3] = vertexCos + start;
+      const size_t chunk_offset = sizeof(float[3]) * size_t(start);
+      const size_t chunk_size = sizeof(float[3]) * size_t(size);
+      if (!BLI_mmap_read(file->mmap_file, dst, offset_a + chunk_offset, chunk_size)) {
+        ok = false;
+        return;
+      }
+      if (file->switch_endian) {
+        BLI_endian_switch_float_array(dst[0], int(size * 3));
+      }
+      if (!use_interp) {
+        continue;
+      }
+      float tmp[interp_chunk_size][3];
+      if (!BLI_mmap_read(file->mmap_file, tmp, offset_b + chunk_offset, chunk_size)) {
+        ok = false;
+        return;
+      }
+      if (file->switch_endian) {
+        BLI_endian_switch_float_array(tmp[0], int(size * 3));
+      }
+      interp_vn_vn(dst[0], tmp[0], factor, int(size * 3));
+    }
+  });
+  if (!ok) {
+    *err_str = RPT_("Vertex coordinate read failed");
+    return false;
+  }
+
+  const int next_index = index_range[1] + 1;
+  if (next_index < file->frame_tot) {
+    BLI_mmap_prefetch(
+        file->mmap_file, file->frames_offset + frame_size * size_t(next_index), frame_size);
+  }
+  return true;
+}
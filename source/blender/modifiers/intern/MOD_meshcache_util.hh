@@ -8,17 +8,53 @@
 
 #pragma once
 
+#include <cstdint>
+#include <string>
+
+#include "MEM_guardedalloc.h"
+
+struct BLI_mmap_file;
+
+/**
+ * A memory-mapped cache file. It's stored as runtime data of the modifier and kept open across
+ * evaluations, so that playback only has to copy the vertex positions of the current frame.
+ */
+struct MeshCacheFile {
+  /** The file is opened again when any of these change. */
+  std::string filepath;
+  char type = 0;
+  int64_t mtime = 0;
+  int64_t size = 0;
+  /** Detects files that were replaced within the resolution of `mtime`, zero on WIN32. */
+  uint64_t inode = 0;
+
+  BLI_mmap_file *mmap_file = nullptr;
+
+  int verts_tot = 0;
+  int frame_tot = 0;
+  /** Byte offset of the first frame, every frame has `verts_tot` positions. */
+  size_t frames_offset = 0;
+  /** The file doesn't use the byte order of this machine. */
+  bool switch_endian = false;
+
+  /* PC2 only. */
+  float start = 0.0f;
+  float sampling = 1.0f;
+
+  /* MDD only: byte offset of `frame_tot` time stamps. */
+  size_t times_offset = 0;
+
+  ~MeshCacheFile();
+
+  MEM_CXX_CLASS_ALLOC_FUNCS("MeshCacheFile")
+};
+
 /* `MOD_meshcache_mdd.cc` */
 
-bool MOD_meshcache_read_mdd_index(
-    FILE *fp, float (*vertexCos)[3], int verts_tot, int index, float factor, const char **err_str);
-bool MOD_meshcache_read_mdd_frame(FILE *fp,
-                                  float (*vertexCos)[3],
-                                  int verts_tot,
-                                  char interp,
-                                  float frame,
-                                  const char **err_str);
-bool MOD_meshcache_read_mdd_times(const char *filepath,
+/** Size of the file header, smaller files are rejected without mapping them. */
+size_t MOD_meshcache_mdd_head_size();
+bool MOD_meshcache_read_mdd_head(MeshCacheFile *file, const char **err_str);
+bool MOD_meshcache_read_mdd_times(MeshCacheFile *file,
                                   float (*vertexCos)[3],
                                   int verts_tot,
                                   char interp,
@@ -29,15 +65,9 @@ bool MOD_meshcache_read_mdd_times(const char *filepath,
 
 /* `MOD_meshcache_pc2.cc` */
 
-bool MOD_meshcache_read_pc2_index(
-    FILE *fp, float (*vertexCos)[3], int verts_tot, int index, float factor, const char **err_str);
-bool MOD_meshcache_read_pc2_frame(FILE *fp,
-                                  float (*vertexCos)[3],
-                                  int verts_tot,
-                                  char interp,
-                                  float frame,
-                                  const char **err_str);
-bool MOD_meshcache_read_pc2_times(const char *filepath,
+size_t MOD_meshcache_pc2_head_size();
+bool MOD_meshcache_read_pc2_head(MeshCacheFile *file, const char **err_str);
+bool MOD_meshcache_read_pc2_times(MeshCacheFile *file,
                                   float (*vertexCos)[3],
                                   int verts_tot,
                                   char interp,
@@ -51,4 +81,28 @@ bool MOD_meshcache_read_pc2_times(const char *filepath,
 void MOD_meshcache_calc_range(
     float frame, char interp, int frame_tot, int r_index_range[2], float *r_factor);
 
+/**
+ * Get the mapped file for \a filepath, reusing \a *file_p when the file did not change since it
+ * was opened. Returns null and frees the previous file on failure.
+ *
+ * \note On WIN32 a mapped file can't be replaced or truncated, callers should free the file once
+ * the frame has been read to avoid blocking the cache from being exported again.
+ */
+MeshCacheFile *MOD_meshcache_file_ensure(MeshCacheFile **file_p,
+                                         const char *filepath,
+                                         char type,
+                                         const char **err_str);
+void MOD_meshcache_file_free(MeshCacheFile *file);
+
+/**
+ * Read the positions of the given (possibly fractional) frame, interpolating between two frames
+ * if necessary. The following frame is prefetched, assuming forward playback.
+ */
+bool MOD_meshcache_read_frame(MeshCacheFile *file,
+                              float (*vertexCos)[3],
+                              int verts_tot,
+                              char interp,
+                              float frame,
+                              const char **err_str);
+
 #define FRAME_SNAP_EPS 0.0001f
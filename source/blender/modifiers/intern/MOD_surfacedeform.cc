@@ -9,6 +9,7 @@
 #include "BLI_math_geom.h"
 #include "BLI_math_matrix.h"
 #include "BLI_task.h"
+#include "BLI_task.hh"
 
 #include "BLT_translation.hh"
 
@@ -1273,13 +1274,18 @@ static bool surfacedeformBind(Object *ob,
 
   invert_m4_m4(data.imat, smd_orig->mat);
 
-  for (int i = 0; i < target_verts_num; i++) {
-    mul_v3_m4v3(data.targetCos[i], smd_orig->mat, positions[i]);
-  }
+  blender::threading::parallel_for(
+      positions.index_range(), 4096, [&](const blender::IndexRange range) {
+        for (const int i : range) {
+          mul_v3_m4v3(data.targetCos[i], smd_orig->mat, positions[i]);
+        }
+      });
 
+  /* Binding a single vertex involves a BVH lookup and weights for all of its nearby faces, so
+   * it's worth distributing even small meshes over multiple threads. */
   TaskParallelSettings settings;
   BLI_parallel_range_settings_defaults(&settings);
-  settings.use_threading = (verts_num > 10000);
+  settings.min_iter_per_thread = 64;
   BLI_task_parallel_range(0, verts_num, &data, bindVert, &settings);
 
   MEM_freeN(data.targetCos);
@@ -1979,6 +1979,8 @@ static bool wm_file_write(bContext *C,
                           int fileflags,
                           eBLO_WritePathRemap remap_mode,
                           bool use_save_as_copy,
+                          int compress_level,
+                          int compress_chunk_size,
                           ReportList *reports)
 {
   Main *bmain = CTX_data_main(C);
@@ -2079,6 +2081,8 @@ static bool wm_file_write(bContext *C,
   blend_write_params.use_save_versions = true;
   blend_write_params.use_save_as_copy = use_save_as_copy;
   blend_write_params.thumb = thumb;
+  blend_write_params.compress_level = compress_level;
+  blend_write_params.compress_chunk_size = compress_chunk_size;
 
   const bool success = BLO_write_file(bmain, filepath, fileflags, &blend_write_params, reports);
 
@@ -2184,7 +2188,8 @@ void WM_autosave_write(wmWindowManager *wm, Main *bmain)
 
   char filepath[FILE_MAX];
   wm_autosave_location(filepath);
-  /* Save as regular blend file with recovery information. */
+  /* Save as regular blend file with recovery information. Never compressed, even with the
+   * fastest compression level writing uncompressed is faster. */
   const int fileflags = (G.fileflags & ~G_FILE_COMPRESS) | G_FILE_RECOVER_WRITE;
 
   /* Error reporting into console. */
@@ -3557,8 +3562,14 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
   /* Set compression flag. */
   SET_FLAG_FROM_TEST(fileflags, RNA_boolean_get(op->ptr, "compress"), G_FILE_COMPRESS);
 
-  const bool success = wm_file_write(
-      C, filepath, fileflags, remap_mode, use_save_as_copy, op->reports);
+  const bool success = wm_file_write(C,
+                                    filepath,
+                                    fileflags,
+                                    remap_mode,
+                                    use_save_as_copy,
+                                    RNA_int_get(op->ptr, "compression_level"),
+                                    RNA_int_get(op->ptr, "compression_chunk_size") * 1024,
+                                    op->reports);
 
   if ((op->flag & OP_IS_INVOKE) == 0) {
     /* OP_IS_INVOKE is set when the operator is called from the GUI.
@@ -3627,6 +3638,33 @@ static std::string wm_save_as_mainfile_get_description(bContext * /*C*/,
   return "";
 }
 
+static void wm_save_compression_properties_def(wmOperatorType *ot)
+{
+  PropertyRNA *prop;
+  prop = RNA_def_int(ot->srna,
+                     "compression_level",
+                     0,
+                     0,
+                     22,
+                     "Compression Level",
+                     "Zstandard level used when writing a compressed file, lower levels save "
+                     "faster and higher levels give smaller files (zero for the default)",
+                     0,
+                     22);
+  RNA_def_property_flag(prop, PropertyFlag(PROP_HIDDEN | PROP_SKIP_SAVE));
+  prop = RNA_def_int(ot->srna,
+                     "compression_chunk_size",
+                     0,
+                     0,
+                     65536,
+                     "Compression Chunk Size",
+                     "Size in KiB of the chunks that are compressed in parallel when writing a "
+                     "compressed file (zero for the default)",
+                     0,
+                     65536);
+  RNA_def_property_flag(prop, PropertyFlag(PROP_HIDDEN | PROP_SKIP_SAVE));
+}
+
 void WM_OT_save_as_mainfile(wmOperatorType *ot)
 {
   PropertyRNA *prop;
@@ -3650,6 +3688,7 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_DEFAULT);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  wm_save_compression_properties_def(ot);
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   true,
@@ -3737,6 +3776,7 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_DEFAULT);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  wm_save_compression_properties_def(ot);
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   false,
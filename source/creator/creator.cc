@@ -349,6 +349,12 @@ int main(int argc,
         MEM_use_guarded_allocator();
         break;
       }
+      if (STREQ(argv[i], "--enable-memory-arenas")) {
+        MEM_use_lockfree_arena_allocator();
+      }
+      if (STREQ(argv[i], "--debug-memory-tags")) {
+        MEM_use_memory_tag_tracking(true);
+      }
       if (STR_ELEM(argv[i], "--", "--command")) {
         break;
       }
@@ -738,6 +738,7 @@ static void print_help(bArgs *ba, bool all)
     BLI_args_print_arg_doc(ba, "--debug-cycles");
   }
   BLI_args_print_arg_doc(ba, "--debug-memory");
+  BLI_args_print_arg_doc(ba, "--debug-memory-tags");
   BLI_args_print_arg_doc(ba, "--debug-jobs");
   BLI_args_print_arg_doc(ba, "--debug-python");
   BLI_args_print_arg_doc(ba, "--debug-depsgraph");
@@ -788,6 +789,9 @@ static void print_help(bArgs *ba, bool all)
   BLI_args_print_arg_doc(ba, "--app-template");
   BLI_args_print_arg_doc(ba, "--factory-startup");
   BLI_args_print_arg_doc(ba, "--enable-event-simulate");
+  BLI_args_print_arg_doc(ba, "--enable-memory-arenas");
+  BLI_args_print_arg_doc(ba, "--lazy-data");
+  BLI_args_print_arg_doc(ba, "--profile-file-read");
   PRINT("\n");
   BLI_args_print_arg_doc(ba, "--env-system-datafiles");
   BLI_args_print_arg_doc(ba, "--env-system-scripts");
@@ -990,6 +994,16 @@ static int arg_handle_crash_handler_disable(int /*argc*/, const char ** /*argv*/
   return 0;
 }
 
+static const char arg_handle_memory_arenas_enable_doc[] =
+    "\n\t"
+    "Allocate small memory blocks from per-thread arenas, to reduce allocator contention.\n"
+    "\tIgnored when the fully guarded memory allocator is used (see '--debug-memory').";
+static int arg_handle_memory_arenas_enable(int /*argc*/, const char ** /*argv*/, void * /*data*/)
+{
+  /* The allocator is switched in `main`, before any allocation happened. */
+  return 0;
+}
+
 static const char arg_handle_abort_handler_disable_doc[] =
     "\n\t"
     "Disable the abort handler.";
@@ -1363,6 +1377,19 @@ static int arg_handle_debug_mode_memory_set(int /*argc*/, const char ** /*argv*/
   return 0;
 }
 
+static const char arg_handle_debug_mode_memory_tags_set_doc[] =
+    "\n\t"
+    "Track memory usage per allocation name and thread, with little overhead.\n"
+    "\tThe usage is printed by the memory statistics operator.\n"
+    "\tIgnored when the fully guarded memory allocator is used (see '--debug-memory').";
+static int arg_handle_debug_mode_memory_tags_set(int /*argc*/,
+                                                 const char ** /*argv*/,
+                                                 void * /*data*/)
+{
+  /* Tracking is enabled in `main`, before any allocation happened. */
+  return 0;
+}
+
 static const char arg_handle_debug_value_set_doc[] =
     "<value>\n"
     "\tSet debug value of <value> on startup.";
@@ -1566,6 +1593,34 @@ static int arg_handle_enable_event_simulate(int /*argc*/, const char ** /*argv*/
   return 0;
 }
 
+static const char arg_handle_lazy_data_set_doc[] =
+    "\n\t"
+    "Only read large data arrays from blend-files when they are used, referencing the\n"
+    "\tmemory-mapped file instead of copying it where possible.\n"
+    "\tFiles must not be modified in-place while Blender is running.";
+static int arg_handle_lazy_data_set(int /*argc*/, const char ** /*argv*/, void * /*data*/)
+{
+  G.f |= G_FLAG_READFILE_LAZY_DATA;
+  return 0;
+}
+
+static const char arg_handle_profile_file_read_set_doc[] =
+    "<filepath>\n"
+    "\tWrite a JSON report of the time spent reading blend-files (per data-block type and\n"
+    "\tversioning step), with the amount of data read and memory blocks allocated.\n"
+    "\tThe report of each read file replaces the previous one.";
+static int arg_handle_profile_file_read_set(int argc, const char **argv, void * /*data*/)
+{
+  const char *arg_id = "--profile-file-read";
+  if (argc > 1) {
+    STRNCPY(G.filepath_read_profile, argv[1]);
+    BLI_path_abs_from_cwd(G.filepath_read_profile, sizeof(G.filepath_read_profile));
+    return 1;
+  }
+  fprintf(stderr, "\nError: '%s' no args given.\n", arg_id);
+  return 0;
+}
+
 static const char arg_handle_env_system_set_doc_datafiles[] =
     "\n\t"
     "Set the " STRINGIFY_ARG(BLENDER_SYSTEM_DATAFILES) " environment variable.";
@@ -2636,6 +2691,8 @@ void main_args_setup(bContext *C, bArgs *ba, bool all)
       ba, nullptr, "--disable-crash-handler", CB(arg_handle_crash_handler_disable), nullptr);
   BLI_args_add(
       ba, nullptr, "--disable-abort-handler", CB(arg_handle_abort_handler_disable), nullptr);
+  BLI_args_add(
+      ba, nullptr, "--enable-memory-arenas", CB(arg_handle_memory_arenas_enable), nullptr);
 
   BLI_args_add(ba, "-b", "--background", CB(arg_handle_background_mode_set), nullptr);
   /* Command implies background mode (defers execution). */
@@ -2712,6 +2769,8 @@ void main_args_setup(bContext *C, bArgs *ba, bool all)
     BLI_args_add(ba, nullptr, "--debug-cycles", CB(arg_handle_debug_mode_cycles), nullptr);
   }
   BLI_args_add(ba, nullptr, "--debug-memory", CB(arg_handle_debug_mode_memory_set), nullptr);
+  BLI_args_add(
+      ba, nullptr, "--debug-memory-tags", CB(arg_handle_debug_mode_memory_tags_set), nullptr);
 
   BLI_args_add(ba, nullptr, "--debug-value", CB(arg_handle_debug_value_set), nullptr);
   BLI_args_add(ba,
@@ -2784,6 +2843,8 @@ void main_args_setup(bContext *C, bArgs *ba, bool all)
   BLI_args_add(ba, nullptr, "--factory-startup", CB(arg_handle_factory_startup_set), nullptr);
   BLI_args_add(
       ba, nullptr, "--enable-event-simulate", CB(arg_handle_enable_event_simulate), nullptr);
+  BLI_args_add(ba, nullptr, "--lazy-data", CB(arg_handle_lazy_data_set), nullptr);
+  BLI_args_add(ba, nullptr, "--profile-file-read", CB(arg_handle_profile_file_read_set), nullptr);
 
   /* Pass: Custom Window Stuff. */
   BLI_args_pass_set(ba, ARG_PASS_SETTINGS_GUI);
@@ -0,0 +1,77 @@
+# SPDX-FileCopyrightText: 2024 Blender Authors
+#
+# SPDX-License-Identifier: Apache-2.0
+
+import api
+
+
+def _run(args):
+    import bpy
+    import json
+    import os
+    import time
+
+    # Save the file with the current version, so that loading it should need (almost) no
+    # versioning.
+    bpy.ops.wm.open_mainfile(filepath=args['filepath'])
+    bpy.ops.wm.save_as_mainfile(filepath=args['current_filepath'], copy=True)
+    bpy.ops.wm.read_homefile(use_empty=True, use_factory_startup=True)
+
+    # Load once to ensure it's cached by OS
+    bpy.ops.wm.open_mainfile(filepath=args['current_filepath'])
+    bpy.ops.wm.read_homefile(use_empty=True, use_factory_startup=True)
+
+    # Measure loading the second time
+    start_time = time.time()
+    bpy.ops.wm.open_mainfile(filepath=args['current_filepath'])
+    elapsed_time = time.time() - start_time
+
+    result = {'time': elapsed_time}
+
+    # Time spent in versioning, from the read profile (see `--profile-file-read`).
+    if os.path.exists(args['profile_filepath']):
+        with open(args['profile_filepath']) as f:
+            profile = json.load(f)
+        result['versioning_time'] = sum(step['duration'] for step in profile['versioning'])
+
+    return result
+
+
+class BlendLoadVersioningTest(api.Test):
+    def __init__(self, filepath):
+        self.filepath = filepath
+
+    def name(self):
+        return self.filepath.stem
+
+    def category(self):
+        return "blend_load_versioning"
+
+    def run(self, env, device_id):
+        import pathlib
+        import tempfile
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            tmpdir = pathlib.Path(tmpdir)
+            args = {
+                'filepath': str(self.filepath),
+                'current_filepath': str(tmpdir / 'current.blend'),
+                'profile_filepath': str(tmpdir / 'read_profile.json'),
+            }
+            blender_args = []
+            if _supports_profile_file_read(env):
+                blender_args = ['--profile-file-read', args['profile_filepath']]
+            result, _ = env.run_in_blender(_run, args, blender_args)
+        return result
+
+
+def _supports_profile_file_read(env):
+    # Older revisions don't have the argument and would fail on it, only measure the total load
+    # time for them.
+    lines = env.call_blender(['--help'])
+    return any('--profile-file-read' in line for line in lines)
+
+
+def generate(env):
+    filepaths = env.find_blend_files('*/*')
+    return [BlendLoadVersioningTest(filepath) for filepath in filepaths]
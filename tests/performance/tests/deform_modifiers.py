@@ -0,0 +1,98 @@
+# SPDX-FileCopyrightText: 2024 Blender Authors
+#
+# SPDX-License-Identifier: Apache-2.0
+
+import api
+
+
+def prepare_scene(args):
+    import bpy
+    import numpy as np
+
+    bpy.ops.wm.read_homefile(use_empty=True, use_factory_startup=True)
+
+    # A grid with about one million vertices, with some noise so that smoothing has work to do.
+    size = 1000
+    bpy.ops.mesh.primitive_grid_add(x_subdivisions=size, y_subdivisions=size, size=2.0)
+    ob = bpy.context.object
+    mesh = ob.data
+
+    positions = np.empty(len(mesh.vertices) * 3, dtype=np.float32)
+    mesh.vertices.foreach_get("co", positions)
+    rng = np.random.default_rng(0)
+    positions[2::3] = rng.uniform(-0.01, 0.01, len(mesh.vertices))
+    mesh.vertices.foreach_set("co", positions)
+    mesh.update()
+
+    md = ob.modifiers.new("Test", args['modifier_type'])
+    md.iterations = 10
+    return ob
+
+
+def _run(args):
+    import bpy
+    import time
+
+    ob = prepare_scene(args)
+
+    # Evaluate once first, to avoid measuring any possible lazy initialization.
+    bpy.context.view_layer.update()
+
+    test_time_start = time.time()
+    measured_times = []
+
+    min_measurements = 5
+    max_measurements = 100
+    timeout = 5
+
+    while True:
+        ob.update_tag()
+
+        start_time = time.time()
+        bpy.context.view_layer.update()
+        elapsed_time = time.time() - start_time
+        measured_times.append(elapsed_time)
+
+        if len(measured_times) >= min_measurements and test_time_start + timeout < time.time():
+            break
+        if len(measured_times) >= max_measurements:
+            break
+
+    average_time = sum(measured_times) / len(measured_times)
+    result = {'time': average_time}
+    return result
+
+
+class DeformModifierTest(api.Test):
+    def __init__(self, modifier_type, threads):
+        self.modifier_type = modifier_type
+        self.threads = threads
+
+    def name(self):
+        name = self.modifier_type.lower()
+        if self.threads == 1:
+            # Compare against the multi-threaded test to see how evaluation scales with the cores.
+            name += "_single_thread"
+        return name
+
+    def category(self):
+        return "deform_modifiers"
+
+    def run(self, env, device_id):
+        args = {'modifier_type': self.modifier_type}
+
+        blender_args = []
+        if self.threads != 0:
+            blender_args = ['--threads', str(self.threads)]
+        result, _ = env.run_in_blender(_run, args, blender_args)
+
+        return result
+
+
+def generate(env):
+    tests = []
+    for modifier_type in ('CORRECTIVE_SMOOTH', 'LAPLACIANSMOOTH'):
+        # Zero uses all available threads.
+        for threads in (0, 1):
+            tests.append(DeformModifierTest(modifier_type, threads))
+    return tests